@@ -1,4 +1,5 @@
 include(CheckCSourceCompiles)
+include(CheckLibraryExists)
 
 check_c_source_compiles("
 int main(void) {
@@ -85,6 +86,58 @@ int main(void) {
     return 0;
 }" SPR_HAVE_SC_NPROC)
 
+check_c_source_compiles("
+#include <sys/uio.h>
+int main(void) {
+    struct iovec iov;
+    preadv(0, &iov, 1, 0);
+    pwritev(0, &iov, 1, 0);
+    return 0;
+}" SPR_HAVE_PREADV)
+
+check_c_source_compiles("
+#define _GNU_SOURCE
+#include <unistd.h>
+int main(void) {
+    copy_file_range(0, NULL, 1, NULL, 1, 0);
+    return 0;
+}" SPR_HAVE_COPY_FILE_RANGE)
+
+check_c_source_compiles("
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+int main(void) {
+    struct io_uring_params p = {0};
+    syscall(__NR_io_uring_setup, 8, &p);
+    return IORING_OP_READ + IORING_FEAT_RW_CUR_POS;
+}" SPR_HAVE_IO_URING)
+
+check_c_source_compiles("
+#include <unistd.h>
+int main(void) {
+    return fdatasync(0);
+}" SPR_HAVE_FDATASYNC)
+
+check_c_source_compiles("
+#include <fcntl.h>
+int main(void) {
+    return posix_fallocate(0, 0, 1);
+}" SPR_HAVE_POSIX_FALLOCATE)
+
+check_library_exists(rt shm_open "" SPR_HAVE_LIBRT)
+if (SPR_HAVE_LIBRT)
+    list(APPEND CMAKE_REQUIRED_LIBRARIES rt)
+endif()
+
+check_c_source_compiles("
+#include <fcntl.h>
+#include <sys/mman.h>
+int main(void) {
+    shm_open(\"/spr\", O_RDWR|O_CREAT, 0600);
+    return 0;
+}" SPR_HAVE_SHM_OPEN)
+
 set(CMAKE_REQUIRED_LINK_OPTIONS -lpthread)
 check_c_source_compiles("
 #include <semaphore.h>
@@ -101,6 +154,57 @@ int main(void) {
     return 0;
 }" SPR_HAVE_GCD_SEM)
 
+check_c_source_compiles("
+#include <emmintrin.h>
+__attribute__((target(\"sse2\")))
+static int f(const char *p) {
+    __m128i v = _mm_loadu_si128((const __m128i *) p);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128()));
+}
+int main(void) {
+    char buf[16] = {0};
+    return f(buf);
+}" SPR_HAVE_SSE2)
+
+check_c_source_compiles("
+#include <nmmintrin.h>
+__attribute__((target(\"sse4.2\")))
+static unsigned f(unsigned crc, unsigned char c) {
+    return _mm_crc32_u8(crc, c);
+}
+int main(void) {
+    return (int) f(0, 1);
+}" SPR_HAVE_SSE42)
+
+check_c_source_compiles("
+#include <immintrin.h>
+__attribute__((target(\"avx2\")))
+static int f(const char *p) {
+    __m256i v = _mm256_loadu_si256((const __m256i *) p);
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+}
+int main(void) {
+    char buf[32] = {0};
+    return f(buf);
+}" SPR_HAVE_AVX2)
+
+check_c_source_compiles("
+#include <arm_neon.h>
+int main(void) {
+    uint8x16_t v = vdupq_n_u8(1);
+    return (int) vmaxvq_u8(v);
+}" SPR_HAVE_NEON)
+
+check_c_source_compiles("
+#include <arm_acle.h>
+__attribute__((target(\"+crc\")))
+static unsigned f(unsigned crc, unsigned char c) {
+    return __crc32cb(crc, c);
+}
+int main(void) {
+    return (int) f(0, 1);
+}" SPR_HAVE_ARM_CRC32)
+
 configure_file(
     "cmake/spr_config.h.in"
     "${PROJECT_BINARY_DIR}/spr_config.h"
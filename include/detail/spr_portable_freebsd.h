@@ -53,6 +53,7 @@ used directly. Please use spr_portable.h instead."
 #include <stddef.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <string.h>
 #include <errno.h>
@@ -69,8 +70,10 @@ used directly. Please use spr_portable.h instead."
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <sys/ioctl.h>
+#include <sys/disk.h>
 #include <pwd.h>
 #include <grp.h>
 
@@ -97,6 +100,7 @@ typedef uint32_t                       spr_tid_t;
 typedef pthread_t                      spr_thread_handle_t;
 typedef void *                         spr_thread_value_t;
 typedef struct tm                      spr_tm_t;
+typedef struct iovec                   spr_iovec_t;
 
 #ifdef __cplusplus
 }
@@ -53,6 +53,7 @@ extern "C" {
 #include <stddef.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <string.h>
 #include <errno.h>
@@ -68,8 +69,12 @@ extern "C" {
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
 #include <sys/wait.h>
 #include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
 #include <pwd.h>
 #include <grp.h>
 
@@ -84,6 +89,10 @@ extern "C" {
 #include <sys/mman.h>
 #endif
 
+#if (SPR_HAVE_IO_URING)
+#include <linux/io_uring.h>
+#endif
+
 #if (SPR_HAVE_GCD_SEM)
 #include <dispatch/dispatch.h>
 #endif
@@ -96,6 +105,7 @@ typedef pid_t                          spr_tid_t;
 typedef pthread_t                      spr_thread_handle_t;
 typedef void *                         spr_thread_value_t;
 typedef struct tm                      spr_tm_t;
+typedef struct iovec                   spr_iovec_t;
 
 #ifdef __cplusplus
 }
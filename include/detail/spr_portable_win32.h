@@ -56,6 +56,7 @@ extern "C" {
 
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#include <mswsock.h>
 #include <wspiapi.h>
 #include <ws2ipdef.h>
 #include <windows.h>
@@ -71,6 +72,12 @@ typedef HANDLE                         spr_thread_handle_t;
 typedef DWORD                          spr_thread_value_t;
 typedef SYSTEMTIME                     spr_tm_t;
 
+/* Mirrors struct iovec, so that callers can fill it the same way */
+typedef struct {
+    void *iov_base;
+    size_t iov_len;
+} spr_iovec_t;
+
 #ifdef __cplusplus
 }
 #endif
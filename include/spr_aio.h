@@ -0,0 +1,95 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef INCLUDED_SPR_AIO_H
+#define INCLUDED_SPR_AIO_H
+
+#include "spr_portable.h"
+#include "spr_pool.h"
+#include "spr_filesys.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Operations */
+#define SPR_AIO_READ                 0
+#define SPR_AIO_WRITE                1
+#define SPR_AIO_FSYNC                2
+
+/* Engine parameters */
+#define SPR_AIO_THREADS              0x01
+
+typedef struct spr_aio_s spr_aio_t;
+typedef struct spr_aio_req_s spr_aio_req_t;
+
+typedef void (*spr_aio_handler_pt)(spr_aio_req_t *req);
+
+/*
+ * A request belongs to the caller until it is completed. The file is
+ * always needed, file_index and buf_index select a registered file or
+ * buffer and are ignored by the thread pool. On completion result
+ * holds the number of bytes transferred, or -1 with err set.
+ */
+struct spr_aio_req_s {
+    spr_uint_t op;
+    spr_file_t *file;
+    uint8_t *buf;
+    size_t size;
+    spr_off_t offset;
+    spr_int_t file_index;
+    spr_int_t buf_index;
+    spr_aio_handler_pt handler;
+    void *data;
+    ssize_t result;
+    spr_err_t err;
+};
+
+spr_aio_t *spr_aio_create(spr_pool_t *pool, size_t entries,
+    spr_uint_t nthreads, spr_uint_t flags);
+spr_err_t spr_aio_create1(spr_aio_t **aio, spr_pool_t *pool, size_t entries,
+    spr_uint_t nthreads, spr_uint_t flags);
+bool spr_aio_is_uring(spr_aio_t *aio);
+
+spr_err_t spr_aio_register_files(spr_aio_t *aio, spr_file_t **files,
+    size_t n);
+spr_err_t spr_aio_register_buffers(spr_aio_t *aio, const spr_iovec_t *iov,
+    size_t n);
+
+void spr_aio_prep(spr_aio_req_t *req, spr_uint_t op, spr_file_t *file,
+    void *buf, size_t size, spr_off_t offset);
+ssize_t spr_aio_submit(spr_aio_t *aio, spr_aio_req_t **reqs, size_t n);
+size_t spr_aio_complete(spr_aio_t *aio, spr_aio_req_t **done, size_t n,
+    bool wait);
+size_t spr_aio_pending(spr_aio_t *aio);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPR_AIO_H */
@@ -0,0 +1,74 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef INCLUDED_SPR_ATOMIC_H
+#define INCLUDED_SPR_ATOMIC_H
+
+#include "spr_portable.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define spr_atomic_load(p)           __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define spr_atomic_load_relaxed(p)   __atomic_load_n(p, __ATOMIC_RELAXED)
+#define spr_atomic_store(p, v)       __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define spr_atomic_store_relaxed(p, v) \
+    __atomic_store_n(p, v, __ATOMIC_RELAXED)
+
+#define spr_atomic_fetch_add(p, v) \
+    __atomic_fetch_add(p, v, __ATOMIC_ACQ_REL)
+#define spr_atomic_fetch_add_relaxed(p, v) \
+    __atomic_fetch_add(p, v, __ATOMIC_RELAXED)
+#define spr_atomic_fetch_sub(p, v) \
+    __atomic_fetch_sub(p, v, __ATOMIC_ACQ_REL)
+#define spr_atomic_exchange(p, v) \
+    __atomic_exchange_n(p, v, __ATOMIC_ACQ_REL)
+
+/* On failure the expected value is updated with the current one */
+#define spr_atomic_cas(p, expected, desired) \
+    __atomic_compare_exchange_n(p, expected, desired, 0, \
+                                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define spr_atomic_cas_weak(p, expected, desired) \
+    __atomic_compare_exchange_n(p, expected, desired, 1, \
+                                __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)
+
+#define spr_atomic_fence()           __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#if defined(__i386__) || defined(__x86_64__)
+#define spr_cpu_relax()              __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define spr_cpu_relax()              __asm__ __volatile__("yield")
+#else
+#define spr_cpu_relax()
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPR_ATOMIC_H */
@@ -0,0 +1,102 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef INCLUDED_SPR_BSTREAM_H
+#define INCLUDED_SPR_BSTREAM_H
+
+#include "spr_portable.h"
+#include "spr_pool.h"
+#include "spr_filesys.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Stream parameters */
+#define SPR_BSTREAM_READ             0x01
+#define SPR_BSTREAM_WRITE            0x02
+#define SPR_BSTREAM_ALIGNED          0x04
+
+#define SPR_BSTREAM_SIZE             65536
+
+typedef struct spr_bstream_s spr_bstream_t;
+
+/*
+ * Buffered reader or writer over a file, I/O is positional and starts
+ * at the offset given on creation. A reader holds [pos, last) unread,
+ * bytes in [start, pos) can be unread. A writer holds [start, pos) not
+ * yet written. Offset is the file position of start. An aligned stream
+ * keeps the buffer and the file position of start on page boundaries,
+ * or on block boundaries of a direct file with larger blocks. Writing
+ * a direct file pads the last block with zeros, spr_bstream_close()
+ * truncates the file to spr_bstream_tell().
+ */
+struct spr_bstream_s {
+    spr_file_t *file;
+    uint8_t *start;
+    uint8_t *pos;
+    uint8_t *last;
+    uint8_t *end;
+    spr_off_t offset;
+    size_t align;
+    spr_uint_t flags;
+};
+
+#define spr_bstream_tell(bs) \
+    ((bs)->offset + (spr_off_t) ((bs)->pos - (bs)->start))
+
+/* The most a reader can hold unconsumed after a fill */
+#define spr_bstream_capacity(bs) \
+    ((size_t) ((bs)->end - (bs)->start) - ((bs)->align - 1))
+
+spr_bstream_t *spr_bstream_create(spr_pool_t *pool, spr_file_t *file,
+    spr_off_t offset, size_t size, spr_uint_t flags);
+spr_err_t spr_bstream_create1(spr_bstream_t **bs, spr_pool_t *pool,
+    spr_file_t *file, spr_off_t offset, size_t size, spr_uint_t flags);
+
+ssize_t spr_bstream_read(spr_bstream_t *bs, void *buf, size_t n);
+ssize_t spr_bstream_peek(spr_bstream_t *bs, const uint8_t **data,
+    size_t n);
+ssize_t spr_bstream_borrow(spr_bstream_t *bs, const uint8_t **data,
+    size_t n);
+ssize_t spr_bstream_borrow_until(spr_bstream_t *bs, int delim,
+    const uint8_t **data);
+spr_err_t spr_bstream_unread(spr_bstream_t *bs, size_t n);
+spr_err_t spr_bstream_readahead(spr_bstream_t *bs, size_t n);
+
+ssize_t spr_bstream_write(spr_bstream_t *bs, const void *buf, size_t n);
+spr_err_t spr_bstream_flush(spr_bstream_t *bs);
+spr_err_t spr_bstream_close(spr_bstream_t *bs);
+
+spr_err_t spr_bstream_seek(spr_bstream_t *bs, spr_off_t offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPR_BSTREAM_H */
@@ -0,0 +1,118 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef INCLUDED_SPR_BTREE_H
+#define INCLUDED_SPR_BTREE_H
+
+#include "spr_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Keys per node, a node occupies 8 cache lines on 64-bit platforms */
+#define SPR_BTREE_ORDER              28
+#define SPR_BTREE_MAX_HEIGHT         24
+
+typedef struct spr_btree_s spr_btree_t;
+typedef struct spr_btree_node_s spr_btree_node_t;
+typedef struct spr_btree_iter_s spr_btree_iter_t;
+
+/*
+ * Keys are compared as unsigned integers unless a compare function
+ * is given, in that case keys usually hold pointers to the real keys
+ */
+typedef int (*spr_btree_compare_pt)(uint64_t key1, uint64_t key2);
+typedef spr_uint_t (*spr_btree_rank_pt)(spr_btree_t *tree,
+    spr_btree_node_t *node, uint64_t key, spr_uint_t upper);
+
+struct spr_btree_node_s {
+    uint32_t nkeys;
+    uint32_t leaf;
+    uint64_t keys[SPR_BTREE_ORDER];
+    union {
+        spr_btree_node_t *children[SPR_BTREE_ORDER + 1];
+        struct {
+            void *values[SPR_BTREE_ORDER];
+            spr_btree_node_t *prev;
+            spr_btree_node_t *next;
+        } leaf;
+    } u;
+};
+
+struct spr_btree_s {
+    spr_pool_t *pool;
+    spr_btree_node_t *root;
+    spr_btree_node_t *first;
+    spr_btree_node_t *last;
+    spr_btree_node_t *free_nodes;
+    spr_btree_compare_pt compare;
+    spr_btree_rank_pt rank;
+    size_t nfree;
+    size_t size;
+    size_t height;
+};
+
+struct spr_btree_iter_s {
+    spr_btree_node_t *node;
+    spr_uint_t pos;
+};
+
+#define spr_btree_size(tree)         ((tree)->size)
+
+#define spr_btree_iter_valid(it)     ((it)->node != NULL)
+#define spr_btree_iter_key(it)       ((it)->node->keys[(it)->pos])
+#define spr_btree_iter_value(it) \
+    ((it)->node->u.leaf.values[(it)->pos])
+
+spr_btree_t *spr_btree_create(spr_pool_t *pool,
+    spr_btree_compare_pt compare);
+spr_err_t spr_btree_create1(spr_btree_t **tree, spr_pool_t *pool,
+    spr_btree_compare_pt compare);
+
+spr_err_t spr_btree_insert(spr_btree_t *tree, uint64_t key, void *value);
+spr_err_t spr_btree_remove(spr_btree_t *tree, uint64_t key, void **value);
+void *spr_btree_find(spr_btree_t *tree, uint64_t key);
+spr_err_t spr_btree_bulk_load(spr_btree_t *tree, const uint64_t *keys,
+    void *const *values, size_t n);
+void spr_btree_clear(spr_btree_t *tree);
+
+bool spr_btree_lower_bound(spr_btree_t *tree, uint64_t key,
+    spr_btree_iter_t *it);
+bool spr_btree_upper_bound(spr_btree_t *tree, uint64_t key,
+    spr_btree_iter_t *it);
+bool spr_btree_first(spr_btree_t *tree, spr_btree_iter_t *it);
+bool spr_btree_last(spr_btree_t *tree, spr_btree_iter_t *it);
+bool spr_btree_next(spr_btree_iter_t *it);
+bool spr_btree_prev(spr_btree_iter_t *it);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPR_BTREE_H */
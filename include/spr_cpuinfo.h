@@ -33,7 +33,29 @@
 extern "C" {
 #endif
 
+#define SPR_CPU_FEATURE_SSE2         0x00000001
+#define SPR_CPU_FEATURE_SSE42        0x00000002
+#define SPR_CPU_FEATURE_AVX2         0x00000004
+#define SPR_CPU_FEATURE_NEON         0x00000008
+#define SPR_CPU_FEATURE_ARM_CRC32    0x00000010
+
+#define spr_cpu_has_feature(feature) \
+    (spr_get_cpu_features() & (feature))
+
+#if defined(__GNUC__)
+#define SPR_TARGET_SSE2              __attribute__((target("sse2")))
+#define SPR_TARGET_SSE42             __attribute__((target("sse4.2")))
+#define SPR_TARGET_AVX2              __attribute__((target("avx2")))
+#define SPR_TARGET_ARM_CRC32         __attribute__((target("+crc")))
+#else
+#define SPR_TARGET_SSE2
+#define SPR_TARGET_SSE42
+#define SPR_TARGET_AVX2
+#define SPR_TARGET_ARM_CRC32
+#endif
+
 spr_uint_t spr_get_number_cpu(void);
+spr_bitfield_t spr_get_cpu_features(void);
 
 #ifdef __cplusplus
 }
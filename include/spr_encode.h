@@ -0,0 +1,121 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef INCLUDED_SPR_ENCODE_H
+#define INCLUDED_SPR_ENCODE_H
+
+#include "spr_portable.h"
+#include "spr_pool.h"
+#include "spr_string.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Base64 flags, the URL alphabet is the one from RFC 4648 section 5 */
+#define SPR_BASE64_URL               0x01
+#define SPR_BASE64_NOPAD             0x02
+
+/* Hex flags */
+#define SPR_HEX_UPPER                0x01
+
+/* Percent-encoding flags, form encoding maps space to '+' */
+#define SPR_URL_FORM                 0x01
+
+/*
+ * Output bounds. They also hold for a single update call of the
+ * streaming decoders, whatever the codec has buffered.
+ */
+#define spr_base64_encoded_length(len)  (((len) + 2) / 3 * 4)
+#define spr_base64_decoded_length(len)  (((len) + 3) / 4 * 3)
+#define spr_hex_encoded_length(len)     ((len) * 2)
+#define spr_hex_decoded_length(len)     (((len) + 1) / 2)
+#define spr_url_decoded_length(len)     (len)
+
+typedef struct spr_codec_s spr_codec_t;
+
+/*
+ * State of a streaming encoder or decoder. Input can be split at any
+ * byte, the codec keeps the few bytes of an incomplete group until the
+ * next call. Hex encoding and percent-encoding need no state, their
+ * one-shot functions can be called on each chunk as is.
+ */
+struct spr_codec_s {
+    spr_uint_t flags;
+    bool done;
+    size_t pending;
+    uint8_t buf[4];
+};
+
+size_t spr_base64_encode(char *dst, const void *src, size_t len,
+    spr_uint_t flags);
+ssize_t spr_base64_decode(void *dst, const char *src, size_t len,
+    spr_uint_t flags);
+spr_err_t spr_base64_pencode(spr_pool_t *pool, spr_str_t *dst,
+    const void *src, size_t len, spr_uint_t flags);
+spr_err_t spr_base64_pdecode(spr_pool_t *pool, spr_str_t *dst,
+    const char *src, size_t len, spr_uint_t flags);
+
+size_t spr_hex_encode(char *dst, const void *src, size_t len,
+    spr_uint_t flags);
+ssize_t spr_hex_decode(void *dst, const char *src, size_t len);
+spr_err_t spr_hex_pencode(spr_pool_t *pool, spr_str_t *dst,
+    const void *src, size_t len, spr_uint_t flags);
+spr_err_t spr_hex_pdecode(spr_pool_t *pool, spr_str_t *dst,
+    const char *src, size_t len);
+
+size_t spr_url_encoded_length(const void *src, size_t len,
+    spr_uint_t flags);
+size_t spr_url_encode(char *dst, const void *src, size_t len,
+    spr_uint_t flags);
+ssize_t spr_url_decode(void *dst, const char *src, size_t len,
+    spr_uint_t flags);
+spr_err_t spr_url_pencode(spr_pool_t *pool, spr_str_t *dst,
+    const void *src, size_t len, spr_uint_t flags);
+spr_err_t spr_url_pdecode(spr_pool_t *pool, spr_str_t *dst,
+    const char *src, size_t len, spr_uint_t flags);
+
+void spr_codec_init(spr_codec_t *codec, spr_uint_t flags);
+size_t spr_base64_encode_update(spr_codec_t *codec, char *dst,
+    const void *src, size_t len);
+size_t spr_base64_encode_final(spr_codec_t *codec, char *dst);
+ssize_t spr_base64_decode_update(spr_codec_t *codec, void *dst,
+    const char *src, size_t len);
+ssize_t spr_base64_decode_final(spr_codec_t *codec, void *dst);
+ssize_t spr_hex_decode_update(spr_codec_t *codec, void *dst,
+    const char *src, size_t len);
+ssize_t spr_hex_decode_final(spr_codec_t *codec);
+ssize_t spr_url_decode_update(spr_codec_t *codec, void *dst,
+    const char *src, size_t len);
+ssize_t spr_url_decode_final(spr_codec_t *codec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPR_ENCODE_H */
@@ -67,6 +67,8 @@ extern "C" {
 #define SPR_ERR_FILESYS              SPR_ERROR_DOMAIN(1)
 #define SPR_ERR_FILESYS_ABS_PATH     (SPR_ERR_FILESYS+1)
 #define SPR_ERR_FILESYS_LONG_PATH    (SPR_ERR_FILESYS+2)
+#define SPR_ERR_FILESYS_ENCODING     (SPR_ERR_FILESYS+3)
+#define SPR_ERR_FILESYS_ALIGNMENT    (SPR_ERR_FILESYS+4)
 
 
 const char *spr_strerror(spr_err_t err, char *buf, size_t bufsize);
@@ -30,6 +30,7 @@
 #define INCLUDED_SPR_FILESYS_H
 
 #include "spr_portable.h"
+#include "spr_pool.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -50,6 +51,13 @@ extern "C" {
 #define SPR_FILE_CREATE_OR_APPEND         (O_CREAT|O_APPEND|O_WRONLY)
 #define SPR_FILE_NONBLOCK                 O_NONBLOCK
 
+#if defined(O_DIRECT)
+#define SPR_FILE_DIRECT                   O_DIRECT
+#else
+/* Not an open(2) flag, spr_file_open() asks for F_NOCACHE or directio() */
+#define SPR_FILE_DIRECT                   0x80000000
+#endif
+
 /* Access */
 #define SPR_FILE_DEFAULT_ACCESS           0644
 #define SPR_FILE_OWNER_ACCESS             0600
@@ -71,6 +79,12 @@ extern "C" {
 #define SPR_MAX_PATH_LEN                  4096
 #endif
 
+#if defined(IOV_MAX)
+#define SPR_IOV_MAX                       IOV_MAX
+#else
+#define SPR_IOV_MAX                       16
+#endif
+
 #define SPR_FILE_ACCESS_USETID            0x8000
 #define SPR_FILE_ACCESS_UR                0x0400
 #define SPR_FILE_ACCESS_UW                0x0200
@@ -154,6 +168,9 @@ struct spr_glob_s {
 #define SPR_FILE_CREATE_OR_APPEND         OPEN_ALWAYS /* fixme */
 #define SPR_FILE_NONBLOCK                 0
 
+/* Reserved access bit, spr_file_open() maps it to FILE_FLAG_NO_BUFFERING */
+#define SPR_FILE_DIRECT                   0x04000000
+
 /* Access */
 #define SPR_FILE_DEFAULT_ACCESS           0
 #define SPR_FILE_OWNER_ACCESS             0
@@ -215,10 +232,14 @@ spr_err_t spr_file_stat_by_path(spr_file_stat_t *stat, const char *path);
 #define spr_dir_current_namelen(dir) \
     spr_strlen(spr_dir_current_name(dir))
 
+/* Used when the device does not report its logical block size */
+#define SPR_FILE_BLOCK_SIZE               4096
+
 struct spr_file_s {
     spr_fd_t fd;
     char *name;
     spr_off_t offset;
+    size_t align;     /* Direct I/O alignment, 0 for buffered files */
 };
 
 struct spr_file_info_s {
@@ -234,6 +255,20 @@ ssize_t spr_file_read(spr_file_t *file, uint8_t *buf, size_t size,
     spr_off_t offset);
 ssize_t spr_file_write(spr_file_t *file, const char *buf, size_t size,
     spr_off_t offset);
+ssize_t spr_file_readv(spr_file_t *file, const spr_iovec_t *iov,
+    size_t iovcnt, spr_off_t offset);
+ssize_t spr_file_writev(spr_file_t *file, const spr_iovec_t *iov,
+    size_t iovcnt, spr_off_t offset);
+ssize_t spr_file_send_to_socket(spr_file_t *file, spr_socket_t sockfd,
+    spr_off_t offset, size_t size);
+ssize_t spr_file_copy_range(spr_file_t *src, spr_off_t src_offset,
+    spr_file_t *dst, spr_off_t dst_offset, size_t size);
+ssize_t spr_file_read_direct(spr_file_t *file, uint8_t *buf, size_t size,
+    spr_off_t offset);
+ssize_t spr_file_write_direct(spr_file_t *file, const char *buf, size_t size,
+    spr_off_t offset);
+spr_err_t spr_file_block_size(spr_file_t *file, size_t *size);
+void *spr_file_palloc(spr_pool_t *pool, spr_file_t *file, size_t size);
 ssize_t spr_file_size(spr_file_t *file);
 void spr_file_close(spr_file_t *file);
 
@@ -245,6 +280,7 @@ ssize_t spr_write_stderr(const char *str);
 
 spr_err_t spr_file_info_by_path(spr_file_info_t *info, const char *path);
 spr_err_t spr_file_info(spr_file_info_t *info, spr_file_t *file);
+spr_err_t spr_file_truncate(spr_file_t *file, spr_off_t size);
 
 spr_err_t spr_dir_open(spr_dir_t *dir, const char *path);
 spr_err_t spr_dir_read(spr_dir_t *dir);
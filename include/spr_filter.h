@@ -0,0 +1,108 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef INCLUDED_SPR_FILTER_H
+#define INCLUDED_SPR_FILTER_H
+
+#include "spr_pool.h"
+#include "spr_filesys.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPR_BLOOM_BLOCK_WORDS        8
+#define SPR_CUCKOO_BUCKET_SLOTS      4
+#define SPR_CUCKOO_MAX_KICKS         500
+
+typedef struct spr_bloom_s spr_bloom_t;
+typedef struct spr_cuckoo_s spr_cuckoo_t;
+
+/*
+ * Split block Bloom filter, every key sets one bit in each word of
+ * a single 32-byte block, so a lookup touches one cache line
+ */
+struct spr_bloom_s {
+    uint32_t *blocks;
+    size_t nblocks;
+    size_t count;
+    uint64_t seed;
+};
+
+/*
+ * Cuckoo filter with four 16-bit fingerprints per bucket. The victim
+ * holds the fingerprint which did not find a place, once it is taken
+ * the filter is full.
+ */
+struct spr_cuckoo_s {
+    uint64_t *buckets;
+    size_t mask;
+    size_t count;
+    uint64_t seed;
+    uint64_t rnd;
+    size_t victim_index;
+    uint16_t victim_fp;
+};
+
+#define spr_bloom_count(bloom)       ((bloom)->count)
+#define spr_cuckoo_count(cuckoo)     ((cuckoo)->count)
+
+spr_bloom_t *spr_bloom_create(spr_pool_t *pool, size_t n,
+    spr_uint_t bits_per_key);
+spr_err_t spr_bloom_create1(spr_bloom_t **bloom, spr_pool_t *pool, size_t n,
+    spr_uint_t bits_per_key);
+void spr_bloom_add(spr_bloom_t *bloom, const void *key, size_t len);
+bool spr_bloom_check(spr_bloom_t *bloom, const void *key, size_t len);
+void spr_bloom_add_hash(spr_bloom_t *bloom, uint64_t hash);
+bool spr_bloom_check_hash(spr_bloom_t *bloom, uint64_t hash);
+void spr_bloom_clear(spr_bloom_t *bloom);
+spr_err_t spr_bloom_save(spr_bloom_t *bloom, spr_file_t *file,
+    spr_off_t offset);
+spr_err_t spr_bloom_load(spr_bloom_t **bloom, spr_pool_t *pool,
+    spr_file_t *file, spr_off_t offset);
+
+spr_cuckoo_t *spr_cuckoo_create(spr_pool_t *pool, size_t n);
+spr_err_t spr_cuckoo_create1(spr_cuckoo_t **cuckoo, spr_pool_t *pool,
+    size_t n);
+spr_err_t spr_cuckoo_add(spr_cuckoo_t *cuckoo, const void *key, size_t len);
+bool spr_cuckoo_check(spr_cuckoo_t *cuckoo, const void *key, size_t len);
+spr_err_t spr_cuckoo_remove(spr_cuckoo_t *cuckoo, const void *key,
+    size_t len);
+spr_err_t spr_cuckoo_add_hash(spr_cuckoo_t *cuckoo, uint64_t hash);
+bool spr_cuckoo_check_hash(spr_cuckoo_t *cuckoo, uint64_t hash);
+spr_err_t spr_cuckoo_remove_hash(spr_cuckoo_t *cuckoo, uint64_t hash);
+void spr_cuckoo_clear(spr_cuckoo_t *cuckoo);
+spr_err_t spr_cuckoo_save(spr_cuckoo_t *cuckoo, spr_file_t *file,
+    spr_off_t offset);
+spr_err_t spr_cuckoo_load(spr_cuckoo_t **cuckoo, spr_pool_t *pool,
+    spr_file_t *file, spr_off_t offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPR_FILTER_H */
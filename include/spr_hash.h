@@ -0,0 +1,74 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef INCLUDED_SPR_HASH_H
+#define INCLUDED_SPR_HASH_H
+
+#include "spr_portable.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPR_HASH_STRIPE_LEN          64
+#define SPR_HASH_SECRET_WORDS        32
+#define SPR_HASH_BUFFER_SIZE         (4 * SPR_HASH_STRIPE_LEN)
+
+typedef struct spr_hash128_s spr_hash128_t;
+typedef struct spr_hash_state_s spr_hash_state_t;
+
+struct spr_hash128_s {
+    uint64_t low;
+    uint64_t high;
+};
+
+struct spr_hash_state_s {
+    uint64_t acc[8];
+    uint64_t secret[SPR_HASH_SECRET_WORDS];
+    uint8_t buffer[SPR_HASH_BUFFER_SIZE];
+    size_t buffered;
+    size_t nstripes;
+    uint64_t total_len;
+    uint64_t seed;
+};
+
+uint64_t spr_hash64(const void *data, size_t len, uint64_t seed);
+spr_hash128_t spr_hash128(const void *data, size_t len, uint64_t seed);
+
+void spr_hash_init(spr_hash_state_t *state, uint64_t seed);
+void spr_hash_update(spr_hash_state_t *state, const void *data, size_t len);
+uint64_t spr_hash64_final(spr_hash_state_t *state);
+spr_hash128_t spr_hash128_final(spr_hash_state_t *state);
+
+uint32_t spr_crc32c(uint32_t crc, const void *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPR_HASH_H */
@@ -0,0 +1,116 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef INCLUDED_SPR_HEAP_H
+#define INCLUDED_SPR_HEAP_H
+
+#include "spr_pool.h"
+#include "spr_memory.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPR_HEAP_MAX_ARITY           16
+
+/* Siblings of one parent fill a single cache line */
+#define SPR_HEAP_DEFAULT_ARITY \
+    (SPR_CACHELINE_SIZE / sizeof(spr_heap_entry_t))
+
+#define SPR_HEAP_INVALID_INDEX       0
+
+typedef struct spr_heap_s spr_heap_t;
+typedef struct spr_iheap_s spr_iheap_t;
+typedef struct spr_heap_node_s spr_heap_node_t;
+
+typedef struct {
+    uint64_t key;
+    void *value;
+} spr_heap_entry_t;
+
+/* Min-heap on unsigned keys, arity is a power of two */
+struct spr_heap_s {
+    spr_pool_t *pool;
+    spr_heap_entry_t *entries;
+    size_t size;
+    size_t capacity;
+    spr_uint_t shift;
+};
+
+/*
+ * Indexed heap keeps track of node positions, the node is usually
+ * embedded into the structure which is scheduled
+ */
+struct spr_iheap_s {
+    spr_heap_t heap;
+};
+
+/*
+ * Index is the position in the heap plus one, a zeroed node is not
+ * queued and needs no spr_heap_node_init()
+ */
+struct spr_heap_node_s {
+    size_t index;
+};
+
+#define spr_heap_size(h)             ((h)->size)
+#define spr_heap_empty(h)            ((h)->size == 0)
+#define spr_heap_top(h)              ((h)->size ? &(h)->entries[0] : NULL)
+
+spr_heap_t *spr_heap_create(spr_pool_t *pool, spr_uint_t arity, size_t n);
+spr_err_t spr_heap_create1(spr_heap_t **heap, spr_pool_t *pool,
+    spr_uint_t arity, size_t n);
+spr_err_t spr_heap_push(spr_heap_t *heap, uint64_t key, void *value);
+spr_err_t spr_heap_pop(spr_heap_t *heap, uint64_t *key, void **value);
+void spr_heap_clear(spr_heap_t *heap);
+
+#define spr_heap_node_init(node)     ((node)->index = SPR_HEAP_INVALID_INDEX)
+#define spr_heap_node_queued(node)   ((node)->index != SPR_HEAP_INVALID_INDEX)
+
+#define spr_iheap_size(h)            ((h)->heap.size)
+#define spr_iheap_empty(h)           ((h)->heap.size == 0)
+#define spr_iheap_min(h) \
+    ((h)->heap.size ? (spr_heap_node_t *) (h)->heap.entries[0].value : NULL)
+#define spr_iheap_min_key(h)         ((h)->heap.entries[0].key)
+#define spr_iheap_key(h, node)       ((h)->heap.entries[(node)->index - 1].key)
+
+spr_iheap_t *spr_iheap_create(spr_pool_t *pool, spr_uint_t arity, size_t n);
+spr_err_t spr_iheap_create1(spr_iheap_t **heap, spr_pool_t *pool,
+    spr_uint_t arity, size_t n);
+spr_err_t spr_iheap_insert(spr_iheap_t *heap, spr_heap_node_t *node,
+    uint64_t key);
+spr_err_t spr_iheap_update(spr_iheap_t *heap, spr_heap_node_t *node,
+    uint64_t key);
+void spr_iheap_remove(spr_iheap_t *heap, spr_heap_node_t *node);
+spr_heap_node_t *spr_iheap_pop(spr_iheap_t *heap);
+void spr_iheap_clear(spr_iheap_t *heap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPR_HEAP_H */
@@ -0,0 +1,109 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef INCLUDED_SPR_INTERN_H
+#define INCLUDED_SPR_INTERN_H
+
+#include "spr_portable.h"
+#include "spr_pool.h"
+#include "spr_memory.h"
+#include "spr_mutex.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPR_INTERN_CHUNK_SIZE        256
+#define SPR_INTERN_MAX_CHUNKS        25
+
+typedef struct spr_intern_s spr_intern_t;
+typedef struct spr_intern_str_s spr_intern_str_t;
+typedef struct spr_intern_table_s spr_intern_table_t;
+typedef struct spr_intern_stats_s spr_intern_stats_t;
+typedef struct spr_intern_counter_s spr_intern_counter_t;
+
+struct spr_intern_str_s {
+    uint64_t hash;
+    uint32_t id;
+    uint32_t len;
+    char data[];
+};
+
+struct spr_intern_stats_s {
+    uint64_t lookups;
+    uint64_t hits;
+    size_t count;
+    size_t bytes_stored;
+    uint64_t bytes_saved;
+};
+
+/*
+ * Interned strings live in the pool and are never moved, so their
+ * address is their identity. Readers probe the table without locking,
+ * writers serialize on the mutex and publish a new table when it grows.
+ * Ids index a directory of chunks, chunk c holds
+ * SPR_INTERN_CHUNK_SIZE << c strings. Misses are counted under the
+ * mutex, hits in sharded counters so that lookups share no written
+ * cache line.
+ */
+struct spr_intern_s {
+    spr_intern_table_t *table;
+    spr_intern_str_t **chunks[SPR_INTERN_MAX_CHUNKS];
+    uint32_t count;
+    uint64_t seed;
+    size_t bytes_stored;
+    uint64_t misses;
+    spr_intern_counter_t *counters;
+    spr_pool_t *pool;
+    spr_mutex_t lock;
+};
+
+/* Canonical pointers compare equal exactly when the strings are equal */
+#define spr_intern_eq(s1, s2)        ((s1) == (s2))
+
+#define spr_intern_str(intern, str, id) \
+    spr_intern(intern, (str)->data, (str)->len, id)
+
+spr_intern_t *spr_intern_create(spr_pool_t *pool, size_t n);
+spr_err_t spr_intern_create1(spr_intern_t **intern, spr_pool_t *pool,
+    size_t n);
+const char *spr_intern(spr_intern_t *intern, const char *str, size_t len,
+    uint32_t *id);
+const char *spr_intern_lookup(spr_intern_t *intern, const char *str,
+    size_t len, uint32_t *id);
+const char *spr_intern_get(spr_intern_t *intern, uint32_t id, size_t *len);
+uint32_t spr_intern_id(const char *str);
+size_t spr_intern_length(const char *str);
+size_t spr_intern_count(spr_intern_t *intern);
+void spr_intern_stats(spr_intern_t *intern, spr_intern_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPR_INTERN_H */
@@ -38,14 +38,24 @@ extern "C" {
 #define SPR_ALIGN_SIZE               sizeof(uintptr_t)
 #define SPR_PAGE_SIZE                spr_get_page_size()
 
+#if (SPR_DARWIN) && defined(__aarch64__)
+#define SPR_CACHELINE_SIZE           128
+#else
+#define SPR_CACHELINE_SIZE           64
+#endif
+
 #define spr_align(p, b)  (((p) + ((b) - 1)) & ~((b) - 1))
 #define spr_align_default(p)         spr_align(p, SPR_ALIGN_SIZE)
+#define spr_align_ptr(p, b) \
+    ((uint8_t *) (((uintptr_t) (p) + ((uintptr_t) (b) - 1)) \
+                                    & ~((uintptr_t) (b) - 1)))
 
 #define spr_memset(buf, c, n)        memset(buf, c, n)
 #define spr_memzero(buf, n)          spr_memset(buf, 0, n)
 #define spr_memcmp(s1, s2, n)        memcmp(s1, s2, n)
 #define spr_memcpy(dst, src, n)      memcpy(dst, src, n)
 #define spr_memmove(dst, src, n)     memmove(dst, src, n)
+#define spr_memchr(buf, c, n)        memchr(buf, c, n)
 
 
 void *spr_malloc(size_t size);
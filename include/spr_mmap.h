@@ -0,0 +1,94 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef INCLUDED_SPR_MMAP_H
+#define INCLUDED_SPR_MMAP_H
+
+#include "spr_portable.h"
+#include "spr_pool.h"
+#include "spr_filesys.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Access, writes go to the file unless the mapping is private */
+#define SPR_MMAP_READ                0x01
+#define SPR_MMAP_WRITE               0x02
+#define SPR_MMAP_PRIVATE             0x04
+
+/* Advice */
+#define SPR_MMAP_NORMAL              0
+#define SPR_MMAP_SEQUENTIAL          1
+#define SPR_MMAP_RANDOM              2
+#define SPR_MMAP_WILLNEED            3
+#define SPR_MMAP_DONTNEED            4
+#define SPR_MMAP_HUGEPAGE            5
+
+#define spr_mmap_data(mmap)          ((mmap)->data)
+#define spr_mmap_size(mmap)          ((mmap)->size)
+#define spr_mmap_offset(mmap)        ((mmap)->offset)
+
+typedef struct spr_mmap_s spr_mmap_t;
+
+/*
+ * A window of a file mapped into memory. The mapping itself starts at
+ * the allocation granularity boundary below offset, data points at the
+ * requested byte. A size of 0 maps up to the end of the file. The file
+ * is never extended, it has to be grown before a writable window is
+ * moved or enlarged past its end.
+ */
+struct spr_mmap_s {
+    uint8_t *data;
+    size_t size;
+    spr_off_t offset;
+    void *base;
+    size_t map_size;
+    spr_file_t *file;
+    spr_uint_t flags;
+#if (SPR_WIN32)
+    HANDLE mapping;
+#endif
+};
+
+spr_mmap_t *spr_mmap_create(spr_pool_t *pool, spr_file_t *file,
+    spr_off_t offset, size_t size, spr_uint_t flags);
+spr_err_t spr_mmap_create1(spr_mmap_t **mmap, spr_pool_t *pool,
+    spr_file_t *file, spr_off_t offset, size_t size, spr_uint_t flags);
+spr_err_t spr_mmap_remap(spr_mmap_t *mmap, spr_off_t offset, size_t size);
+spr_err_t spr_mmap_advise(spr_mmap_t *mmap, size_t offset, size_t size,
+    spr_uint_t advice);
+spr_err_t spr_mmap_sync(spr_mmap_t *mmap, size_t offset, size_t size,
+    bool async);
+void spr_mmap_close(spr_mmap_t *mmap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPR_MMAP_H */
@@ -42,6 +42,7 @@ extern "C" {
 #define SPR_MUTEX_RECURSIVE          0x00000004
 #define SPR_MUTEX_NONRECURSIVE       0x00000008
 #define SPR_MUTEX_DEFAULT            0x00000010
+#define SPR_MUTEX_COND               0x00000020
 
 
 #if (SPR_POSIX)
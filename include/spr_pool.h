@@ -53,6 +53,9 @@ spr_err_t spr_pool_create1(spr_pool_t **newpool, size_t size,
 void spr_pool_add_child(spr_pool_t *parent, spr_pool_t *new_child);
 void *spr_palloc(spr_pool_t *pool, size_t size);
 void *spr_pcalloc(spr_pool_t *pool, size_t size);
+void *spr_pmemalign(spr_pool_t *pool, size_t size, size_t alignment);
+void *spr_prealloc(spr_pool_t *pool, void *mem, size_t old_size,
+    size_t new_size);
 void spr_pool_cleanup_add1(spr_pool_t *pool, void *data,
     spr_cleanup_handler_t handler);
 void spr_pool_cleanup_run1(spr_pool_t *pool, void *data,
@@ -73,6 +73,7 @@ typedef struct spr_file_info_s         spr_file_info_t;
 typedef struct spr_thread_s            spr_thread_t;
 typedef struct spr_mutex_s             spr_mutex_t;
 typedef struct spr_semaphore_s         spr_semaphore_t;
+typedef struct spr_cond_s              spr_cond_t;
 
 #ifdef __cplusplus
 }
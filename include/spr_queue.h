@@ -0,0 +1,103 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef INCLUDED_SPR_QUEUE_H
+#define INCLUDED_SPR_QUEUE_H
+
+#include "spr_pool.h"
+#include "spr_memory.h"
+#include "spr_semaphore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct spr_mpmc_queue_s spr_mpmc_queue_t;
+typedef struct spr_mpmc_bqueue_s spr_mpmc_bqueue_t;
+
+typedef struct {
+    size_t seq;
+    void *data;
+} spr_mpmc_cell_t;
+
+/*
+ * Bounded multi-producer multi-consumer queue, every cell carries
+ * a sequence number which tells whether it is ready to be written or
+ * read at the given position. Producers and consumers only share
+ * the cells they contend for, head and tail live in own cache lines.
+ */
+struct spr_mpmc_queue_s {
+    spr_mpmc_cell_t *cells;
+    size_t mask;
+    uint8_t pad0[SPR_CACHELINE_SIZE - sizeof(void *) - sizeof(size_t)];
+    size_t head;
+    uint8_t pad1[SPR_CACHELINE_SIZE - sizeof(size_t)];
+    size_t tail;
+    uint8_t pad2[SPR_CACHELINE_SIZE - sizeof(size_t)];
+};
+
+/*
+ * Blocking wrapper, the counters hold the number of available items
+ * and free cells minus the number of sleeping threads, so semaphores
+ * are touched only when the queue gets empty or full
+ */
+struct spr_mpmc_bqueue_s {
+    spr_mpmc_queue_t queue;
+    spr_ssize_t items;
+    uint8_t pad0[SPR_CACHELINE_SIZE - sizeof(spr_ssize_t)];
+    spr_ssize_t slots;
+    uint8_t pad1[SPR_CACHELINE_SIZE - sizeof(spr_ssize_t)];
+    spr_semaphore_t items_sem;
+    spr_semaphore_t slots_sem;
+};
+
+#define spr_mpmc_queue_capacity(q)   ((q)->mask + 1)
+
+spr_mpmc_queue_t *spr_mpmc_queue_create(spr_pool_t *pool, size_t n);
+spr_err_t spr_mpmc_queue_create1(spr_mpmc_queue_t **queue,
+    spr_pool_t *pool, size_t n);
+spr_err_t spr_mpmc_queue_try_push(spr_mpmc_queue_t *queue, void *data);
+spr_err_t spr_mpmc_queue_try_pop(spr_mpmc_queue_t *queue, void **data);
+size_t spr_mpmc_queue_push_bulk(spr_mpmc_queue_t *queue, void *const *data,
+    size_t n);
+size_t spr_mpmc_queue_pop_bulk(spr_mpmc_queue_t *queue, void **data,
+    size_t n);
+size_t spr_mpmc_queue_size(spr_mpmc_queue_t *queue);
+
+spr_mpmc_bqueue_t *spr_mpmc_bqueue_create(spr_pool_t *pool, size_t n);
+spr_err_t spr_mpmc_bqueue_create1(spr_mpmc_bqueue_t **queue,
+    spr_pool_t *pool, size_t n);
+spr_err_t spr_mpmc_bqueue_push(spr_mpmc_bqueue_t *queue, void *data);
+spr_err_t spr_mpmc_bqueue_pop(spr_mpmc_bqueue_t *queue, void **data);
+spr_err_t spr_mpmc_bqueue_try_push(spr_mpmc_bqueue_t *queue, void *data);
+spr_err_t spr_mpmc_bqueue_try_pop(spr_mpmc_bqueue_t *queue, void **data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPR_QUEUE_H */
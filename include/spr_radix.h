@@ -0,0 +1,71 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef INCLUDED_SPR_RADIX_H
+#define INCLUDED_SPR_RADIX_H
+
+#include "spr_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct spr_radix_s spr_radix_t;
+typedef struct spr_radix_node_s spr_radix_node_t;
+
+/* Returns non-zero value to stop the iteration */
+typedef int (*spr_radix_callback_pt)(void *data, const uint8_t *key,
+    size_t len, void *value);
+
+struct spr_radix_s {
+    spr_pool_t *pool;
+    spr_radix_node_t *root;
+    spr_radix_node_t *free_nodes[4];
+    size_t size;
+};
+
+#define spr_radix_size(tree)         ((tree)->size)
+
+spr_radix_t *spr_radix_create(spr_pool_t *pool);
+spr_err_t spr_radix_create1(spr_radix_t **tree, spr_pool_t *pool);
+
+spr_err_t spr_radix_insert(spr_radix_t *tree, const void *key, size_t len,
+    void *value);
+spr_err_t spr_radix_remove(spr_radix_t *tree, const void *key, size_t len,
+    void **value);
+void *spr_radix_find(spr_radix_t *tree, const void *key, size_t len);
+void *spr_radix_longest_prefix(spr_radix_t *tree, const void *key,
+    size_t len, size_t *match_len);
+int spr_radix_iter_prefix(spr_radix_t *tree, const void *prefix, size_t len,
+    spr_radix_callback_pt callback, void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPR_RADIX_H */
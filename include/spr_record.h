@@ -0,0 +1,85 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef INCLUDED_SPR_RECORD_H
+#define INCLUDED_SPR_RECORD_H
+
+#include "spr_portable.h"
+#include "spr_pool.h"
+#include "spr_string.h"
+#include "spr_bstream.h"
+#include "spr_mmap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Reader parameters */
+#define SPR_RECORD_CRLF              0x01
+
+typedef struct spr_record_reader_s spr_record_reader_t;
+
+/*
+ * Splits a stream or a memory area into records ended by delim. The
+ * delimiters of a 64 byte block are found at once and kept as a bit
+ * mask, so short records cost a bit scan rather than a call each.
+ * Records point into the stream buffer or the memory area and stay
+ * valid until the next call. Partial is set for a piece of a record
+ * that does not fit into the stream buffer, the last piece and a last
+ * record without its delimiter at the end of input are not partial.
+ */
+struct spr_record_reader_s {
+    spr_bstream_t *stream;
+    uint8_t *pos;
+    uint8_t *next;
+    uint8_t *last;
+    uint8_t *base;
+    uint64_t mask;
+    spr_uint_t flags;
+    uint8_t delim;
+    bool partial;
+};
+
+#define spr_record_reader_create_mmap(pool, mmap, delim, flags) \
+    spr_record_reader_create_buf(pool, spr_mmap_data(mmap), \
+                                 spr_mmap_size(mmap), delim, flags)
+
+spr_record_reader_t *spr_record_reader_create(spr_pool_t *pool,
+    spr_bstream_t *stream, int delim, spr_uint_t flags);
+spr_err_t spr_record_reader_create1(spr_record_reader_t **reader,
+    spr_pool_t *pool, spr_bstream_t *stream, int delim, spr_uint_t flags);
+spr_record_reader_t *spr_record_reader_create_buf(spr_pool_t *pool,
+    const void *buf, size_t len, int delim, spr_uint_t flags);
+
+spr_err_t spr_record_next(spr_record_reader_t *reader, spr_str_t *record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPR_RECORD_H */
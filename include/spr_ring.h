@@ -0,0 +1,98 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef INCLUDED_SPR_RING_H
+#define INCLUDED_SPR_RING_H
+
+#include "spr_pool.h"
+#include "spr_memory.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct spr_ring_s spr_ring_t;
+
+/* Shared part of the ring, placed in front of the data */
+typedef struct {
+    size_t head;
+    uint8_t pad0[SPR_CACHELINE_SIZE - sizeof(size_t)];
+    size_t tail;
+    uint8_t pad1[SPR_CACHELINE_SIZE - sizeof(size_t)];
+    size_t size;
+} spr_ring_ctl_t;
+
+/*
+ * Single-producer single-consumer byte ring. When the data is mapped
+ * twice in a row, reserved and peeked regions never wrap around,
+ * otherwise they end at the end of the buffer and the rest is returned
+ * by the next call.
+ */
+struct spr_ring_s {
+    spr_ring_ctl_t *ctl;
+    uint8_t *data;
+    size_t mask;
+    void *map;
+    size_t map_size;
+#if (SPR_WIN32)
+    HANDLE mapping;
+#endif
+    bool mirror;
+    uint8_t pad0[SPR_CACHELINE_SIZE];
+    /* Producer side */
+    size_t cached_tail;
+    uint8_t pad1[SPR_CACHELINE_SIZE - sizeof(size_t)];
+    /* Consumer side */
+    size_t cached_head;
+    uint8_t pad2[SPR_CACHELINE_SIZE - sizeof(size_t)];
+};
+
+#define spr_ring_capacity(ring)      ((ring)->mask + 1)
+#define spr_ring_mirrored(ring)      ((ring)->mirror)
+
+spr_ring_t *spr_ring_create(spr_pool_t *pool, size_t size);
+spr_err_t spr_ring_create1(spr_ring_t **ring, spr_pool_t *pool,
+    size_t size);
+spr_err_t spr_ring_create_shared(spr_ring_t **ring, spr_pool_t *pool,
+    const char *name, size_t size);
+spr_err_t spr_ring_open_shared(spr_ring_t **ring, spr_pool_t *pool,
+    const char *name);
+spr_err_t spr_ring_remove_shared(const char *name);
+
+void *spr_ring_reserve(spr_ring_t *ring, size_t *len);
+void spr_ring_commit(spr_ring_t *ring, size_t n);
+const void *spr_ring_peek(spr_ring_t *ring, size_t *len);
+void spr_ring_release(spr_ring_t *ring, size_t n);
+
+size_t spr_ring_write(spr_ring_t *ring, const void *data, size_t n);
+size_t spr_ring_read(spr_ring_t *ring, void *buf, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPR_RING_H */
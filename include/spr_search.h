@@ -0,0 +1,82 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef INCLUDED_SPR_SEARCH_H
+#define INCLUDED_SPR_SEARCH_H
+
+#include "spr_portable.h"
+#include "spr_pool.h"
+#include "spr_string.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPR_SEARCH_CASELESS          0x00000001
+
+typedef struct spr_search_s spr_search_t;
+
+/*
+ * Handler is called for every match with the index of the pattern and
+ * the offset of its first byte. Anything other than SPR_OK stops the
+ * scan and is returned by spr_search_scan().
+ */
+typedef spr_int_t (*spr_search_handler_pt)(void *data, size_t pattern,
+    size_t offset);
+
+/*
+ * Aho-Corasick automaton compiled into a dense transition table. Bytes
+ * which occur in no pattern share one column, so a row is only as wide
+ * as the pattern alphabet.
+ */
+struct spr_search_s {
+    uint32_t *delta;
+    uint32_t *match;
+    uint32_t *report;
+    uint32_t *dict;
+    size_t *lens;
+    size_t npatterns;
+    size_t nstates;
+    spr_uint_t nclasses;
+    uint8_t classes[256];
+};
+
+spr_search_t *spr_search_create(spr_pool_t *pool, const spr_str_t *patterns,
+    size_t n, spr_uint_t flags);
+spr_err_t spr_search_create1(spr_search_t **search, spr_pool_t *pool,
+    const spr_str_t *patterns, size_t n, spr_uint_t flags);
+spr_int_t spr_search_scan(const spr_search_t *search, const void *buf,
+    size_t len, spr_search_handler_pt handler, void *data);
+const char *spr_search_find(const spr_search_t *search, const void *buf,
+    size_t len, size_t *pattern);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPR_SEARCH_H */
@@ -0,0 +1,63 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef INCLUDED_SPR_SPRINTF_H
+#define INCLUDED_SPR_SPRINTF_H
+
+#include "spr_portable.h"
+#include "spr_pool.h"
+#include "spr_string.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The formatter understands the C99 conversions with their flags, width,
+ * precision and length modifiers, except %n. On top of that:
+ *
+ *   %V    spr_str_t *
+ *   %R    spr_err_t, the text from spr_strerror()
+ *   %m    the text for spr_get_errno() at the time of the call
+ *   %N    struct sockaddr *, as "addr:port" or "[addr]:port"
+ *
+ * Integers, strings and the SPR types are formatted natively, only the
+ * floating point conversions go through libc.
+ */
+
+char *spr_psprintf(spr_pool_t *pool, const char *fmt, ...);
+char *spr_vpsprintf(spr_pool_t *pool, const char *fmt, va_list args);
+spr_err_t spr_strbuf_printf(spr_strbuf_t *buf, const char *fmt, ...);
+spr_err_t spr_strbuf_vprintf(spr_strbuf_t *buf, const char *fmt,
+    va_list args);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPR_SPRINTF_H */
@@ -31,6 +31,7 @@
 
 #include "spr_portable.h"
 #include "spr_pool.h"
+#include "spr_memory.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -81,18 +82,95 @@ extern "C" {
 
 #define spr_pstrcat(...)             spr_pstrcat1(__VA_ARGS__, NULL)
 
+#define spr_string(text)             { sizeof(text) - 1, (char *) text }
+#define spr_null_string              { 0, NULL }
+
+#define spr_str_set(str, text) \
+    (str)->len = sizeof(text) - 1; (str)->data = (char *) text
+
+#define spr_str_null(str) \
+    (str)->len = 0; (str)->data = NULL
+
+#define spr_str_eq(s1, s2) \
+    ((s1)->len == (s2)->len \
+     && spr_memcmp((s1)->data, (s2)->data, (s1)->len) == 0)
+
+#define spr_str_atoi(str)            spr_atoi((str)->data, (str)->len)
+#define spr_str_atosz(str)           spr_atosz((str)->data, (str)->len)
+
+#define spr_str_pcat(pool, dst, ...) \
+    spr_str_pcat1(pool, dst, __VA_ARGS__, NULL)
+
+#define SPR_STRBUF_DEFAULT_SIZE      64
+
+#define spr_strbuf_commit(buf, n)    ((buf)->len += (n))
+#define spr_strbuf_reset(buf)        ((buf)->len = 0)
+
+#define spr_strbuf_append_str(buf, str) \
+    spr_strbuf_append(buf, (str)->data, (str)->len)
+
+#define spr_strbuf_append_cstr(buf, s) \
+    spr_strbuf_append(buf, s, spr_strlen(s))
+
+typedef struct spr_str_s spr_str_t;
+typedef struct spr_strbuf_s spr_strbuf_t;
+
+struct spr_str_s {
+    size_t len;
+    char *data;
+};
+
+/*
+ * Growable string in pool memory. One byte past size is always
+ * allocated, so that spr_strbuf_finish() can add the terminating NUL
+ * without reallocating.
+ */
+struct spr_strbuf_s {
+    char *data;
+    size_t len;
+    size_t size;
+    spr_pool_t *pool;
+};
+
 spr_int_t spr_atoi(const char *str, size_t n);
 ssize_t spr_atosz(const char *str, size_t n);
+spr_err_t spr_atou64(const char *str, size_t n, uint64_t *value);
+spr_err_t spr_atoi64(const char *str, size_t n, int64_t *value);
+spr_err_t spr_hextou64(const char *str, size_t n, uint64_t *value);
+size_t spr_u64toa(uint64_t value, char *buf);
+size_t spr_i64toa(int64_t value, char *buf);
+size_t spr_u64tohex(uint64_t value, char *buf);
+char *spr_pu64toa(spr_pool_t *pool, uint64_t value);
+char *spr_pi64toa(spr_pool_t *pool, int64_t value);
 size_t spr_strlen(const char *str);
 size_t spr_strnlen(const char *str, size_t n);
-spr_int_t spr_strcasecmp(char *str1, char *str2);
-spr_int_t spr_strncasecmp(char *str1, char *str2, size_t n);
+spr_int_t spr_strcasecmp(const char *str1, const char *str2);
+spr_int_t spr_strncasecmp(const char *str1, const char *str2, size_t n);
+void spr_strlower(char *str, size_t n);
+void spr_strupper(char *str, size_t n);
+uint64_t spr_strcasehash(const char *str, size_t n, uint64_t seed);
 char *spr_strchr(const char *str, int c);
 char *spr_strrchr(const char *str, int c);
+char *spr_strstr(const char *haystack, const char *needle);
+void *spr_memmem(const void *haystack, size_t hlen, const void *needle,
+    size_t nlen);
 char *spr_pstrdup(spr_pool_t *pool, const char *str);
 char *spr_pstrndup(spr_pool_t *pool, const char *str, size_t n);
 char *spr_pstrcat1(spr_pool_t *pool, ...);
 
+spr_int_t spr_str_cmp(const spr_str_t *str1, const spr_str_t *str2);
+spr_int_t spr_str_casecmp(const spr_str_t *str1, const spr_str_t *str2);
+char *spr_str_chr(const spr_str_t *str, int c);
+char *spr_str_find(const spr_str_t *str, const spr_str_t *needle);
+char *spr_str_pdup(spr_pool_t *pool, spr_str_t *dst, const spr_str_t *src);
+char *spr_str_pcat1(spr_pool_t *pool, spr_str_t *dst, ...);
+
+spr_err_t spr_strbuf_init(spr_strbuf_t *buf, spr_pool_t *pool, size_t size);
+char *spr_strbuf_reserve(spr_strbuf_t *buf, size_t n);
+spr_err_t spr_strbuf_append(spr_strbuf_t *buf, const void *data, size_t n);
+spr_err_t spr_strbuf_append_char(spr_strbuf_t *buf, char c);
+char *spr_strbuf_finish(spr_strbuf_t *buf, spr_str_t *str);
+
 #ifdef __cplusplus
 }
 #endif
@@ -80,6 +80,7 @@ extern "C" {
 #endif
 
 void spr_gettimeofday(struct timeval *tv);
+uint64_t spr_monotonic_msec(void);
 void spr_localtime(time_t sec, spr_tm_t *tm);
 
 #ifdef __cplusplus
@@ -0,0 +1,98 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef INCLUDED_SPR_TIMER_H
+#define INCLUDED_SPR_TIMER_H
+
+#include "spr_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPR_TIMER_ROOT_BITS          8
+#define SPR_TIMER_LEVEL_BITS         6
+#define SPR_TIMER_ROOT_SIZE          (1 << SPR_TIMER_ROOT_BITS)
+#define SPR_TIMER_LEVEL_SIZE         (1 << SPR_TIMER_LEVEL_BITS)
+#define SPR_TIMER_LEVELS             4
+
+#define SPR_TIMER_INFINITE           ((uint64_t) -1)
+
+typedef struct spr_timer_s spr_timer_t;
+typedef struct spr_timer_link_s spr_timer_link_t;
+typedef struct spr_timer_wheel_s spr_timer_wheel_t;
+
+typedef void (*spr_timer_handler_pt)(spr_timer_t *timer);
+
+struct spr_timer_link_s {
+    spr_timer_link_t *next;
+    spr_timer_link_t *prev;
+};
+
+/* Timer is usually embedded into the structure which owns it */
+struct spr_timer_s {
+    spr_timer_link_t link;
+    uint64_t expires;
+    spr_timer_handler_pt handler;
+    void *data;
+};
+
+/*
+ * Time is counted in milliseconds, usually spr_monotonic_msec() values.
+ * The root level has a slot per millisecond, every next level covers
+ * the whole previous one with a single slot.
+ */
+struct spr_timer_wheel_s {
+    spr_pool_t *pool;
+    uint64_t time;
+    uint64_t current;
+    size_t size;
+    spr_timer_link_t root[SPR_TIMER_ROOT_SIZE];
+    spr_timer_link_t levels[SPR_TIMER_LEVELS][SPR_TIMER_LEVEL_SIZE];
+};
+
+#define spr_timer_pending(timer)     ((timer)->link.next != NULL)
+#define spr_timer_wheel_size(wheel)  ((wheel)->size)
+
+spr_timer_wheel_t *spr_timer_wheel_create(spr_pool_t *pool, uint64_t now);
+spr_err_t spr_timer_wheel_create1(spr_timer_wheel_t **wheel,
+    spr_pool_t *pool, uint64_t now);
+
+void spr_timer_init(spr_timer_t *timer, spr_timer_handler_pt handler,
+    void *data);
+void spr_timer_add(spr_timer_wheel_t *wheel, spr_timer_t *timer,
+    uint64_t msec);
+void spr_timer_cancel(spr_timer_wheel_t *wheel, spr_timer_t *timer);
+
+size_t spr_timer_wheel_advance(spr_timer_wheel_t *wheel, uint64_t now);
+uint64_t spr_timer_wheel_next_timeout(spr_timer_wheel_t *wheel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPR_TIMER_H */
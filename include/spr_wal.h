@@ -0,0 +1,83 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef INCLUDED_SPR_WAL_H
+#define INCLUDED_SPR_WAL_H
+
+#include "spr_portable.h"
+#include "spr_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Defaults for the sizes given as 0 */
+#define SPR_WAL_BUFFER_SIZE          (4 * 1024 * 1024)
+#define SPR_WAL_BATCH_SIZE           (512 * 1024)
+#define SPR_WAL_SEGMENT_SIZE         (64 * 1024 * 1024)
+
+/* Record size and CRC-32C, both little endian */
+#define SPR_WAL_HEADER_SIZE          8
+
+typedef uint64_t spr_wal_lsn_t;
+typedef struct spr_wal_s spr_wal_t;
+
+/*
+ * An append log with group commit. Appending threads copy framed
+ * records into a shared buffer and one flusher thread writes them out
+ * in batches, with a single data sync per batch. A batch is taken once
+ * batch_size bytes are pending, latency milliseconds after its first
+ * record arrived, or when an appender finds the buffer full.
+ *
+ * The log is a sequence of preallocated segment files named by their
+ * number in hex, "0000000000000001.wal" and so on, in the directory.
+ * A log sequence number is the byte position past a record, segment n
+ * holds positions from n * segment_size. Records never cross segments,
+ * a zero header ends the records of a segment. Opening a directory
+ * that already has segments continues in a new segment after them.
+ */
+
+spr_wal_t *spr_wal_create(spr_pool_t *pool, const char *dir,
+    size_t buffer_size, size_t batch_size, spr_msec_t latency,
+    size_t segment_size);
+spr_err_t spr_wal_create1(spr_wal_t **wal, spr_pool_t *pool,
+    const char *dir, size_t buffer_size, size_t batch_size,
+    spr_msec_t latency, size_t segment_size);
+
+spr_err_t spr_wal_append(spr_wal_t *wal, const void *data, size_t size,
+    spr_wal_lsn_t *lsn);
+spr_err_t spr_wal_wait(spr_wal_t *wal, spr_wal_lsn_t lsn);
+spr_err_t spr_wal_commit(spr_wal_t *wal, const void *data, size_t size);
+spr_err_t spr_wal_flush(spr_wal_t *wal);
+spr_wal_lsn_t spr_wal_durable(spr_wal_t *wal);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPR_WAL_H */
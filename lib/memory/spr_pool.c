@@ -74,6 +74,7 @@ struct spr_cleanup_node_s {
 
 struct spr_pool_s {
     spr_memnode_t *nodes[SPR_MAX_POOL_SLOT];
+    spr_memnode_t *last; /* Served the last allocation, see spr_prealloc */
     spr_pool_t *parent;
     spr_pool_t *brother;
     spr_pool_t *child;
@@ -346,6 +347,7 @@ spr_palloc(spr_pool_t *pool, size_t size)
                 node->size_avail -= align_size;
                 mem = node->first_avail;
                 node->first_avail += align_size;
+                pool->last = node;
                 goto done;
             }
             node = node->next;
@@ -367,6 +369,7 @@ spr_palloc(spr_pool_t *pool, size_t size)
         node->size_avail -= align_size;
         mem = node->first_avail;
         node->first_avail += align_size;
+        pool->last = node;
         goto done;
     }
 
@@ -395,6 +398,82 @@ spr_pcalloc(spr_pool_t *pool, size_t size)
     return mem;
 }
 
+/*
+ * Resizes the block in place when it is the last allocation made from
+ * the pool and its node has room left, otherwise falls back to a fresh
+ * allocation and a copy. The old block is still valid on failure.
+ */
+void *
+spr_prealloc(spr_pool_t *pool, void *mem, size_t old_size, size_t new_size)
+{
+    spr_memnode_t *node;
+    size_t old_align, new_align;
+    void *newmem;
+
+    old_align = spr_align_allocation(old_size);
+    new_align = spr_align_allocation(new_size);
+    if (!old_align || !new_align) {
+        return NULL;
+    }
+
+#if (SPR_POOL_THREAD_SAFETY)
+    spr_mutex_lock(pool->mutex);
+#endif
+
+    node = pool->last;
+
+    if (node && node->first_avail == (uint8_t *) mem + old_align) {
+
+        if (new_align > old_align
+            && node->size_avail < new_align - old_align)
+        {
+            goto copy;
+        }
+
+        node->size_avail += old_align;
+        node->size_avail -= new_align;
+        node->first_avail = (uint8_t *) mem + new_align;
+
+#if (SPR_POOL_THREAD_SAFETY)
+        spr_mutex_unlock(pool->mutex);
+#endif
+        return mem;
+    }
+
+copy:
+#if (SPR_POOL_THREAD_SAFETY)
+    spr_mutex_unlock(pool->mutex);
+#endif
+
+    if (new_size <= old_size) {
+        return mem;
+    }
+
+    newmem = spr_palloc(pool, new_size);
+    if (newmem) {
+        spr_memcpy(newmem, mem, old_size);
+    }
+
+    return newmem;
+}
+
+void *
+spr_pmemalign(spr_pool_t *pool, size_t size, size_t alignment)
+{
+    uint8_t *mem;
+
+    if (size + alignment < size) {
+        return NULL;
+    }
+
+    mem = spr_palloc(pool, size + alignment - 1);
+    if (!mem) {
+        return NULL;
+    }
+
+    return spr_align_ptr(mem, alignment);
+}
+
 void
 spr_pool_cleanup_add1(spr_pool_t *pool, void *data,
     spr_cleanup_handler_t handler)
@@ -589,6 +668,8 @@ spr_pool_clear(spr_pool_t *pool)
         }
     }
 
+    pool->last = NULL;
+
     for (i = 0; i < SPR_MAX_POOL_SLOT; ++i) {
         node = (pool->nodes)[i];
         while (node) {
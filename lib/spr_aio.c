@@ -0,0 +1,761 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "spr_portable.h"
+#include "spr_errno.h"
+#include "spr_atomic.h"
+#include "spr_memory.h"
+#include "spr_pool.h"
+#include "spr_cpuinfo.h"
+#include "spr_thread.h"
+#include "spr_queue.h"
+#include "spr_filesys.h"
+#include "spr_aio.h"
+
+#define SPR_AIO_ENTRIES              256
+
+
+#if (SPR_HAVE_IO_URING)
+
+typedef struct {
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_map;
+    size_t sq_map_size;
+    void *cq_map;
+    size_t cq_map_size;
+    size_t sqes_size;
+    /* Queued in the ring but not yet handed to the kernel */
+    unsigned unsubmitted;
+} spr_aio_uring_t;
+
+#endif
+
+/*
+ * An engine is driven by a single thread, only the worker pool touches
+ * it from other threads and it does so through the queues
+ */
+struct spr_aio_s {
+    size_t entries;
+    size_t inflight;
+    bool uring;
+#if (SPR_HAVE_IO_URING)
+    spr_aio_uring_t ring;
+#endif
+    spr_mpmc_bqueue_t *submit_queue;
+    spr_mpmc_bqueue_t *done_queue;
+    spr_thread_t *threads;
+    spr_uint_t nthreads;
+};
+
+
+#if (SPR_HAVE_IO_URING)
+
+static void
+spr_aio_uring_close(spr_aio_uring_t *ring)
+{
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+
+    if (ring->cq_map && ring->cq_map != ring->sq_map) {
+        munmap(ring->cq_map, ring->cq_map_size);
+    }
+
+    if (ring->sq_map) {
+        munmap(ring->sq_map, ring->sq_map_size);
+    }
+
+    close(ring->fd);
+}
+
+static void *
+spr_aio_uring_map(int fd, size_t size, off_t offset)
+{
+    void *addr;
+
+    addr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+                fd, offset);
+
+    return (addr != MAP_FAILED) ? addr : NULL;
+}
+
+static spr_err_t
+spr_aio_uring_init(spr_aio_t *aio, size_t entries)
+{
+    struct io_uring_params params;
+    spr_aio_uring_t *ring;
+    uint8_t *sq, *cq;
+    spr_err_t err;
+    int fd;
+
+    spr_memzero(&params, sizeof(params));
+
+    fd = (int) syscall(__NR_io_uring_setup, (unsigned) entries, &params);
+    if (fd == -1) {
+        return spr_get_errno();
+    }
+
+    /* IORING_OP_READ and IORING_OP_WRITE arrived with this feature */
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+        close(fd);
+        return SPR_DECLINED;
+    }
+
+    ring = &aio->ring;
+    spr_memzero(ring, sizeof(spr_aio_uring_t));
+    ring->fd = fd;
+
+    ring->sq_map_size = params.sq_off.array
+                        + params.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = params.cq_off.cqes
+                        + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_map_size > ring->sq_map_size) {
+            ring->sq_map_size = ring->cq_map_size;
+        }
+        ring->cq_map_size = ring->sq_map_size;
+    }
+
+    ring->sq_map = spr_aio_uring_map(fd, ring->sq_map_size,
+                                     IORING_OFF_SQ_RING);
+    if (!ring->sq_map) {
+        goto failed;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_map = ring->sq_map;
+
+    } else {
+        ring->cq_map = spr_aio_uring_map(fd, ring->cq_map_size,
+                                         IORING_OFF_CQ_RING);
+        if (!ring->cq_map) {
+            goto failed;
+        }
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = spr_aio_uring_map(fd, ring->sqes_size, IORING_OFF_SQES);
+    if (!ring->sqes) {
+        goto failed;
+    }
+
+    sq = ring->sq_map;
+    cq = ring->cq_map;
+
+    ring->sq_head = (unsigned *) (sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+    ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+    ring->sq_mask = *(unsigned *) (sq + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+
+    ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned *) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+
+    /* The completion ring is larger, it can never overflow */
+    aio->entries = params.sq_entries;
+    aio->uring = 1;
+
+    return SPR_OK;
+
+failed:
+
+    err = spr_get_errno();
+    spr_aio_uring_close(ring);
+
+    return err;
+}
+
+/* Hands queued entries to the kernel and optionally waits for one */
+static spr_err_t
+spr_aio_uring_enter(spr_aio_uring_t *ring, unsigned min_complete)
+{
+    unsigned flags;
+    long n;
+
+    flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+
+    if (ring->unsubmitted == 0 && min_complete == 0) {
+        return SPR_OK;
+    }
+
+    for ( ;; ) {
+        n = syscall(__NR_io_uring_enter, ring->fd, ring->unsubmitted,
+                    min_complete, flags, NULL, 0);
+        if (n >= 0) {
+            ring->unsubmitted -= (unsigned) n;
+            return SPR_OK;
+        }
+
+        if (spr_get_errno() != EINTR) {
+            return spr_get_errno();
+        }
+    }
+}
+
+static void
+spr_aio_uring_prep(struct io_uring_sqe *sqe, spr_aio_req_t *req)
+{
+    bool fixed;
+
+    spr_memzero(sqe, sizeof(struct io_uring_sqe));
+
+    if (req->file_index >= 0) {
+        sqe->fd = (int) req->file_index;
+        sqe->flags = IOSQE_FIXED_FILE;
+
+    } else {
+        sqe->fd = req->file->fd;
+    }
+
+    sqe->user_data = (uint64_t) (uintptr_t) req;
+
+    if (req->op == SPR_AIO_FSYNC) {
+        sqe->opcode = IORING_OP_FSYNC;
+        return;
+    }
+
+    fixed = (req->buf_index >= 0);
+
+    if (req->op == SPR_AIO_READ) {
+        sqe->opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    } else {
+        sqe->opcode = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    }
+
+    if (fixed) {
+        sqe->buf_index = (uint16_t) req->buf_index;
+    }
+
+    /* The kernel shortens large transfers anyway */
+    sqe->addr = (uint64_t) (uintptr_t) req->buf;
+    sqe->len = (req->size > UINT_MAX) ? UINT_MAX : (unsigned) req->size;
+    sqe->off = (uint64_t) req->offset;
+}
+
+static ssize_t
+spr_aio_uring_submit(spr_aio_t *aio, spr_aio_req_t **reqs, size_t n)
+{
+    spr_aio_uring_t *ring;
+    unsigned head, tail, idx;
+    spr_err_t err;
+    size_t i;
+
+    ring = &aio->ring;
+
+    head = spr_atomic_load(ring->sq_head);
+    tail = spr_atomic_load_relaxed(ring->sq_tail);
+
+    for (i = 0; i < n; i++) {
+        if (aio->inflight + i == aio->entries
+            || tail - head == ring->sq_entries)
+        {
+            break;
+        }
+
+        idx = tail & ring->sq_mask;
+
+        spr_aio_uring_prep(&ring->sqes[idx], reqs[i]);
+        ring->sq_array[idx] = idx;
+        tail++;
+    }
+
+    /* The whole batch goes to the kernel with one system call */
+    spr_atomic_store(ring->sq_tail, tail);
+    ring->unsubmitted += (unsigned) i;
+    aio->inflight += i;
+
+    err = spr_aio_uring_enter(ring, 0);
+
+    /*
+     * Requests taken into the ring are queued whatever the kernel said,
+     * they are counted and the error comes back with the next call
+     */
+    if (err != SPR_OK && err != EAGAIN && err != EBUSY && i == 0) {
+        spr_set_errno(err);
+        return -1;
+    }
+
+    return (ssize_t) i;
+}
+
+static size_t
+spr_aio_uring_complete(spr_aio_t *aio, spr_aio_req_t **done, size_t n,
+    bool wait)
+{
+    struct io_uring_cqe *cqe;
+    spr_aio_uring_t *ring;
+    spr_aio_req_t *req;
+    unsigned head, tail;
+    size_t i;
+
+    ring = &aio->ring;
+
+    head = spr_atomic_load_relaxed(ring->cq_head);
+    tail = spr_atomic_load(ring->cq_tail);
+
+    if (head == tail && wait && aio->inflight) {
+        if (spr_aio_uring_enter(ring, 1) != SPR_OK) {
+            return 0;
+        }
+
+        tail = spr_atomic_load(ring->cq_tail);
+
+    } else if (ring->unsubmitted) {
+        (void) spr_aio_uring_enter(ring, 0);
+    }
+
+    for (i = 0; i < n && head != tail; i++, head++) {
+        cqe = &ring->cqes[head & ring->cq_mask];
+        req = (spr_aio_req_t *) (uintptr_t) cqe->user_data;
+
+        if (cqe->res < 0) {
+            req->result = -1;
+            req->err = -cqe->res;
+
+        } else {
+            req->result = cqe->res;
+            req->err = SPR_OK;
+        }
+
+        done[i] = req;
+    }
+
+    spr_atomic_store(ring->cq_head, head);
+
+    return i;
+}
+
+static void
+spr_aio_uring_cleanup(spr_aio_t *aio)
+{
+    spr_aio_uring_close(&aio->ring);
+}
+
+#endif
+
+
+static void
+spr_aio_execute(spr_aio_req_t *req)
+{
+    switch (req->op) {
+
+    case SPR_AIO_READ:
+        req->result = spr_file_read(req->file, req->buf, req->size,
+                                    req->offset);
+        break;
+
+    case SPR_AIO_WRITE:
+        req->result = spr_file_write(req->file, (const char *) req->buf,
+                                     req->size, req->offset);
+        break;
+
+    default:
+#if (SPR_WIN32)
+        req->result = spr_fsync(req->file->fd) ? 0 : -1;
+#else
+        req->result = spr_fsync(req->file->fd);
+#endif
+        break;
+    }
+
+    req->err = (req->result == -1) ? spr_get_errno() : SPR_OK;
+}
+
+static spr_thread_value_t
+spr_aio_worker(void *arg)
+{
+    spr_aio_t *aio;
+    void *req;
+
+    aio = arg;
+
+    for ( ;; ) {
+        if (spr_mpmc_bqueue_pop(aio->submit_queue, &req) != SPR_OK) {
+            continue;
+        }
+
+        /* Sentinel pushed on shutdown */
+        if (!req) {
+            break;
+        }
+
+        spr_aio_execute(req);
+
+        /* Never blocks, at most entries requests are in flight */
+        (void) spr_mpmc_bqueue_push(aio->done_queue, req);
+    }
+
+    return 0;
+}
+
+static void
+spr_aio_threads_stop(spr_aio_t *aio)
+{
+    spr_uint_t i;
+
+    for (i = 0; i < aio->nthreads; i++) {
+        (void) spr_mpmc_bqueue_push(aio->submit_queue, NULL);
+    }
+
+    for (i = 0; i < aio->nthreads; i++) {
+        spr_thread_join(&aio->threads[i]);
+        spr_thread_fini(&aio->threads[i]);
+    }
+
+    aio->nthreads = 0;
+}
+
+static spr_err_t
+spr_aio_threads_init(spr_aio_t *aio, spr_pool_t *pool, size_t entries,
+    spr_uint_t nthreads)
+{
+    spr_err_t err;
+    spr_uint_t i;
+
+    if (nthreads == 0) {
+        nthreads = spr_get_number_cpu();
+    }
+
+    err = spr_mpmc_bqueue_create1(&aio->submit_queue, pool, entries);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    err = spr_mpmc_bqueue_create1(&aio->done_queue, pool, entries);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    aio->threads = spr_palloc(pool, nthreads * sizeof(spr_thread_t));
+    if (!aio->threads) {
+        return spr_get_errno();
+    }
+
+    for (i = 0; i < nthreads; i++) {
+        err = spr_thread_init(&aio->threads[i], SPR_THREAD_CREATE_JOINABLE,
+                              0, SPR_THREAD_PRIORITY_NORMAL, spr_aio_worker,
+                              aio);
+        if (err != SPR_OK) {
+            spr_aio_threads_stop(aio);
+            return err;
+        }
+
+        aio->nthreads++;
+    }
+
+    aio->entries = entries;
+
+    return SPR_OK;
+}
+
+static size_t
+spr_aio_threads_complete(spr_aio_t *aio, spr_aio_req_t **done, size_t n,
+    bool wait)
+{
+    spr_err_t err;
+    void *req;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        if (i == 0 && wait && aio->inflight) {
+            err = spr_mpmc_bqueue_pop(aio->done_queue, &req);
+        } else {
+            err = spr_mpmc_bqueue_try_pop(aio->done_queue, &req);
+        }
+
+        if (err != SPR_OK) {
+            break;
+        }
+
+        done[i] = req;
+    }
+
+    return i;
+}
+
+static void
+spr_aio_threads_cleanup(spr_aio_t *aio)
+{
+    spr_aio_threads_stop(aio);
+}
+
+/*
+ * Uses io_uring where the kernel has it, unless SPR_AIO_THREADS is
+ * given, and falls back to nthreads workers doing blocking I/O
+ * (0 means one per CPU). At most entries requests are in flight.
+ */
+spr_err_t
+spr_aio_create1(spr_aio_t **out_aio, spr_pool_t *pool, size_t entries,
+    spr_uint_t nthreads, spr_uint_t flags)
+{
+    spr_aio_t *aio;
+    spr_err_t err;
+
+    aio = spr_pcalloc(pool, sizeof(spr_aio_t));
+    if (!aio) {
+        return spr_get_errno();
+    }
+
+    if (entries == 0) {
+        entries = SPR_AIO_ENTRIES;
+    }
+
+#if (SPR_HAVE_IO_URING)
+
+    if (!(flags & SPR_AIO_THREADS)
+        && spr_aio_uring_init(aio, entries) == SPR_OK)
+    {
+        spr_pool_cleanup_add(pool, aio, spr_aio_uring_cleanup);
+
+        *out_aio = aio;
+
+        return SPR_OK;
+    }
+
+#else
+
+    (void) flags;
+
+#endif
+
+    err = spr_aio_threads_init(aio, pool, entries, nthreads);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    spr_pool_cleanup_add(pool, aio, spr_aio_threads_cleanup);
+
+    *out_aio = aio;
+
+    return SPR_OK;
+}
+
+spr_aio_t *
+spr_aio_create(spr_pool_t *pool, size_t entries, spr_uint_t nthreads,
+    spr_uint_t flags)
+{
+    spr_aio_t *aio;
+
+    aio = NULL;
+
+    if (spr_aio_create1(&aio, pool, entries, nthreads, flags) != SPR_OK) {
+        return NULL;
+    }
+
+    return aio;
+}
+
+bool
+spr_aio_is_uring(spr_aio_t *aio)
+{
+    return aio->uring;
+}
+
+/* Registered files are referred to by their position in files */
+spr_err_t
+spr_aio_register_files(spr_aio_t *aio, spr_file_t **files, size_t n)
+{
+#if (SPR_HAVE_IO_URING)
+    spr_err_t err;
+    size_t i;
+    int *fds;
+
+    if (!aio->uring) {
+        return SPR_OK;
+    }
+
+    (void) syscall(__NR_io_uring_register, aio->ring.fd,
+                   IORING_UNREGISTER_FILES, NULL, 0);
+
+    if (n == 0) {
+        return SPR_OK;
+    }
+
+    fds = spr_malloc(n * sizeof(int));
+    if (!fds) {
+        return spr_get_errno();
+    }
+
+    for (i = 0; i < n; i++) {
+        fds[i] = files[i]->fd;
+    }
+
+    err = SPR_OK;
+
+    if (syscall(__NR_io_uring_register, aio->ring.fd,
+                IORING_REGISTER_FILES, fds, (unsigned) n) != 0)
+    {
+        err = spr_get_errno();
+    }
+
+    spr_free(fds);
+
+    return err;
+#else
+    (void) aio;
+    (void) files;
+    (void) n;
+    return SPR_OK;
+#endif
+}
+
+/*
+ * Pins the buffers once instead of on every request, a request picks
+ * one by its position in iov and must stay inside it
+ */
+spr_err_t
+spr_aio_register_buffers(spr_aio_t *aio, const spr_iovec_t *iov, size_t n)
+{
+#if (SPR_HAVE_IO_URING)
+    if (!aio->uring) {
+        return SPR_OK;
+    }
+
+    (void) syscall(__NR_io_uring_register, aio->ring.fd,
+                   IORING_UNREGISTER_BUFFERS, NULL, 0);
+
+    if (n == 0) {
+        return SPR_OK;
+    }
+
+    if (syscall(__NR_io_uring_register, aio->ring.fd,
+                IORING_REGISTER_BUFFERS, iov, (unsigned) n) != 0)
+    {
+        return spr_get_errno();
+    }
+
+    return SPR_OK;
+#else
+    (void) aio;
+    (void) iov;
+    (void) n;
+    return SPR_OK;
+#endif
+}
+
+void
+spr_aio_prep(spr_aio_req_t *req, spr_uint_t op, spr_file_t *file,
+    void *buf, size_t size, spr_off_t offset)
+{
+    req->op = op;
+    req->file = file;
+    req->buf = buf;
+    req->size = size;
+    req->offset = offset;
+    req->file_index = -1;
+    req->buf_index = -1;
+    req->handler = NULL;
+    req->data = NULL;
+    req->result = 0;
+    req->err = SPR_OK;
+}
+
+/*
+ * Queues up to n requests, fewer when entries requests are already in
+ * flight, and returns the number queued. Queued requests are owned by
+ * the engine even if the kernel refused to take them yet, they go out
+ * with the next submit or complete. -1 means none of the n was queued,
+ * either an op is invalid or the kernel refused requests queued before.
+ */
+ssize_t
+spr_aio_submit(spr_aio_t *aio, spr_aio_req_t **reqs, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        if (reqs[i]->op > SPR_AIO_FSYNC) {
+            spr_set_errno(EINVAL);
+            return -1;
+        }
+    }
+
+#if (SPR_HAVE_IO_URING)
+    if (aio->uring) {
+        return spr_aio_uring_submit(aio, reqs, n);
+    }
+#endif
+
+    for (i = 0; i < n && aio->inflight < aio->entries; i++) {
+        if (spr_mpmc_bqueue_try_push(aio->submit_queue, reqs[i]) != SPR_OK)
+        {
+            break;
+        }
+
+        aio->inflight++;
+    }
+
+    return (ssize_t) i;
+}
+
+/*
+ * Reaps up to n completed requests into done and calls their handlers.
+ * With wait set it blocks until at least one request completes, unless
+ * nothing is in flight.
+ */
+size_t
+spr_aio_complete(spr_aio_t *aio, spr_aio_req_t **done, size_t n,
+    bool wait)
+{
+    size_t i, count;
+
+#if (SPR_HAVE_IO_URING)
+    count = aio->uring ? spr_aio_uring_complete(aio, done, n, wait)
+                       : spr_aio_threads_complete(aio, done, n, wait);
+#else
+    count = spr_aio_threads_complete(aio, done, n, wait);
+#endif
+
+    aio->inflight -= count;
+
+    for (i = 0; i < count; i++) {
+        if (done[i]->handler) {
+            done[i]->handler(done[i]);
+        }
+    }
+
+    return count;
+}
+
+size_t
+spr_aio_pending(spr_aio_t *aio)
+{
+    return aio->inflight;
+}
@@ -0,0 +1,518 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "spr_portable.h"
+#include "spr_errno.h"
+#include "spr_memory.h"
+#include "spr_pool.h"
+#include "spr_filesys.h"
+#include "spr_bstream.h"
+
+
+/*
+ * Moves the unconsumed bytes to the front and reads after them.
+ * Returns the number of bytes read, 0 at the end of the file.
+ */
+static ssize_t
+spr_bstream_fill(spr_bstream_t *bs)
+{
+    size_t drop, kept;
+    ssize_t n;
+
+    drop = (size_t) (bs->pos - bs->start);
+    drop -= drop % bs->align;
+
+    if (drop) {
+        kept = (size_t) (bs->last - bs->start) - drop;
+        spr_memmove(bs->start, bs->start + drop, kept);
+
+        bs->offset += drop;
+        bs->pos -= drop;
+        bs->last = bs->start + kept;
+    }
+
+    n = spr_file_read(bs->file, bs->last, (size_t) (bs->end - bs->last),
+                      bs->offset + (bs->last - bs->start));
+    if (n > 0) {
+        bs->last += n;
+    }
+
+    return n;
+}
+
+spr_err_t
+spr_bstream_create1(spr_bstream_t **out_bs, spr_pool_t *pool,
+    spr_file_t *file, spr_off_t offset, size_t size, spr_uint_t flags)
+{
+    spr_bstream_t *bs;
+    spr_err_t err;
+
+    bs = spr_pcalloc(pool, sizeof(spr_bstream_t));
+    if (!bs) {
+        return spr_get_errno();
+    }
+
+    if (size == 0) {
+        size = SPR_BSTREAM_SIZE;
+    }
+
+    if (flags & SPR_BSTREAM_ALIGNED) {
+        bs->align = spr_get_page_size();
+        if (file->align > bs->align) {
+            bs->align = file->align;
+        }
+
+        /*
+         * A fill keeps up to align - 1 consumed bytes in front of pos,
+         * one spare block keeps the capacity at the size asked for
+         */
+        size = (size + 2 * bs->align - 1) & ~(bs->align - 1);
+        bs->start = spr_pmemalign(pool, size, bs->align);
+
+    } else {
+        bs->align = 1;
+        bs->start = spr_palloc(pool, size);
+    }
+
+    if (!bs->start) {
+        return spr_get_errno();
+    }
+
+    bs->file = file;
+    bs->pos = bs->start;
+    bs->last = bs->start;
+    bs->end = bs->start + size;
+    bs->flags = flags;
+
+    err = spr_bstream_seek(bs, offset);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    *out_bs = bs;
+
+    return SPR_OK;
+}
+
+spr_bstream_t *
+spr_bstream_create(spr_pool_t *pool, spr_file_t *file, spr_off_t offset,
+    size_t size, spr_uint_t flags)
+{
+    spr_bstream_t *bs;
+
+    bs = NULL;
+
+    if (spr_bstream_create1(&bs, pool, file, offset, size, flags)
+        != SPR_OK)
+    {
+        return NULL;
+    }
+
+    return bs;
+}
+
+/* Reads of at least the buffer size go straight to the caller */
+ssize_t
+spr_bstream_read(spr_bstream_t *bs, void *buf, size_t n)
+{
+    size_t copied, avail;
+    spr_off_t offset;
+    uint8_t *p;
+    ssize_t rc;
+
+    p = buf;
+    copied = 0;
+
+    while (copied < n) {
+        avail = (size_t) (bs->last - bs->pos);
+
+        if (avail) {
+            if (avail > n - copied) {
+                avail = n - copied;
+            }
+
+            spr_memcpy(p + copied, bs->pos, avail);
+            bs->pos += avail;
+            copied += avail;
+            continue;
+        }
+
+        if (n - copied >= (size_t) (bs->end - bs->start)
+            && bs->align == 1)
+        {
+            offset = spr_bstream_tell(bs);
+
+            rc = spr_file_read(bs->file, p + copied, n - copied, offset);
+            if (rc > 0) {
+                bs->offset = offset + rc;
+                bs->pos = bs->start;
+                bs->last = bs->start;
+                copied += rc;
+            }
+
+        } else {
+            rc = spr_bstream_fill(bs);
+        }
+
+        if (rc == -1) {
+            return copied ? (ssize_t) copied : -1;
+        }
+
+        if (rc == 0) {
+            break;
+        }
+    }
+
+    return (ssize_t) copied;
+}
+
+/*
+ * Makes up to n bytes available without consuming them, less only at
+ * the end of the file or when n exceeds the buffer
+ */
+ssize_t
+spr_bstream_peek(spr_bstream_t *bs, const uint8_t **data, size_t n)
+{
+    size_t cap, avail;
+    ssize_t rc;
+
+    cap = spr_bstream_capacity(bs);
+    if (n > cap) {
+        n = cap;
+    }
+
+    while ((size_t) (bs->last - bs->pos) < n) {
+        rc = spr_bstream_fill(bs);
+        if (rc == -1) {
+            return -1;
+        }
+
+        if (rc == 0) {
+            break;
+        }
+    }
+
+    avail = (size_t) (bs->last - bs->pos);
+
+    *data = bs->pos;
+
+    return (ssize_t) (avail < n ? avail : n);
+}
+
+/*
+ * Consumes up to n bytes in place, the data stays valid until the next
+ * call on the stream
+ */
+ssize_t
+spr_bstream_borrow(spr_bstream_t *bs, const uint8_t **data, size_t n)
+{
+    ssize_t rc;
+
+    rc = spr_bstream_peek(bs, data, n);
+    if (rc > 0) {
+        bs->pos += rc;
+    }
+
+    return rc;
+}
+
+/*
+ * Consumes bytes up to and including delim in place. Without delim the
+ * rest of the file or a whole buffer is returned.
+ */
+ssize_t
+spr_bstream_borrow_until(spr_bstream_t *bs, int delim,
+    const uint8_t **data)
+{
+    size_t scanned, len;
+    uint8_t *p;
+    ssize_t rc;
+
+    scanned = 0;
+
+    for ( ;; ) {
+        p = spr_memchr(bs->pos + scanned, delim,
+                       (size_t) (bs->last - bs->pos) - scanned);
+        if (p) {
+            len = (size_t) (p + 1 - bs->pos);
+            break;
+        }
+
+        scanned = (size_t) (bs->last - bs->pos);
+
+        if (scanned >= spr_bstream_capacity(bs)) {
+            len = scanned;
+            break;
+        }
+
+        rc = spr_bstream_fill(bs);
+        if (rc == -1) {
+            return -1;
+        }
+
+        if (rc == 0) {
+            len = scanned;
+            break;
+        }
+    }
+
+    *data = bs->pos;
+    bs->pos += len;
+
+    return (ssize_t) len;
+}
+
+/* Only bytes consumed since the last fill can be put back */
+spr_err_t
+spr_bstream_unread(spr_bstream_t *bs, size_t n)
+{
+    if (n > (size_t) (bs->pos - bs->start)) {
+        return SPR_FAILED;
+    }
+
+    bs->pos -= n;
+
+    return SPR_OK;
+}
+
+/* Asks the kernel to prefetch n bytes past the buffered data */
+spr_err_t
+spr_bstream_readahead(spr_bstream_t *bs, size_t n)
+{
+#if (SPR_POSIX && defined(POSIX_FADV_WILLNEED))
+    return posix_fadvise(bs->file->fd, bs->offset + (bs->last - bs->start),
+                         (off_t) n, POSIX_FADV_WILLNEED);
+#elif (SPR_DARWIN)
+    struct radvisory ra;
+
+    ra.ra_offset = bs->offset + (bs->last - bs->start);
+    ra.ra_count = (n > INT_MAX) ? INT_MAX : (int) n;
+
+    if (fcntl(bs->file->fd, F_RDADVISE, &ra) == -1) {
+        return spr_get_errno();
+    }
+
+    return SPR_OK;
+#else
+    (void) bs;
+    (void) n;
+    return SPR_DECLINED;
+#endif
+}
+
+/*
+ * Buffers the data and flushes whenever the buffer fills up, writes of
+ * at least the buffer size bypass it. A short count means the flush
+ * failed after part of the data was taken.
+ */
+ssize_t
+spr_bstream_write(spr_bstream_t *bs, const void *buf, size_t n)
+{
+    const uint8_t *p;
+    size_t left, k;
+
+    if (n <= (size_t) (bs->end - bs->pos)) {
+        spr_memcpy(bs->pos, buf, n);
+        bs->pos += n;
+        return (ssize_t) n;
+    }
+
+    p = buf;
+
+    for (left = n; left; left -= k, p += k) {
+        if (bs->pos == bs->start
+            && left >= (size_t) (bs->end - bs->start)
+            && left % bs->align == 0
+            && (bs->file->align == 0 || (uintptr_t) p % bs->align == 0))
+        {
+            if (spr_file_write(bs->file, (const char *) p, left, bs->offset)
+                == -1)
+            {
+                break;
+            }
+
+            bs->offset += left;
+            left = 0;
+            break;
+        }
+
+        k = (size_t) (bs->end - bs->pos);
+        if (k > left) {
+            k = left;
+        }
+
+        spr_memcpy(bs->pos, p, k);
+        bs->pos += k;
+
+        if (bs->pos == bs->end && spr_bstream_flush(bs) != SPR_OK) {
+            left -= k;
+            break;
+        }
+    }
+
+    if (left == n) {
+        return -1;
+    }
+
+    return (ssize_t) (n - left);
+}
+
+/*
+ * Writes the buffered data out. Aligned streams keep a partial last
+ * block, it is written again together with what follows it. A direct
+ * file only takes whole blocks, so the partial block goes out padded
+ * with zeros and the file may end past spr_bstream_tell() until
+ * spr_bstream_close() truncates it.
+ */
+spr_err_t
+spr_bstream_flush(spr_bstream_t *bs)
+{
+    size_t n, size, tail;
+
+    n = (size_t) (bs->pos - bs->start);
+    if (n == 0) {
+        return SPR_OK;
+    }
+
+    size = n;
+
+    if (bs->file->align) {
+        size = (n + bs->align - 1) & ~(bs->align - 1);
+        spr_memzero(bs->pos, size - n);
+    }
+
+    if (spr_file_write(bs->file, (const char *) bs->start, size, bs->offset)
+        == -1)
+    {
+        return spr_get_errno();
+    }
+
+    tail = n % bs->align;
+
+    if (tail) {
+        spr_memmove(bs->start, bs->start + n - tail, tail);
+    }
+
+    bs->offset += n - tail;
+    bs->pos = bs->start + tail;
+
+    return SPR_OK;
+}
+
+/*
+ * A writer is flushed first. Readers keep the buffer when the offset
+ * falls into it, aligned readers load the block holding the offset.
+ * Aligned writers only move to aligned offsets.
+ */
+spr_err_t
+spr_bstream_seek(spr_bstream_t *bs, spr_off_t offset)
+{
+    spr_err_t err;
+    size_t delta;
+    ssize_t n;
+
+    if (offset < 0) {
+        return SPR_FAILED;
+    }
+
+    delta = (size_t) offset % bs->align;
+
+    if (bs->flags & SPR_BSTREAM_WRITE) {
+        if (delta) {
+            return SPR_FAILED;
+        }
+
+        err = spr_bstream_flush(bs);
+        if (err != SPR_OK) {
+            return err;
+        }
+
+        bs->offset = offset;
+        bs->pos = bs->start;
+        bs->last = bs->start;
+
+        return SPR_OK;
+    }
+
+    if (offset >= bs->offset
+        && offset <= bs->offset + (bs->last - bs->start))
+    {
+        bs->pos = bs->start + (offset - bs->offset);
+        return SPR_OK;
+    }
+
+    bs->offset = offset - (spr_off_t) delta;
+    bs->pos = bs->start;
+    bs->last = bs->start;
+
+    if (delta == 0) {
+        return SPR_OK;
+    }
+
+    n = spr_file_read(bs->file, bs->start, (size_t) (bs->end - bs->start),
+                      bs->offset);
+    if (n == -1) {
+        return spr_get_errno();
+    }
+
+    /* Past the end of the file there is no block to align to */
+    if ((size_t) n < delta) {
+        bs->offset = offset;
+        return SPR_OK;
+    }
+
+    bs->last = bs->start + n;
+    bs->pos = bs->start + delta;
+
+    return SPR_OK;
+}
+
+/*
+ * Finishes a writer, the data is flushed and a direct file loses the
+ * zero padding of its last block. Readers have nothing to finish.
+ */
+spr_err_t
+spr_bstream_close(spr_bstream_t *bs)
+{
+    spr_err_t err;
+
+    if (!(bs->flags & SPR_BSTREAM_WRITE)) {
+        return SPR_OK;
+    }
+
+    err = spr_bstream_flush(bs);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    if (bs->file->align && bs->pos != bs->start) {
+        return spr_file_truncate(bs->file, spr_bstream_tell(bs));
+    }
+
+    return SPR_OK;
+}
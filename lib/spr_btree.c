@@ -0,0 +1,1008 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "spr_portable.h"
+#include "spr_btree.h"
+#include "spr_memory.h"
+#include "spr_errno.h"
+#include "spr_cpuinfo.h"
+
+#if (SPR_HAVE_AVX2)
+#include <immintrin.h>
+#endif
+
+#if (SPR_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+#define SPR_BTREE_MIN_KEYS           (SPR_BTREE_ORDER / 2)
+#define SPR_BTREE_NODES_CHUNK        8
+
+#define SPR_BTREE_NODE_SIZE \
+    spr_align(sizeof(spr_btree_node_t), SPR_CACHELINE_SIZE)
+
+#define spr_btree_less(tree, a, b) \
+    ((tree)->compare ? (tree)->compare(a, b) < 0 : (a) < (b))
+
+
+static spr_uint_t
+spr_btree_rank_compare(spr_btree_t *tree, spr_btree_node_t *node,
+    uint64_t key, spr_uint_t upper)
+{
+    spr_uint_t lo, hi, mid;
+    int rv;
+
+    lo = 0;
+    hi = node->nkeys;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        rv = tree->compare(node->keys[mid], key);
+        if (rv < 0 || (upper && rv == 0)) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+static spr_uint_t
+spr_btree_rank_scalar(spr_btree_t *tree, spr_btree_node_t *node,
+    uint64_t key, spr_uint_t upper)
+{
+    spr_uint_t lo, n, half;
+    uint64_t *keys;
+
+    (void) tree;
+
+    keys = node->keys;
+    lo = 0;
+    n = node->nkeys;
+
+    /* Branchless binary search */
+    while (n > 1) {
+        half = n / 2;
+        if (upper) {
+            lo = (keys[lo + half - 1] <= key) ? lo + half : lo;
+        }
+        else {
+            lo = (keys[lo + half - 1] < key) ? lo + half : lo;
+        }
+        n -= half;
+    }
+
+    if (n == 1) {
+        lo += upper ? (keys[lo] <= key) : (keys[lo] < key);
+    }
+
+    return lo;
+}
+
+#if (SPR_HAVE_AVX2)
+
+/*
+ * Keys are sorted, so the rank is the number of keys less
+ * (or less or equal) than the given key
+ */
+static SPR_TARGET_AVX2 spr_uint_t
+spr_btree_rank_avx2(spr_btree_t *tree, spr_btree_node_t *node,
+    uint64_t key, spr_uint_t upper)
+{
+    __m256i sign, k, v;
+    spr_uint_t i, n, mask, rank;
+
+    (void) tree;
+
+    sign = _mm256_set1_epi64x((long long) 0x8000000000000000ULL);
+    k = _mm256_xor_si256(_mm256_set1_epi64x((long long) key), sign);
+    n = node->nkeys;
+    rank = 0;
+
+    for (i = 0; i < n; i += 4) {
+        v = _mm256_xor_si256(
+                _mm256_loadu_si256((const __m256i *) (node->keys + i)), sign);
+
+        if (upper) {
+            /* Count keys which are not greater */
+            mask = ~_mm256_movemask_pd(
+                        _mm256_castsi256_pd(_mm256_cmpgt_epi64(v, k))) & 0xf;
+        }
+        else {
+            mask = _mm256_movemask_pd(
+                        _mm256_castsi256_pd(_mm256_cmpgt_epi64(k, v)));
+        }
+
+        if (n - i < 4) {
+            mask &= (1U << (n - i)) - 1;
+        }
+
+        rank += __builtin_popcount(mask);
+
+        if (mask != 0xf) {
+            break;
+        }
+    }
+
+    return rank;
+}
+
+#endif
+
+#if (SPR_HAVE_NEON)
+
+static spr_uint_t
+spr_btree_rank_neon(spr_btree_t *tree, spr_btree_node_t *node,
+    uint64_t key, spr_uint_t upper)
+{
+    uint64x2_t k, v, m;
+    spr_uint_t i, n, rank, cnt;
+
+    (void) tree;
+
+    k = vdupq_n_u64(key);
+    n = node->nkeys;
+    rank = 0;
+
+    for (i = 0; i < n; i += 2) {
+        v = vld1q_u64(node->keys + i);
+        m = upper ? vcleq_u64(v, k) : vcltq_u64(v, k);
+
+        cnt = (vgetq_lane_u64(m, 0) & 1);
+        if (n - i > 1) {
+            cnt += (vgetq_lane_u64(m, 1) & 1);
+        }
+
+        rank += cnt;
+
+        if (cnt != 2) {
+            break;
+        }
+    }
+
+    return rank;
+}
+
+#endif
+
+static spr_btree_rank_pt
+spr_btree_select_rank(spr_btree_compare_pt compare)
+{
+    if (compare) {
+        return spr_btree_rank_compare;
+    }
+
+#if (SPR_HAVE_AVX2)
+    if (spr_cpu_has_feature(SPR_CPU_FEATURE_AVX2)) {
+        return spr_btree_rank_avx2;
+    }
+#endif
+
+#if (SPR_HAVE_NEON)
+    if (spr_cpu_has_feature(SPR_CPU_FEATURE_NEON)) {
+        return spr_btree_rank_neon;
+    }
+#endif
+
+    return spr_btree_rank_scalar;
+}
+
+spr_err_t
+spr_btree_create1(spr_btree_t **out_tree, spr_pool_t *pool,
+    spr_btree_compare_pt compare)
+{
+    spr_btree_t *tree;
+
+    tree = spr_pcalloc(pool, sizeof(spr_btree_t));
+    if (!tree) {
+        return spr_get_errno();
+    }
+
+    /*
+     * Next fields set by spr_pcalloc()
+     *
+     * tree->root = NULL;
+     * tree->first = NULL;
+     * tree->last = NULL;
+     * tree->free_nodes = NULL;
+     * tree->nfree = 0;
+     * tree->size = 0;
+     * tree->height = 0;
+     *
+     */
+
+    tree->pool = pool;
+    tree->compare = compare;
+    tree->rank = spr_btree_select_rank(compare);
+
+    *out_tree = tree;
+
+    return SPR_OK;
+}
+
+spr_btree_t *
+spr_btree_create(spr_pool_t *pool, spr_btree_compare_pt compare)
+{
+    spr_btree_t *tree;
+
+    tree = NULL;
+
+    if (spr_btree_create1(&tree, pool, compare) != SPR_OK) {
+        return NULL;
+    }
+
+    return tree;
+}
+
+/* Guarantees that next n node allocations succeed */
+static spr_err_t
+spr_btree_reserve(spr_btree_t *tree, size_t n)
+{
+    spr_btree_node_t *node;
+    uint8_t *mem;
+    size_t count, i;
+
+    if (tree->nfree >= n) {
+        return SPR_OK;
+    }
+
+    count = n - tree->nfree;
+    if (count < SPR_BTREE_NODES_CHUNK) {
+        count = SPR_BTREE_NODES_CHUNK;
+    }
+
+    mem = spr_pmemalign(tree->pool, count * SPR_BTREE_NODE_SIZE,
+                        SPR_CACHELINE_SIZE);
+    if (!mem) {
+        return spr_get_errno();
+    }
+
+    for (i = 0; i < count; ++i) {
+        node = (spr_btree_node_t *) (mem + i * SPR_BTREE_NODE_SIZE);
+        node->u.children[0] = tree->free_nodes;
+        tree->free_nodes = node;
+    }
+
+    tree->nfree += count;
+
+    return SPR_OK;
+}
+
+static spr_btree_node_t *
+spr_btree_node_alloc(spr_btree_t *tree, uint32_t leaf)
+{
+    spr_btree_node_t *node;
+
+    node = tree->free_nodes;
+    tree->free_nodes = node->u.children[0];
+    tree->nfree -= 1;
+
+    node->nkeys = 0;
+    node->leaf = leaf;
+
+    if (leaf) {
+        node->u.leaf.prev = NULL;
+        node->u.leaf.next = NULL;
+    }
+
+    return node;
+}
+
+static void
+spr_btree_node_free(spr_btree_t *tree, spr_btree_node_t *node)
+{
+    node->u.children[0] = tree->free_nodes;
+    tree->free_nodes = node;
+    tree->nfree += 1;
+}
+
+static spr_btree_node_t *
+spr_btree_find_leaf(spr_btree_t *tree, uint64_t key,
+    spr_btree_node_t **path, spr_uint_t *index, spr_uint_t *depth)
+{
+    spr_btree_node_t *node;
+    spr_uint_t i, d;
+
+    node = tree->root;
+    d = 0;
+
+    while (!node->leaf) {
+        i = tree->rank(tree, node, key, 1);
+        if (path) {
+            path[d] = node;
+            index[d] = i;
+        }
+        d++;
+        node = node->u.children[i];
+    }
+
+    if (depth) {
+        *depth = d;
+    }
+
+    return node;
+}
+
+static void
+spr_btree_leaf_insert(spr_btree_node_t *node, spr_uint_t i, uint64_t key,
+    void *value)
+{
+    spr_uint_t n;
+
+    n = node->nkeys - i;
+
+    spr_memmove(&node->keys[i + 1], &node->keys[i], n * sizeof(uint64_t));
+    spr_memmove(&node->u.leaf.values[i + 1], &node->u.leaf.values[i],
+                n * sizeof(void *));
+
+    node->keys[i] = key;
+    node->u.leaf.values[i] = value;
+    node->nkeys += 1;
+}
+
+static void
+spr_btree_inner_insert(spr_btree_node_t *node, spr_uint_t i, uint64_t key,
+    spr_btree_node_t *child)
+{
+    spr_uint_t n;
+
+    n = node->nkeys - i;
+
+    spr_memmove(&node->keys[i + 1], &node->keys[i], n * sizeof(uint64_t));
+    spr_memmove(&node->u.children[i + 2], &node->u.children[i + 1],
+                n * sizeof(spr_btree_node_t *));
+
+    node->keys[i] = key;
+    node->u.children[i + 1] = child;
+    node->nkeys += 1;
+}
+
+static spr_btree_node_t *
+spr_btree_leaf_split(spr_btree_t *tree, spr_btree_node_t *node,
+    spr_uint_t i, uint64_t key, void *value)
+{
+    spr_btree_node_t *right;
+    spr_uint_t split, n;
+
+    right = spr_btree_node_alloc(tree, 1);
+
+    /* Number of entries which stay in the left node */
+    split = (SPR_BTREE_ORDER + 1) / 2;
+
+    if (i < split) {
+        split -= 1;
+    }
+
+    n = SPR_BTREE_ORDER - split;
+
+    spr_memcpy(right->keys, &node->keys[split], n * sizeof(uint64_t));
+    spr_memcpy(right->u.leaf.values, &node->u.leaf.values[split],
+               n * sizeof(void *));
+    right->nkeys = n;
+    node->nkeys = split;
+
+    if (i <= split) {
+        spr_btree_leaf_insert(node, i, key, value);
+    }
+    else {
+        spr_btree_leaf_insert(right, i - split, key, value);
+    }
+
+    right->u.leaf.next = node->u.leaf.next;
+    right->u.leaf.prev = node;
+
+    if (node->u.leaf.next) {
+        node->u.leaf.next->u.leaf.prev = right;
+    }
+    else {
+        tree->last = right;
+    }
+
+    node->u.leaf.next = right;
+
+    return right;
+}
+
+static spr_btree_node_t *
+spr_btree_inner_split(spr_btree_t *tree, spr_btree_node_t *node,
+    spr_uint_t i, uint64_t *key, spr_btree_node_t *child)
+{
+    uint64_t keys[SPR_BTREE_ORDER + 1];
+    spr_btree_node_t *children[SPR_BTREE_ORDER + 2];
+    spr_btree_node_t *right;
+    spr_uint_t mid, n;
+
+    spr_memcpy(keys, node->keys, i * sizeof(uint64_t));
+    keys[i] = *key;
+    spr_memcpy(&keys[i + 1], &node->keys[i],
+               (SPR_BTREE_ORDER - i) * sizeof(uint64_t));
+
+    spr_memcpy(children, node->u.children,
+               (i + 1) * sizeof(spr_btree_node_t *));
+    children[i + 1] = child;
+    spr_memcpy(&children[i + 2], &node->u.children[i + 1],
+               (SPR_BTREE_ORDER - i) * sizeof(spr_btree_node_t *));
+
+    right = spr_btree_node_alloc(tree, 0);
+
+    /* The middle key moves up to the parent */
+    mid = (SPR_BTREE_ORDER + 1) / 2;
+    n = SPR_BTREE_ORDER - mid;
+
+    spr_memcpy(node->keys, keys, mid * sizeof(uint64_t));
+    spr_memcpy(node->u.children, children,
+               (mid + 1) * sizeof(spr_btree_node_t *));
+    node->nkeys = mid;
+
+    spr_memcpy(right->keys, &keys[mid + 1], n * sizeof(uint64_t));
+    spr_memcpy(right->u.children, &children[mid + 1],
+               (n + 1) * sizeof(spr_btree_node_t *));
+    right->nkeys = n;
+
+    *key = keys[mid];
+
+    return right;
+}
+
+spr_err_t
+spr_btree_insert(spr_btree_t *tree, uint64_t key, void *value)
+{
+    spr_btree_node_t *path[SPR_BTREE_MAX_HEIGHT];
+    spr_uint_t index[SPR_BTREE_MAX_HEIGHT];
+    spr_btree_node_t *node, *child, *root;
+    spr_uint_t i, depth, d;
+    size_t needed;
+    spr_err_t err;
+
+    if (!tree->root) {
+        err = spr_btree_reserve(tree, 1);
+        if (err != SPR_OK) {
+            return err;
+        }
+
+        node = spr_btree_node_alloc(tree, 1);
+        node->keys[0] = key;
+        node->u.leaf.values[0] = value;
+        node->nkeys = 1;
+
+        tree->root = node;
+        tree->first = node;
+        tree->last = node;
+        tree->height = 1;
+        tree->size = 1;
+
+        return SPR_OK;
+    }
+
+    node = spr_btree_find_leaf(tree, key, path, index, &depth);
+
+    i = tree->rank(tree, node, key, 0);
+    if (i < node->nkeys && !spr_btree_less(tree, key, node->keys[i])) {
+        return SPR_DECLINED;
+    }
+
+    if (node->nkeys < SPR_BTREE_ORDER) {
+        spr_btree_leaf_insert(node, i, key, value);
+        tree->size += 1;
+        return SPR_OK;
+    }
+
+    /* Reserve nodes for all the splits so that insert can't fail midway */
+    needed = 1;
+    d = depth;
+
+    while (d > 0 && path[d - 1]->nkeys == SPR_BTREE_ORDER) {
+        needed++;
+        d--;
+    }
+
+    if (d == 0) {
+        if (depth + 1 >= SPR_BTREE_MAX_HEIGHT) {
+            return SPR_FAILED;
+        }
+        needed++;
+    }
+
+    err = spr_btree_reserve(tree, needed);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    child = spr_btree_leaf_split(tree, node, i, key, value);
+    key = child->keys[0];
+
+    tree->size += 1;
+
+    while (depth > 0) {
+        depth--;
+        node = path[depth];
+        i = index[depth];
+
+        if (node->nkeys < SPR_BTREE_ORDER) {
+            spr_btree_inner_insert(node, i, key, child);
+            return SPR_OK;
+        }
+
+        child = spr_btree_inner_split(tree, node, i, &key, child);
+    }
+
+    root = spr_btree_node_alloc(tree, 0);
+    root->keys[0] = key;
+    root->u.children[0] = tree->root;
+    root->u.children[1] = child;
+    root->nkeys = 1;
+
+    tree->root = root;
+    tree->height += 1;
+
+    return SPR_OK;
+}
+
+void *
+spr_btree_find(spr_btree_t *tree, uint64_t key)
+{
+    spr_btree_node_t *node;
+    spr_uint_t i;
+
+    if (!tree->root) {
+        return NULL;
+    }
+
+    node = spr_btree_find_leaf(tree, key, NULL, NULL, NULL);
+
+    i = tree->rank(tree, node, key, 0);
+    if (i < node->nkeys && !spr_btree_less(tree, key, node->keys[i])) {
+        return node->u.leaf.values[i];
+    }
+
+    return NULL;
+}
+
+static void
+spr_btree_borrow_left(spr_btree_node_t *parent, spr_uint_t ci,
+    spr_btree_node_t *left, spr_btree_node_t *node)
+{
+    spr_uint_t n;
+
+    n = node->nkeys;
+
+    spr_memmove(&node->keys[1], &node->keys[0], n * sizeof(uint64_t));
+
+    if (node->leaf) {
+        spr_memmove(&node->u.leaf.values[1], &node->u.leaf.values[0],
+                    n * sizeof(void *));
+
+        node->keys[0] = left->keys[left->nkeys - 1];
+        node->u.leaf.values[0] = left->u.leaf.values[left->nkeys - 1];
+        parent->keys[ci - 1] = node->keys[0];
+    }
+    else {
+        spr_memmove(&node->u.children[1], &node->u.children[0],
+                    (n + 1) * sizeof(spr_btree_node_t *));
+
+        node->keys[0] = parent->keys[ci - 1];
+        node->u.children[0] = left->u.children[left->nkeys];
+        parent->keys[ci - 1] = left->keys[left->nkeys - 1];
+    }
+
+    node->nkeys += 1;
+    left->nkeys -= 1;
+}
+
+static void
+spr_btree_borrow_right(spr_btree_node_t *parent, spr_uint_t ci,
+    spr_btree_node_t *node, spr_btree_node_t *right)
+{
+    spr_uint_t n;
+
+    n = right->nkeys - 1;
+
+    if (node->leaf) {
+        node->keys[node->nkeys] = right->keys[0];
+        node->u.leaf.values[node->nkeys] = right->u.leaf.values[0];
+
+        spr_memmove(&right->keys[0], &right->keys[1], n * sizeof(uint64_t));
+        spr_memmove(&right->u.leaf.values[0], &right->u.leaf.values[1],
+                    n * sizeof(void *));
+
+        parent->keys[ci] = right->keys[0];
+    }
+    else {
+        node->keys[node->nkeys] = parent->keys[ci];
+        node->u.children[node->nkeys + 1] = right->u.children[0];
+        parent->keys[ci] = right->keys[0];
+
+        spr_memmove(&right->keys[0], &right->keys[1], n * sizeof(uint64_t));
+        spr_memmove(&right->u.children[0], &right->u.children[1],
+                    (n + 1) * sizeof(spr_btree_node_t *));
+    }
+
+    node->nkeys += 1;
+    right->nkeys -= 1;
+}
+
+/* Merges children ci and ci + 1 of the parent */
+static void
+spr_btree_merge(spr_btree_t *tree, spr_btree_node_t *parent, spr_uint_t ci)
+{
+    spr_btree_node_t *left, *right;
+    spr_uint_t n;
+
+    left = parent->u.children[ci];
+    right = parent->u.children[ci + 1];
+
+    if (left->leaf) {
+        spr_memcpy(&left->keys[left->nkeys], right->keys,
+                   right->nkeys * sizeof(uint64_t));
+        spr_memcpy(&left->u.leaf.values[left->nkeys], right->u.leaf.values,
+                   right->nkeys * sizeof(void *));
+        left->nkeys += right->nkeys;
+
+        left->u.leaf.next = right->u.leaf.next;
+
+        if (right->u.leaf.next) {
+            right->u.leaf.next->u.leaf.prev = left;
+        }
+        else {
+            tree->last = left;
+        }
+    }
+    else {
+        left->keys[left->nkeys] = parent->keys[ci];
+        spr_memcpy(&left->keys[left->nkeys + 1], right->keys,
+                   right->nkeys * sizeof(uint64_t));
+        spr_memcpy(&left->u.children[left->nkeys + 1], right->u.children,
+                   (right->nkeys + 1) * sizeof(spr_btree_node_t *));
+        left->nkeys += right->nkeys + 1;
+    }
+
+    n = parent->nkeys - ci - 1;
+
+    spr_memmove(&parent->keys[ci], &parent->keys[ci + 1],
+                n * sizeof(uint64_t));
+    spr_memmove(&parent->u.children[ci + 1], &parent->u.children[ci + 2],
+                n * sizeof(spr_btree_node_t *));
+    parent->nkeys -= 1;
+
+    spr_btree_node_free(tree, right);
+}
+
+spr_err_t
+spr_btree_remove(spr_btree_t *tree, uint64_t key, void **value)
+{
+    spr_btree_node_t *path[SPR_BTREE_MAX_HEIGHT];
+    spr_uint_t index[SPR_BTREE_MAX_HEIGHT];
+    spr_btree_node_t *node, *parent, *left, *right, *root;
+    spr_uint_t i, ci, depth, n;
+
+    if (!tree->root) {
+        return SPR_NOT_FOUND;
+    }
+
+    node = spr_btree_find_leaf(tree, key, path, index, &depth);
+
+    i = tree->rank(tree, node, key, 0);
+    if (i >= node->nkeys || spr_btree_less(tree, key, node->keys[i])) {
+        return SPR_NOT_FOUND;
+    }
+
+    if (value) {
+        *value = node->u.leaf.values[i];
+    }
+
+    n = node->nkeys - i - 1;
+
+    spr_memmove(&node->keys[i], &node->keys[i + 1], n * sizeof(uint64_t));
+    spr_memmove(&node->u.leaf.values[i], &node->u.leaf.values[i + 1],
+                n * sizeof(void *));
+    node->nkeys -= 1;
+
+    tree->size -= 1;
+
+    while (depth > 0 && node->nkeys < SPR_BTREE_MIN_KEYS) {
+        parent = path[depth - 1];
+        ci = index[depth - 1];
+
+        left = (ci > 0) ? parent->u.children[ci - 1] : NULL;
+        right = (ci < parent->nkeys) ? parent->u.children[ci + 1] : NULL;
+
+        if (left && left->nkeys > SPR_BTREE_MIN_KEYS) {
+            spr_btree_borrow_left(parent, ci, left, node);
+            break;
+        }
+
+        if (right && right->nkeys > SPR_BTREE_MIN_KEYS) {
+            spr_btree_borrow_right(parent, ci, node, right);
+            break;
+        }
+
+        if (left) {
+            spr_btree_merge(tree, parent, ci - 1);
+        }
+        else {
+            spr_btree_merge(tree, parent, ci);
+        }
+
+        node = parent;
+        depth--;
+    }
+
+    root = tree->root;
+
+    if (!root->leaf && root->nkeys == 0) {
+        tree->root = root->u.children[0];
+        tree->height -= 1;
+        spr_btree_node_free(tree, root);
+    }
+    else if (root->leaf && root->nkeys == 0) {
+        tree->root = NULL;
+        tree->first = NULL;
+        tree->last = NULL;
+        tree->height = 0;
+        spr_btree_node_free(tree, root);
+    }
+
+    return SPR_OK;
+}
+
+static uint64_t
+spr_btree_min_key(spr_btree_node_t *node)
+{
+    while (!node->leaf) {
+        node = node->u.children[0];
+    }
+
+    return node->keys[0];
+}
+
+spr_err_t
+spr_btree_bulk_load(spr_btree_t *tree, const uint64_t *keys,
+    void *const *values, size_t n)
+{
+    spr_btree_node_t **level, *node, *prev;
+    size_t i, j, count, nnodes, total, per, extra, taken;
+    spr_err_t err;
+
+    if (tree->root) {
+        return SPR_DECLINED;
+    }
+
+    if (n == 0) {
+        return SPR_OK;
+    }
+
+    for (i = 1; i < n; ++i) {
+        if (!spr_btree_less(tree, keys[i - 1], keys[i])) {
+            return SPR_FAILED;
+        }
+    }
+
+    /* Count nodes of all the levels to allocate them at once */
+    nnodes = (n + SPR_BTREE_ORDER - 1) / SPR_BTREE_ORDER;
+    total = nnodes;
+
+    for (count = nnodes; count > 1; ) {
+        count = (count + SPR_BTREE_ORDER) / (SPR_BTREE_ORDER + 1);
+        total += count;
+    }
+
+    err = spr_btree_reserve(tree, total);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    level = spr_malloc(nnodes * sizeof(spr_btree_node_t *));
+    if (!level) {
+        return spr_get_errno();
+    }
+
+    /* Spread keys evenly, so every leaf is at least half full */
+    per = n / nnodes;
+    extra = n % nnodes;
+    prev = NULL;
+    taken = 0;
+
+    for (i = 0; i < nnodes; ++i) {
+        node = spr_btree_node_alloc(tree, 1);
+        node->nkeys = per + (i < extra);
+
+        spr_memcpy(node->keys, keys + taken, node->nkeys * sizeof(uint64_t));
+
+        for (j = 0; j < node->nkeys; ++j) {
+            node->u.leaf.values[j] = values ? values[taken + j] : NULL;
+        }
+
+        taken += node->nkeys;
+
+        node->u.leaf.prev = prev;
+        if (prev) {
+            prev->u.leaf.next = node;
+        }
+        prev = node;
+
+        level[i] = node;
+    }
+
+    tree->first = level[0];
+    tree->last = prev;
+    tree->height = 1;
+
+    /* Build inner levels in place, parents never outrun their children */
+    while (nnodes > 1) {
+        count = (nnodes + SPR_BTREE_ORDER) / (SPR_BTREE_ORDER + 1);
+        per = nnodes / count;
+        extra = nnodes % count;
+        taken = 0;
+
+        for (i = 0; i < count; ++i) {
+            node = spr_btree_node_alloc(tree, 0);
+            node->nkeys = per + (i < extra) - 1;
+
+            node->u.children[0] = level[taken];
+
+            for (j = 0; j < node->nkeys; ++j) {
+                node->u.children[j + 1] = level[taken + j + 1];
+                node->keys[j] = spr_btree_min_key(level[taken + j + 1]);
+            }
+
+            taken += node->nkeys + 1;
+            level[i] = node;
+        }
+
+        nnodes = count;
+        tree->height += 1;
+    }
+
+    tree->root = level[0];
+    tree->size = n;
+
+    spr_free(level);
+
+    return SPR_OK;
+}
+
+static void
+spr_btree_free_subtree(spr_btree_t *tree, spr_btree_node_t *node)
+{
+    spr_uint_t i;
+
+    if (!node->leaf) {
+        for (i = 0; i <= node->nkeys; ++i) {
+            spr_btree_free_subtree(tree, node->u.children[i]);
+        }
+    }
+
+    spr_btree_node_free(tree, node);
+}
+
+void
+spr_btree_clear(spr_btree_t *tree)
+{
+    if (tree->root) {
+        spr_btree_free_subtree(tree, tree->root);
+    }
+
+    tree->root = NULL;
+    tree->first = NULL;
+    tree->last = NULL;
+    tree->size = 0;
+    tree->height = 0;
+}
+
+static bool
+spr_btree_bound(spr_btree_t *tree, uint64_t key, spr_uint_t upper,
+    spr_btree_iter_t *it)
+{
+    spr_btree_node_t *node;
+
+    it->node = NULL;
+    it->pos = 0;
+
+    if (!tree->root) {
+        return 0;
+    }
+
+    node = spr_btree_find_leaf(tree, key, NULL, NULL, NULL);
+
+    it->node = node;
+    it->pos = tree->rank(tree, node, key, upper);
+
+    if (it->pos == node->nkeys) {
+        it->node = node->u.leaf.next;
+        it->pos = 0;
+    }
+
+    return it->node != NULL;
+}
+
+bool
+spr_btree_lower_bound(spr_btree_t *tree, uint64_t key, spr_btree_iter_t *it)
+{
+    return spr_btree_bound(tree, key, 0, it);
+}
+
+bool
+spr_btree_upper_bound(spr_btree_t *tree, uint64_t key, spr_btree_iter_t *it)
+{
+    return spr_btree_bound(tree, key, 1, it);
+}
+
+bool
+spr_btree_first(spr_btree_t *tree, spr_btree_iter_t *it)
+{
+    it->node = tree->first;
+    it->pos = 0;
+
+    return it->node != NULL;
+}
+
+bool
+spr_btree_last(spr_btree_t *tree, spr_btree_iter_t *it)
+{
+    it->node = tree->last;
+    it->pos = it->node ? it->node->nkeys - 1 : 0;
+
+    return it->node != NULL;
+}
+
+bool
+spr_btree_next(spr_btree_iter_t *it)
+{
+    if (!it->node) {
+        return 0;
+    }
+
+    it->pos += 1;
+
+    if (it->pos == it->node->nkeys) {
+        it->node = it->node->u.leaf.next;
+        it->pos = 0;
+    }
+
+    return it->node != NULL;
+}
+
+bool
+spr_btree_prev(spr_btree_iter_t *it)
+{
+    if (!it->node) {
+        return 0;
+    }
+
+    if (it->pos == 0) {
+        it->node = it->node->u.leaf.prev;
+        it->pos = it->node ? it->node->nkeys - 1 : 0;
+    }
+    else {
+        it->pos -= 1;
+    }
+
+    return it->node != NULL;
+}
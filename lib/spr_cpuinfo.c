@@ -27,6 +27,19 @@
  */
 
 #include "spr_portable.h"
+#include "spr_bitfield.h"
+#include "spr_cpuinfo.h"
+
+#if (SPR_HAVE_SSE2 || SPR_HAVE_SSE42 || SPR_HAVE_AVX2)
+#include <cpuid.h>
+#endif
+
+#if (SPR_LINUX && SPR_HAVE_ARM_CRC32)
+#include <sys/auxv.h>
+#endif
+
+static spr_bitfield_t spr_cpu_features;
+static bool spr_cpu_features_detected;
 
 
 #if (SPR_POSIX)
@@ -68,3 +81,85 @@ spr_get_number_cpu(void)
 }
 
 #endif
+
+
+#if (SPR_HAVE_SSE2 || SPR_HAVE_SSE42 || SPR_HAVE_AVX2)
+
+static spr_bitfield_t
+spr_cpu_detect_features(void)
+{
+    unsigned int eax, ebx, ecx, edx, xcr0;
+    spr_bitfield_t features;
+
+    features = 0;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return features;
+    }
+
+    if (edx & bit_SSE2) {
+        spr_bit_set(features, SPR_CPU_FEATURE_SSE2);
+    }
+    if (ecx & bit_SSE4_2) {
+        spr_bit_set(features, SPR_CPU_FEATURE_SSE42);
+    }
+
+    /* AVX2 is usable only if the OS saves the YMM state */
+    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX)) {
+        return features;
+    }
+
+    __asm__ volatile ("xgetbv" : "=a" (xcr0), "=d" (edx) : "c" (0));
+    if ((xcr0 & 0x6) != 0x6) {
+        return features;
+    }
+
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)
+        && (ebx & bit_AVX2))
+    {
+        spr_bit_set(features, SPR_CPU_FEATURE_AVX2);
+    }
+
+    return features;
+}
+
+#elif (SPR_HAVE_NEON)
+
+static spr_bitfield_t
+spr_cpu_detect_features(void)
+{
+    spr_bitfield_t features;
+
+    features = SPR_CPU_FEATURE_NEON;
+
+#if (SPR_HAVE_ARM_CRC32 && SPR_LINUX && defined(HWCAP_CRC32))
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+        spr_bit_set(features, SPR_CPU_FEATURE_ARM_CRC32);
+    }
+#elif (SPR_HAVE_ARM_CRC32 && (SPR_DARWIN || defined(__ARM_FEATURE_CRC32)))
+    spr_bit_set(features, SPR_CPU_FEATURE_ARM_CRC32);
+#endif
+
+    return features;
+}
+
+#else
+
+static spr_bitfield_t
+spr_cpu_detect_features(void)
+{
+    return 0;
+}
+
+#endif
+
+spr_bitfield_t
+spr_get_cpu_features(void)
+{
+    if (!spr_cpu_features_detected) {
+        spr_cpu_features = spr_cpu_detect_features();
+        spr_cpu_features_detected = 1;
+    }
+
+    return spr_cpu_features;
+}
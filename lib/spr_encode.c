@@ -0,0 +1,1467 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "spr_portable.h"
+#include "spr_memory.h"
+#include "spr_pool.h"
+#include "spr_errno.h"
+#include "spr_string.h"
+#include "spr_atomic.h"
+#include "spr_cpuinfo.h"
+#include "spr_encode.h"
+
+#if (SPR_HAVE_AVX2)
+#include <immintrin.h>
+#endif
+
+#if (SPR_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+#define spr_base64_alphabet(flags) \
+    (((flags) & SPR_BASE64_URL) ? &spr_base64_url : &spr_base64_std)
+
+#define spr_url_unreserved(c) \
+    (spr_url_low_nibble[(c) & 0x0f] & spr_url_high_nibble[(c) >> 4])
+
+typedef struct spr_base64_alphabet_s spr_base64_alphabet_t;
+
+struct spr_base64_alphabet_s {
+    const char *encode;
+    const uint8_t *decode;
+};
+
+/*
+ * The block functions work on whole groups only: three bytes or four
+ * characters for base64, one byte or two characters for hex. Decoders
+ * stop at the first group that is not plain alphabet and return how
+ * much input they consumed, the callers deal with padding and errors.
+ */
+typedef size_t (*spr_base64_encode_pt)(char *dst, const uint8_t *src,
+    size_t len, const spr_base64_alphabet_t *alphabet);
+typedef size_t (*spr_base64_decode_pt)(uint8_t *dst, const uint8_t *src,
+    size_t len, const spr_base64_alphabet_t *alphabet);
+typedef void (*spr_hex_encode_pt)(char *dst, const uint8_t *src,
+    size_t len, const char *digits);
+typedef size_t (*spr_hex_decode_pt)(uint8_t *dst, const uint8_t *src,
+    size_t len);
+typedef size_t (*spr_url_span_pt)(const uint8_t *src, size_t len);
+
+static size_t spr_base64_encode_init(char *dst, const uint8_t *src,
+    size_t len, const spr_base64_alphabet_t *alphabet);
+static size_t spr_base64_decode_init(uint8_t *dst, const uint8_t *src,
+    size_t len, const spr_base64_alphabet_t *alphabet);
+static void spr_hex_encode_init(char *dst, const uint8_t *src, size_t len,
+    const char *digits);
+static size_t spr_hex_decode_init(uint8_t *dst, const uint8_t *src,
+    size_t len);
+static size_t spr_url_span_init(const uint8_t *src, size_t len);
+
+static spr_base64_encode_pt spr_base64_encode_blocks =
+    spr_base64_encode_init;
+static spr_base64_decode_pt spr_base64_decode_blocks =
+    spr_base64_decode_init;
+static spr_hex_encode_pt spr_hex_encode_blocks = spr_hex_encode_init;
+static spr_hex_decode_pt spr_hex_decode_blocks = spr_hex_decode_init;
+static spr_url_span_pt spr_url_span = spr_url_span_init;
+
+/* Characters outside of the alphabet map to 0xff */
+static const uint8_t spr_base64_decode_std[256] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0x3e, 0xff, 0xff, 0xff, 0x3f,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b,
+    0x3c, 0x3d, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+    0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+    0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20,
+    0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30,
+    0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+/* The same for the URL alphabet */
+static const uint8_t spr_base64_decode_url[256] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0x3e, 0xff, 0xff,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b,
+    0x3c, 0x3d, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+    0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+    0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0x3f,
+    0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20,
+    0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30,
+    0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+/* Hex digits of either case */
+static const uint8_t spr_hex_decode_table[256] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+static const spr_base64_alphabet_t spr_base64_std = {
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/",
+    spr_base64_decode_std
+};
+
+static const spr_base64_alphabet_t spr_base64_url = {
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_",
+    spr_base64_decode_url
+};
+
+static const char spr_hex_lower[] = "0123456789abcdef";
+static const char spr_hex_upper[] = "0123456789ABCDEF";
+
+/*
+ * Unreserved characters of RFC 3986 as a bitmap split by nibbles: the
+ * entry for the low nibble has a bit set for every high nibble which
+ * makes an unreserved character with it. Both tables fit in a single
+ * shuffle register.
+ */
+static const uint8_t spr_url_low_nibble[16] = {
+    0xa8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8,
+    0xf8, 0xf8, 0xf0, 0x50, 0x50, 0x54, 0xd4, 0x70
+};
+
+static const uint8_t spr_url_high_nibble[16] = {
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+
+static size_t
+spr_base64_encode_scalar(char *dst, const uint8_t *src, size_t len,
+    const spr_base64_alphabet_t *alphabet)
+{
+    const char *basis;
+    size_t i;
+
+    basis = alphabet->encode;
+
+    for (i = 0; len - i >= 3; i += 3) {
+        *dst++ = basis[src[i] >> 2];
+        *dst++ = basis[((src[i] & 0x03) << 4) | (src[i + 1] >> 4)];
+        *dst++ = basis[((src[i + 1] & 0x0f) << 2) | (src[i + 2] >> 6)];
+        *dst++ = basis[src[i + 2] & 0x3f];
+    }
+
+    return i;
+}
+
+static size_t
+spr_base64_decode_scalar(uint8_t *dst, const uint8_t *src, size_t len,
+    const spr_base64_alphabet_t *alphabet)
+{
+    const uint8_t *basis;
+    uint32_t a, b, c, d;
+    size_t i;
+
+    basis = alphabet->decode;
+
+    for (i = 0; len - i >= 4; i += 4) {
+        a = basis[src[i]];
+        b = basis[src[i + 1]];
+        c = basis[src[i + 2]];
+        d = basis[src[i + 3]];
+
+        if ((a | b | c | d) & 0x80) {
+            break;
+        }
+
+        *dst++ = (uint8_t) (a << 2 | b >> 4);
+        *dst++ = (uint8_t) (b << 4 | c >> 2);
+        *dst++ = (uint8_t) (c << 6 | d);
+    }
+
+    return i;
+}
+
+static void
+spr_hex_encode_scalar(char *dst, const uint8_t *src, size_t len,
+    const char *digits)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        *dst++ = digits[src[i] >> 4];
+        *dst++ = digits[src[i] & 0x0f];
+    }
+}
+
+static size_t
+spr_hex_decode_scalar(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    uint8_t h, l;
+    size_t i;
+
+    for (i = 0; len - i >= 2; i += 2) {
+        h = spr_hex_decode_table[src[i]];
+        l = spr_hex_decode_table[src[i + 1]];
+
+        if ((h | l) & 0x80) {
+            break;
+        }
+
+        *dst++ = (uint8_t) (h << 4 | l);
+    }
+
+    return i;
+}
+
+static size_t
+spr_url_span_scalar(const uint8_t *src, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len && spr_url_unreserved(src[i]); i++) {
+        /* void */
+    }
+
+    return i;
+}
+
+#if (SPR_HAVE_AVX2)
+
+static SPR_TARGET_AVX2 __m256i
+spr_encode_table_avx2(const uint8_t *table)
+{
+    return _mm256_broadcastsi128_si256(
+               _mm_loadu_si128((const __m128i *) table));
+}
+
+/* Mask of the bytes within [lo, hi], signed compares keep 0x80-0xff out */
+static SPR_TARGET_AVX2 __m256i
+spr_encode_range_avx2(__m256i v, char lo, char hi)
+{
+    return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v));
+}
+
+/*
+ * Muła's encoder: each 32-bit lane gets three input bytes, the four
+ * 6-bit indices are moved into place with two multiplies, and a small
+ * shuffle table supplies the offset from index to character.
+ */
+static SPR_TARGET_AVX2 size_t
+spr_base64_encode_avx2(char *dst, const uint8_t *src, size_t len,
+    const spr_base64_alphabet_t *alphabet)
+{
+    __m256i v, indices, offsets, shuffle, lut, mask_hi, mask_lo;
+    __m256i mul_hi, mul_lo;
+    char c62, c63;
+    size_t i;
+
+    c62 = alphabet->encode[62];
+    c63 = alphabet->encode[63];
+
+    shuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7,
+                               10, 9, 11, 10,
+                               1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7,
+                               10, 9, 11, 10);
+
+    lut = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52,
+                           '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                           '0' - 52, '0' - 52, '0' - 52, c62 - 62,
+                           c63 - 63, 'A', 0, 0,
+                           'a' - 26, '0' - 52, '0' - 52, '0' - 52,
+                           '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                           '0' - 52, '0' - 52, '0' - 52, c62 - 62,
+                           c63 - 63, 'A', 0, 0);
+
+    mask_hi = _mm256_set1_epi32(0x0fc0fc00);
+    mask_lo = _mm256_set1_epi32(0x003f03f0);
+    mul_hi = _mm256_set1_epi32(0x04000040);
+    mul_lo = _mm256_set1_epi32(0x01000010);
+
+    /* Each iteration reads 28 bytes and consumes 24 */
+    for (i = 0; len - i >= 28; i += 24) {
+        v = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(
+                    _mm_loadu_si128((const __m128i *) (src + i))),
+                _mm_loadu_si128((const __m128i *) (src + i + 12)), 1);
+
+        v = _mm256_shuffle_epi8(v, shuffle);
+
+        indices = _mm256_or_si256(
+            _mm256_mulhi_epu16(_mm256_and_si256(v, mask_hi), mul_hi),
+            _mm256_mullo_epi16(_mm256_and_si256(v, mask_lo), mul_lo));
+
+        offsets = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        offsets = _mm256_or_si256(offsets,
+                      _mm256_and_si256(
+                          _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices),
+                          _mm256_set1_epi8(13)));
+
+        v = _mm256_add_epi8(indices, _mm256_shuffle_epi8(lut, offsets));
+
+        _mm256_storeu_si256((__m256i *) (dst + i / 3 * 4), v);
+    }
+
+    return i + spr_base64_encode_scalar(dst + i / 3 * 4, src + i, len - i,
+                                        alphabet);
+}
+
+static SPR_TARGET_AVX2 size_t
+spr_base64_decode_avx2(uint8_t *dst, const uint8_t *src, size_t len,
+    const spr_base64_alphabet_t *alphabet)
+{
+    __m256i v, upper, lower, digit, is62, is63, valid, offsets;
+    __m256i shuffle, permute;
+    char c62, c63;
+    size_t i;
+
+    c62 = alphabet->encode[62];
+    c63 = alphabet->encode[63];
+
+    shuffle = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                               -1, -1, -1, -1,
+                               2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                               -1, -1, -1, -1);
+    permute = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+
+    for (i = 0; len - i >= 32; i += 32) {
+        v = _mm256_loadu_si256((const __m256i *) (src + i));
+
+        upper = spr_encode_range_avx2(v, 'A', 'Z');
+        lower = spr_encode_range_avx2(v, 'a', 'z');
+        digit = spr_encode_range_avx2(v, '0', '9');
+        is62 = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c62));
+        is63 = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c63));
+
+        valid = _mm256_or_si256(_mm256_or_si256(upper, lower),
+                                _mm256_or_si256(digit,
+                                                _mm256_or_si256(is62, is63)));
+
+        if (_mm256_movemask_epi8(valid) != -1) {
+            break;
+        }
+
+        offsets = _mm256_or_si256(
+            _mm256_or_si256(
+                _mm256_and_si256(upper, _mm256_set1_epi8(-'A')),
+                _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a'))),
+            _mm256_or_si256(
+                _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')),
+                _mm256_or_si256(
+                    _mm256_and_si256(is62, _mm256_set1_epi8(62 - c62)),
+                    _mm256_and_si256(is63, _mm256_set1_epi8(63 - c63)))));
+
+        v = _mm256_add_epi8(v, offsets);
+
+        /* Pack four 6-bit values into 24 bits per 32-bit lane */
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+        v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+        v = _mm256_shuffle_epi8(v, shuffle);
+        v = _mm256_permutevar8x32_epi32(v, permute);
+
+        _mm_storeu_si128((__m128i *) (dst + i / 4 * 3),
+                         _mm256_castsi256_si128(v));
+        _mm_storel_epi64((__m128i *) (dst + i / 4 * 3 + 16),
+                         _mm256_extracti128_si256(v, 1));
+    }
+
+    return i + spr_base64_decode_scalar(dst + i / 4 * 3, src + i, len - i,
+                                        alphabet);
+}
+
+static SPR_TARGET_AVX2 void
+spr_hex_encode_avx2(char *dst, const uint8_t *src, size_t len,
+    const char *digits)
+{
+    __m256i v, lut, low;
+    size_t i;
+
+    lut = spr_encode_table_avx2((const uint8_t *) digits);
+    low = _mm256_set1_epi16(0x0f);
+
+    for (i = 0; len - i >= 16; i += 16) {
+        v = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (src + i)));
+
+        /* The high nibble goes first in memory */
+        v = _mm256_or_si256(_mm256_srli_epi16(v, 4),
+                            _mm256_slli_epi16(_mm256_and_si256(v, low), 8));
+
+        _mm256_storeu_si256((__m256i *) (dst + i * 2),
+                            _mm256_shuffle_epi8(lut, v));
+    }
+
+    spr_hex_encode_scalar(dst + i * 2, src + i, len - i, digits);
+}
+
+static SPR_TARGET_AVX2 size_t
+spr_hex_decode_avx2(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    __m256i v, digit, lower, upper, valid, offsets;
+    size_t i;
+
+    for (i = 0; len - i >= 32; i += 32) {
+        v = _mm256_loadu_si256((const __m256i *) (src + i));
+
+        digit = spr_encode_range_avx2(v, '0', '9');
+        lower = spr_encode_range_avx2(v, 'a', 'f');
+        upper = spr_encode_range_avx2(v, 'A', 'F');
+
+        valid = _mm256_or_si256(digit, _mm256_or_si256(lower, upper));
+
+        if (_mm256_movemask_epi8(valid) != -1) {
+            break;
+        }
+
+        offsets = _mm256_or_si256(
+            _mm256_and_si256(digit, _mm256_set1_epi8(-'0')),
+            _mm256_or_si256(
+                _mm256_and_si256(lower, _mm256_set1_epi8(10 - 'a')),
+                _mm256_and_si256(upper, _mm256_set1_epi8(10 - 'A'))));
+
+        v = _mm256_add_epi8(v, offsets);
+
+        /* high * 16 + low, then narrow both lanes into the low half */
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi16(0x0110));
+        v = _mm256_packus_epi16(v, v);
+        v = _mm256_permute4x64_epi64(v, 0x08);
+
+        _mm_storeu_si128((__m128i *) (dst + i / 2),
+                         _mm256_castsi256_si128(v));
+    }
+
+    return i + spr_hex_decode_scalar(dst + i / 2, src + i, len - i);
+}
+
+static SPR_TARGET_AVX2 size_t
+spr_url_span_avx2(const uint8_t *src, size_t len)
+{
+    __m256i v, low, high, low_nibble, high_nibble, nibble;
+    uint32_t mask;
+    size_t i;
+
+    low_nibble = spr_encode_table_avx2(spr_url_low_nibble);
+    high_nibble = spr_encode_table_avx2(spr_url_high_nibble);
+    nibble = _mm256_set1_epi8(0x0f);
+
+    for (i = 0; len - i >= 32; i += 32) {
+        v = _mm256_loadu_si256((const __m256i *) (src + i));
+
+        low = _mm256_shuffle_epi8(low_nibble, _mm256_and_si256(v, nibble));
+        high = _mm256_shuffle_epi8(high_nibble,
+                   _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+
+        mask = (uint32_t) _mm256_movemask_epi8(
+                   _mm256_cmpeq_epi8(_mm256_and_si256(low, high),
+                                     _mm256_setzero_si256()));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+
+    return i + spr_url_span_scalar(src + i, len - i);
+}
+
+#endif
+
+#if (SPR_HAVE_NEON)
+
+static uint8x16x4_t
+spr_encode_table_neon(const uint8_t *table)
+{
+    uint8x16x4_t t;
+
+    t.val[0] = vld1q_u8(table);
+    t.val[1] = vld1q_u8(table + 16);
+    t.val[2] = vld1q_u8(table + 32);
+    t.val[3] = vld1q_u8(table + 48);
+
+    return t;
+}
+
+/*
+ * Looks ASCII characters up in a 128-entry table. Bytes from 0x80 up
+ * come back as 0, callers catch them by OR-ing the input into the
+ * error mask.
+ */
+static uint8x16_t
+spr_encode_lookup_neon(uint8x16x4_t lo, uint8x16x4_t hi, uint8x16_t v)
+{
+    return vqtbx4q_u8(vqtbl4q_u8(lo, v), hi,
+                      vsubq_u8(v, vdupq_n_u8(64)));
+}
+
+/* vld3q and vst4q do the interleaving, a 64-byte lookup maps indices */
+static size_t
+spr_base64_encode_neon(char *dst, const uint8_t *src, size_t len,
+    const spr_base64_alphabet_t *alphabet)
+{
+    uint8x16x4_t lut, out;
+    uint8x16x3_t in;
+    uint8x16_t mask;
+    size_t i;
+
+    lut = spr_encode_table_neon((const uint8_t *) alphabet->encode);
+    mask = vdupq_n_u8(0x3f);
+
+    for (i = 0; len - i >= 48; i += 48) {
+        in = vld3q_u8(src + i);
+
+        out.val[0] = vshrq_n_u8(in.val[0], 2);
+        out.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4),
+                                       vshrq_n_u8(in.val[1], 4)), mask);
+        out.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2),
+                                       vshrq_n_u8(in.val[2], 6)), mask);
+        out.val[3] = vandq_u8(in.val[2], mask);
+
+        out.val[0] = vqtbl4q_u8(lut, out.val[0]);
+        out.val[1] = vqtbl4q_u8(lut, out.val[1]);
+        out.val[2] = vqtbl4q_u8(lut, out.val[2]);
+        out.val[3] = vqtbl4q_u8(lut, out.val[3]);
+
+        vst4q_u8((uint8_t *) dst + i / 3 * 4, out);
+    }
+
+    return i + spr_base64_encode_scalar(dst + i / 3 * 4, src + i, len - i,
+                                        alphabet);
+}
+
+static size_t
+spr_base64_decode_neon(uint8_t *dst, const uint8_t *src, size_t len,
+    const spr_base64_alphabet_t *alphabet)
+{
+    uint8x16x4_t lo, hi, in;
+    uint8x16x3_t out;
+    uint8x16_t a, b, c, d, error;
+    size_t i;
+
+    lo = spr_encode_table_neon(alphabet->decode);
+    hi = spr_encode_table_neon(alphabet->decode + 64);
+
+    for (i = 0; len - i >= 64; i += 64) {
+        in = vld4q_u8(src + i);
+
+        a = spr_encode_lookup_neon(lo, hi, in.val[0]);
+        b = spr_encode_lookup_neon(lo, hi, in.val[1]);
+        c = spr_encode_lookup_neon(lo, hi, in.val[2]);
+        d = spr_encode_lookup_neon(lo, hi, in.val[3]);
+
+        error = vorrq_u8(vorrq_u8(vorrq_u8(a, b), vorrq_u8(c, d)),
+                         vorrq_u8(vorrq_u8(in.val[0], in.val[1]),
+                                  vorrq_u8(in.val[2], in.val[3])));
+
+        if (vmaxvq_u8(error) & 0x80) {
+            break;
+        }
+
+        out.val[0] = vorrq_u8(vshlq_n_u8(a, 2), vshrq_n_u8(b, 4));
+        out.val[1] = vorrq_u8(vshlq_n_u8(b, 4), vshrq_n_u8(c, 2));
+        out.val[2] = vorrq_u8(vshlq_n_u8(c, 6), d);
+
+        vst3q_u8(dst + i / 4 * 3, out);
+    }
+
+    return i + spr_base64_decode_scalar(dst + i / 4 * 3, src + i, len - i,
+                                        alphabet);
+}
+
+static void
+spr_hex_encode_neon(char *dst, const uint8_t *src, size_t len,
+    const char *digits)
+{
+    uint8x16x2_t out;
+    uint8x16_t v, lut;
+    size_t i;
+
+    lut = vld1q_u8((const uint8_t *) digits);
+
+    for (i = 0; len - i >= 16; i += 16) {
+        v = vld1q_u8(src + i);
+
+        out.val[0] = vqtbl1q_u8(lut, vshrq_n_u8(v, 4));
+        out.val[1] = vqtbl1q_u8(lut, vandq_u8(v, vdupq_n_u8(0x0f)));
+
+        vst2q_u8((uint8_t *) dst + i * 2, out);
+    }
+
+    spr_hex_encode_scalar(dst + i * 2, src + i, len - i, digits);
+}
+
+static size_t
+spr_hex_decode_neon(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    uint8x16x4_t lo, hi;
+    uint8x16x2_t in;
+    uint8x16_t h, l, error;
+    size_t i;
+
+    lo = spr_encode_table_neon(spr_hex_decode_table);
+    hi = spr_encode_table_neon(spr_hex_decode_table + 64);
+
+    for (i = 0; len - i >= 32; i += 32) {
+        in = vld2q_u8(src + i);
+
+        h = spr_encode_lookup_neon(lo, hi, in.val[0]);
+        l = spr_encode_lookup_neon(lo, hi, in.val[1]);
+
+        error = vorrq_u8(vorrq_u8(h, l), vorrq_u8(in.val[0], in.val[1]));
+
+        if (vmaxvq_u8(error) & 0x80) {
+            break;
+        }
+
+        vst1q_u8(dst + i / 2, vorrq_u8(vshlq_n_u8(h, 4), l));
+    }
+
+    return i + spr_hex_decode_scalar(dst + i / 2, src + i, len - i);
+}
+
+static size_t
+spr_url_span_neon(const uint8_t *src, size_t len)
+{
+    uint8x16_t v, low, high, low_nibble, high_nibble, miss;
+    uint64_t mask;
+    size_t i;
+
+    low_nibble = vld1q_u8(spr_url_low_nibble);
+    high_nibble = vld1q_u8(spr_url_high_nibble);
+
+    for (i = 0; len - i >= 16; i += 16) {
+        v = vld1q_u8(src + i);
+
+        low = vqtbl1q_u8(low_nibble, vandq_u8(v, vdupq_n_u8(0x0f)));
+        high = vqtbl1q_u8(high_nibble, vshrq_n_u8(v, 4));
+        miss = vceqq_u8(vandq_u8(low, high), vdupq_n_u8(0));
+
+        /* Four bits per byte, NEON has no movemask */
+        mask = vget_lane_u64(vreinterpret_u64_u8(
+                   vshrn_n_u16(vreinterpretq_u16_u8(miss), 4)), 0);
+        if (mask) {
+            return i + (__builtin_ctzll(mask) >> 2);
+        }
+    }
+
+    return i + spr_url_span_scalar(src + i, len - i);
+}
+
+#endif
+
+static void
+spr_encode_dispatch(void)
+{
+    spr_base64_encode_pt base64_encode;
+    spr_base64_decode_pt base64_decode;
+    spr_hex_encode_pt hex_encode;
+    spr_hex_decode_pt hex_decode;
+    spr_url_span_pt url_span;
+
+    base64_encode = spr_base64_encode_scalar;
+    base64_decode = spr_base64_decode_scalar;
+    hex_encode = spr_hex_encode_scalar;
+    hex_decode = spr_hex_decode_scalar;
+    url_span = spr_url_span_scalar;
+
+#if (SPR_HAVE_AVX2)
+    if (spr_cpu_has_feature(SPR_CPU_FEATURE_AVX2)) {
+        base64_encode = spr_base64_encode_avx2;
+        base64_decode = spr_base64_decode_avx2;
+        hex_encode = spr_hex_encode_avx2;
+        hex_decode = spr_hex_decode_avx2;
+        url_span = spr_url_span_avx2;
+    }
+#endif
+
+#if (SPR_HAVE_NEON)
+    if (spr_cpu_has_feature(SPR_CPU_FEATURE_NEON)) {
+        base64_encode = spr_base64_encode_neon;
+        base64_decode = spr_base64_decode_neon;
+        hex_encode = spr_hex_encode_neon;
+        hex_decode = spr_hex_decode_neon;
+        url_span = spr_url_span_neon;
+    }
+#endif
+
+    spr_atomic_store(&spr_url_span, url_span);
+    spr_atomic_store(&spr_hex_decode_blocks, hex_decode);
+    spr_atomic_store(&spr_hex_encode_blocks, hex_encode);
+    spr_atomic_store(&spr_base64_decode_blocks, base64_decode);
+    spr_atomic_store(&spr_base64_encode_blocks, base64_encode);
+}
+
+static size_t
+spr_base64_encode_init(char *dst, const uint8_t *src, size_t len,
+    const spr_base64_alphabet_t *alphabet)
+{
+    spr_encode_dispatch();
+    return spr_atomic_load(&spr_base64_encode_blocks)(dst, src, len, alphabet);
+}
+
+static size_t
+spr_base64_decode_init(uint8_t *dst, const uint8_t *src, size_t len,
+    const spr_base64_alphabet_t *alphabet)
+{
+    spr_encode_dispatch();
+    return spr_atomic_load(&spr_base64_decode_blocks)(dst, src, len, alphabet);
+}
+
+static void
+spr_hex_encode_init(char *dst, const uint8_t *src, size_t len,
+    const char *digits)
+{
+    spr_encode_dispatch();
+    spr_atomic_load(&spr_hex_encode_blocks)(dst, src, len, digits);
+}
+
+static size_t
+spr_hex_decode_init(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    spr_encode_dispatch();
+    return spr_atomic_load(&spr_hex_decode_blocks)(dst, src, len);
+}
+
+static size_t
+spr_url_span_init(const uint8_t *src, size_t len)
+{
+    spr_encode_dispatch();
+    return spr_atomic_load(&spr_url_span)(src, len);
+}
+
+/* Encodes the last one or two bytes */
+static size_t
+spr_base64_encode_tail(char *dst, const uint8_t *src, size_t len,
+    spr_uint_t flags)
+{
+    const char *basis;
+    size_t n;
+
+    if (len == 0) {
+        return 0;
+    }
+
+    basis = spr_base64_alphabet(flags)->encode;
+
+    dst[0] = basis[src[0] >> 2];
+
+    if (len == 1) {
+        dst[1] = basis[(src[0] & 0x03) << 4];
+        n = 2;
+
+    } else {
+        dst[1] = basis[((src[0] & 0x03) << 4) | (src[1] >> 4)];
+        dst[2] = basis[(src[1] & 0x0f) << 2];
+        n = 3;
+    }
+
+    if (flags & SPR_BASE64_NOPAD) {
+        return n;
+    }
+
+    while (n < 4) {
+        dst[n++] = '=';
+    }
+
+    return n;
+}
+
+/*
+ * Decodes the final group: a padded quad, or two or three characters
+ * without padding. Unused bits must be zero, so every byte string has
+ * exactly one accepted encoding.
+ */
+static ssize_t
+spr_base64_decode_tail(uint8_t *dst, const uint8_t *src, size_t len,
+    spr_uint_t flags)
+{
+    const uint8_t *basis;
+    uint32_t a, b, c;
+
+    if (!(flags & SPR_BASE64_NOPAD)) {
+        if (len != 4 || src[3] != '=') {
+            return -1;
+        }
+
+        len = (src[2] == '=') ? 2 : 3;
+
+    } else if (len < 2 || len > 3) {
+        return -1;
+    }
+
+    basis = spr_base64_alphabet(flags)->decode;
+
+    a = basis[src[0]];
+    b = basis[src[1]];
+    c = (len == 3) ? basis[src[2]] : 0;
+
+    if ((a | b | c) & 0x80) {
+        return -1;
+    }
+
+    dst[0] = (uint8_t) (a << 2 | b >> 4);
+
+    if (len == 2) {
+        return (b & 0x0f) ? -1 : 1;
+    }
+
+    dst[1] = (uint8_t) (b << 4 | c >> 2);
+
+    return (c & 0x03) ? -1 : 2;
+}
+
+size_t
+spr_base64_encode(char *dst, const void *src, size_t len, spr_uint_t flags)
+{
+    size_t n;
+    spr_base64_encode_pt encode;
+
+    encode = spr_atomic_load(&spr_base64_encode_blocks);
+    n = encode(dst, src, len, spr_base64_alphabet(flags));
+
+    return n / 3 * 4 + spr_base64_encode_tail(dst + n / 3 * 4,
+                                              (const uint8_t *) src + n,
+                                              len - n, flags);
+}
+
+ssize_t
+spr_base64_decode(void *dst, const char *src, size_t len, spr_uint_t flags)
+{
+    ssize_t rc;
+    size_t n;
+    spr_base64_decode_pt decode;
+
+    decode = spr_atomic_load(&spr_base64_decode_blocks);
+    n = decode(dst, (const uint8_t *) src, len, spr_base64_alphabet(flags));
+    if (n == len) {
+        return n / 4 * 3;
+    }
+
+    if (len - n > 4) {
+        return -1;
+    }
+
+    rc = spr_base64_decode_tail((uint8_t *) dst + n / 4 * 3,
+                                (const uint8_t *) src + n, len - n, flags);
+    if (rc < 0) {
+        return -1;
+    }
+
+    return n / 4 * 3 + rc;
+}
+
+spr_err_t
+spr_base64_pencode(spr_pool_t *pool, spr_str_t *dst, const void *src,
+    size_t len, spr_uint_t flags)
+{
+    char *data;
+
+    if (len > (SIZE_MAX - 4) / 4 * 3) {
+        return SPR_FAILED;
+    }
+
+    data = spr_palloc(pool, spr_base64_encoded_length(len) + 1);
+    if (!data) {
+        return spr_get_errno();
+    }
+
+    dst->len = spr_base64_encode(data, src, len, flags);
+    dst->data = data;
+    data[dst->len] = '\0';
+
+    return SPR_OK;
+}
+
+spr_err_t
+spr_base64_pdecode(spr_pool_t *pool, spr_str_t *dst, const char *src,
+    size_t len, spr_uint_t flags)
+{
+    ssize_t n;
+    char *data;
+
+    data = spr_palloc(pool, spr_base64_decoded_length(len) + 1);
+    if (!data) {
+        return spr_get_errno();
+    }
+
+    n = spr_base64_decode(data, src, len, flags);
+    if (n < 0) {
+        return SPR_FAILED;
+    }
+
+    dst->len = n;
+    dst->data = data;
+    data[n] = '\0';
+
+    return SPR_OK;
+}
+
+size_t
+spr_hex_encode(char *dst, const void *src, size_t len, spr_uint_t flags)
+{
+    spr_hex_encode_pt encode;
+
+    encode = spr_atomic_load(&spr_hex_encode_blocks);
+    encode(dst, src, len,
+           (flags & SPR_HEX_UPPER) ? spr_hex_upper : spr_hex_lower);
+
+    return len * 2;
+}
+
+ssize_t
+spr_hex_decode(void *dst, const char *src, size_t len)
+{
+    spr_hex_decode_pt decode;
+
+    decode = spr_atomic_load(&spr_hex_decode_blocks);
+
+    if ((len & 1) || decode(dst, (const uint8_t *) src, len) != len) {
+        return -1;
+    }
+
+    return len / 2;
+}
+
+spr_err_t
+spr_hex_pencode(spr_pool_t *pool, spr_str_t *dst, const void *src,
+    size_t len, spr_uint_t flags)
+{
+    char *data;
+
+    if (len > (SIZE_MAX - 1) / 2) {
+        return SPR_FAILED;
+    }
+
+    data = spr_palloc(pool, spr_hex_encoded_length(len) + 1);
+    if (!data) {
+        return spr_get_errno();
+    }
+
+    dst->len = spr_hex_encode(data, src, len, flags);
+    dst->data = data;
+    data[dst->len] = '\0';
+
+    return SPR_OK;
+}
+
+spr_err_t
+spr_hex_pdecode(spr_pool_t *pool, spr_str_t *dst, const char *src,
+    size_t len)
+{
+    ssize_t n;
+    char *data;
+
+    data = spr_palloc(pool, spr_hex_decoded_length(len) + 1);
+    if (!data) {
+        return spr_get_errno();
+    }
+
+    n = spr_hex_decode(data, src, len);
+    if (n < 0) {
+        return SPR_FAILED;
+    }
+
+    dst->len = n;
+    dst->data = data;
+    data[n] = '\0';
+
+    return SPR_OK;
+}
+
+size_t
+spr_url_encoded_length(const void *src, size_t len, spr_uint_t flags)
+{
+    const uint8_t *p;
+    size_t i, n;
+    spr_url_span_pt span;
+
+    span = spr_atomic_load(&spr_url_span);
+
+    p = src;
+    n = len;
+
+    for (i = 0; ; i++) {
+        i += span(p + i, len - i);
+        if (i == len) {
+            break;
+        }
+
+        if (p[i] != ' ' || !(flags & SPR_URL_FORM)) {
+            n += 2;
+        }
+    }
+
+    return n;
+}
+
+size_t
+spr_url_encode(char *dst, const void *src, size_t len, spr_uint_t flags)
+{
+    const uint8_t *p;
+    size_t i, n;
+    char *d;
+    spr_url_span_pt span;
+
+    span = spr_atomic_load(&spr_url_span);
+
+    p = src;
+    d = dst;
+
+    for (i = 0; ; i++) {
+        n = span(p + i, len - i);
+
+        spr_memcpy(d, p + i, n);
+        d += n;
+        i += n;
+
+        if (i == len) {
+            break;
+        }
+
+        if (p[i] == ' ' && (flags & SPR_URL_FORM)) {
+            *d++ = '+';
+
+        } else {
+            *d++ = '%';
+            *d++ = spr_hex_upper[p[i] >> 4];
+            *d++ = spr_hex_upper[p[i] & 0x0f];
+        }
+    }
+
+    return d - dst;
+}
+
+ssize_t
+spr_url_decode(void *dst, const char *src, size_t len, spr_uint_t flags)
+{
+    spr_codec_t codec;
+    ssize_t n;
+
+    spr_codec_init(&codec, flags);
+
+    n = spr_url_decode_update(&codec, dst, src, len);
+    if (n < 0 || spr_url_decode_final(&codec) != 0) {
+        return -1;
+    }
+
+    return n;
+}
+
+spr_err_t
+spr_url_pencode(spr_pool_t *pool, spr_str_t *dst, const void *src,
+    size_t len, spr_uint_t flags)
+{
+    char *data;
+    size_t n;
+
+    n = spr_url_encoded_length(src, len, flags);
+
+    data = spr_palloc(pool, n + 1);
+    if (!data) {
+        return spr_get_errno();
+    }
+
+    dst->len = spr_url_encode(data, src, len, flags);
+    dst->data = data;
+    data[dst->len] = '\0';
+
+    return SPR_OK;
+}
+
+spr_err_t
+spr_url_pdecode(spr_pool_t *pool, spr_str_t *dst, const char *src,
+    size_t len, spr_uint_t flags)
+{
+    ssize_t n;
+    char *data;
+
+    data = spr_palloc(pool, spr_url_decoded_length(len) + 1);
+    if (!data) {
+        return spr_get_errno();
+    }
+
+    n = spr_url_decode(data, src, len, flags);
+    if (n < 0) {
+        return SPR_FAILED;
+    }
+
+    dst->len = n;
+    dst->data = data;
+    data[n] = '\0';
+
+    return SPR_OK;
+}
+
+void
+spr_codec_init(spr_codec_t *codec, spr_uint_t flags)
+{
+    codec->flags = flags;
+    codec->done = false;
+    codec->pending = 0;
+}
+
+size_t
+spr_base64_encode_update(spr_codec_t *codec, char *dst, const void *src,
+    size_t len)
+{
+    const spr_base64_alphabet_t *alphabet;
+    const uint8_t *p;
+    size_t n;
+    char *d;
+
+    alphabet = spr_base64_alphabet(codec->flags);
+    p = src;
+    d = dst;
+
+    if (codec->pending) {
+        while (codec->pending < 3 && len) {
+            codec->buf[codec->pending++] = *p++;
+            len--;
+        }
+
+        if (codec->pending < 3) {
+            return 0;
+        }
+
+        spr_base64_encode_scalar(d, codec->buf, 3, alphabet);
+        codec->pending = 0;
+        d += 4;
+    }
+
+    n = spr_atomic_load(&spr_base64_encode_blocks)(d, p, len, alphabet);
+    d += n / 3 * 4;
+
+    spr_memcpy(codec->buf, p + n, len - n);
+    codec->pending = len - n;
+
+    return d - dst;
+}
+
+size_t
+spr_base64_encode_final(spr_codec_t *codec, char *dst)
+{
+    size_t n;
+
+    n = spr_base64_encode_tail(dst, codec->buf, codec->pending,
+                               codec->flags);
+    codec->pending = 0;
+
+    return n;
+}
+
+ssize_t
+spr_base64_decode_update(spr_codec_t *codec, void *dst, const char *src,
+    size_t len)
+{
+    const spr_base64_alphabet_t *alphabet;
+    const uint8_t *p;
+    uint8_t *d;
+    ssize_t rc;
+    size_t n;
+
+    if (len == 0) {
+        return 0;
+    }
+
+    /* Nothing may follow the padding */
+    if (codec->done) {
+        return -1;
+    }
+
+    alphabet = spr_base64_alphabet(codec->flags);
+    p = (const uint8_t *) src;
+    d = dst;
+
+    if (codec->pending) {
+        while (codec->pending < 4 && len) {
+            codec->buf[codec->pending++] = *p++;
+            len--;
+        }
+
+        if (codec->pending < 4) {
+            return 0;
+        }
+
+        codec->pending = 0;
+
+        if (spr_base64_decode_scalar(d, codec->buf, 4, alphabet) == 4) {
+            d += 3;
+
+        } else {
+            rc = spr_base64_decode_tail(d, codec->buf, 4, codec->flags);
+            if (rc < 0 || len) {
+                return -1;
+            }
+
+            codec->done = true;
+
+            return (d - (uint8_t *) dst) + rc;
+        }
+    }
+
+    n = spr_atomic_load(&spr_base64_decode_blocks)(d, p, len, alphabet);
+    d += n / 4 * 3;
+    p += n;
+    len -= n;
+
+    if (len >= 4) {
+        if (len > 4) {
+            return -1;
+        }
+
+        rc = spr_base64_decode_tail(d, p, 4, codec->flags);
+        if (rc < 0) {
+            return -1;
+        }
+
+        codec->done = true;
+
+        return (d - (uint8_t *) dst) + rc;
+    }
+
+    spr_memcpy(codec->buf, p, len);
+    codec->pending = len;
+
+    return d - (uint8_t *) dst;
+}
+
+ssize_t
+spr_base64_decode_final(spr_codec_t *codec, void *dst)
+{
+    size_t n;
+
+    n = codec->pending;
+    codec->pending = 0;
+
+    if (n == 0) {
+        return 0;
+    }
+
+    return spr_base64_decode_tail(dst, codec->buf, n, codec->flags);
+}
+
+ssize_t
+spr_hex_decode_update(spr_codec_t *codec, void *dst, const char *src,
+    size_t len)
+{
+    const uint8_t *p;
+    uint8_t *d, h, l;
+    size_t n;
+
+    if (len == 0) {
+        return 0;
+    }
+
+    p = (const uint8_t *) src;
+    d = dst;
+
+    if (codec->pending) {
+        h = spr_hex_decode_table[codec->buf[0]];
+        l = spr_hex_decode_table[*p++];
+
+        if ((h | l) & 0x80) {
+            return -1;
+        }
+
+        *d++ = (uint8_t) (h << 4 | l);
+        codec->pending = 0;
+        len--;
+    }
+
+    n = spr_atomic_load(&spr_hex_decode_blocks)(d, p, len & ~(size_t) 1);
+    if (n != (len & ~(size_t) 1)) {
+        return -1;
+    }
+
+    d += n / 2;
+
+    if (len & 1) {
+        codec->buf[0] = p[len - 1];
+        codec->pending = 1;
+    }
+
+    return d - (uint8_t *) dst;
+}
+
+ssize_t
+spr_hex_decode_final(spr_codec_t *codec)
+{
+    if (codec->pending) {
+        codec->pending = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+ssize_t
+spr_url_decode_update(spr_codec_t *codec, void *dst, const char *src,
+    size_t len)
+{
+    const char *end, *p, *q;
+    uint8_t *d, h, l;
+
+    end = src + len;
+    d = dst;
+
+    /* Finish an escape split by the previous chunk */
+    if (codec->pending) {
+        while (codec->pending < 3 && src < end) {
+            codec->buf[codec->pending++] = *src++;
+        }
+
+        if (codec->pending < 3) {
+            return 0;
+        }
+
+        h = spr_hex_decode_table[codec->buf[1]];
+        l = spr_hex_decode_table[codec->buf[2]];
+
+        if ((h | l) & 0x80) {
+            return -1;
+        }
+
+        *d++ = (uint8_t) (h << 4 | l);
+        codec->pending = 0;
+    }
+
+    while (src < end) {
+        p = spr_memchr(src, '%', end - src);
+        if (!p) {
+            p = end;
+        }
+
+        if (codec->flags & SPR_URL_FORM) {
+            for (q = src; q < p; q++) {
+                *d++ = (*q == '+') ? ' ' : *q;
+            }
+
+        } else {
+            spr_memcpy(d, src, p - src);
+            d += p - src;
+        }
+
+        if (p == end) {
+            break;
+        }
+
+        if (end - p < 3) {
+            spr_memcpy(codec->buf, p, end - p);
+            codec->pending = end - p;
+            break;
+        }
+
+        h = spr_hex_decode_table[(uint8_t) p[1]];
+        l = spr_hex_decode_table[(uint8_t) p[2]];
+
+        if ((h | l) & 0x80) {
+            return -1;
+        }
+
+        *d++ = (uint8_t) (h << 4 | l);
+        src = p + 3;
+    }
+
+    return d - (uint8_t *) dst;
+}
+
+ssize_t
+spr_url_decode_final(spr_codec_t *codec)
+{
+    if (codec->pending) {
+        codec->pending = 0;
+        return -1;
+    }
+
+    return 0;
+}
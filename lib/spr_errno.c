@@ -47,6 +47,8 @@ static const struct {
     /* SPR_ERR_FILESYS domain */
     {SPR_ERR_FILESYS_ABS_PATH,     "Specified path is not absolute"},
     {SPR_ERR_FILESYS_LONG_PATH,    "Result path is too long"},
+    {SPR_ERR_FILESYS_ENCODING,     "Path is not valid UTF-8"},
+    {SPR_ERR_FILESYS_ALIGNMENT,    "Direct I/O is not block aligned"},
 
     /* End of error list */
     {SPR_ERR_UNKNOW,               "Unknown error code"}
@@ -31,8 +31,72 @@
 #include "spr_errno.h"
 #include "spr_memory.h"
 #include "spr_string.h"
+#include "spr_utf8.h"
+#include "spr_atomic.h"
+
+#if (SPR_POSIX)
+
+/* Vectors resumed by spr_file_writev() after a partial write */
+#if (SPR_IOV_MAX > 64)
+#define SPR_FILE_IOVS                64
+#else
+#define SPR_FILE_IOVS                SPR_IOV_MAX
+#endif
+
+#elif (SPR_WIN32)
+
+/* ReadFile() and WriteFile() take a DWORD size */
+#define SPR_FILE_IO_CHUNK            0x7ffff000
+
+#endif
+
+#define SPR_FILE_COPY_SIZE           65536
 
 
+/* Last resort, the data passes through a buffer in user space */
+static ssize_t
+spr_file_copy_buffered(spr_file_t *src, spr_off_t src_offset,
+    spr_file_t *dst, spr_off_t dst_offset, size_t size)
+{
+    size_t copied, chunk;
+    uint8_t *buf;
+    ssize_t n;
+
+    buf = spr_malloc(SPR_FILE_COPY_SIZE);
+    if (!buf) {
+        return -1;
+    }
+
+    n = 0;
+
+    for (copied = 0; copied < size; copied += n) {
+        chunk = size - copied;
+        if (chunk > SPR_FILE_COPY_SIZE) {
+            chunk = SPR_FILE_COPY_SIZE;
+        }
+
+        n = spr_file_read(src, buf, chunk, src_offset + copied);
+        if (n <= 0) {
+            break;
+        }
+
+        if (spr_file_write(dst, (const char *) buf, n, dst_offset + copied)
+            == -1)
+        {
+            n = -1;
+            break;
+        }
+    }
+
+    spr_free(buf);
+
+    if (n == -1 && copied == 0) {
+        return -1;
+    }
+
+    return (ssize_t) copied;
+}
+
 #if (SPR_POSIX)
 
 static spr_file_type_t
@@ -139,10 +203,19 @@ spr_err_t
 spr_file_open(spr_file_t *file, const char *path, spr_uint_t mode,
     spr_uint_t create, spr_uint_t access)
 {
+    spr_uint_t direct;
+    spr_err_t err;
     spr_fd_t fd;
 
     spr_memzero(file, sizeof(spr_file_t));
 
+    direct = (mode|create) & SPR_FILE_DIRECT;
+
+#if !defined(O_DIRECT)
+    mode &= ~((spr_uint_t) SPR_FILE_DIRECT);
+    create &= ~((spr_uint_t) SPR_FILE_DIRECT);
+#endif
+
     fd = open(path, mode|create, access);
     if (fd == SPR_INVALID_FILE) {
         return spr_get_errno();
@@ -152,25 +225,55 @@ spr_file_open(spr_file_t *file, const char *path, spr_uint_t mode,
     file->name = (char *) path;
     file->offset = (size_t) 0;
 
+    if (!direct) {
+        return SPR_OK;
+    }
+
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+    if (fcntl(fd, F_NOCACHE, 1) == -1) {
+        err = spr_get_errno();
+        goto failed;
+    }
+#elif !defined(O_DIRECT) && defined(DIRECTIO_ON)
+    if (directio(fd, DIRECTIO_ON) == -1) {
+        err = spr_get_errno();
+        goto failed;
+    }
+#endif
+
+    err = spr_file_block_size(file, &file->align);
+    if (err != SPR_OK) {
+        goto failed;
+    }
+
     return SPR_OK;
+
+failed:
+
+    close(fd);
+    file->fd = SPR_INVALID_FILE;
+    return err;
 }
 
+/*
+ * Positional I/O leaves the file position alone, so threads can share
+ * one spr_file_t without locking around it.
+ */
 ssize_t
 spr_file_read(spr_file_t *file, uint8_t *buf, size_t size,
     spr_off_t offset)
 {
     ssize_t n;
 
-    if (lseek(file->fd, offset, SEEK_SET) == -1) {
-        return -1;
-    }
+    do {
+        n = pread(file->fd, buf, size, offset);
+    } while (n == -1 && spr_get_errno() == EINTR);
 
-    n = read(file->fd, buf, size);
     if (n == -1) {
         return -1;
     }
 
-    file->offset += n;
+    spr_atomic_fetch_add_relaxed(&file->offset, n);
     return n;
 }
 
@@ -179,71 +282,631 @@ spr_file_write(spr_file_t *file, const char *buf, size_t size,
     spr_off_t offset)
 {
     ssize_t n;
-    ssize_t written = 0;
+    size_t written;
+
+    for (written = 0; written < size; written += n) {
+        n = pwrite(file->fd, buf + written, size - written,
+                   offset + written);
+        if (n == -1) {
+            if (spr_get_errno() == EINTR) {
+                n = 0;
+                continue;
+            }
+            return -1;
+        }
+
+        /* Nothing written for a non-empty buffer would never end */
+        if (n == 0) {
+            spr_set_errno(EIO);
+            return -1;
+        }
+
+        spr_atomic_fetch_add_relaxed(&file->offset, n);
+    }
+
+    return written;
+}
+
+#if (SPR_HAVE_PREADV)
+
+/* Reads until a short read, SPR_IOV_MAX vectors per call */
+ssize_t
+spr_file_readv(spr_file_t *file, const spr_iovec_t *iov, size_t iovcnt,
+    spr_off_t offset)
+{
+    size_t i, n, size, total;
+    ssize_t rv;
+
+    total = 0;
+
+    while (iovcnt) {
+        n = (iovcnt < SPR_IOV_MAX) ? iovcnt : SPR_IOV_MAX;
+
+        do {
+            rv = preadv(file->fd, iov, (int) n, offset + total);
+        } while (rv == -1 && spr_get_errno() == EINTR);
+
+        if (rv == -1) {
+            return (total != 0) ? (ssize_t) total : -1;
+        }
+
+        spr_atomic_fetch_add_relaxed(&file->offset, rv);
+        total += rv;
+
+        for (size = 0, i = 0; i < n; i++) {
+            size += iov[i].iov_len;
+        }
+
+        if ((size_t) rv < size) {
+            break;
+        }
+
+        iov += n;
+        iovcnt -= n;
+    }
+
+    return total;
+}
+
+/*
+ * Writes everything. A window of vectors is copied to the stack, so
+ * that a partial write can be resumed by trimming the first entry.
+ */
+ssize_t
+spr_file_writev(spr_file_t *file, const spr_iovec_t *iov, size_t iovcnt,
+    spr_off_t offset)
+{
+    spr_iovec_t vec[SPR_FILE_IOVS], *first;
+    size_t n, written;
+    ssize_t rv;
+    bool zero;
+
+    written = 0;
+
+    while (iovcnt) {
+        n = (iovcnt < SPR_FILE_IOVS) ? iovcnt : SPR_FILE_IOVS;
+
+        spr_memcpy(vec, iov, n * sizeof(spr_iovec_t));
+        iov += n;
+        iovcnt -= n;
+
+        first = vec;
+
+        while (n) {
+            rv = pwritev(file->fd, first, (int) n, offset + written);
+            if (rv == -1) {
+                if (spr_get_errno() == EINTR) {
+                    continue;
+                }
+                return -1;
+            }
+
+            spr_atomic_fetch_add_relaxed(&file->offset, rv);
+            written += rv;
+
+            zero = (rv == 0);
+
+            while (n && (size_t) rv >= first->iov_len) {
+                rv -= first->iov_len;
+                first++;
+                n--;
+            }
+
+            /* Empty vectors are skipped above, others must make progress */
+            if (n && zero) {
+                spr_set_errno(EIO);
+                return -1;
+            }
+
+            if (n) {
+                first->iov_base = (char *) first->iov_base + rv;
+                first->iov_len -= rv;
+            }
+        }
+    }
+
+    return written;
+}
+
+#else
+
+ssize_t
+spr_file_readv(spr_file_t *file, const spr_iovec_t *iov, size_t iovcnt,
+    spr_off_t offset)
+{
+    size_t i, total;
+    ssize_t n;
+
+    total = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        n = spr_file_read(file, iov[i].iov_base, iov[i].iov_len,
+                          offset + total);
+        if (n == -1) {
+            return (total != 0) ? (ssize_t) total : -1;
+        }
+
+        total += n;
 
-    if (lseek(file->fd, offset, SEEK_SET) == -1) {
+        if ((size_t) n < iov[i].iov_len) {
+            break;
+        }
+    }
+
+    return total;
+}
+
+ssize_t
+spr_file_writev(spr_file_t *file, const spr_iovec_t *iov, size_t iovcnt,
+    spr_off_t offset)
+{
+    size_t i, written;
+
+    written = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        if (spr_file_write(file, iov[i].iov_base, iov[i].iov_len,
+                           offset + written) == -1)
+        {
+            return -1;
+        }
+
+        written += iov[i].iov_len;
+    }
+
+    return written;
+}
+
+#endif
+
+/*
+ * Devices report their logical block size, files report what their
+ * filesystem needs for direct I/O where it can, else st_blksize.
+ */
+spr_err_t
+spr_file_block_size(spr_file_t *file, size_t *size)
+{
+    spr_file_stat_t st;
+#if (SPR_LINUX) && defined(STATX_DIOALIGN)
+    struct statx stx;
+#endif
+#if (SPR_LINUX) && defined(BLKSSZGET)
+    int sector;
+#elif (SPR_FREEBSD) && defined(DIOCGSECTORSIZE)
+    u_int sector;
+#elif (SPR_DARWIN) && defined(DKIOCGETBLOCKSIZE)
+    uint32_t sector;
+#endif
+
+    if (fstat(file->fd, &st) == -1) {
+        return spr_get_errno();
+    }
+
+#if (SPR_LINUX) && defined(BLKSSZGET)
+    if (S_ISBLK(st.st_mode)
+        && ioctl(file->fd, BLKSSZGET, &sector) == 0 && sector > 0)
+    {
+        *size = (size_t) sector;
+        return SPR_OK;
+    }
+#elif (SPR_FREEBSD) && defined(DIOCGSECTORSIZE)
+    if (S_ISCHR(st.st_mode)
+        && ioctl(file->fd, DIOCGSECTORSIZE, &sector) == 0 && sector > 0)
+    {
+        *size = (size_t) sector;
+        return SPR_OK;
+    }
+#elif (SPR_DARWIN) && defined(DKIOCGETBLOCKSIZE)
+    if ((S_ISBLK(st.st_mode) || S_ISCHR(st.st_mode))
+        && ioctl(file->fd, DKIOCGETBLOCKSIZE, &sector) == 0 && sector > 0)
+    {
+        *size = (size_t) sector;
+        return SPR_OK;
+    }
+#endif
+
+#if (SPR_LINUX) && defined(STATX_DIOALIGN)
+    if (statx(file->fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0
+        && (stx.stx_mask & STATX_DIOALIGN) && stx.stx_dio_offset_align > 0)
+    {
+        *size = stx.stx_dio_offset_align;
+        if (stx.stx_dio_mem_align > *size) {
+            *size = stx.stx_dio_mem_align;
+        }
+        return SPR_OK;
+    }
+#endif
+
+    *size = st.st_blksize > 0 ? (size_t) st.st_blksize : SPR_FILE_BLOCK_SIZE;
+    return SPR_OK;
+}
+
+/* Work even we already read some bytes from file */
+ssize_t
+spr_file_size(spr_file_t *file)
+{
+    spr_off_t off;
+    size_t size;
+
+    off = lseek(file->fd, 0, SEEK_CUR);
+    if (off == (spr_off_t) -1) {
         return -1;
     }
+    size = (size_t) lseek(file->fd, 0, SEEK_END);
+    if (size == (size_t) -1) {
+        return -1;
+    }
+    if (lseek(file->fd, off, SEEK_SET) == (spr_off_t) -1) {
+        return -1;
+    }
+    return size;
+}
+
+ssize_t
+spr_read_fd(spr_fd_t fd, void *buf, size_t n)
+{
+    ssize_t rv;
+
+    rv = read(fd, buf, n);
+    if (rv == -1) {
+        return -1;
+    }
+    return rv;
+}
+
+ssize_t
+spr_write_fd(spr_fd_t fd, void *buf, size_t n)
+{
+    ssize_t rv;
+
+    rv = write(fd, buf, n);
+    if (rv == -1) {
+        return -1;
+    }
+    return rv;
+}
+
+/* Errors telling that a copy method does not apply to the files */
+#define spr_file_copy_unsupported(err) \
+    ((err) == EXDEV || (err) == EINVAL || (err) == ENOSYS \
+     || (err) == EOPNOTSUPP)
+
+/* A reset peer must fail the send with EPIPE, not kill the process */
+#if defined(MSG_NOSIGNAL)
+#define SPR_FILE_SEND_FLAGS  MSG_NOSIGNAL
+#else
+#define SPR_FILE_SEND_FLAGS  0
+#endif
+
+#if (SPR_FREEBSD || SPR_DARWIN) && defined(SO_NOSIGPIPE)
+
+static void
+spr_file_socket_nosigpipe(spr_socket_t sockfd)
+{
+    int on;
+
+    /* sendfile() takes no flags, so it has to be set on the socket */
+    on = 1;
+    (void) setsockopt(sockfd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+}
+
+#endif
+
+static ssize_t
+spr_file_send_buffered(spr_file_t *file, spr_socket_t sockfd,
+    spr_off_t offset, size_t size)
+{
+    size_t sent, chunk, done;
+    uint8_t *buf;
+    ssize_t n, k;
+
+    buf = spr_malloc(SPR_FILE_COPY_SIZE);
+    if (!buf) {
+        return -1;
+    }
+
+    k = 0;
+
+    for (sent = 0; sent < size; sent += done) {
+        chunk = size - sent;
+        if (chunk > SPR_FILE_COPY_SIZE) {
+            chunk = SPR_FILE_COPY_SIZE;
+        }
+
+        n = spr_file_read(file, buf, chunk, offset + sent);
+        if (n <= 0) {
+            k = n;
+            break;
+        }
+
+        for (done = 0; done < (size_t) n; done += k) {
+            k = send(sockfd, buf + done, n - done, SPR_FILE_SEND_FLAGS);
+            if (k == -1) {
+                if (spr_get_socket_errno() == EINTR) {
+                    k = 0;
+                    continue;
+                }
+                break;
+            }
+        }
+
+        if (k == -1) {
+            sent += done;
+            break;
+        }
+    }
+
+    spr_free(buf);
+
+    if (k == -1 && sent == 0) {
+        return -1;
+    }
+
+    return (ssize_t) sent;
+}
+
+#if (SPR_LINUX)
+
+/*
+ * Sends size bytes of the file from offset without copying them to
+ * user space. Returns less at the end of the file or when a non-blocking
+ * socket fills up, -1 only if nothing was sent.
+ */
+ssize_t
+spr_file_send_to_socket(spr_file_t *file, spr_socket_t sockfd,
+    spr_off_t offset, size_t size)
+{
+    size_t sent;
+    ssize_t n;
+    off_t off;
+
+    for (sent = 0; sent < size; sent += n) {
+        off = offset + sent;
+
+        n = sendfile(sockfd, file->fd, &off, size - sent);
+        if (n == -1) {
+            if (spr_get_errno() == EINTR) {
+                n = 0;
+                continue;
+            }
+
+            /* The file does not support it */
+            if (sent == 0 && spr_file_copy_unsupported(spr_get_errno())) {
+                return spr_file_send_buffered(file, sockfd, offset, size);
+            }
+
+            return sent ? (ssize_t) sent : -1;
+        }
+
+        if (n == 0) {
+            break;
+        }
+    }
+
+    return (ssize_t) sent;
+}
+
+#elif (SPR_FREEBSD || SPR_DARWIN)
+
+ssize_t
+spr_file_send_to_socket(spr_file_t *file, spr_socket_t sockfd,
+    spr_off_t offset, size_t size)
+{
+    size_t sent;
+    off_t len;
+    int rc;
+
+#if defined(SO_NOSIGPIPE)
+    spr_file_socket_nosigpipe(sockfd);
+#endif
+
+    /* A length of 0 would mean up to the end of the file */
+    for (sent = 0; sent < size; sent += len) {
+#if (SPR_FREEBSD)
+        len = 0;
+        rc = sendfile(file->fd, sockfd, offset + sent, size - sent, NULL,
+                      &len, 0);
+#else
+        len = size - sent;
+        rc = sendfile(file->fd, sockfd, offset + sent, &len, NULL, 0);
+#endif
+
+        if (rc == 0) {
+            if (len == 0) {
+                break;
+            }
+            continue;
+        }
+
+        if (spr_get_errno() != EINTR) {
+            sent += len;
+
+            /* Not a regular file or not a stream socket */
+            if (sent == 0 && (spr_get_errno() == EOPNOTSUPP
+                              || spr_get_errno() == ENOTSOCK))
+            {
+                return spr_file_send_buffered(file, sockfd, offset, size);
+            }
+
+            return sent ? (ssize_t) sent : -1;
+        }
+    }
+
+    return (ssize_t) sent;
+}
+
+#else
+
+ssize_t
+spr_file_send_to_socket(spr_file_t *file, spr_socket_t sockfd,
+    spr_off_t offset, size_t size)
+{
+    return spr_file_send_buffered(file, sockfd, offset, size);
+}
+
+#endif
+
+#if (SPR_HAVE_COPY_FILE_RANGE)
+
+static size_t
+spr_file_copy_kernel(spr_file_t *src, spr_off_t src_offset,
+    spr_file_t *dst, spr_off_t dst_offset, size_t size, spr_err_t *err)
+{
+    loff_t in, out;
+    size_t copied;
+    ssize_t n;
+
+    *err = SPR_OK;
+
+    for (copied = 0; copied < size; copied += n) {
+        in = src_offset + copied;
+        out = dst_offset + copied;
+
+        n = copy_file_range(src->fd, &in, dst->fd, &out, size - copied, 0);
+        if (n == -1) {
+            if (spr_get_errno() == EINTR) {
+                n = 0;
+                continue;
+            }
+
+            *err = spr_get_errno();
+            break;
+        }
+
+        if (n == 0) {
+            break;
+        }
+    }
+
+    return copied;
+}
+
+#endif
+
+#if (SPR_LINUX)
+
+/* Moves the pages through a pipe, they are never mapped into user space */
+static size_t
+spr_file_copy_splice(spr_file_t *src, spr_off_t src_offset,
+    spr_file_t *dst, spr_off_t dst_offset, size_t size, spr_err_t *err)
+{
+    size_t copied, chunk, moved;
+    loff_t in, out;
+    int pipefd[2];
+    ssize_t n, k;
+
+    *err = SPR_OK;
+
+    if (pipe2(pipefd, O_CLOEXEC) == -1) {
+        *err = spr_get_errno();
+        return 0;
+    }
+
+    for (copied = 0; copied < size; copied += moved) {
+        chunk = size - copied;
+        if (chunk > SPR_FILE_COPY_SIZE) {
+            chunk = SPR_FILE_COPY_SIZE;
+        }
+
+        in = src_offset + copied;
+        moved = 0;
+
+        n = splice(src->fd, &in, pipefd[1], NULL, chunk, SPLICE_F_MOVE);
+        if (n == -1) {
+            if (spr_get_errno() == EINTR) {
+                continue;
+            }
+
+            *err = spr_get_errno();
+            break;
+        }
+
+        if (n == 0) {
+            break;
+        }
+
+        for ( ; moved < (size_t) n; moved += k) {
+            out = dst_offset + copied + moved;
 
-    for ( ; ; ) {
-        n = write(file->fd, buf + written, size);
-        if (n == -1) {
-            return -1;
+            k = splice(pipefd[0], NULL, dst->fd, &out, n - moved,
+                       SPLICE_F_MOVE);
+            if (k == -1) {
+                if (spr_get_errno() == EINTR) {
+                    k = 0;
+                    continue;
+                }
+
+                *err = spr_get_errno();
+                break;
+            }
         }
-        file->offset += n;
-        written += n;
-        if ((size_t) n == size) {
-            return written;
+
+        if (*err != SPR_OK) {
+            copied += moved;
+            break;
         }
-        size -= n;
     }
+
+    close(pipefd[0]);
+    close(pipefd[1]);
+
+    return copied;
 }
 
-/* Work even we already read some bytes from file */
+#endif
+
+/*
+ * Copies size bytes between the offsets inside the kernel when it can,
+ * with copy_file_range(), then splice(), then a plain read and write.
+ * Returns less at the end of the source, -1 only if nothing was copied.
+ */
 ssize_t
-spr_file_size(spr_file_t *file)
+spr_file_copy_range(spr_file_t *src, spr_off_t src_offset, spr_file_t *dst,
+    spr_off_t dst_offset, size_t size)
 {
-    spr_off_t off;
-    size_t size;
+    size_t copied;
+    spr_err_t err;
+    ssize_t n;
 
-    off = lseek(file->fd, 0, SEEK_CUR);
-    if (off == (spr_off_t) -1) {
-        return -1;
-    }
-    size = (size_t) lseek(file->fd, 0, SEEK_END);
-    if (size == (size_t) -1) {
-        return -1;
+    copied = 0;
+
+#if (SPR_HAVE_COPY_FILE_RANGE)
+    copied = spr_file_copy_kernel(src, src_offset, dst, dst_offset, size,
+                                  &err);
+    if (!spr_file_copy_unsupported(err)) {
+        goto done;
     }
-    if (lseek(file->fd, off, SEEK_SET) == (spr_off_t) -1) {
-        return -1;
+#endif
+
+#if (SPR_LINUX)
+    copied += spr_file_copy_splice(src, src_offset + copied, dst,
+                                   dst_offset + copied, size - copied, &err);
+    if (!spr_file_copy_unsupported(err)) {
+        goto done;
     }
-    return size;
-}
+#endif
 
-ssize_t
-spr_read_fd(spr_fd_t fd, void *buf, size_t n)
-{
-    ssize_t rv;
+    n = spr_file_copy_buffered(src, src_offset + copied, dst,
+                               dst_offset + copied, size - copied);
+    if (n == -1) {
+        err = spr_get_errno();
 
-    rv = read(fd, buf, n);
-    if (rv == -1) {
-        return -1;
+    } else {
+        copied += n;
+        err = SPR_OK;
     }
-    return rv;
-}
 
-ssize_t
-spr_write_fd(spr_fd_t fd, void *buf, size_t n)
-{
-    ssize_t rv;
+#if (SPR_HAVE_COPY_FILE_RANGE || SPR_LINUX)
+done:
+#endif
 
-    rv = write(fd, buf, n);
-    if (rv == -1) {
+    if (err != SPR_OK && copied == 0) {
+        spr_set_errno(err);
         return -1;
     }
-    return rv;
-}
 
+    return (ssize_t) copied;
+}
 
 spr_err_t
 spr_file_info_by_path(spr_file_info_t *info, const char *path)
@@ -275,6 +938,18 @@ spr_file_info(spr_file_info_t *info, spr_file_t *file)
     return SPR_OK;
 }
 
+spr_err_t
+spr_file_truncate(spr_file_t *file, spr_off_t size)
+{
+    while (ftruncate(file->fd, (off_t) size) == -1) {
+        if (spr_get_errno() != EINTR) {
+            return spr_get_errno();
+        }
+    }
+
+    return SPR_OK;
+}
+
 void
 spr_file_close(spr_file_t *file)
 {
@@ -431,105 +1106,25 @@ spr_check_absolute_path(const char *path)
 
 #elif (SPR_WIN32)
 
-static uint32_t
-spr_utf8_decode(u_char **p, size_t n)
+static spr_err_t
+spr_path_to_wchar(uint16_t *outstr, size_t outlen, const char *instr)
 {
+    ssize_t n;
     size_t len;
-    uint32_t u, i, valid;
-
-    u = **p;
-
-    if (u >= 0xf0) {
-        u &= 0x07;
-        valid = 0xffff;
-        len = 3;
-    }
-    else if (u >= 0xe0) {
-        u &= 0x0f;
-        valid = 0x7ff;
-        len = 2;
-    }
-    else if (u >= 0xc2) {
-        u &= 0x1f;
-        valid = 0x7f;
-        len = 1;
-    }
-    else {
-        (*p)++;
-        return 0xffffffff;
-    }
 
-    if (n - 1 < len) {
-        return 0xfffffffe;
-    }
-
-    (*p)++;
-
-    while (len) {
-        i = *(*p)++;
-
-        if (i < 0x80) {
-            return 0xffffffff;
-        }
-
-        u = (u << 6) | (i & 0x3f);
+    len = spr_strlen(instr);
 
-        len--;
-    }
+    /* Leave room for the terminating zero */
+    n = spr_utf8_to_utf16((const uint8_t *) instr, len, outstr, outlen - 1);
 
-    if (u > valid) {
-        return u;
+    if (n < 0) {
+        return spr_utf8_validate(instr, len) ? SPR_ERR_FILESYS_LONG_PATH
+                                             : SPR_ERR_FILESYS_ENCODING;
     }
 
-    return 0xffffffff;
-}
-
-static uint16_t *
-spr_path_to_wchar(uint16_t *outstr, size_t outlen,
-    const uint8_t *instr)
-{
-    uint8_t *p;
-    uint16_t *u, *last;
-    uint32_t n;
-
-    p = (uint8_t *) instr;
-    u = outstr;
-    last = outstr + outlen;
-
-    while (u < last) {
-
-        if (*p < 0x80) {
-            *u++ = (uint16_t) *p;
-
-            if (*p == 0) {
-                return outstr;
-            }
-
-            p++;
-
-            continue;
-        }
-
-        if (u + 1 == last) {
-            break;
-        }
-
-        n = spr_utf8_decode(&p, 4);
-
-        if (n > 0x10ffff) {
-            return NULL;
-        }
-
-        if (n > 0xffff) {
-            n -= 0x10000;
-            *u++ = (uint16_t) (0xd800 + (n >> 10));
-            *u++ = (uint16_t) (0xdc00 + (n & 0x03ff));
-            continue;
-        }
+    outstr[n] = 0;
 
-        *u++ = (uint16_t) n;
-    }
-    return NULL;
+    return SPR_OK;
 }
 
 static spr_file_type_t
@@ -554,15 +1149,27 @@ spr_file_open(spr_file_t *file, const char *path, spr_uint_t mode,
     spr_uint_t create, spr_uint_t access)
 {
     uint16_t wpath[SPR_MAX_PATH_LEN];
+    spr_err_t err;
     spr_fd_t fd;
+    DWORD flags;
 
     (void) access;
 
     spr_memzero(file, sizeof(spr_file_t));
 
-    spr_path_to_wchar(wpath, sizeof(wpath), (const uint8_t *) path);
+    err = spr_path_to_wchar(wpath, SPR_MAX_PATH_LEN, path);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    flags = 0;
+
+    if (mode & SPR_FILE_DIRECT) {
+        mode &= ~((spr_uint_t) SPR_FILE_DIRECT);
+        flags = FILE_FLAG_NO_BUFFERING;
+    }
 
-    fd = CreateFileW(wpath, mode, 0, NULL, create, 0, NULL);
+    fd = CreateFileW(wpath, mode, 0, NULL, create, flags, NULL);
     if (fd == SPR_INVALID_FILE) {
         return spr_get_errno();
     }
@@ -571,26 +1178,52 @@ spr_file_open(spr_file_t *file, const char *path, spr_uint_t mode,
     file->name = (char *) path;
     file->offset = (size_t) 0;
 
+    if (flags) {
+        err = spr_file_block_size(file, &file->align);
+        if (err != SPR_OK) {
+            CloseHandle(fd);
+            file->fd = SPR_INVALID_FILE;
+            return err;
+        }
+    }
+
     return SPR_OK;
 }
 
+static void
+spr_file_overlapped(OVERLAPPED *ovlp, spr_off_t offset)
+{
+    spr_memzero(ovlp, sizeof(OVERLAPPED));
+
+    ovlp->Offset = (DWORD) offset;
+    ovlp->OffsetHigh = (DWORD) ((uint64_t) offset >> 32);
+}
+
+/*
+ * With an OVERLAPPED offset the transfer starts at the given position
+ * whatever the file pointer is, so threads can share the handle.
+ */
 ssize_t
 spr_file_read(spr_file_t *file, uint8_t *buf, size_t size,
     spr_off_t offset)
 {
-    DWORD n;
     OVERLAPPED ovlp;
+    DWORD n;
 
-    ovlp.Internal = 0;
-    ovlp.InternalHigh = 0;
-    ovlp.Offset = (DWORD) offset;
-    /* ovlp.OffsetHigh = (DWORD) (offset >> 32); */
-    ovlp.hEvent = NULL;
+    spr_file_overlapped(&ovlp, offset);
+
+    if (size > SPR_FILE_IO_CHUNK) {
+        size = SPR_FILE_IO_CHUNK;
+    }
 
-    if (ReadFile(file->fd, buf, size, &n, &ovlp) == 0) {
+    if (ReadFile(file->fd, buf, (DWORD) size, &n, &ovlp) == 0) {
+        if (spr_get_errno() == ERROR_HANDLE_EOF) {
+            return 0;
+        }
         return -1;
     }
-    file->offset += n;
+
+    spr_atomic_fetch_add_relaxed(&file->offset, n);
     return (ssize_t) n;
 }
 
@@ -598,24 +1231,99 @@ ssize_t
 spr_file_write(spr_file_t *file, const char *buf, size_t size,
     spr_off_t offset)
 {
-    DWORD n;
     OVERLAPPED ovlp;
+    size_t written, chunk;
+    DWORD n;
 
-    ovlp.Internal = 0;
-    ovlp.InternalHigh = 0;
-    ovlp.Offset = (DWORD) offset;
-    /* ovlp.OffsetHigh = (DWORD) (offset >> 32); */
-    ovlp.hEvent = NULL;
+    for (written = 0; written < size; written += n) {
+        chunk = size - written;
+        if (chunk > SPR_FILE_IO_CHUNK) {
+            chunk = SPR_FILE_IO_CHUNK;
+        }
 
-    if (WriteFile(file->fd, buf, size, &n, &ovlp) == 0) {
-        return -1;
+        spr_file_overlapped(&ovlp, offset + written);
+
+        if (WriteFile(file->fd, buf + written, (DWORD) chunk, &n, &ovlp)
+            == 0)
+        {
+            return -1;
+        }
+
+        if (n == 0) {
+            spr_set_errno(ERROR_WRITE_FAULT);
+            return -1;
+        }
+
+        spr_atomic_fetch_add_relaxed(&file->offset, n);
     }
 
-    if (((size_t) n) != size) {
-        return -1;
+    return written;
+}
+
+/* Windows has no positional scatter-gather for buffered handles */
+ssize_t
+spr_file_readv(spr_file_t *file, const spr_iovec_t *iov, size_t iovcnt,
+    spr_off_t offset)
+{
+    size_t i, total;
+    ssize_t n;
+
+    total = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        n = spr_file_read(file, iov[i].iov_base, iov[i].iov_len,
+                          offset + total);
+        if (n == -1) {
+            return (total != 0) ? (ssize_t) total : -1;
+        }
+
+        total += n;
+
+        if ((size_t) n < iov[i].iov_len) {
+            break;
+        }
     }
-    file->offset += n;
-    return n;
+
+    return total;
+}
+
+ssize_t
+spr_file_writev(spr_file_t *file, const spr_iovec_t *iov, size_t iovcnt,
+    spr_off_t offset)
+{
+    size_t i, written;
+
+    written = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        if (spr_file_write(file, iov[i].iov_base, iov[i].iov_len,
+                           offset + written) == -1)
+        {
+            return -1;
+        }
+
+        written += iov[i].iov_len;
+    }
+
+    return written;
+}
+
+/* FileStorageInfo needs Windows 8, older systems get the default */
+spr_err_t
+spr_file_block_size(spr_file_t *file, size_t *size)
+{
+    FILE_STORAGE_INFO info;
+
+    if (GetFileInformationByHandleEx(file->fd, FileStorageInfo, &info,
+                                     sizeof(FILE_STORAGE_INFO)) == 0
+        || info.LogicalBytesPerSector == 0)
+    {
+        *size = SPR_FILE_BLOCK_SIZE;
+        return SPR_OK;
+    }
+
+    *size = (size_t) info.LogicalBytesPerSector;
+    return SPR_OK;
 }
 
 #if (SPR_PTR_SIZE == 8)
@@ -670,13 +1378,86 @@ spr_write_fd(spr_fd_t fd, void *buf, size_t size)
     return (ssize_t) n;
 }
 
+/*
+ * TransmitFile() takes the offset from the OVERLAPPED structure, the
+ * completion is waited for so the socket may be an overlapped one
+ */
+ssize_t
+spr_file_send_to_socket(spr_file_t *file, spr_socket_t sockfd,
+    spr_off_t offset, size_t size)
+{
+    DWORD chunk, n, flags;
+    OVERLAPPED ovlp;
+    WSAEVENT event;
+    spr_err_t err;
+    size_t sent;
+
+    event = WSACreateEvent();
+    if (event == WSA_INVALID_EVENT) {
+        return -1;
+    }
+
+    for (sent = 0; sent < size; sent += n) {
+        chunk = (size - sent > SPR_FILE_IO_CHUNK)
+                ? SPR_FILE_IO_CHUNK : (DWORD) (size - sent);
+
+        spr_file_overlapped(&ovlp, offset + sent);
+        ovlp.hEvent = event;
+
+        if (!TransmitFile(sockfd, file->fd, chunk, 0, &ovlp, NULL, 0)
+            && spr_get_socket_errno() != WSA_IO_PENDING)
+        {
+            goto failed;
+        }
+
+        if (!WSAGetOverlappedResult(sockfd, &ovlp, &n, TRUE, &flags)) {
+            goto failed;
+        }
+
+        /* End of the file */
+        if (n < chunk) {
+            sent += n;
+            break;
+        }
+    }
+
+    WSACloseEvent(event);
+
+    return (ssize_t) sent;
+
+failed:
+
+    err = spr_get_socket_errno();
+    WSACloseEvent(event);
+
+    if (sent) {
+        return (ssize_t) sent;
+    }
+
+    spr_set_errno(err);
+
+    return -1;
+}
+
+/* No ranged copy in the kernel, FSCTL_DUPLICATE_EXTENTS is ReFS only */
+ssize_t
+spr_file_copy_range(spr_file_t *src, spr_off_t src_offset, spr_file_t *dst,
+    spr_off_t dst_offset, size_t size)
+{
+    return spr_file_copy_buffered(src, src_offset, dst, dst_offset, size);
+}
+
 spr_err_t
 spr_file_stat_by_path(spr_file_stat_t *stat, const char *path)
 {
     WIN32_FILE_ATTRIBUTE_DATA file_attr;
     uint16_t wpath[SPR_MAX_PATH_LEN];
+    spr_err_t err;
 
-    spr_path_to_wchar(wpath, sizeof(wpath), (const uint8_t *) path);
+    err = spr_path_to_wchar(wpath, SPR_MAX_PATH_LEN, path);
+    if (err != SPR_OK) {
+        return err;
+    }
 
     if (GetFileAttributesExW(wpath, GetFileExInfoStandard, &file_attr) == 0) {
         return spr_get_errno();
@@ -721,6 +1502,22 @@ spr_file_info(spr_file_info_t *info, spr_file_t *file)
     return SPR_OK;
 }
 
+spr_err_t
+spr_file_truncate(spr_file_t *file, spr_off_t size)
+{
+    FILE_END_OF_FILE_INFO info;
+
+    info.EndOfFile.QuadPart = size;
+
+    if (!SetFileInformationByHandle(file->fd, FileEndOfFileInfo, &info,
+                                    sizeof(info)))
+    {
+        return spr_get_errno();
+    }
+
+    return SPR_OK;
+}
+
 void
 spr_file_close(spr_file_t *file)
 {
@@ -910,6 +1707,71 @@ spr_check_absolute_path(const char *path)
 
 #endif
 
+/*
+ * A misaligned direct transfer fails with a bare EINVAL from the kernel,
+ * or silently goes through the cache on some systems, so it is refused
+ * here with an error that says what is wrong.
+ */
+static bool
+spr_file_direct_aligned(spr_file_t *file, const void *buf, size_t size,
+    spr_off_t offset)
+{
+    size_t align;
+
+    align = file->align;
+    if (align == 0) {
+        return true;
+    }
+
+    return (uintptr_t) buf % align == 0
+           && size % align == 0
+           && (uint64_t) offset % align == 0;
+}
+
+ssize_t
+spr_file_read_direct(spr_file_t *file, uint8_t *buf, size_t size,
+    spr_off_t offset)
+{
+    if (!spr_file_direct_aligned(file, buf, size, offset)) {
+        spr_set_errno(SPR_ERR_FILESYS_ALIGNMENT);
+        return -1;
+    }
+
+    return spr_file_read(file, buf, size, offset);
+}
+
+ssize_t
+spr_file_write_direct(spr_file_t *file, const char *buf, size_t size,
+    spr_off_t offset)
+{
+    if (!spr_file_direct_aligned(file, buf, size, offset)) {
+        spr_set_errno(SPR_ERR_FILESYS_ALIGNMENT);
+        return -1;
+    }
+
+    return spr_file_write(file, buf, size, offset);
+}
+
+/* The size is rounded up to whole blocks, so the tail can be padded */
+void *
+spr_file_palloc(spr_pool_t *pool, spr_file_t *file, size_t size)
+{
+    size_t align;
+
+    align = file->align;
+    if (align == 0) {
+        return spr_palloc(pool, size);
+    }
+
+    if (size + align < size) {
+        return NULL;
+    }
+
+    size = (size + align - 1) / align * align;
+
+    return spr_pmemalign(pool, size, align);
+}
+
 ssize_t
 spr_write_stdout(const char *str)
 {
@@ -0,0 +1,739 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "spr_portable.h"
+#include "spr_filter.h"
+#include "spr_hash.h"
+#include "spr_memory.h"
+#include "spr_atomic.h"
+#include "spr_cpuinfo.h"
+#include "spr_errno.h"
+
+#if (SPR_HAVE_AVX2)
+#include <immintrin.h>
+#endif
+
+#if (SPR_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+#define SPR_BLOOM_MAGIC              0x4d4f4c42 /* "BLOM" */
+#define SPR_CUCKOO_MAGIC             0x4b435543 /* "CUCK" */
+#define SPR_FILTER_VERSION           1
+#define SPR_FILTER_SEED              0
+
+#define SPR_CUCKOO_LANES             0x0001000100010001ULL
+#define SPR_CUCKOO_HIGH_BITS         0x8000800080008000ULL
+
+typedef bool (*spr_bloom_block_pt)(uint32_t *block, uint32_t hash,
+    bool add);
+
+/* File header, it keeps the data after it cache line aligned */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;
+    uint64_t count;
+    uint64_t seed;
+    uint64_t victim_index;
+    uint32_t victim_fp;
+    uint32_t checksum;
+    uint8_t reserved[16];
+} spr_filter_header_t;
+
+static bool spr_bloom_block_init(uint32_t *block, uint32_t hash, bool add);
+
+static spr_bloom_block_pt spr_bloom_block = spr_bloom_block_init;
+
+static const uint32_t spr_bloom_salt[SPR_BLOOM_BLOCK_WORDS] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+
+static spr_err_t
+spr_filter_save(spr_file_t *file, spr_off_t offset,
+    spr_filter_header_t *header, const void *data, size_t size)
+{
+    header->version = SPR_FILTER_VERSION;
+    header->checksum = spr_crc32c(0, data, size);
+    spr_memzero(header->reserved, sizeof(header->reserved));
+
+    if (spr_file_write(file, (const char *) header,
+                       sizeof(spr_filter_header_t), offset) < 0)
+    {
+        return spr_get_errno();
+    }
+
+    if (spr_file_write(file, data, size,
+                       offset + sizeof(spr_filter_header_t)) < 0)
+    {
+        return spr_get_errno();
+    }
+
+    return SPR_OK;
+}
+
+static spr_err_t
+spr_filter_read(spr_file_t *file, void *buf, size_t size, spr_off_t offset)
+{
+    size_t total;
+    ssize_t n;
+
+    for (total = 0; total < size; total += n) {
+        n = spr_file_read(file, (uint8_t *) buf + total, size - total,
+                          offset + total);
+        if (n < 0) {
+            return spr_get_errno();
+        }
+
+        if (n == 0) {
+            return SPR_FAILED;
+        }
+    }
+
+    return SPR_OK;
+}
+
+/*
+ * The header is read and checked first, then exactly the data it
+ * describes is read behind it into a pool buffer, the filter may be
+ * followed by other data in the file
+ */
+static spr_err_t
+spr_filter_load(spr_pool_t *pool, spr_file_t *file, spr_off_t offset,
+    uint32_t magic, size_t unit, spr_filter_header_t **out_header,
+    uint8_t **data)
+{
+    spr_filter_header_t *header, h;
+    spr_err_t err;
+    ssize_t fsize;
+    uint8_t *buf;
+    size_t size;
+
+    fsize = spr_file_size(file);
+    if (fsize < 0) {
+        return spr_get_errno();
+    }
+
+    if (fsize < offset + (ssize_t) sizeof(spr_filter_header_t)) {
+        return SPR_FAILED;
+    }
+
+    err = spr_filter_read(file, &h, sizeof(spr_filter_header_t), offset);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    if (h.magic != magic
+        || h.version != SPR_FILTER_VERSION
+        || h.size == 0
+        || h.size > (uint64_t) (fsize - offset
+                                - (ssize_t) sizeof(spr_filter_header_t))
+                    / unit)
+    {
+        return SPR_FAILED;
+    }
+
+    size = (size_t) h.size * unit;
+
+    buf = spr_pmemalign(pool, sizeof(spr_filter_header_t) + size,
+                        SPR_CACHELINE_SIZE);
+    if (!buf) {
+        return spr_get_errno();
+    }
+
+    header = (spr_filter_header_t *) buf;
+    *header = h;
+
+    *data = buf + sizeof(spr_filter_header_t);
+
+    err = spr_filter_read(file, *data, size,
+                          offset + sizeof(spr_filter_header_t));
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    if (spr_crc32c(0, *data, size) != header->checksum) {
+        return SPR_FAILED;
+    }
+
+    *out_header = header;
+
+    return SPR_OK;
+}
+
+static bool
+spr_bloom_block_scalar(uint32_t *block, uint32_t hash, bool add)
+{
+    uint32_t mask;
+    spr_uint_t i;
+    bool found;
+
+    found = 1;
+
+    for (i = 0; i < SPR_BLOOM_BLOCK_WORDS; ++i) {
+        mask = (uint32_t) 1 << ((hash * spr_bloom_salt[i]) >> 27);
+
+        if (add) {
+            block[i] |= mask;
+        }
+        else if (!(block[i] & mask)) {
+            found = 0;
+        }
+    }
+
+    return found;
+}
+
+#if (SPR_HAVE_AVX2)
+
+static SPR_TARGET_AVX2 bool
+spr_bloom_block_avx2(uint32_t *block, uint32_t hash, bool add)
+{
+    __m256i salt, mask, data;
+
+    salt = _mm256_loadu_si256((const __m256i *) spr_bloom_salt);
+    mask = _mm256_mullo_epi32(_mm256_set1_epi32((int) hash), salt);
+    mask = _mm256_sllv_epi32(_mm256_set1_epi32(1),
+                             _mm256_srli_epi32(mask, 27));
+
+    data = _mm256_load_si256((const __m256i *) block);
+
+    if (add) {
+        _mm256_store_si256((__m256i *) block, _mm256_or_si256(data, mask));
+        return 1;
+    }
+
+    return _mm256_testc_si256(data, mask);
+}
+
+#endif
+
+#if (SPR_HAVE_NEON)
+
+static bool
+spr_bloom_block_neon(uint32_t *block, uint32_t hash, bool add)
+{
+    uint32x4_t h, one, mask0, mask1, data0, data1;
+
+    h = vdupq_n_u32(hash);
+    one = vdupq_n_u32(1);
+
+    mask0 = vshrq_n_u32(vmulq_u32(h, vld1q_u32(spr_bloom_salt)), 27);
+    mask1 = vshrq_n_u32(vmulq_u32(h, vld1q_u32(spr_bloom_salt + 4)), 27);
+    mask0 = vshlq_u32(one, vreinterpretq_s32_u32(mask0));
+    mask1 = vshlq_u32(one, vreinterpretq_s32_u32(mask1));
+
+    data0 = vld1q_u32(block);
+    data1 = vld1q_u32(block + 4);
+
+    if (add) {
+        vst1q_u32(block, vorrq_u32(data0, mask0));
+        vst1q_u32(block + 4, vorrq_u32(data1, mask1));
+        return 1;
+    }
+
+    return vmaxvq_u32(vorrq_u32(vbicq_u32(mask0, data0),
+                                vbicq_u32(mask1, data1))) == 0;
+}
+
+#endif
+
+static bool
+spr_bloom_block_init(uint32_t *block, uint32_t hash, bool add)
+{
+    spr_bloom_block_pt fn;
+
+    fn = spr_bloom_block_scalar;
+
+#if (SPR_HAVE_AVX2)
+    if (spr_cpu_has_feature(SPR_CPU_FEATURE_AVX2)) {
+        fn = spr_bloom_block_avx2;
+    }
+#endif
+
+#if (SPR_HAVE_NEON)
+    if (spr_cpu_has_feature(SPR_CPU_FEATURE_NEON)) {
+        fn = spr_bloom_block_neon;
+    }
+#endif
+
+    spr_atomic_store(&spr_bloom_block, fn);
+
+    return fn(block, hash, add);
+}
+
+spr_err_t
+spr_bloom_create1(spr_bloom_t **out_bloom, spr_pool_t *pool, size_t n,
+    spr_uint_t bits_per_key)
+{
+    spr_bloom_t *bloom;
+    size_t nblocks, size;
+
+    nblocks = (n * bits_per_key + 255) / 256;
+    if (nblocks == 0) {
+        nblocks = 1;
+    }
+
+    if (nblocks > UINT32_MAX) {
+        return SPR_FAILED;
+    }
+
+    bloom = spr_palloc(pool, sizeof(spr_bloom_t));
+    if (!bloom) {
+        return spr_get_errno();
+    }
+
+    size = nblocks * SPR_BLOOM_BLOCK_WORDS * sizeof(uint32_t);
+
+    bloom->blocks = spr_pmemalign(pool, size, SPR_CACHELINE_SIZE);
+    if (!bloom->blocks) {
+        return spr_get_errno();
+    }
+
+    spr_memzero(bloom->blocks, size);
+
+    bloom->nblocks = nblocks;
+    bloom->count = 0;
+    bloom->seed = SPR_FILTER_SEED;
+
+    *out_bloom = bloom;
+
+    return SPR_OK;
+}
+
+spr_bloom_t *
+spr_bloom_create(spr_pool_t *pool, size_t n, spr_uint_t bits_per_key)
+{
+    spr_bloom_t *bloom;
+
+    bloom = NULL;
+
+    if (spr_bloom_create1(&bloom, pool, n, bits_per_key) != SPR_OK) {
+        return NULL;
+    }
+
+    return bloom;
+}
+
+/* High half of the hash picks the block, low half sets the bits */
+#define spr_bloom_block_of(bloom, hash) \
+    ((bloom)->blocks + SPR_BLOOM_BLOCK_WORDS \
+     * (((hash) >> 32) * (uint64_t) (bloom)->nblocks >> 32))
+
+void
+spr_bloom_add_hash(spr_bloom_t *bloom, uint64_t hash)
+{
+    spr_atomic_load(&spr_bloom_block)(spr_bloom_block_of(bloom, hash),
+                                      (uint32_t) hash, 1);
+    bloom->count += 1;
+}
+
+bool
+spr_bloom_check_hash(spr_bloom_t *bloom, uint64_t hash)
+{
+    return spr_atomic_load(&spr_bloom_block)(spr_bloom_block_of(bloom, hash),
+                                             (uint32_t) hash, 0);
+}
+
+void
+spr_bloom_add(spr_bloom_t *bloom, const void *key, size_t len)
+{
+    spr_bloom_add_hash(bloom, spr_hash64(key, len, bloom->seed));
+}
+
+bool
+spr_bloom_check(spr_bloom_t *bloom, const void *key, size_t len)
+{
+    return spr_bloom_check_hash(bloom, spr_hash64(key, len, bloom->seed));
+}
+
+void
+spr_bloom_clear(spr_bloom_t *bloom)
+{
+    spr_memzero(bloom->blocks,
+                bloom->nblocks * SPR_BLOOM_BLOCK_WORDS * sizeof(uint32_t));
+    bloom->count = 0;
+}
+
+spr_err_t
+spr_bloom_save(spr_bloom_t *bloom, spr_file_t *file, spr_off_t offset)
+{
+    spr_filter_header_t header;
+
+    header.magic = SPR_BLOOM_MAGIC;
+    header.size = bloom->nblocks;
+    header.count = bloom->count;
+    header.seed = bloom->seed;
+    header.victim_index = 0;
+    header.victim_fp = 0;
+
+    return spr_filter_save(file, offset, &header, bloom->blocks,
+                           bloom->nblocks * SPR_BLOOM_BLOCK_WORDS
+                           * sizeof(uint32_t));
+}
+
+spr_err_t
+spr_bloom_load(spr_bloom_t **out_bloom, spr_pool_t *pool,
+    spr_file_t *file, spr_off_t offset)
+{
+    spr_filter_header_t *header;
+    spr_bloom_t *bloom;
+    uint8_t *data;
+    spr_err_t err;
+
+    err = spr_filter_load(pool, file, offset, SPR_BLOOM_MAGIC,
+                          SPR_BLOOM_BLOCK_WORDS * sizeof(uint32_t),
+                          &header, &data);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    if (header->size > UINT32_MAX) {
+        return SPR_FAILED;
+    }
+
+    bloom = spr_palloc(pool, sizeof(spr_bloom_t));
+    if (!bloom) {
+        return spr_get_errno();
+    }
+
+    bloom->blocks = (uint32_t *) data;
+    bloom->nblocks = header->size;
+    bloom->count = header->count;
+    bloom->seed = header->seed;
+
+    *out_bloom = bloom;
+
+    return SPR_OK;
+}
+
+/* Returns the first slot holding the fingerprint or -1 */
+static int
+spr_cuckoo_find(uint64_t bucket, uint16_t fp)
+{
+    uint64_t x, z;
+
+    x = bucket ^ (SPR_CUCKOO_LANES * fp);
+    z = (x - SPR_CUCKOO_LANES) & ~x & SPR_CUCKOO_HIGH_BITS;
+
+    if (z == 0) {
+        return -1;
+    }
+
+    return __builtin_ctzll(z) >> 4;
+}
+
+static uint16_t
+spr_cuckoo_fingerprint(uint64_t hash)
+{
+    uint16_t fp;
+
+    /* Zero marks empty slots */
+    fp = (uint16_t) hash;
+
+    return fp ? fp : 1;
+}
+
+#define spr_cuckoo_index(cuckoo, hash) \
+    ((size_t) ((hash) >> 32) & (cuckoo)->mask)
+#define spr_cuckoo_alt_index(cuckoo, index, fp) \
+    (((index) ^ ((size_t) (fp) * 0x5bd1e995)) & (cuckoo)->mask)
+
+static bool
+spr_cuckoo_put(spr_cuckoo_t *cuckoo, size_t index, uint16_t fp)
+{
+    int slot;
+
+    slot = spr_cuckoo_find(cuckoo->buckets[index], 0);
+    if (slot < 0) {
+        return 0;
+    }
+
+    cuckoo->buckets[index] |= (uint64_t) fp << (16 * slot);
+
+    return 1;
+}
+
+static void
+spr_cuckoo_insert(spr_cuckoo_t *cuckoo, size_t index, uint16_t fp)
+{
+    uint64_t *bucket;
+    spr_uint_t kick, slot, shift;
+    uint16_t old;
+
+    if (spr_cuckoo_put(cuckoo, index, fp)
+        || spr_cuckoo_put(cuckoo, spr_cuckoo_alt_index(cuckoo, index, fp),
+                          fp))
+    {
+        return;
+    }
+
+    for (kick = 0; kick < SPR_CUCKOO_MAX_KICKS; ++kick) {
+        cuckoo->rnd ^= cuckoo->rnd << 13;
+        cuckoo->rnd ^= cuckoo->rnd >> 7;
+        cuckoo->rnd ^= cuckoo->rnd << 17;
+
+        if (cuckoo->rnd & 4) {
+            index = spr_cuckoo_alt_index(cuckoo, index, fp);
+        }
+
+        slot = cuckoo->rnd & (SPR_CUCKOO_BUCKET_SLOTS - 1);
+        shift = 16 * slot;
+        bucket = &cuckoo->buckets[index];
+
+        old = (uint16_t) (*bucket >> shift);
+        *bucket = (*bucket & ~((uint64_t) 0xffff << shift))
+                  | ((uint64_t) fp << shift);
+        fp = old;
+
+        index = spr_cuckoo_alt_index(cuckoo, index, fp);
+
+        if (spr_cuckoo_put(cuckoo, index, fp)) {
+            return;
+        }
+    }
+
+    cuckoo->victim_index = index;
+    cuckoo->victim_fp = fp;
+}
+
+spr_err_t
+spr_cuckoo_create1(spr_cuckoo_t **out_cuckoo, spr_pool_t *pool, size_t n)
+{
+    spr_cuckoo_t *cuckoo;
+    size_t nbuckets;
+
+    /* Load factor stays below 95% */
+    for (nbuckets = 1;
+         nbuckets * SPR_CUCKOO_BUCKET_SLOTS * 95 / 100 < n;
+         nbuckets <<= 1)
+    {
+        /* void */
+    }
+
+    cuckoo = spr_palloc(pool, sizeof(spr_cuckoo_t));
+    if (!cuckoo) {
+        return spr_get_errno();
+    }
+
+    cuckoo->buckets = spr_pmemalign(pool, nbuckets * sizeof(uint64_t),
+                                    SPR_CACHELINE_SIZE);
+    if (!cuckoo->buckets) {
+        return spr_get_errno();
+    }
+
+    cuckoo->mask = nbuckets - 1;
+    cuckoo->seed = SPR_FILTER_SEED;
+
+    spr_cuckoo_clear(cuckoo);
+
+    *out_cuckoo = cuckoo;
+
+    return SPR_OK;
+}
+
+spr_cuckoo_t *
+spr_cuckoo_create(spr_pool_t *pool, size_t n)
+{
+    spr_cuckoo_t *cuckoo;
+
+    cuckoo = NULL;
+
+    if (spr_cuckoo_create1(&cuckoo, pool, n) != SPR_OK) {
+        return NULL;
+    }
+
+    return cuckoo;
+}
+
+spr_err_t
+spr_cuckoo_add_hash(spr_cuckoo_t *cuckoo, uint64_t hash)
+{
+    if (cuckoo->victim_fp) {
+        return SPR_FAILED;
+    }
+
+    spr_cuckoo_insert(cuckoo, spr_cuckoo_index(cuckoo, hash),
+                      spr_cuckoo_fingerprint(hash));
+    cuckoo->count += 1;
+
+    return SPR_OK;
+}
+
+bool
+spr_cuckoo_check_hash(spr_cuckoo_t *cuckoo, uint64_t hash)
+{
+    size_t i1, i2;
+    uint16_t fp;
+
+    fp = spr_cuckoo_fingerprint(hash);
+    i1 = spr_cuckoo_index(cuckoo, hash);
+    i2 = spr_cuckoo_alt_index(cuckoo, i1, fp);
+
+    if (spr_cuckoo_find(cuckoo->buckets[i1], fp) >= 0
+        || spr_cuckoo_find(cuckoo->buckets[i2], fp) >= 0)
+    {
+        return 1;
+    }
+
+    return cuckoo->victim_fp == fp
+           && (cuckoo->victim_index == i1 || cuckoo->victim_index == i2);
+}
+
+spr_err_t
+spr_cuckoo_remove_hash(spr_cuckoo_t *cuckoo, uint64_t hash)
+{
+    size_t i1, i2, index;
+    uint16_t fp;
+    int slot;
+
+    fp = spr_cuckoo_fingerprint(hash);
+    i1 = spr_cuckoo_index(cuckoo, hash);
+    i2 = spr_cuckoo_alt_index(cuckoo, i1, fp);
+
+    if (cuckoo->victim_fp == fp
+        && (cuckoo->victim_index == i1 || cuckoo->victim_index == i2))
+    {
+        cuckoo->victim_fp = 0;
+        cuckoo->count -= 1;
+        return SPR_OK;
+    }
+
+    index = i1;
+    slot = spr_cuckoo_find(cuckoo->buckets[index], fp);
+
+    if (slot < 0) {
+        index = i2;
+        slot = spr_cuckoo_find(cuckoo->buckets[index], fp);
+
+        if (slot < 0) {
+            return SPR_NOT_FOUND;
+        }
+    }
+
+    cuckoo->buckets[index] &= ~((uint64_t) 0xffff << (16 * slot));
+    cuckoo->count -= 1;
+
+    /* The freed slot may give room to the victim */
+    if (cuckoo->victim_fp) {
+        fp = cuckoo->victim_fp;
+        cuckoo->victim_fp = 0;
+        spr_cuckoo_insert(cuckoo, cuckoo->victim_index, fp);
+    }
+
+    return SPR_OK;
+}
+
+spr_err_t
+spr_cuckoo_add(spr_cuckoo_t *cuckoo, const void *key, size_t len)
+{
+    return spr_cuckoo_add_hash(cuckoo, spr_hash64(key, len, cuckoo->seed));
+}
+
+bool
+spr_cuckoo_check(spr_cuckoo_t *cuckoo, const void *key, size_t len)
+{
+    return spr_cuckoo_check_hash(cuckoo,
+                                 spr_hash64(key, len, cuckoo->seed));
+}
+
+spr_err_t
+spr_cuckoo_remove(spr_cuckoo_t *cuckoo, const void *key, size_t len)
+{
+    return spr_cuckoo_remove_hash(cuckoo,
+                                  spr_hash64(key, len, cuckoo->seed));
+}
+
+void
+spr_cuckoo_clear(spr_cuckoo_t *cuckoo)
+{
+    spr_memzero(cuckoo->buckets, (cuckoo->mask + 1) * sizeof(uint64_t));
+
+    cuckoo->count = 0;
+    cuckoo->rnd = 0x9e3779b97f4a7c15ULL;
+    cuckoo->victim_index = 0;
+    cuckoo->victim_fp = 0;
+}
+
+spr_err_t
+spr_cuckoo_save(spr_cuckoo_t *cuckoo, spr_file_t *file, spr_off_t offset)
+{
+    spr_filter_header_t header;
+
+    header.magic = SPR_CUCKOO_MAGIC;
+    header.size = cuckoo->mask + 1;
+    header.count = cuckoo->count;
+    header.seed = cuckoo->seed;
+    header.victim_index = cuckoo->victim_index;
+    header.victim_fp = cuckoo->victim_fp;
+
+    return spr_filter_save(file, offset, &header, cuckoo->buckets,
+                           (cuckoo->mask + 1) * sizeof(uint64_t));
+}
+
+spr_err_t
+spr_cuckoo_load(spr_cuckoo_t **out_cuckoo, spr_pool_t *pool,
+    spr_file_t *file, spr_off_t offset)
+{
+    spr_filter_header_t *header;
+    spr_cuckoo_t *cuckoo;
+    uint8_t *data;
+    spr_err_t err;
+
+    err = spr_filter_load(pool, file, offset, SPR_CUCKOO_MAGIC,
+                          sizeof(uint64_t), &header, &data);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    if ((header->size & (header->size - 1))
+        || header->victim_index >= header->size
+        || header->victim_fp > 0xffff)
+    {
+        return SPR_FAILED;
+    }
+
+    cuckoo = spr_palloc(pool, sizeof(spr_cuckoo_t));
+    if (!cuckoo) {
+        return spr_get_errno();
+    }
+
+    cuckoo->buckets = (uint64_t *) data;
+    cuckoo->mask = header->size - 1;
+    cuckoo->count = header->count;
+    cuckoo->seed = header->seed;
+    cuckoo->rnd = 0x9e3779b97f4a7c15ULL;
+    cuckoo->victim_index = header->victim_index;
+    cuckoo->victim_fp = (uint16_t) header->victim_fp;
+
+    *out_cuckoo = cuckoo;
+
+    return SPR_OK;
+}
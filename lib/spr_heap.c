@@ -0,0 +1,437 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "spr_portable.h"
+#include "spr_heap.h"
+#include "spr_memory.h"
+#include "spr_errno.h"
+
+#define SPR_HEAP_DEFAULT_SIZE        64
+
+#define spr_heap_parent(h, i)        (((i) - 1) >> (h)->shift)
+#define spr_heap_first_child(h, i)   (((i) << (h)->shift) + 1)
+
+
+static spr_heap_entry_t *
+spr_heap_alloc_entries(spr_heap_t *heap, size_t n)
+{
+    spr_heap_entry_t *entries;
+    size_t pad;
+
+    /*
+     * Children of the entry i start at the index (i << shift) + 1, the
+     * array is shifted so that every group of siblings is aligned
+     */
+    pad = ((size_t) 1 << heap->shift) - 1;
+
+    entries = spr_pmemalign(heap->pool, (n + pad) * sizeof(spr_heap_entry_t),
+                            SPR_CACHELINE_SIZE);
+    if (!entries) {
+        return NULL;
+    }
+
+    return entries + pad;
+}
+
+static spr_err_t
+spr_heap_init(spr_heap_t *heap, spr_pool_t *pool, spr_uint_t arity,
+    size_t n)
+{
+    if (arity == 0) {
+        arity = SPR_HEAP_DEFAULT_ARITY;
+    }
+
+    if (arity < 2 || arity > SPR_HEAP_MAX_ARITY || (arity & (arity - 1))) {
+        return SPR_FAILED;
+    }
+
+    if (n == 0) {
+        n = SPR_HEAP_DEFAULT_SIZE;
+    }
+
+    heap->pool = pool;
+    heap->size = 0;
+    heap->capacity = n;
+
+    for (heap->shift = 0; ((spr_uint_t) 1 << heap->shift) < arity;
+         heap->shift++)
+    {
+        /* void */
+    }
+
+    heap->entries = spr_heap_alloc_entries(heap, n);
+    if (!heap->entries) {
+        return spr_get_errno();
+    }
+
+    return SPR_OK;
+}
+
+/* Old entries stay in the pool, growth is geometric */
+static spr_err_t
+spr_heap_grow(spr_heap_t *heap)
+{
+    spr_heap_entry_t *entries;
+
+    entries = spr_heap_alloc_entries(heap, heap->capacity * 2);
+    if (!entries) {
+        return spr_get_errno();
+    }
+
+    spr_memcpy(entries, heap->entries,
+               heap->size * sizeof(spr_heap_entry_t));
+
+    heap->entries = entries;
+    heap->capacity *= 2;
+
+    return SPR_OK;
+}
+
+static void
+spr_heap_sift_up(spr_heap_t *heap, size_t i, spr_heap_entry_t entry,
+    bool indexed)
+{
+    spr_heap_entry_t *entries;
+    size_t parent;
+
+    entries = heap->entries;
+
+    while (i > 0) {
+        parent = spr_heap_parent(heap, i);
+
+        if (entries[parent].key <= entry.key) {
+            break;
+        }
+
+        entries[i] = entries[parent];
+
+        if (indexed) {
+            ((spr_heap_node_t *) entries[i].value)->index = i + 1;
+        }
+
+        i = parent;
+    }
+
+    entries[i] = entry;
+
+    if (indexed) {
+        ((spr_heap_node_t *) entry.value)->index = i + 1;
+    }
+}
+
+static void
+spr_heap_sift_down(spr_heap_t *heap, size_t i, spr_heap_entry_t entry,
+    bool indexed)
+{
+    spr_heap_entry_t *entries;
+    size_t child, last, min, j;
+
+    entries = heap->entries;
+
+    for ( ; ; ) {
+        child = spr_heap_first_child(heap, i);
+
+        if (child >= heap->size) {
+            break;
+        }
+
+        last = child + ((size_t) 1 << heap->shift);
+        if (last > heap->size) {
+            last = heap->size;
+        }
+
+        min = child;
+
+        for (j = child + 1; j < last; ++j) {
+            if (entries[j].key < entries[min].key) {
+                min = j;
+            }
+        }
+
+        if (entry.key <= entries[min].key) {
+            break;
+        }
+
+        entries[i] = entries[min];
+
+        if (indexed) {
+            ((spr_heap_node_t *) entries[i].value)->index = i + 1;
+        }
+
+        i = min;
+    }
+
+    entries[i] = entry;
+
+    if (indexed) {
+        ((spr_heap_node_t *) entry.value)->index = i + 1;
+    }
+}
+
+/* Fills the hole at the position i with the last entry */
+static void
+spr_heap_delete(spr_heap_t *heap, size_t i, bool indexed)
+{
+    spr_heap_entry_t last;
+
+    heap->size -= 1;
+
+    if (i == heap->size) {
+        return;
+    }
+
+    last = heap->entries[heap->size];
+
+    if (i > 0 && last.key < heap->entries[spr_heap_parent(heap, i)].key) {
+        spr_heap_sift_up(heap, i, last, indexed);
+    }
+    else {
+        spr_heap_sift_down(heap, i, last, indexed);
+    }
+}
+
+spr_err_t
+spr_heap_create1(spr_heap_t **out_heap, spr_pool_t *pool, spr_uint_t arity,
+    size_t n)
+{
+    spr_heap_t *heap;
+    spr_err_t err;
+
+    heap = spr_palloc(pool, sizeof(spr_heap_t));
+    if (!heap) {
+        return spr_get_errno();
+    }
+
+    err = spr_heap_init(heap, pool, arity, n);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    *out_heap = heap;
+
+    return SPR_OK;
+}
+
+spr_heap_t *
+spr_heap_create(spr_pool_t *pool, spr_uint_t arity, size_t n)
+{
+    spr_heap_t *heap;
+
+    heap = NULL;
+
+    if (spr_heap_create1(&heap, pool, arity, n) != SPR_OK) {
+        return NULL;
+    }
+
+    return heap;
+}
+
+spr_err_t
+spr_heap_push(spr_heap_t *heap, uint64_t key, void *value)
+{
+    spr_heap_entry_t entry;
+    spr_err_t err;
+
+    if (heap->size == heap->capacity) {
+        err = spr_heap_grow(heap);
+        if (err != SPR_OK) {
+            return err;
+        }
+    }
+
+    entry.key = key;
+    entry.value = value;
+
+    heap->size += 1;
+    spr_heap_sift_up(heap, heap->size - 1, entry, 0);
+
+    return SPR_OK;
+}
+
+spr_err_t
+spr_heap_pop(spr_heap_t *heap, uint64_t *key, void **value)
+{
+    if (heap->size == 0) {
+        return SPR_NOT_FOUND;
+    }
+
+    if (key) {
+        *key = heap->entries[0].key;
+    }
+
+    if (value) {
+        *value = heap->entries[0].value;
+    }
+
+    spr_heap_delete(heap, 0, 0);
+
+    return SPR_OK;
+}
+
+void
+spr_heap_clear(spr_heap_t *heap)
+{
+    heap->size = 0;
+}
+
+spr_err_t
+spr_iheap_create1(spr_iheap_t **out_heap, spr_pool_t *pool,
+    spr_uint_t arity, size_t n)
+{
+    spr_iheap_t *heap;
+    spr_err_t err;
+
+    heap = spr_palloc(pool, sizeof(spr_iheap_t));
+    if (!heap) {
+        return spr_get_errno();
+    }
+
+    err = spr_heap_init(&heap->heap, pool, arity, n);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    *out_heap = heap;
+
+    return SPR_OK;
+}
+
+spr_iheap_t *
+spr_iheap_create(spr_pool_t *pool, spr_uint_t arity, size_t n)
+{
+    spr_iheap_t *heap;
+
+    heap = NULL;
+
+    if (spr_iheap_create1(&heap, pool, arity, n) != SPR_OK) {
+        return NULL;
+    }
+
+    return heap;
+}
+
+spr_err_t
+spr_iheap_insert(spr_iheap_t *heap, spr_heap_node_t *node, uint64_t key)
+{
+    spr_heap_entry_t entry;
+    spr_heap_t *h;
+    spr_err_t err;
+
+    if (spr_heap_node_queued(node)) {
+        return SPR_DECLINED;
+    }
+
+    h = &heap->heap;
+
+    if (h->size == h->capacity) {
+        err = spr_heap_grow(h);
+        if (err != SPR_OK) {
+            return err;
+        }
+    }
+
+    entry.key = key;
+    entry.value = node;
+
+    h->size += 1;
+    spr_heap_sift_up(h, h->size - 1, entry, 1);
+
+    return SPR_OK;
+}
+
+/* A node that is not queued, e.g. an already fired timeout, is left out */
+spr_err_t
+spr_iheap_update(spr_iheap_t *heap, spr_heap_node_t *node, uint64_t key)
+{
+    spr_heap_entry_t entry;
+    spr_heap_t *h;
+    size_t i;
+
+    if (!spr_heap_node_queued(node)) {
+        return SPR_NOT_FOUND;
+    }
+
+    h = &heap->heap;
+    i = node->index - 1;
+
+    entry.value = node;
+    entry.key = key;
+
+    if (key < h->entries[i].key) {
+        spr_heap_sift_up(h, i, entry, 1);
+    }
+    else {
+        spr_heap_sift_down(h, i, entry, 1);
+    }
+
+    return SPR_OK;
+}
+
+void
+spr_iheap_remove(spr_iheap_t *heap, spr_heap_node_t *node)
+{
+    size_t i;
+
+    if (!spr_heap_node_queued(node)) {
+        return;
+    }
+
+    i = node->index - 1;
+
+    spr_heap_node_init(node);
+    spr_heap_delete(&heap->heap, i, 1);
+}
+
+spr_heap_node_t *
+spr_iheap_pop(spr_iheap_t *heap)
+{
+    spr_heap_node_t *node;
+
+    if (heap->heap.size == 0) {
+        return NULL;
+    }
+
+    node = heap->heap.entries[0].value;
+
+    spr_heap_node_init(node);
+    spr_heap_delete(&heap->heap, 0, 1);
+
+    return node;
+}
+
+void
+spr_iheap_clear(spr_iheap_t *heap)
+{
+    size_t i;
+
+    for (i = 0; i < heap->heap.size; ++i) {
+        spr_heap_node_init((spr_heap_node_t *) heap->heap.entries[i].value);
+    }
+
+    heap->heap.size = 0;
+}
@@ -0,0 +1,433 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "spr_portable.h"
+#include "spr_intern.h"
+#include "spr_atomic.h"
+#include "spr_errno.h"
+#include "spr_hash.h"
+
+#define SPR_INTERN_MIN_SLOTS         64
+#define SPR_INTERN_COUNTERS          16
+
+#define spr_intern_str_of(str) \
+    ((spr_intern_str_t *) ((char *) (str) \
+                           - offsetof(spr_intern_str_t, data)))
+
+struct spr_intern_table_s {
+    size_t mask;
+    spr_intern_str_t *slots[];
+};
+
+/* One cache line each */
+struct spr_intern_counter_s {
+    uint64_t hits;
+    uint64_t bytes_saved;
+    uint8_t pad[SPR_CACHELINE_SIZE - 2 * sizeof(uint64_t)];
+};
+
+
+static spr_intern_table_t *
+spr_intern_table_create(spr_pool_t *pool, size_t nslots)
+{
+    spr_intern_table_t *table;
+    size_t size;
+
+    size = sizeof(spr_intern_table_t) + nslots * sizeof(spr_intern_str_t *);
+
+    table = spr_pmemalign(pool, size, SPR_CACHELINE_SIZE);
+    if (!table) {
+        return NULL;
+    }
+
+    spr_memzero(table, size);
+    table->mask = nslots - 1;
+
+    return table;
+}
+
+static void
+spr_intern_cleanup(spr_intern_t *intern)
+{
+    spr_mutex_fini(&intern->lock);
+}
+
+spr_err_t
+spr_intern_create1(spr_intern_t **out_intern, spr_pool_t *pool, size_t n)
+{
+    spr_intern_t *intern;
+    size_t nslots;
+    spr_err_t err;
+
+    /* Load factor stays below 75% */
+    for (nslots = SPR_INTERN_MIN_SLOTS; nslots / 4 * 3 < n; nslots <<= 1) {
+        /* void */
+    }
+
+    intern = spr_pmemalign(pool, sizeof(spr_intern_t), SPR_CACHELINE_SIZE);
+    if (!intern) {
+        return spr_get_errno();
+    }
+
+    spr_memzero(intern, sizeof(spr_intern_t));
+
+    intern->table = spr_intern_table_create(pool, nslots);
+    if (!intern->table) {
+        return spr_get_errno();
+    }
+
+    intern->counters = spr_pmemalign(pool,
+                           SPR_INTERN_COUNTERS * sizeof(spr_intern_counter_t),
+                           SPR_CACHELINE_SIZE);
+    if (!intern->counters) {
+        return spr_get_errno();
+    }
+
+    spr_memzero(intern->counters,
+                SPR_INTERN_COUNTERS * sizeof(spr_intern_counter_t));
+
+    err = spr_mutex_init(&intern->lock, SPR_MUTEX_PRIVATE);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    spr_pool_cleanup_add(pool, intern, spr_intern_cleanup);
+
+    intern->pool = pool;
+    intern->seed = (uint64_t) (uintptr_t) intern;
+
+    *out_intern = intern;
+
+    return SPR_OK;
+}
+
+spr_intern_t *
+spr_intern_create(spr_pool_t *pool, size_t n)
+{
+    spr_intern_t *intern;
+
+    intern = NULL;
+
+    if (spr_intern_create1(&intern, pool, n) != SPR_OK) {
+        return NULL;
+    }
+
+    return intern;
+}
+
+static spr_intern_str_t *
+spr_intern_find(spr_intern_table_t *table, const char *str, size_t len,
+    uint64_t hash)
+{
+    spr_intern_str_t *entry;
+    size_t i;
+
+    for (i = hash & table->mask; ; i = (i + 1) & table->mask) {
+        entry = spr_atomic_load(&table->slots[i]);
+
+        if (entry == NULL) {
+            return NULL;
+        }
+
+        if (entry->hash == hash && entry->len == len
+            && spr_memcmp(entry->data, str, len) == 0)
+        {
+            return entry;
+        }
+    }
+}
+
+static void
+spr_intern_table_put(spr_intern_table_t *table, spr_intern_str_t *entry)
+{
+    size_t i;
+
+    for (i = entry->hash & table->mask;
+         table->slots[i] != NULL;
+         i = (i + 1) & table->mask)
+    {
+        /* void */
+    }
+
+    spr_atomic_store(&table->slots[i], entry);
+}
+
+/* Chunk c starts at id SPR_INTERN_CHUNK_SIZE * (2^c - 1) */
+static spr_intern_str_t **
+spr_intern_slot(spr_intern_t *intern, uint32_t id, bool create)
+{
+    spr_intern_str_t **chunk;
+    spr_uint_t c;
+    size_t base;
+
+    c = 63 - __builtin_clzll((uint64_t) id / SPR_INTERN_CHUNK_SIZE + 1);
+    base = SPR_INTERN_CHUNK_SIZE * (((size_t) 1 << c) - 1);
+
+    chunk = spr_atomic_load_relaxed(&intern->chunks[c]);
+
+    if (chunk == NULL && create) {
+        chunk = spr_palloc(intern->pool, (SPR_INTERN_CHUNK_SIZE << c)
+                                         * sizeof(spr_intern_str_t *));
+        if (chunk == NULL) {
+            return NULL;
+        }
+
+        spr_atomic_store_relaxed(&intern->chunks[c], chunk);
+    }
+
+    return chunk + (id - base);
+}
+
+/*
+ * Called with the lock held. Old tables are left in the pool, readers
+ * may still be probing them; doubling keeps the waste below the size
+ * of the current table.
+ */
+static spr_err_t
+spr_intern_grow(spr_intern_t *intern)
+{
+    spr_intern_table_t *table, *old;
+    size_t i;
+
+    old = intern->table;
+
+    table = spr_intern_table_create(intern->pool, (old->mask + 1) * 2);
+    if (!table) {
+        return spr_get_errno();
+    }
+
+    for (i = 0; i <= old->mask; i++) {
+        if (old->slots[i]) {
+            spr_intern_table_put(table, old->slots[i]);
+        }
+    }
+
+    spr_atomic_store(&intern->table, table);
+
+    return SPR_OK;
+}
+
+static spr_intern_str_t *
+spr_intern_insert(spr_intern_t *intern, const char *str, size_t len,
+    uint64_t hash)
+{
+    spr_intern_str_t *entry, **slot;
+    spr_intern_table_t *table;
+    uint32_t id;
+
+    table = intern->table;
+
+    /* Someone may have added it since the lock-free probe */
+    entry = spr_intern_find(table, str, len, hash);
+    if (entry) {
+        return entry;
+    }
+
+    id = intern->count;
+
+    if (id == UINT32_MAX || len > UINT32_MAX) {
+        return NULL;
+    }
+
+    if ((size_t) id + 1 > (table->mask + 1) / 4 * 3) {
+        if (spr_intern_grow(intern) != SPR_OK) {
+            return NULL;
+        }
+
+        table = intern->table;
+    }
+
+    slot = spr_intern_slot(intern, id, true);
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    entry = spr_palloc(intern->pool, sizeof(spr_intern_str_t) + len + 1);
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    entry->hash = hash;
+    entry->id = id;
+    entry->len = (uint32_t) len;
+    spr_memcpy(entry->data, str, len);
+    entry->data[len] = '\0';
+
+    *slot = entry;
+
+    /* Release stores publish the entry only after it is complete */
+    spr_intern_table_put(table, entry);
+    spr_atomic_store(&intern->count, id + 1);
+
+    intern->bytes_stored += len + 1;
+
+    return entry;
+}
+
+/*
+ * The counter is picked by the address of the caller's stack. Threads
+ * run on different stacks, so they mostly count on different lines.
+ */
+static void
+spr_intern_count_hit(spr_intern_t *intern, size_t len)
+{
+    spr_intern_counter_t *counter;
+    uint64_t h;
+
+    h = (uint64_t) ((uintptr_t) &counter >> 16) * 0x9e3779b97f4a7c15ULL;
+    counter = &intern->counters[h >> 60 & (SPR_INTERN_COUNTERS - 1)];
+
+    spr_atomic_fetch_add_relaxed(&counter->hits, 1);
+    spr_atomic_fetch_add_relaxed(&counter->bytes_saved, len + 1);
+}
+
+const char *
+spr_intern(spr_intern_t *intern, const char *str, size_t len, uint32_t *id)
+{
+    spr_intern_str_t *entry;
+    uint64_t hash;
+    uint32_t count;
+    bool added;
+
+    hash = spr_hash64(str, len, intern->seed);
+
+    entry = spr_intern_find(spr_atomic_load(&intern->table), str, len, hash);
+
+    if (entry) {
+        spr_intern_count_hit(intern, len);
+
+    } else {
+        if (spr_mutex_lock(&intern->lock) != SPR_OK) {
+            return NULL;
+        }
+
+        count = intern->count;
+
+        entry = spr_intern_insert(intern, str, len, hash);
+
+        added = (intern->count != count);
+        if (added) {
+            intern->misses++;
+        }
+
+        spr_mutex_unlock(&intern->lock);
+
+        if (entry == NULL) {
+            return NULL;
+        }
+
+        /* Another thread added it since the lock-free probe */
+        if (!added) {
+            spr_intern_count_hit(intern, len);
+        }
+    }
+
+    if (id) {
+        *id = entry->id;
+    }
+
+    return entry->data;
+}
+
+const char *
+spr_intern_lookup(spr_intern_t *intern, const char *str, size_t len,
+    uint32_t *id)
+{
+    spr_intern_str_t *entry;
+
+    entry = spr_intern_find(spr_atomic_load(&intern->table), str, len,
+                            spr_hash64(str, len, intern->seed));
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    if (id) {
+        *id = entry->id;
+    }
+
+    return entry->data;
+}
+
+const char *
+spr_intern_get(spr_intern_t *intern, uint32_t id, size_t *len)
+{
+    spr_intern_str_t *entry;
+
+    if (id >= spr_atomic_load(&intern->count)) {
+        return NULL;
+    }
+
+    entry = *spr_intern_slot(intern, id, false);
+
+    if (len) {
+        *len = entry->len;
+    }
+
+    return entry->data;
+}
+
+uint32_t
+spr_intern_id(const char *str)
+{
+    return spr_intern_str_of(str)->id;
+}
+
+size_t
+spr_intern_length(const char *str)
+{
+    return spr_intern_str_of(str)->len;
+}
+
+size_t
+spr_intern_count(spr_intern_t *intern)
+{
+    return spr_atomic_load(&intern->count);
+}
+
+void
+spr_intern_stats(spr_intern_t *intern, spr_intern_stats_t *stats)
+{
+    spr_uint_t i;
+
+    stats->hits = 0;
+    stats->bytes_saved = 0;
+
+    for (i = 0; i < SPR_INTERN_COUNTERS; i++) {
+        stats->hits += spr_atomic_load_relaxed(&intern->counters[i].hits);
+        stats->bytes_saved +=
+            spr_atomic_load_relaxed(&intern->counters[i].bytes_saved);
+    }
+
+    spr_mutex_lock(&intern->lock);
+
+    stats->lookups = stats->hits + intern->misses;
+    stats->count = intern->count;
+    stats->bytes_stored = intern->bytes_stored;
+
+    spr_mutex_unlock(&intern->lock);
+}
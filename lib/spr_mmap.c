@@ -0,0 +1,465 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "spr_portable.h"
+#include "spr_errno.h"
+#include "spr_memory.h"
+#include "spr_pool.h"
+#include "spr_filesys.h"
+#include "spr_mmap.h"
+
+
+#if (SPR_POSIX && SPR_HAVE_MMAP)
+
+static spr_err_t
+spr_mmap_map(spr_mmap_t *mmap_, spr_off_t offset, size_t size)
+{
+    size_t delta;
+    int prot, flags;
+    void *addr;
+
+    delta = (size_t) offset % spr_get_page_size();
+
+    prot = PROT_READ;
+    if (mmap_->flags & SPR_MMAP_WRITE) {
+        prot |= PROT_WRITE;
+    }
+
+    flags = (mmap_->flags & SPR_MMAP_PRIVATE) ? MAP_PRIVATE : MAP_SHARED;
+
+    addr = NULL;
+
+    /* Nothing to map for an empty window */
+    if (size != 0) {
+        addr = mmap(NULL, size + delta, prot, flags, mmap_->file->fd,
+                    offset - delta);
+        if (addr == MAP_FAILED) {
+            return spr_get_errno();
+        }
+    }
+
+    mmap_->base = addr;
+    mmap_->map_size = (addr != NULL) ? size + delta : 0;
+    mmap_->data = (addr != NULL) ? (uint8_t *) addr + delta : NULL;
+    mmap_->size = size;
+    mmap_->offset = offset;
+
+    return SPR_OK;
+}
+
+static void
+spr_mmap_unmap(spr_mmap_t *mmap_)
+{
+    if (mmap_->base) {
+        munmap(mmap_->base, mmap_->map_size);
+        mmap_->base = NULL;
+    }
+}
+
+#elif (SPR_WIN32)
+
+static spr_err_t
+spr_mmap_map(spr_mmap_t *mmap_, spr_off_t offset, size_t size)
+{
+    SYSTEM_INFO si;
+    DWORD protect, access;
+    HANDLE mapping;
+    uint64_t start;
+    size_t delta;
+    spr_err_t err;
+    void *addr;
+
+    GetSystemInfo(&si);
+
+    /* Views start at the allocation granularity, not the page size */
+    delta = (size_t) offset % si.dwAllocationGranularity;
+    start = (uint64_t) offset - delta;
+
+    if (mmap_->flags & SPR_MMAP_PRIVATE) {
+        protect = PAGE_WRITECOPY;
+        access = FILE_MAP_COPY;
+
+    } else if (mmap_->flags & SPR_MMAP_WRITE) {
+        protect = PAGE_READWRITE;
+        access = FILE_MAP_WRITE;
+
+    } else {
+        protect = PAGE_READONLY;
+        access = FILE_MAP_READ;
+    }
+
+    addr = NULL;
+    mapping = NULL;
+
+    if (size != 0) {
+        /* A maximum size of 0 keeps the file at its current size */
+        mapping = CreateFileMappingW(mmap_->file->fd, NULL, protect, 0, 0,
+                                     NULL);
+        if (!mapping) {
+            return spr_get_errno();
+        }
+
+        addr = MapViewOfFile(mapping, access, (DWORD) (start >> 32),
+                             (DWORD) start, size + delta);
+        if (!addr) {
+            err = spr_get_errno();
+            CloseHandle(mapping);
+            return err;
+        }
+    }
+
+    mmap_->base = addr;
+    mmap_->mapping = mapping;
+    mmap_->map_size = (addr != NULL) ? size + delta : 0;
+    mmap_->data = (addr != NULL) ? (uint8_t *) addr + delta : NULL;
+    mmap_->size = size;
+    mmap_->offset = offset;
+
+    return SPR_OK;
+}
+
+static void
+spr_mmap_unmap(spr_mmap_t *mmap_)
+{
+    if (mmap_->base) {
+        UnmapViewOfFile(mmap_->base);
+        CloseHandle(mmap_->mapping);
+        mmap_->base = NULL;
+        mmap_->mapping = NULL;
+    }
+}
+
+#else
+
+static spr_err_t
+spr_mmap_map(spr_mmap_t *mmap_, spr_off_t offset, size_t size)
+{
+    (void) mmap_;
+    (void) offset;
+    (void) size;
+    return SPR_FAILED;
+}
+
+static void
+spr_mmap_unmap(spr_mmap_t *mmap_)
+{
+    (void) mmap_;
+}
+
+#endif
+
+/* Turns a size of 0 into the rest of the file */
+static spr_err_t
+spr_mmap_window(spr_mmap_t *mmap_, spr_off_t offset, size_t *size)
+{
+    ssize_t end;
+
+    if (offset < 0) {
+        return SPR_FAILED;
+    }
+
+    if (*size == 0) {
+        end = spr_file_size(mmap_->file);
+        if (end == -1) {
+            return spr_get_errno();
+        }
+
+        if (end < offset) {
+            return SPR_FAILED;
+        }
+
+        *size = end - offset;
+    }
+
+    return SPR_OK;
+}
+
+/* Page aligned part of the window, for msync() and madvise() */
+static spr_err_t
+spr_mmap_range(spr_mmap_t *mmap_, size_t offset, size_t size,
+    uint8_t **addr, size_t *len)
+{
+    uint8_t *start;
+    size_t delta;
+
+    if (offset > mmap_->size) {
+        return SPR_FAILED;
+    }
+
+    if (size == 0 || size > mmap_->size - offset) {
+        size = mmap_->size - offset;
+    }
+
+    start = mmap_->data + offset;
+    delta = (uintptr_t) start % spr_get_page_size();
+
+    *addr = start - delta;
+    *len = (size != 0) ? size + delta : 0;
+
+    return SPR_OK;
+}
+
+static void
+spr_mmap_cleanup(spr_mmap_t *mmap_)
+{
+    spr_mmap_unmap(mmap_);
+}
+
+spr_err_t
+spr_mmap_create1(spr_mmap_t **out_mmap, spr_pool_t *pool, spr_file_t *file,
+    spr_off_t offset, size_t size, spr_uint_t flags)
+{
+    spr_mmap_t *mmap_;
+    spr_err_t err;
+
+    mmap_ = spr_pcalloc(pool, sizeof(spr_mmap_t));
+    if (!mmap_) {
+        return spr_get_errno();
+    }
+
+    mmap_->file = file;
+    mmap_->flags = flags;
+
+    err = spr_mmap_window(mmap_, offset, &size);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    err = spr_mmap_map(mmap_, offset, size);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    spr_pool_cleanup_add(pool, mmap_, spr_mmap_cleanup);
+
+    *out_mmap = mmap_;
+
+    return SPR_OK;
+}
+
+spr_mmap_t *
+spr_mmap_create(spr_pool_t *pool, spr_file_t *file, spr_off_t offset,
+    size_t size, spr_uint_t flags)
+{
+    spr_mmap_t *mmap_;
+
+    mmap_ = NULL;
+
+    if (spr_mmap_create1(&mmap_, pool, file, offset, size, flags)
+        != SPR_OK)
+    {
+        return NULL;
+    }
+
+    return mmap_;
+}
+
+/*
+ * Moves or resizes the window, data may change. The old window stays
+ * mapped if the new one cannot be set up.
+ */
+spr_err_t
+spr_mmap_remap(spr_mmap_t *mmap_, spr_off_t offset, size_t size)
+{
+    spr_mmap_t old;
+    spr_err_t err;
+#if (SPR_LINUX && SPR_HAVE_MMAP)
+    size_t delta;
+    void *addr;
+#endif
+
+    err = spr_mmap_window(mmap_, offset, &size);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+#if (SPR_LINUX && SPR_HAVE_MMAP)
+
+    /*
+     * Same start, the kernel can resize without tearing down the map.
+     * mremap() refuses ranges that madvise() has split into several
+     * areas, those take the slow path below.
+     */
+    if (mmap_->base && size != 0 && offset == mmap_->offset) {
+        delta = mmap_->data - (uint8_t *) mmap_->base;
+
+        addr = mremap(mmap_->base, mmap_->map_size, size + delta,
+                      MREMAP_MAYMOVE);
+        if (addr != MAP_FAILED) {
+            mmap_->base = addr;
+            mmap_->map_size = size + delta;
+            mmap_->data = (uint8_t *) addr + delta;
+            mmap_->size = size;
+
+            return SPR_OK;
+        }
+    }
+
+#endif
+
+    old = *mmap_;
+
+    err = spr_mmap_map(mmap_, offset, size);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    spr_mmap_unmap(&old);
+
+    return SPR_OK;
+}
+
+spr_err_t
+spr_mmap_advise(spr_mmap_t *mmap_, size_t offset, size_t size,
+    spr_uint_t advice)
+{
+    uint8_t *addr;
+    spr_err_t err;
+    size_t len;
+#if (SPR_POSIX && SPR_HAVE_MMAP)
+    int flag;
+#elif (SPR_WIN32 && _WIN32_WINNT >= 0x0602)
+    WIN32_MEMORY_RANGE_ENTRY range;
+#endif
+
+    err = spr_mmap_range(mmap_, offset, size, &addr, &len);
+    if (err != SPR_OK || len == 0) {
+        return err;
+    }
+
+#if (SPR_POSIX && SPR_HAVE_MMAP)
+
+    switch (advice) {
+    case SPR_MMAP_NORMAL:
+        flag = MADV_NORMAL;
+        break;
+    case SPR_MMAP_SEQUENTIAL:
+        flag = MADV_SEQUENTIAL;
+        break;
+    case SPR_MMAP_RANDOM:
+        flag = MADV_RANDOM;
+        break;
+    case SPR_MMAP_WILLNEED:
+        flag = MADV_WILLNEED;
+        break;
+    case SPR_MMAP_DONTNEED:
+        flag = MADV_DONTNEED;
+        break;
+#if defined(MADV_HUGEPAGE)
+    case SPR_MMAP_HUGEPAGE:
+        flag = MADV_HUGEPAGE;
+        break;
+#endif
+    default:
+        return SPR_DECLINED;
+    }
+
+    if (madvise(addr, len, flag) != 0) {
+        return spr_get_errno();
+    }
+
+    return SPR_OK;
+
+#elif (SPR_WIN32)
+
+    /* Only prefetching has a counterpart */
+    switch (advice) {
+    case SPR_MMAP_NORMAL:
+        return SPR_OK;
+#if (_WIN32_WINNT >= 0x0602)
+    case SPR_MMAP_WILLNEED:
+        range.VirtualAddress = addr;
+        range.NumberOfBytes = len;
+
+        if (!PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0)) {
+            return spr_get_errno();
+        }
+
+        return SPR_OK;
+#endif
+    default:
+        return SPR_DECLINED;
+    }
+
+#else
+
+    (void) advice;
+    return SPR_FAILED;
+
+#endif
+}
+
+spr_err_t
+spr_mmap_sync(spr_mmap_t *mmap_, size_t offset, size_t size, bool async)
+{
+    uint8_t *addr;
+    spr_err_t err;
+    size_t len;
+
+    err = spr_mmap_range(mmap_, offset, size, &addr, &len);
+    if (err != SPR_OK || len == 0) {
+        return err;
+    }
+
+#if (SPR_POSIX && SPR_HAVE_MMAP)
+
+    if (msync(addr, len, async ? MS_ASYNC : MS_SYNC) != 0) {
+        return spr_get_errno();
+    }
+
+    return SPR_OK;
+
+#elif (SPR_WIN32)
+
+    /* FlushViewOfFile() only starts the write back */
+    if (!FlushViewOfFile(addr, len)) {
+        return spr_get_errno();
+    }
+
+    if (!async && !FlushFileBuffers(mmap_->file->fd)) {
+        return spr_get_errno();
+    }
+
+    return SPR_OK;
+
+#else
+
+    (void) async;
+    return SPR_FAILED;
+
+#endif
+}
+
+void
+spr_mmap_close(spr_mmap_t *mmap_)
+{
+    spr_mmap_unmap(mmap_);
+
+    mmap_->data = NULL;
+    mmap_->size = 0;
+}
@@ -0,0 +1,1197 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "spr_portable.h"
+#include "spr_radix.h"
+#include "spr_memory.h"
+#include "spr_errno.h"
+
+/* SSE2 is part of x86-64, the Node16 search needs no runtime check */
+#if (SPR_HAVE_SSE2) && (defined(__x86_64__) || defined(_M_X64))
+#define SPR_RADIX_SSE2               1
+#include <emmintrin.h>
+#endif
+
+#define SPR_RADIX_NODE4              0
+#define SPR_RADIX_NODE16             1
+#define SPR_RADIX_NODE48             2
+#define SPR_RADIX_NODE256            3
+
+#define SPR_RADIX_MAX_PREFIX         10
+
+/*
+ * Children pointers with the lowest bit set are leaves. Prefixes longer
+ * than SPR_RADIX_MAX_PREFIX are checked optimistically while searching
+ * and against the minimum leaf while inserting.
+ */
+#define spr_radix_is_leaf(p)         (((uintptr_t) (p)) & 1)
+#define spr_radix_leaf(p) \
+    ((spr_radix_leaf_t *) (((uintptr_t) (p)) & ~((uintptr_t) 1)))
+#define spr_radix_leaf_tag(l) \
+    ((spr_radix_node_t *) (((uintptr_t) (l)) | 1))
+
+#define spr_radix_min(a, b)          ((a) < (b) ? (a) : (b))
+
+
+typedef struct spr_radix_leaf_s spr_radix_leaf_t;
+
+struct spr_radix_leaf_s {
+    void *value;
+    size_t len;
+    uint8_t key[1];
+};
+
+struct spr_radix_node_s {
+    uint8_t type;
+    uint16_t nchildren;
+    uint32_t prefix_len;
+    uint8_t prefix[SPR_RADIX_MAX_PREFIX];
+    /* Key which ends at this node */
+    spr_radix_leaf_t *leaf;
+};
+
+typedef struct {
+    spr_radix_node_t n;
+    uint8_t keys[4];
+    spr_radix_node_t *children[4];
+} spr_radix_node4_t;
+
+typedef struct {
+    spr_radix_node_t n;
+    uint8_t keys[16];
+    spr_radix_node_t *children[16];
+} spr_radix_node16_t;
+
+typedef struct {
+    spr_radix_node_t n;
+    uint8_t index[256];
+    spr_radix_node_t *children[48];
+} spr_radix_node48_t;
+
+typedef struct {
+    spr_radix_node_t n;
+    spr_radix_node_t *children[256];
+} spr_radix_node256_t;
+
+static const size_t spr_radix_node_sizes[] = {
+    sizeof(spr_radix_node4_t),
+    sizeof(spr_radix_node16_t),
+    sizeof(spr_radix_node48_t),
+    sizeof(spr_radix_node256_t)
+};
+
+
+
+spr_err_t
+spr_radix_create1(spr_radix_t **out_tree, spr_pool_t *pool)
+{
+    spr_radix_t *tree;
+
+    tree = spr_pcalloc(pool, sizeof(spr_radix_t));
+    if (!tree) {
+        return spr_get_errno();
+    }
+
+    /*
+     * Next fields set by spr_pcalloc()
+     *
+     * tree->root = NULL;
+     * tree->free_nodes = { NULL };
+     * tree->size = 0;
+     *
+     */
+
+    tree->pool = pool;
+
+    *out_tree = tree;
+
+    return SPR_OK;
+}
+
+spr_radix_t *
+spr_radix_create(spr_pool_t *pool)
+{
+    spr_radix_t *tree;
+
+    tree = NULL;
+
+    if (spr_radix_create1(&tree, pool) != SPR_OK) {
+        return NULL;
+    }
+
+    return tree;
+}
+
+static spr_radix_node_t *
+spr_radix_node_alloc(spr_radix_t *tree, uint8_t type)
+{
+    spr_radix_node_t *node;
+
+    node = tree->free_nodes[type];
+
+    if (node) {
+        tree->free_nodes[type] = (spr_radix_node_t *) node->leaf;
+    }
+    else {
+        node = spr_palloc(tree->pool, spr_radix_node_sizes[type]);
+        if (!node) {
+            return NULL;
+        }
+    }
+
+    spr_memzero(node, spr_radix_node_sizes[type]);
+    node->type = type;
+
+    return node;
+}
+
+static void
+spr_radix_node_free(spr_radix_t *tree, spr_radix_node_t *node)
+{
+    /* Free nodes are chained through the leaf field */
+    node->leaf = (spr_radix_leaf_t *) tree->free_nodes[node->type];
+    tree->free_nodes[node->type] = node;
+}
+
+/* Removed leaves stay in the pool until it is cleared */
+static spr_radix_leaf_t *
+spr_radix_leaf_alloc(spr_radix_t *tree, const uint8_t *key, size_t len,
+    void *value)
+{
+    spr_radix_leaf_t *leaf;
+
+    leaf = spr_palloc(tree->pool, offsetof(spr_radix_leaf_t, key) + len);
+    if (!leaf) {
+        return NULL;
+    }
+
+    leaf->value = value;
+    leaf->len = len;
+    spr_memcpy(leaf->key, key, len);
+
+    return leaf;
+}
+
+static bool
+spr_radix_leaf_matches(spr_radix_leaf_t *leaf, const uint8_t *key,
+    size_t len)
+{
+    return leaf->len == len && spr_memcmp(leaf->key, key, len) == 0;
+}
+
+static bool
+spr_radix_leaf_is_prefix(spr_radix_leaf_t *leaf, const uint8_t *key,
+    size_t len)
+{
+    return leaf->len <= len && spr_memcmp(leaf->key, key, leaf->len) == 0;
+}
+
+/* Index of the key in a Node16, -1 if it is not there */
+static spr_int_t
+spr_radix_find16(const uint8_t *keys, spr_uint_t n, uint8_t c)
+{
+#if (SPR_RADIX_SSE2)
+
+    spr_uint_t mask;
+
+    mask = (spr_uint_t) _mm_movemask_epi8(
+               _mm_cmpeq_epi8(_mm_set1_epi8((char) c),
+                              _mm_loadu_si128((const __m128i *) keys)));
+    mask &= (1U << n) - 1;
+
+    if (mask) {
+        return (spr_int_t) __builtin_ctz(mask);
+    }
+
+    return -1;
+
+#else
+
+    spr_uint_t i;
+
+    for (i = 0; i < n; ++i) {
+        if (keys[i] == c) {
+            return (spr_int_t) i;
+        }
+    }
+
+    return -1;
+
+#endif
+}
+
+static spr_radix_node_t **
+spr_radix_find_child(spr_radix_node_t *node, uint8_t c)
+{
+    spr_radix_node4_t *n4;
+    spr_radix_node16_t *n16;
+    spr_radix_node48_t *n48;
+    spr_radix_node256_t *n256;
+    spr_uint_t i;
+    spr_int_t k;
+
+    switch (node->type) {
+
+    case SPR_RADIX_NODE4:
+        n4 = (spr_radix_node4_t *) node;
+        for (i = 0; i < node->nchildren; ++i) {
+            if (n4->keys[i] == c) {
+                return &n4->children[i];
+            }
+        }
+        return NULL;
+
+    case SPR_RADIX_NODE16:
+        n16 = (spr_radix_node16_t *) node;
+
+        k = spr_radix_find16(n16->keys, node->nchildren, c);
+        if (k >= 0) {
+            return &n16->children[k];
+        }
+        return NULL;
+
+    case SPR_RADIX_NODE48:
+        n48 = (spr_radix_node48_t *) node;
+        i = n48->index[c];
+        if (i) {
+            return &n48->children[i - 1];
+        }
+        return NULL;
+
+    default:
+        n256 = (spr_radix_node256_t *) node;
+        if (n256->children[c]) {
+            return &n256->children[c];
+        }
+        return NULL;
+    }
+}
+
+static spr_radix_leaf_t *
+spr_radix_min_leaf(spr_radix_node_t *node)
+{
+    spr_radix_node48_t *n48;
+    spr_radix_node256_t *n256;
+    spr_uint_t i;
+
+    while (!spr_radix_is_leaf(node)) {
+
+        if (node->leaf) {
+            return node->leaf;
+        }
+
+        switch (node->type) {
+
+        case SPR_RADIX_NODE4:
+            node = ((spr_radix_node4_t *) node)->children[0];
+            break;
+
+        case SPR_RADIX_NODE16:
+            node = ((spr_radix_node16_t *) node)->children[0];
+            break;
+
+        case SPR_RADIX_NODE48:
+            n48 = (spr_radix_node48_t *) node;
+            for (i = 0; !n48->index[i]; ++i) {
+                /* void */
+            }
+            node = n48->children[n48->index[i] - 1];
+            break;
+
+        default:
+            n256 = (spr_radix_node256_t *) node;
+            for (i = 0; !n256->children[i]; ++i) {
+                /* void */
+            }
+            node = n256->children[i];
+            break;
+        }
+    }
+
+    return spr_radix_leaf(node);
+}
+
+/* Returns the number of prefix bytes matching the key */
+static size_t
+spr_radix_prefix_mismatch(spr_radix_node_t *node, const uint8_t *key,
+    size_t len, size_t depth)
+{
+    spr_radix_leaf_t *leaf;
+    size_t limit, stored, i;
+
+    limit = spr_radix_min(node->prefix_len, len - depth);
+    stored = spr_radix_min(limit, SPR_RADIX_MAX_PREFIX);
+
+    for (i = 0; i < stored; ++i) {
+        if (node->prefix[i] != key[depth + i]) {
+            return i;
+        }
+    }
+
+    if (limit > SPR_RADIX_MAX_PREFIX) {
+        leaf = spr_radix_min_leaf(node);
+
+        for ( ; i < limit; ++i) {
+            if (leaf->key[depth + i] != key[depth + i]) {
+                return i;
+            }
+        }
+    }
+
+    return limit;
+}
+
+/* Optimistic check, the leaf comparison confirms the match */
+static bool
+spr_radix_check_prefix(spr_radix_node_t *node, const uint8_t *key,
+    size_t len, size_t depth)
+{
+    size_t n;
+
+    if (len - depth < node->prefix_len) {
+        return 0;
+    }
+
+    n = spr_radix_min(node->prefix_len, SPR_RADIX_MAX_PREFIX);
+
+    return spr_memcmp(node->prefix, key + depth, n) == 0;
+}
+
+static void
+spr_radix_copy_header(spr_radix_node_t *dst, spr_radix_node_t *src)
+{
+    dst->nchildren = src->nchildren;
+    dst->prefix_len = src->prefix_len;
+    dst->leaf = src->leaf;
+    spr_memcpy(dst->prefix, src->prefix,
+               spr_radix_min(src->prefix_len, SPR_RADIX_MAX_PREFIX));
+}
+
+static spr_err_t
+spr_radix_add_child(spr_radix_t *tree, spr_radix_node_t *node,
+    spr_radix_node_t **ref, uint8_t c, spr_radix_node_t *child)
+{
+    spr_radix_node4_t *n4;
+    spr_radix_node16_t *n16;
+    spr_radix_node48_t *n48;
+    spr_radix_node256_t *n256;
+    spr_radix_node_t *grown;
+    spr_uint_t i, n;
+
+    n = node->nchildren;
+
+    switch (node->type) {
+
+    case SPR_RADIX_NODE4:
+        n4 = (spr_radix_node4_t *) node;
+
+        if (n < 4) {
+            for (i = 0; i < n && n4->keys[i] < c; ++i) {
+                /* void */
+            }
+
+            spr_memmove(&n4->keys[i + 1], &n4->keys[i], n - i);
+            spr_memmove(&n4->children[i + 1], &n4->children[i],
+                        (n - i) * sizeof(spr_radix_node_t *));
+            n4->keys[i] = c;
+            n4->children[i] = child;
+            node->nchildren += 1;
+            return SPR_OK;
+        }
+
+        grown = spr_radix_node_alloc(tree, SPR_RADIX_NODE16);
+        if (!grown) {
+            return spr_get_errno();
+        }
+
+        n16 = (spr_radix_node16_t *) grown;
+        spr_radix_copy_header(grown, node);
+        spr_memcpy(n16->keys, n4->keys, n);
+        spr_memcpy(n16->children, n4->children,
+                   n * sizeof(spr_radix_node_t *));
+        break;
+
+    case SPR_RADIX_NODE16:
+        n16 = (spr_radix_node16_t *) node;
+
+        if (n < 16) {
+            for (i = 0; i < n && n16->keys[i] < c; ++i) {
+                /* void */
+            }
+
+            spr_memmove(&n16->keys[i + 1], &n16->keys[i], n - i);
+            spr_memmove(&n16->children[i + 1], &n16->children[i],
+                        (n - i) * sizeof(spr_radix_node_t *));
+            n16->keys[i] = c;
+            n16->children[i] = child;
+            node->nchildren += 1;
+            return SPR_OK;
+        }
+
+        grown = spr_radix_node_alloc(tree, SPR_RADIX_NODE48);
+        if (!grown) {
+            return spr_get_errno();
+        }
+
+        n48 = (spr_radix_node48_t *) grown;
+        spr_radix_copy_header(grown, node);
+
+        for (i = 0; i < n; ++i) {
+            n48->children[i] = n16->children[i];
+            n48->index[n16->keys[i]] = (uint8_t) (i + 1);
+        }
+        break;
+
+    case SPR_RADIX_NODE48:
+        n48 = (spr_radix_node48_t *) node;
+
+        if (n < 48) {
+            for (i = 0; n48->children[i]; ++i) {
+                /* void */
+            }
+
+            n48->children[i] = child;
+            n48->index[c] = (uint8_t) (i + 1);
+            node->nchildren += 1;
+            return SPR_OK;
+        }
+
+        grown = spr_radix_node_alloc(tree, SPR_RADIX_NODE256);
+        if (!grown) {
+            return spr_get_errno();
+        }
+
+        n256 = (spr_radix_node256_t *) grown;
+        spr_radix_copy_header(grown, node);
+
+        for (i = 0; i < 256; ++i) {
+            if (n48->index[i]) {
+                n256->children[i] = n48->children[n48->index[i] - 1];
+            }
+        }
+        break;
+
+    default:
+        n256 = (spr_radix_node256_t *) node;
+        n256->children[c] = child;
+        node->nchildren += 1;
+        return SPR_OK;
+    }
+
+    *ref = grown;
+    spr_radix_node_free(tree, node);
+
+    return spr_radix_add_child(tree, grown, ref, c, child);
+}
+
+/* Replaces node4 which has a single entry left with that entry */
+static void
+spr_radix_collapse(spr_radix_t *tree, spr_radix_node_t *node,
+    spr_radix_node_t **ref)
+{
+    spr_radix_node4_t *n4;
+    spr_radix_node_t *child;
+    size_t prefix, sub;
+
+    n4 = (spr_radix_node4_t *) node;
+
+    if (node->nchildren == 0) {
+        *ref = spr_radix_leaf_tag(node->leaf);
+        spr_radix_node_free(tree, node);
+        return;
+    }
+
+    child = n4->children[0];
+
+    if (!spr_radix_is_leaf(child)) {
+        prefix = node->prefix_len;
+
+        if (prefix < SPR_RADIX_MAX_PREFIX) {
+            node->prefix[prefix] = n4->keys[0];
+            prefix++;
+        }
+
+        if (prefix < SPR_RADIX_MAX_PREFIX) {
+            sub = spr_radix_min(child->prefix_len,
+                                SPR_RADIX_MAX_PREFIX - prefix);
+            spr_memcpy(node->prefix + prefix, child->prefix, sub);
+            prefix += sub;
+        }
+
+        spr_memcpy(child->prefix, node->prefix,
+                   spr_radix_min(prefix, SPR_RADIX_MAX_PREFIX));
+        child->prefix_len += node->prefix_len + 1;
+    }
+
+    *ref = child;
+    spr_radix_node_free(tree, node);
+}
+
+static spr_err_t
+spr_radix_shrink(spr_radix_t *tree, spr_radix_node_t *node,
+    spr_radix_node_t **ref)
+{
+    spr_radix_node4_t *n4;
+    spr_radix_node16_t *n16;
+    spr_radix_node48_t *n48;
+    spr_radix_node256_t *n256;
+    spr_radix_node_t *shrunk;
+    spr_uint_t i, n;
+
+    switch (node->type) {
+
+    case SPR_RADIX_NODE16:
+        shrunk = spr_radix_node_alloc(tree, SPR_RADIX_NODE4);
+        if (!shrunk) {
+            return spr_get_errno();
+        }
+
+        n16 = (spr_radix_node16_t *) node;
+        n4 = (spr_radix_node4_t *) shrunk;
+        spr_radix_copy_header(shrunk, node);
+        spr_memcpy(n4->keys, n16->keys, node->nchildren);
+        spr_memcpy(n4->children, n16->children,
+                   node->nchildren * sizeof(spr_radix_node_t *));
+        break;
+
+    case SPR_RADIX_NODE48:
+        shrunk = spr_radix_node_alloc(tree, SPR_RADIX_NODE16);
+        if (!shrunk) {
+            return spr_get_errno();
+        }
+
+        n48 = (spr_radix_node48_t *) node;
+        n16 = (spr_radix_node16_t *) shrunk;
+        spr_radix_copy_header(shrunk, node);
+
+        for (i = 0, n = 0; i < 256; ++i) {
+            if (n48->index[i]) {
+                n16->keys[n] = (uint8_t) i;
+                n16->children[n] = n48->children[n48->index[i] - 1];
+                n++;
+            }
+        }
+        break;
+
+    default:
+        shrunk = spr_radix_node_alloc(tree, SPR_RADIX_NODE48);
+        if (!shrunk) {
+            return spr_get_errno();
+        }
+
+        n256 = (spr_radix_node256_t *) node;
+        n48 = (spr_radix_node48_t *) shrunk;
+        spr_radix_copy_header(shrunk, node);
+
+        for (i = 0, n = 0; i < 256; ++i) {
+            if (n256->children[i]) {
+                n48->children[n] = n256->children[i];
+                n48->index[i] = (uint8_t) (n + 1);
+                n++;
+            }
+        }
+        break;
+    }
+
+    *ref = shrunk;
+    spr_radix_node_free(tree, node);
+
+    return SPR_OK;
+}
+
+static spr_err_t
+spr_radix_remove_child(spr_radix_t *tree, spr_radix_node_t *node,
+    spr_radix_node_t **ref, uint8_t c, spr_radix_node_t **slot)
+{
+    spr_radix_node4_t *n4;
+    spr_radix_node16_t *n16;
+    spr_radix_node48_t *n48;
+    spr_radix_node256_t *n256;
+    spr_uint_t i, n;
+
+    switch (node->type) {
+
+    case SPR_RADIX_NODE4:
+        n4 = (spr_radix_node4_t *) node;
+        i = slot - n4->children;
+        n = node->nchildren - i - 1;
+
+        spr_memmove(&n4->keys[i], &n4->keys[i + 1], n);
+        spr_memmove(&n4->children[i], &n4->children[i + 1],
+                    n * sizeof(spr_radix_node_t *));
+        node->nchildren -= 1;
+
+        if (node->nchildren + (node->leaf != NULL) == 1) {
+            spr_radix_collapse(tree, node, ref);
+        }
+        return SPR_OK;
+
+    case SPR_RADIX_NODE16:
+        n16 = (spr_radix_node16_t *) node;
+        i = slot - n16->children;
+        n = node->nchildren - i - 1;
+
+        spr_memmove(&n16->keys[i], &n16->keys[i + 1], n);
+        spr_memmove(&n16->children[i], &n16->children[i + 1],
+                    n * sizeof(spr_radix_node_t *));
+        node->nchildren -= 1;
+
+        if (node->nchildren == 3) {
+            return spr_radix_shrink(tree, node, ref);
+        }
+        return SPR_OK;
+
+    case SPR_RADIX_NODE48:
+        n48 = (spr_radix_node48_t *) node;
+        n48->children[n48->index[c] - 1] = NULL;
+        n48->index[c] = 0;
+        node->nchildren -= 1;
+
+        if (node->nchildren == 12) {
+            return spr_radix_shrink(tree, node, ref);
+        }
+        return SPR_OK;
+
+    default:
+        n256 = (spr_radix_node256_t *) node;
+        n256->children[c] = NULL;
+        node->nchildren -= 1;
+
+        if (node->nchildren == 37) {
+            return spr_radix_shrink(tree, node, ref);
+        }
+        return SPR_OK;
+    }
+}
+
+static void
+spr_radix_place_leaf(spr_radix_node4_t *n4, spr_radix_leaf_t *leaf,
+    size_t depth)
+{
+    spr_uint_t i;
+
+    if (leaf->len == depth) {
+        n4->n.leaf = leaf;
+        return;
+    }
+
+    i = n4->n.nchildren;
+
+    if (i && n4->keys[0] > leaf->key[depth]) {
+        n4->keys[1] = n4->keys[0];
+        n4->children[1] = n4->children[0];
+        i = 0;
+    }
+
+    n4->keys[i] = leaf->key[depth];
+    n4->children[i] = spr_radix_leaf_tag(leaf);
+    n4->n.nchildren += 1;
+}
+
+spr_err_t
+spr_radix_insert(spr_radix_t *tree, const void *key, size_t len,
+    void *value)
+{
+    spr_radix_node_t *node, *n4, **ref, **slot;
+    spr_radix_leaf_t *leaf, *newleaf;
+    const uint8_t *k;
+    size_t depth, limit, m;
+    spr_err_t err;
+
+    k = key;
+    ref = &tree->root;
+    depth = 0;
+
+    for ( ; ; ) {
+        node = *ref;
+
+        if (!node) {
+            newleaf = spr_radix_leaf_alloc(tree, k, len, value);
+            if (!newleaf) {
+                return spr_get_errno();
+            }
+
+            *ref = spr_radix_leaf_tag(newleaf);
+            break;
+        }
+
+        if (spr_radix_is_leaf(node)) {
+            leaf = spr_radix_leaf(node);
+
+            if (spr_radix_leaf_matches(leaf, k, len)) {
+                return SPR_DECLINED;
+            }
+
+            newleaf = spr_radix_leaf_alloc(tree, k, len, value);
+            if (!newleaf) {
+                return spr_get_errno();
+            }
+
+            n4 = spr_radix_node_alloc(tree, SPR_RADIX_NODE4);
+            if (!n4) {
+                return spr_get_errno();
+            }
+
+            limit = spr_radix_min(leaf->len, len);
+
+            for (m = depth; m < limit && leaf->key[m] == k[m]; ++m) {
+                /* void */
+            }
+
+            n4->prefix_len = m - depth;
+            spr_memcpy(n4->prefix, k + depth,
+                       spr_radix_min(n4->prefix_len, SPR_RADIX_MAX_PREFIX));
+
+            spr_radix_place_leaf((spr_radix_node4_t *) n4, leaf, m);
+            spr_radix_place_leaf((spr_radix_node4_t *) n4, newleaf, m);
+
+            *ref = n4;
+            break;
+        }
+
+        if (node->prefix_len) {
+            m = spr_radix_prefix_mismatch(node, k, len, depth);
+
+            if (m < node->prefix_len) {
+                newleaf = spr_radix_leaf_alloc(tree, k, len, value);
+                if (!newleaf) {
+                    return spr_get_errno();
+                }
+
+                n4 = spr_radix_node_alloc(tree, SPR_RADIX_NODE4);
+                if (!n4) {
+                    return spr_get_errno();
+                }
+
+                n4->prefix_len = m;
+                spr_memcpy(n4->prefix, node->prefix,
+                           spr_radix_min(m, SPR_RADIX_MAX_PREFIX));
+
+                if (node->prefix_len <= SPR_RADIX_MAX_PREFIX) {
+                    spr_radix_add_child(tree, n4, NULL, node->prefix[m],
+                                        node);
+                    node->prefix_len -= m + 1;
+                    spr_memmove(node->prefix, node->prefix + m + 1,
+                                spr_radix_min(node->prefix_len,
+                                              SPR_RADIX_MAX_PREFIX));
+                }
+                else {
+                    leaf = spr_radix_min_leaf(node);
+                    spr_radix_add_child(tree, n4, NULL,
+                                        leaf->key[depth + m], node);
+                    node->prefix_len -= m + 1;
+                    spr_memcpy(node->prefix, leaf->key + depth + m + 1,
+                               spr_radix_min(node->prefix_len,
+                                             SPR_RADIX_MAX_PREFIX));
+                }
+
+                if (depth + m == len) {
+                    n4->leaf = newleaf;
+                }
+                else {
+                    spr_radix_add_child(tree, n4, NULL, k[depth + m],
+                                        spr_radix_leaf_tag(newleaf));
+                }
+
+                *ref = n4;
+                break;
+            }
+
+            depth += node->prefix_len;
+        }
+
+        if (depth == len) {
+            if (node->leaf) {
+                return SPR_DECLINED;
+            }
+
+            newleaf = spr_radix_leaf_alloc(tree, k, len, value);
+            if (!newleaf) {
+                return spr_get_errno();
+            }
+
+            node->leaf = newleaf;
+            break;
+        }
+
+        slot = spr_radix_find_child(node, k[depth]);
+
+        if (slot) {
+            ref = slot;
+            depth++;
+            continue;
+        }
+
+        newleaf = spr_radix_leaf_alloc(tree, k, len, value);
+        if (!newleaf) {
+            return spr_get_errno();
+        }
+
+        err = spr_radix_add_child(tree, node, ref, k[depth],
+                                  spr_radix_leaf_tag(newleaf));
+        if (err != SPR_OK) {
+            return err;
+        }
+
+        break;
+    }
+
+    tree->size += 1;
+
+    return SPR_OK;
+}
+
+spr_err_t
+spr_radix_remove(spr_radix_t *tree, const void *key, size_t len,
+    void **value)
+{
+    spr_radix_node_t *node, **ref, **slot;
+    spr_radix_leaf_t *leaf;
+    const uint8_t *k;
+    size_t depth;
+    spr_err_t err;
+
+    k = key;
+    ref = &tree->root;
+    depth = 0;
+
+    node = *ref;
+    if (!node) {
+        return SPR_NOT_FOUND;
+    }
+
+    if (spr_radix_is_leaf(node)) {
+        leaf = spr_radix_leaf(node);
+
+        if (!spr_radix_leaf_matches(leaf, k, len)) {
+            return SPR_NOT_FOUND;
+        }
+
+        *ref = NULL;
+        goto found;
+    }
+
+    for ( ; ; ) {
+
+        if (node->prefix_len) {
+            if (!spr_radix_check_prefix(node, k, len, depth)) {
+                return SPR_NOT_FOUND;
+            }
+            depth += node->prefix_len;
+        }
+
+        if (depth == len) {
+            leaf = node->leaf;
+
+            if (!leaf || !spr_radix_leaf_matches(leaf, k, len)) {
+                return SPR_NOT_FOUND;
+            }
+
+            node->leaf = NULL;
+
+            if (node->type == SPR_RADIX_NODE4 && node->nchildren == 1) {
+                spr_radix_collapse(tree, node, ref);
+            }
+
+            goto found;
+        }
+
+        slot = spr_radix_find_child(node, k[depth]);
+        if (!slot) {
+            return SPR_NOT_FOUND;
+        }
+
+        if (spr_radix_is_leaf(*slot)) {
+            leaf = spr_radix_leaf(*slot);
+
+            if (!spr_radix_leaf_matches(leaf, k, len)) {
+                return SPR_NOT_FOUND;
+            }
+
+            err = spr_radix_remove_child(tree, node, ref, k[depth], slot);
+            if (err != SPR_OK) {
+                return err;
+            }
+
+            goto found;
+        }
+
+        ref = slot;
+        node = *ref;
+        depth++;
+    }
+
+found:
+
+    if (value) {
+        *value = leaf->value;
+    }
+
+    tree->size -= 1;
+
+    return SPR_OK;
+}
+
+void *
+spr_radix_find(spr_radix_t *tree, const void *key, size_t len)
+{
+    spr_radix_node_t *node, **slot;
+    spr_radix_leaf_t *leaf;
+    const uint8_t *k;
+    size_t depth;
+
+    k = key;
+    node = tree->root;
+    depth = 0;
+
+    while (node) {
+
+        if (spr_radix_is_leaf(node)) {
+            leaf = spr_radix_leaf(node);
+            return spr_radix_leaf_matches(leaf, k, len) ? leaf->value : NULL;
+        }
+
+        if (node->prefix_len) {
+            if (!spr_radix_check_prefix(node, k, len, depth)) {
+                return NULL;
+            }
+            depth += node->prefix_len;
+        }
+
+        if (depth == len) {
+            leaf = node->leaf;
+
+            if (leaf && spr_radix_leaf_matches(leaf, k, len)) {
+                return leaf->value;
+            }
+            return NULL;
+        }
+
+        slot = spr_radix_find_child(node, k[depth]);
+        if (!slot) {
+            return NULL;
+        }
+
+        node = *slot;
+        depth++;
+    }
+
+    return NULL;
+}
+
+void *
+spr_radix_longest_prefix(spr_radix_t *tree, const void *key, size_t len,
+    size_t *match_len)
+{
+    spr_radix_node_t *node, **slot;
+    spr_radix_leaf_t *leaf, *best;
+    const uint8_t *k;
+    size_t depth;
+
+    k = key;
+    node = tree->root;
+    depth = 0;
+    best = NULL;
+
+    while (node) {
+
+        if (spr_radix_is_leaf(node)) {
+            leaf = spr_radix_leaf(node);
+            if (spr_radix_leaf_is_prefix(leaf, k, len)) {
+                best = leaf;
+            }
+            break;
+        }
+
+        if (node->prefix_len) {
+            if (!spr_radix_check_prefix(node, k, len, depth)) {
+                break;
+            }
+            depth += node->prefix_len;
+        }
+
+        if (node->leaf && spr_radix_leaf_is_prefix(node->leaf, k, len)) {
+            best = node->leaf;
+        }
+
+        if (depth == len) {
+            break;
+        }
+
+        slot = spr_radix_find_child(node, k[depth]);
+        if (!slot) {
+            break;
+        }
+
+        node = *slot;
+        depth++;
+    }
+
+    if (!best) {
+        return NULL;
+    }
+
+    if (match_len) {
+        *match_len = best->len;
+    }
+
+    return best->value;
+}
+
+static int
+spr_radix_iter(spr_radix_node_t *node, spr_radix_callback_pt callback,
+    void *data)
+{
+    spr_radix_node4_t *n4;
+    spr_radix_node16_t *n16;
+    spr_radix_node48_t *n48;
+    spr_radix_node256_t *n256;
+    spr_radix_leaf_t *leaf;
+    spr_uint_t i;
+    int rv;
+
+    if (spr_radix_is_leaf(node)) {
+        leaf = spr_radix_leaf(node);
+        return callback(data, leaf->key, leaf->len, leaf->value);
+    }
+
+    /* Key which ends at the node goes before the longer ones */
+    if (node->leaf) {
+        leaf = node->leaf;
+        rv = callback(data, leaf->key, leaf->len, leaf->value);
+        if (rv) {
+            return rv;
+        }
+    }
+
+    switch (node->type) {
+
+    case SPR_RADIX_NODE4:
+        n4 = (spr_radix_node4_t *) node;
+        for (i = 0; i < node->nchildren; ++i) {
+            rv = spr_radix_iter(n4->children[i], callback, data);
+            if (rv) {
+                return rv;
+            }
+        }
+        break;
+
+    case SPR_RADIX_NODE16:
+        n16 = (spr_radix_node16_t *) node;
+        for (i = 0; i < node->nchildren; ++i) {
+            rv = spr_radix_iter(n16->children[i], callback, data);
+            if (rv) {
+                return rv;
+            }
+        }
+        break;
+
+    case SPR_RADIX_NODE48:
+        n48 = (spr_radix_node48_t *) node;
+        for (i = 0; i < 256; ++i) {
+            if (!n48->index[i]) {
+                continue;
+            }
+            rv = spr_radix_iter(n48->children[n48->index[i] - 1],
+                                callback, data);
+            if (rv) {
+                return rv;
+            }
+        }
+        break;
+
+    default:
+        n256 = (spr_radix_node256_t *) node;
+        for (i = 0; i < 256; ++i) {
+            if (!n256->children[i]) {
+                continue;
+            }
+            rv = spr_radix_iter(n256->children[i], callback, data);
+            if (rv) {
+                return rv;
+            }
+        }
+        break;
+    }
+
+    return 0;
+}
+
+int
+spr_radix_iter_prefix(spr_radix_t *tree, const void *prefix, size_t len,
+    spr_radix_callback_pt callback, void *data)
+{
+    spr_radix_node_t *node, **slot;
+    spr_radix_leaf_t *leaf;
+    const uint8_t *k;
+    size_t depth, m;
+
+    k = prefix;
+    node = tree->root;
+    depth = 0;
+
+    while (node) {
+
+        if (spr_radix_is_leaf(node)) {
+            leaf = spr_radix_leaf(node);
+
+            if (leaf->len >= len && spr_memcmp(leaf->key, k, len) == 0) {
+                return callback(data, leaf->key, leaf->len, leaf->value);
+            }
+            return 0;
+        }
+
+        if (node->prefix_len) {
+            m = spr_radix_prefix_mismatch(node, k, len, depth);
+
+            if (depth + m == len) {
+                return spr_radix_iter(node, callback, data);
+            }
+
+            if (m < node->prefix_len) {
+                return 0;
+            }
+
+            depth += node->prefix_len;
+        }
+
+        if (depth == len) {
+            return spr_radix_iter(node, callback, data);
+        }
+
+        slot = spr_radix_find_child(node, k[depth]);
+        if (!slot) {
+            return 0;
+        }
+
+        node = *slot;
+        depth++;
+    }
+
+    return 0;
+}
@@ -0,0 +1,525 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "spr_portable.h"
+#include "spr_errno.h"
+#include "spr_memory.h"
+#include "spr_pool.h"
+#include "spr_atomic.h"
+#include "spr_cpuinfo.h"
+#include "spr_record.h"
+
+#if (SPR_HAVE_SSE2)
+#include <emmintrin.h>
+#endif
+
+#if (SPR_HAVE_AVX2)
+#include <immintrin.h>
+#endif
+
+#if (SPR_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+#define SPR_RECORD_BLOCK             64
+
+/*
+ * Skips blocks without the delimiter and returns the first block which
+ * has one, with bit i of mask set if the block holds it at i. Returns
+ * with mask 0 when less than a block is left.
+ */
+typedef const uint8_t *(*spr_record_find_pt)(const uint8_t *p,
+    const uint8_t *last, uint8_t delim, uint64_t *mask);
+
+static const uint8_t *spr_record_find_init(const uint8_t *p,
+    const uint8_t *last, uint8_t delim, uint64_t *mask);
+
+static spr_record_find_pt spr_record_find = spr_record_find_init;
+
+
+static uint64_t
+spr_record_mask(const uint8_t *p, size_t n, uint8_t delim)
+{
+    uint64_t mask;
+    size_t i;
+
+    mask = 0;
+
+    for (i = 0; i < n; i++) {
+        if (p[i] == delim) {
+            mask |= (uint64_t) 1 << i;
+        }
+    }
+
+    return mask;
+}
+
+/* memchr() is vectorized by the C library, the block starts at the hit */
+static const uint8_t *
+spr_record_find_scalar(const uint8_t *p, const uint8_t *last,
+    uint8_t delim, uint64_t *mask)
+{
+    const uint8_t *q;
+    size_t n;
+
+    q = spr_memchr(p, delim, (size_t) (last - p));
+    if (!q) {
+        *mask = 0;
+        return last;
+    }
+
+    n = (size_t) (last - q);
+
+    *mask = spr_record_mask(q, n < SPR_RECORD_BLOCK ? n : SPR_RECORD_BLOCK,
+                            delim);
+
+    return q;
+}
+
+/*
+ * A run without the delimiter may restart at the block boundary before
+ * p + size, the bytes in between were just checked. Long runs are then
+ * read a cache line at a time, as memchr() does, instead of loads that
+ * straddle two lines.
+ */
+#define spr_record_next_block(p, size)                                      \
+    ((const uint8_t *) (((uintptr_t) (p) + (size))                          \
+                        & ~(uintptr_t) (SPR_RECORD_BLOCK - 1)))
+
+#if (SPR_HAVE_SSE2)
+
+static SPR_TARGET_SSE2 const uint8_t *
+spr_record_find_sse2(const uint8_t *p, const uint8_t *last, uint8_t delim,
+    uint64_t *mask)
+{
+    __m128i d, v0, v1, v2, v3;
+    uint64_t m0, m1, m2, m3;
+
+    d = _mm_set1_epi8((char) delim);
+
+    while (last - p >= SPR_RECORD_BLOCK) {
+        v0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) p), d);
+        v1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p + 16)), d);
+        v2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p + 32)), d);
+        v3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p + 48)), d);
+
+        if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(v0, v1),
+                                           _mm_or_si128(v2, v3))) == 0)
+        {
+            p = spr_record_next_block(p, SPR_RECORD_BLOCK);
+            continue;
+        }
+
+        m0 = (uint32_t) _mm_movemask_epi8(v0);
+        m1 = (uint32_t) _mm_movemask_epi8(v1);
+        m2 = (uint32_t) _mm_movemask_epi8(v2);
+        m3 = (uint32_t) _mm_movemask_epi8(v3);
+
+        *mask = m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+
+        return p;
+    }
+
+    *mask = 0;
+
+    return p;
+}
+
+#endif
+
+#if (SPR_HAVE_AVX2)
+
+static SPR_TARGET_AVX2 const uint8_t *
+spr_record_find_avx2(const uint8_t *p, const uint8_t *last, uint8_t delim,
+    uint64_t *mask)
+{
+    __m256i d, v0, v1, v2, v3, any;
+    uint64_t lo, hi;
+
+    d = _mm256_set1_epi8((char) delim);
+
+    /* Long records, two blocks per test */
+    while (last - p >= 2 * SPR_RECORD_BLOCK) {
+        v0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) p), d);
+        v1 = _mm256_cmpeq_epi8(
+                 _mm256_loadu_si256((const __m256i *) (p + 32)), d);
+        v2 = _mm256_cmpeq_epi8(
+                 _mm256_loadu_si256((const __m256i *) (p + 64)), d);
+        v3 = _mm256_cmpeq_epi8(
+                 _mm256_loadu_si256((const __m256i *) (p + 96)), d);
+
+        any = _mm256_or_si256(_mm256_or_si256(v0, v1),
+                              _mm256_or_si256(v2, v3));
+
+        if (_mm256_testz_si256(any, any)) {
+            p = spr_record_next_block(p, 2 * SPR_RECORD_BLOCK);
+            continue;
+        }
+
+        lo = (uint32_t) _mm256_movemask_epi8(v0);
+        hi = (uint32_t) _mm256_movemask_epi8(v1);
+
+        if (lo | hi) {
+            *mask = lo | (hi << 32);
+            return p;
+        }
+
+        lo = (uint32_t) _mm256_movemask_epi8(v2);
+        hi = (uint32_t) _mm256_movemask_epi8(v3);
+
+        *mask = lo | (hi << 32);
+
+        return p + SPR_RECORD_BLOCK;
+    }
+
+    for ( ; last - p >= SPR_RECORD_BLOCK; p += SPR_RECORD_BLOCK) {
+        v0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) p), d);
+        v1 = _mm256_cmpeq_epi8(
+                 _mm256_loadu_si256((const __m256i *) (p + 32)), d);
+
+        lo = (uint32_t) _mm256_movemask_epi8(v0);
+        hi = (uint32_t) _mm256_movemask_epi8(v1);
+
+        if (lo | hi) {
+            *mask = lo | (hi << 32);
+            return p;
+        }
+    }
+
+    *mask = 0;
+
+    return p;
+}
+
+#endif
+
+#if (SPR_HAVE_NEON)
+
+/* No movemask, the bytes are weighted and folded by pairwise adds */
+static const uint8_t *
+spr_record_find_neon(const uint8_t *p, const uint8_t *last, uint8_t delim,
+    uint64_t *mask)
+{
+    static const uint8_t weights[16] = {
+        1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128
+    };
+    uint8x16_t d, w, m0, m1, m2, m3;
+
+    d = vdupq_n_u8(delim);
+    w = vld1q_u8(weights);
+
+    while (last - p >= SPR_RECORD_BLOCK) {
+        m0 = vceqq_u8(vld1q_u8(p), d);
+        m1 = vceqq_u8(vld1q_u8(p + 16), d);
+        m2 = vceqq_u8(vld1q_u8(p + 32), d);
+        m3 = vceqq_u8(vld1q_u8(p + 48), d);
+
+        if (vmaxvq_u8(vorrq_u8(vorrq_u8(m0, m1), vorrq_u8(m2, m3))) == 0) {
+            p = spr_record_next_block(p, SPR_RECORD_BLOCK);
+            continue;
+        }
+
+        m0 = vpaddq_u8(vandq_u8(m0, w), vandq_u8(m1, w));
+        m2 = vpaddq_u8(vandq_u8(m2, w), vandq_u8(m3, w));
+        m0 = vpaddq_u8(m0, m2);
+        m0 = vpaddq_u8(m0, m0);
+
+        *mask = vgetq_lane_u64(vreinterpretq_u64_u8(m0), 0);
+
+        return p;
+    }
+
+    *mask = 0;
+
+    return p;
+}
+
+#endif
+
+static void
+spr_record_dispatch(void)
+{
+    spr_record_find_pt find;
+
+    find = spr_record_find_scalar;
+
+#if (SPR_HAVE_SSE2)
+    if (spr_cpu_has_feature(SPR_CPU_FEATURE_SSE2)) {
+        find = spr_record_find_sse2;
+    }
+#endif
+
+#if (SPR_HAVE_AVX2)
+    if (spr_cpu_has_feature(SPR_CPU_FEATURE_AVX2)) {
+        find = spr_record_find_avx2;
+    }
+#endif
+
+#if (SPR_HAVE_NEON)
+    if (spr_cpu_has_feature(SPR_CPU_FEATURE_NEON)) {
+        find = spr_record_find_neon;
+    }
+#endif
+
+    spr_atomic_store(&spr_record_find, find);
+}
+
+static const uint8_t *
+spr_record_find_init(const uint8_t *p, const uint8_t *last, uint8_t delim,
+    uint64_t *mask)
+{
+    spr_record_dispatch();
+    return spr_atomic_load(&spr_record_find)(p, last, delim, mask);
+}
+
+static spr_record_reader_t *
+spr_record_reader_alloc(spr_pool_t *pool, int delim, spr_uint_t flags)
+{
+    spr_record_reader_t *reader;
+
+    reader = spr_pcalloc(pool, sizeof(spr_record_reader_t));
+    if (!reader) {
+        return NULL;
+    }
+
+    reader->delim = (uint8_t) delim;
+    reader->flags = flags;
+
+    return reader;
+}
+
+/*
+ * The reader consumes the stream as it hands out records, the stream
+ * must not be read otherwise meanwhile
+ */
+spr_err_t
+spr_record_reader_create1(spr_record_reader_t **out_reader,
+    spr_pool_t *pool, spr_bstream_t *stream, int delim, spr_uint_t flags)
+{
+    spr_record_reader_t *reader;
+
+    reader = spr_record_reader_alloc(pool, delim, flags);
+    if (!reader) {
+        return spr_get_errno();
+    }
+
+    reader->stream = stream;
+    reader->pos = stream->pos;
+    reader->next = stream->pos;
+    reader->last = stream->last;
+
+    *out_reader = reader;
+
+    return SPR_OK;
+}
+
+spr_record_reader_t *
+spr_record_reader_create(spr_pool_t *pool, spr_bstream_t *stream,
+    int delim, spr_uint_t flags)
+{
+    spr_record_reader_t *reader;
+
+    reader = NULL;
+
+    if (spr_record_reader_create1(&reader, pool, stream, delim, flags)
+        != SPR_OK)
+    {
+        return NULL;
+    }
+
+    return reader;
+}
+
+spr_record_reader_t *
+spr_record_reader_create_buf(spr_pool_t *pool, const void *buf,
+    size_t len, int delim, spr_uint_t flags)
+{
+    spr_record_reader_t *reader;
+
+    reader = spr_record_reader_alloc(pool, delim, flags);
+    if (!reader) {
+        return NULL;
+    }
+
+    reader->pos = (uint8_t *) buf;
+    reader->next = reader->pos;
+    reader->last = reader->pos + len;
+
+    return reader;
+}
+
+static void
+spr_record_scan(spr_record_reader_t *reader)
+{
+    spr_record_find_pt find;
+    uint64_t mask;
+    uint8_t *p;
+    size_t n;
+
+    find = spr_atomic_load(&spr_record_find);
+    p = (uint8_t *) find(reader->next, reader->last, reader->delim, &mask);
+
+    n = (size_t) (reader->last - p);
+    if (n > SPR_RECORD_BLOCK) {
+        n = SPR_RECORD_BLOCK;
+    }
+
+    if (mask == 0) {
+        mask = spr_record_mask(p, n, reader->delim);
+    }
+
+    reader->base = p;
+    reader->mask = mask;
+    reader->next = p + n;
+}
+
+/*
+ * Gets more data behind the unfinished record, the stream may move it
+ * to the front of its buffer. SPR_DONE means no more data fits or the
+ * stream has ended.
+ */
+static spr_err_t
+spr_record_refill(spr_record_reader_t *reader)
+{
+    const uint8_t *data;
+    spr_bstream_t *bs;
+    size_t kept;
+    ssize_t n;
+
+    bs = reader->stream;
+    kept = (size_t) (reader->last - reader->pos);
+
+    n = spr_bstream_peek(bs, &data, kept + 1);
+    if (n == -1) {
+        return spr_get_errno();
+    }
+
+    reader->pos = bs->pos;
+    reader->next = bs->pos + kept;
+    reader->last = bs->last;
+
+    return ((size_t) n > kept) ? SPR_OK : SPR_DONE;
+}
+
+static void
+spr_record_set(spr_record_reader_t *reader, spr_str_t *record,
+    uint8_t *end, uint8_t *next)
+{
+    record->data = (char *) reader->pos;
+    record->len = (size_t) (end - reader->pos);
+
+    reader->pos = next;
+
+    if (reader->stream) {
+        reader->stream->pos = next;
+    }
+}
+
+/* Returns SPR_DONE once all records were handed out */
+spr_err_t
+spr_record_next(spr_record_reader_t *reader, spr_str_t *record)
+{
+    uint8_t *p, *end;
+    spr_err_t err;
+
+    for ( ;; ) {
+        if (reader->mask) {
+            p = reader->base + __builtin_ctzll(reader->mask);
+            reader->mask &= reader->mask - 1;
+
+            end = p;
+
+            if ((reader->flags & SPR_RECORD_CRLF)
+                && end > reader->pos && end[-1] == SPR_CR)
+            {
+                end--;
+            }
+
+            reader->partial = 0;
+            spr_record_set(reader, record, end, p + 1);
+
+            return SPR_OK;
+        }
+
+        if (reader->next != reader->last) {
+            spr_record_scan(reader);
+            continue;
+        }
+
+        if (reader->stream) {
+            err = spr_record_refill(reader);
+            if (err == SPR_OK) {
+                continue;
+            }
+
+            if (err != SPR_DONE) {
+                return err;
+            }
+        }
+
+        end = reader->last;
+
+        if (reader->pos == end) {
+            if (!reader->partial) {
+                return SPR_DONE;
+            }
+
+            /* The last record filled the buffer, an empty piece ends it */
+            reader->partial = 0;
+            spr_record_set(reader, record, end, end);
+
+            return SPR_OK;
+        }
+
+        if (reader->stream
+            && (size_t) (end - reader->pos)
+               >= spr_bstream_capacity(reader->stream))
+        {
+            /* A CR ending a piece goes with the next one, it may be a CRLF */
+            if ((reader->flags & SPR_RECORD_CRLF)
+                && end - reader->pos > 1 && end[-1] == SPR_CR)
+            {
+                end--;
+            }
+
+            reader->partial = 1;
+            spr_record_set(reader, record, end, end);
+
+            return SPR_OK;
+        }
+
+        /*
+         * The rest of the input is the last record, a CR there is data
+         * as it is not followed by LF
+         */
+        reader->partial = 0;
+        spr_record_set(reader, record, end, end);
+
+        return SPR_OK;
+    }
+}
@@ -0,0 +1,272 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "spr_portable.h"
+#include "spr_search.h"
+#include "spr_memory.h"
+#include "spr_errno.h"
+
+#define SPR_SEARCH_NONE              UINT32_MAX
+
+
+spr_err_t
+spr_search_create1(spr_search_t **out_search, spr_pool_t *pool,
+    const spr_str_t *patterns, size_t n, spr_uint_t flags)
+{
+    spr_search_t *search;
+    uint32_t *fail, *queue, *row;
+    uint32_t state, next, head, tail;
+    size_t total, maxstates, i, j;
+    spr_uint_t c, nclasses;
+    uint8_t used[256], b;
+    spr_err_t err;
+
+    if (n == 0 || n >= UINT32_MAX) {
+        return SPR_FAILED;
+    }
+
+    spr_memzero(used, sizeof(used));
+
+    total = 0;
+
+    for (i = 0; i < n; i++) {
+
+        if (patterns[i].len == 0 || patterns[i].len > UINT32_MAX - total) {
+            return SPR_FAILED;
+        }
+
+        total += patterns[i].len;
+
+        for (j = 0; j < patterns[i].len; j++) {
+            b = (uint8_t) patterns[i].data[j];
+            if (flags & SPR_SEARCH_CASELESS) {
+                b = (uint8_t) spr_tolower(b);
+            }
+
+            used[b] = 1;
+        }
+    }
+
+    search = spr_palloc(pool, sizeof(spr_search_t));
+    if (!search) {
+        return spr_get_errno();
+    }
+
+    /* Class 0 collects every byte which occurs in no pattern */
+    nclasses = 1;
+
+    for (c = 0; c < 256; c++) {
+        search->classes[c] = used[c] ? (uint8_t) nclasses++ : 0;
+    }
+
+    if (flags & SPR_SEARCH_CASELESS) {
+        for (c = 'A'; c <= 'Z'; c++) {
+            search->classes[c] = search->classes[c | 0x20];
+        }
+    }
+
+    maxstates = total + 1;
+
+    if (maxstates > SIZE_MAX / sizeof(uint32_t) / nclasses) {
+        return SPR_FAILED;
+    }
+
+    search->delta = spr_palloc(pool, maxstates * nclasses * sizeof(uint32_t));
+    search->match = spr_pcalloc(pool, maxstates * sizeof(uint32_t));
+    search->report = spr_pcalloc(pool, maxstates * sizeof(uint32_t));
+    search->dict = spr_pcalloc(pool, maxstates * sizeof(uint32_t));
+    search->lens = spr_palloc(pool, n * sizeof(size_t));
+
+    if (!search->delta || !search->match || !search->report
+        || !search->dict || !search->lens)
+    {
+        return spr_get_errno();
+    }
+
+    spr_memset(search->delta, 0xff, maxstates * nclasses * sizeof(uint32_t));
+
+    /* Trie of all patterns, state 0 is the root */
+    search->nstates = 1;
+
+    for (i = 0; i < n; i++) {
+        state = 0;
+
+        for (j = 0; j < patterns[i].len; j++) {
+            row = search->delta + state * nclasses;
+            c = search->classes[(uint8_t) patterns[i].data[j]];
+
+            if (row[c] == SPR_SEARCH_NONE) {
+                row[c] = (uint32_t) search->nstates++;
+            }
+
+            state = row[c];
+        }
+
+        /* A duplicate pattern is reported under its first index */
+        if (search->match[state] == 0) {
+            search->match[state] = (uint32_t) i + 1;
+        }
+
+        search->lens[i] = patterns[i].len;
+    }
+
+    fail = spr_malloc(search->nstates * sizeof(uint32_t));
+    queue = spr_malloc(search->nstates * sizeof(uint32_t));
+
+    if (!fail || !queue) {
+        err = spr_get_errno();
+        spr_free(fail);
+        spr_free(queue);
+        return err;
+    }
+
+    /*
+     * Breadth-first pass: failure links turn missing transitions into
+     * the transitions of the longest proper suffix, and report/dict
+     * chain the states at which some pattern ends.
+     */
+    head = tail = 0;
+
+    for (c = 0; c < nclasses; c++) {
+        next = search->delta[c];
+
+        if (next == SPR_SEARCH_NONE) {
+            search->delta[c] = 0;
+
+        } else {
+            fail[next] = 0;
+            queue[tail++] = next;
+        }
+    }
+
+    while (head != tail) {
+        state = queue[head++];
+        row = search->delta + state * nclasses;
+
+        search->dict[state] = search->report[fail[state]];
+        search->report[state] = search->match[state]
+                                ? state : search->report[fail[state]];
+
+        for (c = 0; c < nclasses; c++) {
+            next = search->delta[fail[state] * nclasses + c];
+
+            if (row[c] == SPR_SEARCH_NONE) {
+                row[c] = next;
+
+            } else {
+                fail[row[c]] = next;
+                queue[tail++] = row[c];
+            }
+        }
+    }
+
+    spr_free(fail);
+    spr_free(queue);
+
+    search->npatterns = n;
+    search->nclasses = nclasses;
+
+    *out_search = search;
+
+    return SPR_OK;
+}
+
+spr_search_t *
+spr_search_create(spr_pool_t *pool, const spr_str_t *patterns, size_t n,
+    spr_uint_t flags)
+{
+    spr_search_t *search;
+
+    search = NULL;
+
+    if (spr_search_create1(&search, pool, patterns, n, flags) != SPR_OK) {
+        return NULL;
+    }
+
+    return search;
+}
+
+spr_int_t
+spr_search_scan(const spr_search_t *search, const void *buf, size_t len,
+    spr_search_handler_pt handler, void *data)
+{
+    const uint8_t *p;
+    uint32_t state, out, pattern;
+    spr_int_t rc;
+    size_t i;
+
+    p = buf;
+    state = 0;
+
+    for (i = 0; i < len; i++) {
+        state = search->delta[state * search->nclasses
+                              + search->classes[p[i]]];
+
+        for (out = search->report[state]; out; out = search->dict[out]) {
+            pattern = search->match[out] - 1;
+
+            rc = handler(data, pattern, i + 1 - search->lens[pattern]);
+            if (rc != SPR_OK) {
+                return rc;
+            }
+        }
+    }
+
+    return SPR_OK;
+}
+
+/* Returns the match which ends first, the longest one on a tie */
+const char *
+spr_search_find(const spr_search_t *search, const void *buf, size_t len,
+    size_t *pattern)
+{
+    const uint8_t *p;
+    uint32_t state, out;
+    size_t i;
+
+    p = buf;
+    state = 0;
+
+    for (i = 0; i < len; i++) {
+        state = search->delta[state * search->nclasses
+                              + search->classes[p[i]]];
+
+        out = search->report[state];
+
+        if (out) {
+            if (pattern) {
+                *pattern = search->match[out] - 1;
+            }
+
+            return (const char *) p + i + 1
+                   - search->lens[search->match[out] - 1];
+        }
+    }
+
+    return NULL;
+}
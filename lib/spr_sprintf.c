@@ -0,0 +1,722 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "spr_portable.h"
+#include "spr_limits.h"
+#include "spr_memory.h"
+#include "spr_pool.h"
+#include "spr_errno.h"
+#include "spr_string.h"
+#include "spr_sockaddr.h"
+#include "spr_sprintf.h"
+
+#define SPR_SPRINTF_LEFT             0x01
+#define SPR_SPRINTF_ZERO             0x02
+#define SPR_SPRINTF_PLUS             0x04
+#define SPR_SPRINTF_SPACE            0x08
+#define SPR_SPRINTF_ALT              0x10
+#define SPR_SPRINTF_PRECISION        0x20
+
+#define SPR_SPRINTF_INT              0
+#define SPR_SPRINTF_CHAR             1
+#define SPR_SPRINTF_SHORT            2
+#define SPR_SPRINTF_LONG             3
+#define SPR_SPRINTF_LLONG            4
+#define SPR_SPRINTF_SIZE             5
+#define SPR_SPRINTF_INTMAX           6
+#define SPR_SPRINTF_PTRDIFF          7
+#define SPR_SPRINTF_LDOUBLE          8
+
+/* Octal digits of a 64-bit value, plus a terminator */
+#define SPR_SPRINTF_INT_LEN          24
+
+#define SPR_SPRINTF_ADDR_LEN \
+    (SPR_NI_MAXHOST + SPR_NI_MAXSERV + sizeof("[]:"))
+
+typedef struct spr_sprintf_spec_s spr_sprintf_spec_t;
+
+struct spr_sprintf_spec_s {
+    spr_uint_t flags;
+    spr_uint_t length;
+    size_t width;
+    size_t precision;
+};
+
+
+static int64_t
+spr_sprintf_signed(va_list *args, spr_uint_t length)
+{
+    switch (length) {
+    case SPR_SPRINTF_CHAR:
+        return (signed char) va_arg(*args, int);
+    case SPR_SPRINTF_SHORT:
+        return (short) va_arg(*args, int);
+    case SPR_SPRINTF_LONG:
+        return va_arg(*args, long);
+    case SPR_SPRINTF_LLONG:
+        return va_arg(*args, long long);
+    case SPR_SPRINTF_SIZE:
+        return va_arg(*args, ssize_t);
+    case SPR_SPRINTF_INTMAX:
+        return va_arg(*args, intmax_t);
+    case SPR_SPRINTF_PTRDIFF:
+        return va_arg(*args, ptrdiff_t);
+    default:
+        return va_arg(*args, int);
+    }
+}
+
+static uint64_t
+spr_sprintf_unsigned(va_list *args, spr_uint_t length)
+{
+    switch (length) {
+    case SPR_SPRINTF_CHAR:
+        return (unsigned char) va_arg(*args, unsigned int);
+    case SPR_SPRINTF_SHORT:
+        return (unsigned short) va_arg(*args, unsigned int);
+    case SPR_SPRINTF_LONG:
+        return va_arg(*args, unsigned long);
+    case SPR_SPRINTF_LLONG:
+        return va_arg(*args, unsigned long long);
+    case SPR_SPRINTF_SIZE:
+        return va_arg(*args, size_t);
+    case SPR_SPRINTF_INTMAX:
+        return va_arg(*args, uintmax_t);
+    case SPR_SPRINTF_PTRDIFF:
+        return (uint64_t) va_arg(*args, ptrdiff_t);
+    default:
+        return va_arg(*args, unsigned int);
+    }
+}
+
+/* Writes the digits right-aligned in buf and returns where they start */
+static char *
+spr_sprintf_radix(uint64_t value, char *buf, spr_uint_t shift,
+    const char *digits)
+{
+    char *p;
+
+    p = buf + SPR_SPRINTF_INT_LEN;
+
+    do {
+        *--p = digits[value & ((1U << shift) - 1)];
+        value >>= shift;
+    } while (value);
+
+    return p;
+}
+
+/*
+ * Lays out [spaces][prefix][zeros][body][spaces], the padding side is
+ * chosen by the '-' flag.
+ */
+static spr_err_t
+spr_sprintf_emit(spr_strbuf_t *buf, spr_sprintf_spec_t *spec,
+    const char *prefix, size_t prefix_len, size_t zeros, const char *body,
+    size_t body_len)
+{
+    size_t len, pad;
+    char *p;
+
+    len = prefix_len + zeros + body_len;
+    if (len < body_len) {
+        return SPR_FAILED;
+    }
+
+    pad = (spec->width > len) ? spec->width - len : 0;
+
+    p = spr_strbuf_reserve(buf, len + pad);
+    if (!p) {
+        return SPR_FAILED;
+    }
+
+    if (!(spec->flags & SPR_SPRINTF_LEFT)) {
+        spr_memset(p, ' ', pad);
+        p += pad;
+    }
+
+    spr_memcpy(p, prefix, prefix_len);
+    p += prefix_len;
+    spr_memset(p, '0', zeros);
+    p += zeros;
+    spr_memcpy(p, body, body_len);
+    p += body_len;
+
+    if (spec->flags & SPR_SPRINTF_LEFT) {
+        spr_memset(p, ' ', pad);
+    }
+
+    spr_strbuf_commit(buf, len + pad);
+
+    return SPR_OK;
+}
+
+static spr_err_t
+spr_sprintf_integer(spr_strbuf_t *buf, spr_sprintf_spec_t *spec,
+    const char *prefix, size_t prefix_len, const char *body,
+    size_t body_len)
+{
+    size_t zeros;
+
+    zeros = 0;
+
+    if (spec->flags & SPR_SPRINTF_PRECISION) {
+        if (spec->precision > body_len) {
+            zeros = spec->precision - body_len;
+        }
+
+    } else if ((spec->flags & (SPR_SPRINTF_ZERO|SPR_SPRINTF_LEFT))
+               == SPR_SPRINTF_ZERO
+               && spec->width > prefix_len + body_len)
+    {
+        zeros = spec->width - prefix_len - body_len;
+    }
+
+    return spr_sprintf_emit(buf, spec, prefix, prefix_len, zeros, body,
+                            body_len);
+}
+
+/*
+ * Floating point goes through libc, the conversion is rebuilt with the
+ * width and precision passed as arguments.
+ */
+static spr_err_t
+spr_sprintf_double(spr_strbuf_t *buf, spr_sprintf_spec_t *spec, char conv,
+    va_list *args)
+{
+    long double ldvalue;
+    double value;
+    char fmt[16], *p;
+    int width, precision, n;
+
+    if (spec->width > SPR_INT_T_MAX || spec->precision > SPR_INT_T_MAX) {
+        return SPR_FAILED;
+    }
+
+    width = (int) spec->width;
+    precision = (spec->flags & SPR_SPRINTF_PRECISION)
+                ? (int) spec->precision : -1;
+
+    p = fmt;
+    *p++ = '%';
+
+    if (spec->flags & SPR_SPRINTF_LEFT) {
+        *p++ = '-';
+    }
+    if (spec->flags & SPR_SPRINTF_ZERO) {
+        *p++ = '0';
+    }
+    if (spec->flags & SPR_SPRINTF_PLUS) {
+        *p++ = '+';
+    }
+    if (spec->flags & SPR_SPRINTF_SPACE) {
+        *p++ = ' ';
+    }
+    if (spec->flags & SPR_SPRINTF_ALT) {
+        *p++ = '#';
+    }
+
+    *p++ = '*';
+    *p++ = '.';
+    *p++ = '*';
+
+    if (spec->length == SPR_SPRINTF_LDOUBLE) {
+        *p++ = 'L';
+    }
+
+    *p++ = conv;
+    *p = '\0';
+
+    if (spec->length == SPR_SPRINTF_LDOUBLE) {
+        ldvalue = va_arg(*args, long double);
+        n = spr_snprintf(NULL, 0, fmt, width, precision, ldvalue);
+
+    } else {
+        ldvalue = 0;
+        value = va_arg(*args, double);
+        n = spr_snprintf(NULL, 0, fmt, width, precision, value);
+    }
+
+    if (n < 0) {
+        return SPR_FAILED;
+    }
+
+    /* The byte past the reserved space takes the terminator */
+    p = spr_strbuf_reserve(buf, n);
+    if (!p) {
+        return SPR_FAILED;
+    }
+
+    if (spec->length == SPR_SPRINTF_LDOUBLE) {
+        spr_snprintf(p, n + 1, fmt, width, precision, ldvalue);
+    } else {
+        spr_snprintf(p, n + 1, fmt, width, precision, value);
+    }
+
+    spr_strbuf_commit(buf, n);
+
+    return SPR_OK;
+}
+
+static const char *
+spr_sprintf_sockaddr(const struct sockaddr *sockaddr, char *buf)
+{
+    char port[SPR_NI_MAXSERV];
+    char *p;
+    size_t len;
+
+    if (!sockaddr) {
+        return "(null)";
+    }
+
+    p = buf;
+
+    if (sockaddr->sa_family == AF_INET6) {
+        *p++ = '[';
+    }
+
+    if (!spr_sockaddr_get_addr_text(sockaddr, p, SPR_NI_MAXHOST)
+        || !spr_sockaddr_get_port_text(sockaddr, port, sizeof(port)))
+    {
+        return "(unknown)";
+    }
+
+    p += spr_strlen(p);
+
+    if (buf[0] == '[') {
+        *p++ = ']';
+    }
+
+    *p++ = ':';
+
+    len = spr_strlen(port);
+    spr_memcpy(p, port, len + 1);
+
+    return buf;
+}
+
+static spr_err_t
+spr_sprintf_format(spr_strbuf_t *buf, const char *fmt, va_list *args,
+    spr_err_t errnum)
+{
+    static const char lower[] = "0123456789abcdef";
+    static const char upper[] = "0123456789ABCDEF";
+    char num[SPR_SPRINTF_INT_LEN], errstr[SPR_ERRNO_STR_SIZE];
+    char addr[SPR_SPRINTF_ADDR_LEN];
+    const char *start, *prefix, *body;
+    size_t prefix_len, body_len;
+    spr_sprintf_spec_t spec;
+    spr_str_t *str;
+    uint64_t value;
+    int64_t svalue;
+    spr_err_t err;
+    int arg;
+    char ch;
+
+    while (*fmt) {
+        start = spr_strchr(fmt, '%');
+        if (!start) {
+            return spr_strbuf_append_cstr(buf, fmt);
+        }
+
+        if (start != fmt) {
+            err = spr_strbuf_append(buf, fmt, start - fmt);
+            if (err != SPR_OK) {
+                return err;
+            }
+        }
+
+        fmt = start + 1;
+
+        spr_memzero(&spec, sizeof(spr_sprintf_spec_t));
+
+        for ( ;; fmt++) {
+            switch (*fmt) {
+            case '-':
+                spec.flags |= SPR_SPRINTF_LEFT;
+                continue;
+            case '0':
+                spec.flags |= SPR_SPRINTF_ZERO;
+                continue;
+            case '+':
+                spec.flags |= SPR_SPRINTF_PLUS;
+                continue;
+            case ' ':
+                spec.flags |= SPR_SPRINTF_SPACE;
+                continue;
+            case '#':
+                spec.flags |= SPR_SPRINTF_ALT;
+                continue;
+            }
+            break;
+        }
+
+        if (*fmt == '*') {
+            arg = va_arg(*args, int);
+            if (arg < 0) {
+                spec.flags |= SPR_SPRINTF_LEFT;
+                spec.width = -(size_t) arg;
+            } else {
+                spec.width = arg;
+            }
+            fmt++;
+
+        } else {
+            while (*fmt >= '0' && *fmt <= '9') {
+                if (spec.width > (SPR_SSIZE_T_MAX - 9) / 10) {
+                    return SPR_FAILED;
+                }
+                spec.width = spec.width * 10 + (*fmt++ - '0');
+            }
+        }
+
+        if (*fmt == '.') {
+            spec.flags |= SPR_SPRINTF_PRECISION;
+            fmt++;
+
+            if (*fmt == '*') {
+                arg = va_arg(*args, int);
+                if (arg < 0) {
+                    spec.flags &= ~SPR_SPRINTF_PRECISION;
+                } else {
+                    spec.precision = arg;
+                }
+                fmt++;
+
+            } else {
+                while (*fmt >= '0' && *fmt <= '9') {
+                    if (spec.precision > (SPR_SSIZE_T_MAX - 9) / 10) {
+                        return SPR_FAILED;
+                    }
+                    spec.precision = spec.precision * 10 + (*fmt++ - '0');
+                }
+            }
+        }
+
+        switch (*fmt) {
+        case 'h':
+            fmt++;
+            if (*fmt == 'h') {
+                spec.length = SPR_SPRINTF_CHAR;
+                fmt++;
+            } else {
+                spec.length = SPR_SPRINTF_SHORT;
+            }
+            break;
+        case 'l':
+            fmt++;
+            if (*fmt == 'l') {
+                spec.length = SPR_SPRINTF_LLONG;
+                fmt++;
+            } else {
+                spec.length = SPR_SPRINTF_LONG;
+            }
+            break;
+        case 'z':
+            spec.length = SPR_SPRINTF_SIZE;
+            fmt++;
+            break;
+        case 'j':
+            spec.length = SPR_SPRINTF_INTMAX;
+            fmt++;
+            break;
+        case 't':
+            spec.length = SPR_SPRINTF_PTRDIFF;
+            fmt++;
+            break;
+        case 'L':
+            spec.length = SPR_SPRINTF_LDOUBLE;
+            fmt++;
+            break;
+        }
+
+        prefix = "";
+        prefix_len = 0;
+
+        switch (*fmt) {
+
+        case 'd':
+        case 'i':
+            svalue = spr_sprintf_signed(args, spec.length);
+
+            if (svalue < 0) {
+                value = 0 - (uint64_t) svalue;
+                prefix = "-";
+                prefix_len = 1;
+
+            } else {
+                value = svalue;
+
+                if (spec.flags & SPR_SPRINTF_PLUS) {
+                    prefix = "+";
+                    prefix_len = 1;
+
+                } else if (spec.flags & SPR_SPRINTF_SPACE) {
+                    prefix = " ";
+                    prefix_len = 1;
+                }
+            }
+
+            goto decimal;
+
+        case 'u':
+            value = spr_sprintf_unsigned(args, spec.length);
+
+        decimal:
+
+            if (value == 0 && (spec.flags & SPR_SPRINTF_PRECISION)
+                && spec.precision == 0)
+            {
+                body_len = 0;
+            } else {
+                body_len = spr_u64toa(value, num);
+            }
+
+            err = spr_sprintf_integer(buf, &spec, prefix, prefix_len, num,
+                                      body_len);
+            break;
+
+        case 'x':
+        case 'X':
+            value = spr_sprintf_unsigned(args, spec.length);
+
+            if (value != 0 && (spec.flags & SPR_SPRINTF_ALT)) {
+                prefix = (*fmt == 'x') ? "0x" : "0X";
+                prefix_len = 2;
+            }
+
+            body = spr_sprintf_radix(value, num, 4,
+                                     (*fmt == 'x') ? lower : upper);
+            body_len = num + SPR_SPRINTF_INT_LEN - body;
+
+            if (value == 0 && (spec.flags & SPR_SPRINTF_PRECISION)
+                && spec.precision == 0)
+            {
+                body_len = 0;
+            }
+
+            err = spr_sprintf_integer(buf, &spec, prefix, prefix_len, body,
+                                      body_len);
+            break;
+
+        case 'o':
+            value = spr_sprintf_unsigned(args, spec.length);
+
+            body = spr_sprintf_radix(value, num, 3, lower);
+            body_len = num + SPR_SPRINTF_INT_LEN - body;
+
+            if (value == 0 && (spec.flags & SPR_SPRINTF_PRECISION)
+                && spec.precision == 0)
+            {
+                body_len = 0;
+            }
+
+            /* The alternate form forces a leading zero */
+            if ((spec.flags & SPR_SPRINTF_ALT)
+                && (body_len == 0 || body[0] != '0')
+                && !((spec.flags & SPR_SPRINTF_PRECISION)
+                     && spec.precision > body_len))
+            {
+                prefix = "0";
+                prefix_len = 1;
+            }
+
+            err = spr_sprintf_integer(buf, &spec, prefix, prefix_len, body,
+                                      body_len);
+            break;
+
+        case 'p':
+            value = (uintptr_t) va_arg(*args, void *);
+
+            body = spr_sprintf_radix(value, num, 4, lower);
+            body_len = num + SPR_SPRINTF_INT_LEN - body;
+
+            err = spr_sprintf_integer(buf, &spec, "0x", 2, body, body_len);
+            break;
+
+        case 'c':
+            ch = (char) va_arg(*args, int);
+            spec.flags &= ~SPR_SPRINTF_PRECISION;
+            err = spr_sprintf_emit(buf, &spec, "", 0, 0, &ch, 1);
+            break;
+
+        case 's':
+            body = va_arg(*args, const char *);
+            if (!body) {
+                body = "(null)";
+            }
+
+            body_len = (spec.flags & SPR_SPRINTF_PRECISION)
+                       ? spr_strnlen(body, spec.precision)
+                       : spr_strlen(body);
+
+            err = spr_sprintf_emit(buf, &spec, "", 0, 0, body, body_len);
+            break;
+
+        case 'V':
+            str = va_arg(*args, spr_str_t *);
+
+            body = str->data;
+            body_len = str->len;
+
+            if ((spec.flags & SPR_SPRINTF_PRECISION)
+                && spec.precision < body_len)
+            {
+                body_len = spec.precision;
+            }
+
+            err = spr_sprintf_emit(buf, &spec, "", 0, 0, body, body_len);
+            break;
+
+        case 'R':
+        case 'm':
+            body = spr_strerror((*fmt == 'R') ? va_arg(*args, spr_err_t)
+                                              : errnum,
+                                errstr, sizeof(errstr));
+            err = spr_sprintf_emit(buf, &spec, "", 0, 0, body,
+                                   spr_strlen(body));
+            break;
+
+        case 'N':
+            body = spr_sprintf_sockaddr(va_arg(*args,
+                                               const struct sockaddr *),
+                                        addr);
+            err = spr_sprintf_emit(buf, &spec, "", 0, 0, body,
+                                   spr_strlen(body));
+            break;
+
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            err = spr_sprintf_double(buf, &spec, *fmt, args);
+            break;
+
+        case '%':
+            err = spr_strbuf_append_char(buf, '%');
+            break;
+
+        default:
+            /* Unknown or truncated conversions are copied as they are */
+            if (*fmt == '\0') {
+                return spr_strbuf_append_cstr(buf, start);
+            }
+
+            err = spr_strbuf_append(buf, start, fmt + 1 - start);
+            break;
+        }
+
+        if (err != SPR_OK) {
+            return err;
+        }
+
+        fmt++;
+    }
+
+    return SPR_OK;
+}
+
+spr_err_t
+spr_strbuf_vprintf(spr_strbuf_t *buf, const char *fmt, va_list args)
+{
+    spr_err_t err, errnum;
+    va_list copy;
+    size_t len;
+
+    errnum = spr_get_errno();
+    len = buf->len;
+
+    va_copy(copy, args);
+    err = spr_sprintf_format(buf, fmt, &copy, errnum);
+    va_end(copy);
+
+    /* Nothing is left behind on failure */
+    if (err != SPR_OK) {
+        buf->len = len;
+    }
+
+    return err;
+}
+
+spr_err_t
+spr_strbuf_printf(spr_strbuf_t *buf, const char *fmt, ...)
+{
+    va_list args;
+    spr_err_t err;
+
+    va_start(args, fmt);
+    err = spr_strbuf_vprintf(buf, fmt, args);
+    va_end(args);
+
+    return err;
+}
+
+char *
+spr_vpsprintf(spr_pool_t *pool, const char *fmt, va_list args)
+{
+    spr_strbuf_t buf;
+    spr_err_t err, errnum;
+    va_list copy;
+
+    /* Taken before the pool has a chance to touch it */
+    errnum = spr_get_errno();
+
+    if (spr_strbuf_init(&buf, pool, 0) != SPR_OK) {
+        return NULL;
+    }
+
+    va_copy(copy, args);
+    err = spr_sprintf_format(&buf, fmt, &copy, errnum);
+    va_end(copy);
+
+    if (err != SPR_OK) {
+        return NULL;
+    }
+
+    spr_strbuf_finish(&buf, NULL);
+
+    /* Hand the unused tail back to the pool */
+    return spr_prealloc(pool, buf.data, buf.size + 1, buf.len + 1);
+}
+
+char *
+spr_psprintf(spr_pool_t *pool, const char *fmt, ...)
+{
+    va_list args;
+    char *str;
+
+    va_start(args, fmt);
+    str = spr_vpsprintf(pool, fmt, args);
+    va_end(args);
+
+    return str;
+}
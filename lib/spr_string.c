@@ -30,186 +30,1982 @@
 #include "spr_limits.h"
 #include "spr_memory.h"
 #include "spr_pool.h"
+#include "spr_errno.h"
+#include "spr_string.h"
+#include "spr_atomic.h"
+#include "spr_cpuinfo.h"
+#include "spr_hash.h"
 
+#if (SPR_HAVE_SSE2)
+#include <emmintrin.h>
+#endif
+
+#if (SPR_HAVE_SSE42)
+#include <nmmintrin.h>
+#endif
+
+#if (SPR_HAVE_AVX2)
+#include <immintrin.h>
+#endif
+
+#if (SPR_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+/*
+ * The scanners below read whole aligned words or vectors, so they may
+ * look at bytes past the terminator. An aligned load never crosses a
+ * page boundary, which keeps this safe for the hardware but not for the
+ * address sanitizer.
+ */
+#if defined(__has_attribute)
+#if __has_attribute(no_sanitize_address)
+#define SPR_NO_SANITIZE_ADDRESS      __attribute__((no_sanitize_address))
+#endif
+#endif
+
+#ifndef SPR_NO_SANITIZE_ADDRESS
+#define SPR_NO_SANITIZE_ADDRESS
+#endif
+
+#define SPR_STR_WORD_SIZE            sizeof(uintptr_t)
+#define SPR_STR_ONES                 ((uintptr_t) -1 / 0xff)
+#define SPR_STR_HIGHS                (SPR_STR_ONES * 0x80)
+
+#define spr_str_haszero(x) \
+    (((x) - SPR_STR_ONES) & ~(x) & SPR_STR_HIGHS)
+
+#define spr_str_load_word(p)         (*(const spr_str_word_t *) (p))
+
+/*
+ * Unaligned loads from two strings at once cannot be aligned down, so
+ * they are only issued when they stay within the smallest page size.
+ */
+#define SPR_STR_PAGE_SIZE            4096
+
+#define spr_str_page_cross(p, size) \
+    (((uintptr_t) (p) & (SPR_STR_PAGE_SIZE - 1)) > SPR_STR_PAGE_SIZE - (size))
+
+#define SPR_STR_CASEHASH_CHUNK       256
+
+/* Needles up to this length use the first/last byte candidate filter */
+#define SPR_STR_MEMMEM_SHORT         32
+
+/* Significant digits that can never overflow a uint64_t */
+#define SPR_STR_U64_SAFE_DIGITS      19
+
+static spr_err_t spr_strbuf_grow(spr_strbuf_t *buf, size_t n);
+
+#if defined(__GNUC__)
+typedef uintptr_t spr_str_word_t __attribute__((__may_alias__));
+#else
+typedef uintptr_t spr_str_word_t;
+#endif
+
+typedef size_t (*spr_strlen_pt)(const char *str);
+typedef size_t (*spr_strnlen_pt)(const char *str, size_t n);
+typedef char *(*spr_strchr_pt)(const char *str, int c);
+typedef spr_int_t (*spr_strncasecmp_pt)(const char *str1, const char *str2,
+    size_t n);
+typedef void (*spr_strcase_pt)(char *dst, const char *src, size_t n);
+typedef bool (*spr_str_parse16_pt)(const char *p, uint64_t *value);
+typedef const uint8_t *(*spr_memmem_pt)(const uint8_t *haystack, size_t hlen,
+    const uint8_t *needle, size_t nlen);
+
+static size_t spr_strlen_init(const char *str);
+static size_t spr_strnlen_init(const char *str, size_t n);
+static char *spr_strchr_init(const char *str, int c);
+static char *spr_strrchr_init(const char *str, int c);
+static spr_int_t spr_strncasecmp_init(const char *str1, const char *str2,
+    size_t n);
+static void spr_strlower_init(char *dst, const char *src, size_t n);
+static void spr_strupper_init(char *dst, const char *src, size_t n);
+static bool spr_str_parse16_init(const char *p, uint64_t *value);
+static const uint8_t *spr_memmem_short_init(const uint8_t *haystack,
+    size_t hlen, const uint8_t *needle, size_t nlen);
+
+static spr_strlen_pt spr_strlen_impl = spr_strlen_init;
+static spr_strnlen_pt spr_strnlen_impl = spr_strnlen_init;
+static spr_strchr_pt spr_strchr_impl = spr_strchr_init;
+static spr_strchr_pt spr_strrchr_impl = spr_strrchr_init;
+static spr_strncasecmp_pt spr_strncasecmp_impl = spr_strncasecmp_init;
+static spr_strcase_pt spr_strlower_impl = spr_strlower_init;
+static spr_strcase_pt spr_strupper_impl = spr_strupper_init;
+static spr_str_parse16_pt spr_str_parse16 = spr_str_parse16_init;
+static spr_memmem_pt spr_memmem_short = spr_memmem_short_init;
+
+static const char spr_str_digits2[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+
+static SPR_NO_SANITIZE_ADDRESS size_t
+spr_strlen_scalar(const char *str)
+{
+    const char *p;
+
+    for (p = str; (uintptr_t) p & (SPR_STR_WORD_SIZE - 1); p++) {
+        if (*p == '\0') {
+            return p - str;
+        }
+    }
+
+    while (!spr_str_haszero(spr_str_load_word(p))) {
+        p += SPR_STR_WORD_SIZE;
+    }
+
+    while (*p != '\0') {
+        p++;
+    }
+
+    return p - str;
+}
+
+static SPR_NO_SANITIZE_ADDRESS size_t
+spr_strnlen_scalar(const char *str, size_t n)
+{
+    const char *p;
+    size_t len;
+
+    for (p = str, len = 0; (uintptr_t) p & (SPR_STR_WORD_SIZE - 1); p++) {
+        if (len == n || *p == '\0') {
+            return len;
+        }
+        len++;
+    }
+
+    while (n - len >= SPR_STR_WORD_SIZE) {
+
+        if (spr_str_haszero(spr_str_load_word(p))) {
+            break;
+        }
+
+        p += SPR_STR_WORD_SIZE;
+        len += SPR_STR_WORD_SIZE;
+    }
+
+    while (len < n && *p != '\0') {
+        p++;
+        len++;
+    }
+
+    return len;
+}
+
+static SPR_NO_SANITIZE_ADDRESS char *
+spr_strchr_scalar(const char *str, int c)
+{
+    const char *p;
+    uintptr_t x, pattern;
+    char ch;
+
+    ch = (char) c;
+
+    for (p = str; (uintptr_t) p & (SPR_STR_WORD_SIZE - 1); p++) {
+        if (*p == ch) {
+            return (char *) p;
+        }
+
+        if (*p == '\0') {
+            return NULL;
+        }
+    }
+
+    pattern = SPR_STR_ONES * (uint8_t) ch;
+
+    for ( ;; p += SPR_STR_WORD_SIZE) {
+        x = spr_str_load_word(p);
+
+        if (spr_str_haszero(x) | spr_str_haszero(x ^ pattern)) {
+            break;
+        }
+    }
+
+    for ( ;; p++) {
+        if (*p == ch) {
+            return (char *) p;
+        }
+
+        if (*p == '\0') {
+            return NULL;
+        }
+    }
+}
+
+static SPR_NO_SANITIZE_ADDRESS char *
+spr_strrchr_scalar(const char *str, int c)
+{
+    const char *p, *end, *last, *word;
+    uintptr_t x, pattern;
+    char ch;
+
+    ch = (char) c;
+
+    if (ch == '\0') {
+        return (char *) str + spr_strlen_scalar(str);
+    }
+
+    last = NULL;
+
+    for (p = str; (uintptr_t) p & (SPR_STR_WORD_SIZE - 1); p++) {
+        if (*p == '\0') {
+            return (char *) last;
+        }
+
+        if (*p == ch) {
+            last = p;
+        }
+    }
+
+    pattern = SPR_STR_ONES * (uint8_t) ch;
+    word = NULL;
+
+    for ( ;; p += SPR_STR_WORD_SIZE) {
+        x = spr_str_load_word(p);
+
+        if (spr_str_haszero(x)) {
+            break;
+        }
+
+        if (spr_str_haszero(x ^ pattern)) {
+            word = p;
+        }
+    }
+
+    /* The word holding the terminator first, then the last matching one */
+
+    for (end = p; *p != '\0'; p++) {
+        if (*p == ch) {
+            last = p;
+        }
+    }
+
+    if (last != NULL && last >= end) {
+        return (char *) last;
+    }
+
+    if (word != NULL) {
+        for (p = word + SPR_STR_WORD_SIZE - 1; *p != ch; p--) {
+            /* void */
+        }
+
+        return (char *) p;
+    }
+
+    return (char *) last;
+}
+
+#if (SPR_HAVE_SSE2)
+
+static SPR_TARGET_SSE2 SPR_NO_SANITIZE_ADDRESS size_t
+spr_strlen_sse2(const char *str)
+{
+    const char *p;
+    __m128i v, zero;
+    unsigned mask;
+
+    zero = _mm_setzero_si128();
+
+    p = (const char *) ((uintptr_t) str & ~(uintptr_t) 15);
+
+    v = _mm_load_si128((const __m128i *) p);
+    mask = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+    mask &= 0xffffU << (str - p);
+
+    while (!mask) {
+        p += 16;
+        v = _mm_load_si128((const __m128i *) p);
+        mask = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+    }
+
+    return p + __builtin_ctz(mask) - str;
+}
+
+static SPR_TARGET_SSE2 SPR_NO_SANITIZE_ADDRESS size_t
+spr_strnlen_sse2(const char *str, size_t n)
+{
+    const char *p;
+    __m128i v, zero;
+    unsigned mask;
+    size_t len;
+
+    if (n == 0) {
+        return 0;
+    }
+
+    zero = _mm_setzero_si128();
+
+    p = (const char *) ((uintptr_t) str & ~(uintptr_t) 15);
+
+    v = _mm_load_si128((const __m128i *) p);
+    mask = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+    mask &= 0xffffU << (str - p);
+
+    while (!mask) {
+        p += 16;
+
+        if ((size_t) (p - str) >= n) {
+            return n;
+        }
+
+        v = _mm_load_si128((const __m128i *) p);
+        mask = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+    }
+
+    len = p + __builtin_ctz(mask) - str;
+
+    return (len < n) ? len : n;
+}
+
+static SPR_TARGET_SSE2 SPR_NO_SANITIZE_ADDRESS char *
+spr_strchr_sse2(const char *str, int c)
+{
+    const char *p;
+    __m128i v, zero, pattern;
+    unsigned mask;
+    char ch;
+
+    ch = (char) c;
+
+    zero = _mm_setzero_si128();
+    pattern = _mm_set1_epi8(ch);
+
+    p = (const char *) ((uintptr_t) str & ~(uintptr_t) 15);
+
+    v = _mm_load_si128((const __m128i *) p);
+    mask = (unsigned) _mm_movemask_epi8(
+               _mm_or_si128(_mm_cmpeq_epi8(v, zero),
+                            _mm_cmpeq_epi8(v, pattern)));
+    mask &= 0xffffU << (str - p);
+
+    while (!mask) {
+        p += 16;
+        v = _mm_load_si128((const __m128i *) p);
+        mask = (unsigned) _mm_movemask_epi8(
+                   _mm_or_si128(_mm_cmpeq_epi8(v, zero),
+                                _mm_cmpeq_epi8(v, pattern)));
+    }
+
+    p += __builtin_ctz(mask);
+
+    return (*p == ch) ? (char *) p : NULL;
+}
+
+static SPR_TARGET_SSE2 SPR_NO_SANITIZE_ADDRESS char *
+spr_strrchr_sse2(const char *str, int c)
+{
+    const char *p, *last;
+    __m128i v, zero, pattern;
+    unsigned zmask, cmask;
+    char ch;
+
+    ch = (char) c;
+
+    if (ch == '\0') {
+        return (char *) str + spr_strlen_sse2(str);
+    }
+
+    zero = _mm_setzero_si128();
+    pattern = _mm_set1_epi8(ch);
+    last = NULL;
+
+    p = (const char *) ((uintptr_t) str & ~(uintptr_t) 15);
+
+    v = _mm_load_si128((const __m128i *) p);
+    zmask = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+    cmask = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, pattern));
+    zmask &= 0xffffU << (str - p);
+    cmask &= 0xffffU << (str - p);
+
+    while (!zmask) {
+
+        if (cmask) {
+            last = p + 31 - __builtin_clz(cmask);
+        }
+
+        p += 16;
+        v = _mm_load_si128((const __m128i *) p);
+        zmask = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+        cmask = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, pattern));
+    }
+
+    /* Drop matches past the terminator */
+    cmask &= zmask ^ (zmask - 1);
+
+    if (cmask) {
+        return (char *) p + 31 - __builtin_clz(cmask);
+    }
+
+    return (char *) last;
+}
+
+#endif
+
+#if (SPR_HAVE_AVX2)
+
+static SPR_TARGET_AVX2 SPR_NO_SANITIZE_ADDRESS size_t
+spr_strlen_avx2(const char *str)
+{
+    const char *p;
+    __m256i v, zero;
+    unsigned mask;
+
+    zero = _mm256_setzero_si256();
+
+    p = (const char *) ((uintptr_t) str & ~(uintptr_t) 31);
+
+    v = _mm256_load_si256((const __m256i *) p);
+    mask = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+    mask &= 0xffffffffU << (str - p);
+
+    while (!mask) {
+        p += 32;
+        v = _mm256_load_si256((const __m256i *) p);
+        mask = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+    }
+
+    return p + __builtin_ctz(mask) - str;
+}
+
+static SPR_TARGET_AVX2 SPR_NO_SANITIZE_ADDRESS size_t
+spr_strnlen_avx2(const char *str, size_t n)
+{
+    const char *p;
+    __m256i v, zero;
+    unsigned mask;
+    size_t len;
+
+    if (n == 0) {
+        return 0;
+    }
+
+    zero = _mm256_setzero_si256();
+
+    p = (const char *) ((uintptr_t) str & ~(uintptr_t) 31);
+
+    v = _mm256_load_si256((const __m256i *) p);
+    mask = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+    mask &= 0xffffffffU << (str - p);
+
+    while (!mask) {
+        p += 32;
+
+        if ((size_t) (p - str) >= n) {
+            return n;
+        }
+
+        v = _mm256_load_si256((const __m256i *) p);
+        mask = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+    }
+
+    len = p + __builtin_ctz(mask) - str;
+
+    return (len < n) ? len : n;
+}
+
+static SPR_TARGET_AVX2 SPR_NO_SANITIZE_ADDRESS char *
+spr_strchr_avx2(const char *str, int c)
+{
+    const char *p;
+    __m256i v, zero, pattern;
+    unsigned mask;
+    char ch;
+
+    ch = (char) c;
+
+    zero = _mm256_setzero_si256();
+    pattern = _mm256_set1_epi8(ch);
+
+    p = (const char *) ((uintptr_t) str & ~(uintptr_t) 31);
+
+    v = _mm256_load_si256((const __m256i *) p);
+    mask = (unsigned) _mm256_movemask_epi8(
+               _mm256_or_si256(_mm256_cmpeq_epi8(v, zero),
+                               _mm256_cmpeq_epi8(v, pattern)));
+    mask &= 0xffffffffU << (str - p);
+
+    while (!mask) {
+        p += 32;
+        v = _mm256_load_si256((const __m256i *) p);
+        mask = (unsigned) _mm256_movemask_epi8(
+                   _mm256_or_si256(_mm256_cmpeq_epi8(v, zero),
+                                   _mm256_cmpeq_epi8(v, pattern)));
+    }
+
+    p += __builtin_ctz(mask);
+
+    return (*p == ch) ? (char *) p : NULL;
+}
+
+static SPR_TARGET_AVX2 SPR_NO_SANITIZE_ADDRESS char *
+spr_strrchr_avx2(const char *str, int c)
+{
+    const char *p, *last;
+    __m256i v, zero, pattern;
+    unsigned zmask, cmask;
+    char ch;
+
+    ch = (char) c;
+
+    if (ch == '\0') {
+        return (char *) str + spr_strlen_avx2(str);
+    }
+
+    zero = _mm256_setzero_si256();
+    pattern = _mm256_set1_epi8(ch);
+    last = NULL;
+
+    p = (const char *) ((uintptr_t) str & ~(uintptr_t) 31);
+
+    v = _mm256_load_si256((const __m256i *) p);
+    zmask = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+    cmask = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, pattern));
+    zmask &= 0xffffffffU << (str - p);
+    cmask &= 0xffffffffU << (str - p);
+
+    while (!zmask) {
+
+        if (cmask) {
+            last = p + 31 - __builtin_clz(cmask);
+        }
+
+        p += 32;
+        v = _mm256_load_si256((const __m256i *) p);
+        zmask = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+        cmask = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, pattern));
+    }
+
+    /* Drop matches past the terminator */
+    cmask &= zmask ^ (zmask - 1);
+
+    if (cmask) {
+        return (char *) p + 31 - __builtin_clz(cmask);
+    }
+
+    return (char *) last;
+}
+
+#endif
+
+#if (SPR_HAVE_NEON)
+
+/* Four bits per byte of the comparison result */
+static uint64_t
+spr_str_neon_mask(uint8x16_t cmp)
+{
+    return vget_lane_u64(vreinterpret_u64_u8(
+               vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4)), 0);
+}
+
+static SPR_NO_SANITIZE_ADDRESS size_t
+spr_strlen_neon(const char *str)
+{
+    const char *p;
+    uint64_t mask;
+
+    p = (const char *) ((uintptr_t) str & ~(uintptr_t) 15);
+
+    mask = spr_str_neon_mask(vceqzq_u8(vld1q_u8((const uint8_t *) p)));
+    mask &= ~0ULL << ((str - p) * 4);
+
+    while (!mask) {
+        p += 16;
+        mask = spr_str_neon_mask(vceqzq_u8(vld1q_u8((const uint8_t *) p)));
+    }
+
+    return p + (__builtin_ctzll(mask) >> 2) - str;
+}
+
+static SPR_NO_SANITIZE_ADDRESS size_t
+spr_strnlen_neon(const char *str, size_t n)
+{
+    const char *p;
+    uint64_t mask;
+    size_t len;
+
+    if (n == 0) {
+        return 0;
+    }
+
+    p = (const char *) ((uintptr_t) str & ~(uintptr_t) 15);
+
+    mask = spr_str_neon_mask(vceqzq_u8(vld1q_u8((const uint8_t *) p)));
+    mask &= ~0ULL << ((str - p) * 4);
+
+    while (!mask) {
+        p += 16;
+
+        if ((size_t) (p - str) >= n) {
+            return n;
+        }
+
+        mask = spr_str_neon_mask(vceqzq_u8(vld1q_u8((const uint8_t *) p)));
+    }
+
+    len = p + (__builtin_ctzll(mask) >> 2) - str;
+
+    return (len < n) ? len : n;
+}
+
+static SPR_NO_SANITIZE_ADDRESS char *
+spr_strchr_neon(const char *str, int c)
+{
+    const char *p;
+    uint8x16_t v, pattern;
+    uint64_t mask;
+    char ch;
+
+    ch = (char) c;
+
+    pattern = vdupq_n_u8((uint8_t) ch);
+
+    p = (const char *) ((uintptr_t) str & ~(uintptr_t) 15);
+
+    v = vld1q_u8((const uint8_t *) p);
+    mask = spr_str_neon_mask(vorrq_u8(vceqzq_u8(v), vceqq_u8(v, pattern)));
+    mask &= ~0ULL << ((str - p) * 4);
+
+    while (!mask) {
+        p += 16;
+        v = vld1q_u8((const uint8_t *) p);
+        mask = spr_str_neon_mask(vorrq_u8(vceqzq_u8(v),
+                                          vceqq_u8(v, pattern)));
+    }
+
+    p += __builtin_ctzll(mask) >> 2;
+
+    return (*p == ch) ? (char *) p : NULL;
+}
+
+static SPR_NO_SANITIZE_ADDRESS char *
+spr_strrchr_neon(const char *str, int c)
+{
+    const char *p, *last;
+    uint8x16_t v, pattern;
+    uint64_t zmask, cmask;
+    char ch;
+
+    ch = (char) c;
+
+    if (ch == '\0') {
+        return (char *) str + spr_strlen_neon(str);
+    }
+
+    pattern = vdupq_n_u8((uint8_t) ch);
+    last = NULL;
+
+    p = (const char *) ((uintptr_t) str & ~(uintptr_t) 15);
+
+    v = vld1q_u8((const uint8_t *) p);
+    zmask = spr_str_neon_mask(vceqzq_u8(v));
+    cmask = spr_str_neon_mask(vceqq_u8(v, pattern));
+    zmask &= ~0ULL << ((str - p) * 4);
+    cmask &= ~0ULL << ((str - p) * 4);
+
+    while (!zmask) {
+
+        if (cmask) {
+            last = p + ((63 - __builtin_clzll(cmask)) >> 2);
+        }
+
+        p += 16;
+        v = vld1q_u8((const uint8_t *) p);
+        zmask = spr_str_neon_mask(vceqzq_u8(v));
+        cmask = spr_str_neon_mask(vceqq_u8(v, pattern));
+    }
+
+    /* Drop matches past the terminator */
+    cmask &= zmask ^ (zmask - 1);
+
+    if (cmask) {
+        return (char *) p + ((63 - __builtin_clzll(cmask)) >> 2);
+    }
+
+    return (char *) last;
+}
+
+#endif
+
+static spr_int_t
+spr_strncasecmp_scalar(const char *str1, const char *str2, size_t n)
+{
+    spr_uint_t c1, c2;
+
+    while (n) {
+        c1 = (spr_uint_t) *str1++;
+        c2 = (spr_uint_t) *str2++;
+
+        c1 = (c1 >= 'A' && c1 <= 'Z') ? (c1 | 0x20) : c1;
+        c2 = (c2 >= 'A' && c2 <= 'Z') ? (c2 | 0x20) : c2;
+
+        if (c1 == c2) {
+
+            if (c1) {
+                n--;
+                continue;
+            }
+
+            return 0;
+        }
+
+        return c1 - c2;
+    }
+
+    return 0;
+}
+
+static void
+spr_strlower_scalar(char *dst, const char *src, size_t n)
+{
+    while (n--) {
+        *dst++ = spr_tolower(*src);
+        src++;
+    }
+}
+
+static void
+spr_strupper_scalar(char *dst, const char *src, size_t n)
+{
+    while (n--) {
+        *dst++ = spr_toupper(*src);
+        src++;
+    }
+}
+
+#if (SPR_HAVE_SSE2)
+
+/* Flips bit 0x20 of every byte in [first, first + 25] */
+static SPR_TARGET_SSE2 __m128i
+spr_str_flip_case_sse2(__m128i v, char first)
+{
+    __m128i range;
+
+    range = _mm_add_epi8(v, _mm_set1_epi8((char) (0x80 - first)));
+    range = _mm_cmpgt_epi8(_mm_set1_epi8((char) (-128 + 26)), range);
+    range = _mm_and_si128(range, _mm_set1_epi8(0x20));
+
+    return _mm_xor_si128(v, range);
+}
+
+static SPR_TARGET_SSE2 SPR_NO_SANITIZE_ADDRESS spr_int_t
+spr_strncasecmp_sse2(const char *str1, const char *str2, size_t n)
+{
+    __m128i v1, v2, z, zero;
+    spr_uint_t c1, c2;
+    unsigned mask;
+
+    zero = _mm_setzero_si128();
+
+    for ( ;; ) {
+
+        if (n >= 16
+            && !spr_str_page_cross(str1, 16)
+            && !spr_str_page_cross(str2, 16))
+        {
+            v1 = _mm_loadu_si128((const __m128i *) str1);
+            v2 = _mm_loadu_si128((const __m128i *) str2);
+
+            z = _mm_cmpeq_epi8(v1, zero);
+
+            v1 = spr_str_flip_case_sse2(v1, 'A');
+            v2 = spr_str_flip_case_sse2(v2, 'A');
+
+            mask = ~(unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v1, v2));
+            mask |= (unsigned) _mm_movemask_epi8(z);
+            mask &= 0xffffU;
+
+            if (mask == 0) {
+                str1 += 16;
+                str2 += 16;
+                n -= 16;
+                continue;
+            }
+
+            /* Let the byte loop decide at the first difference or NUL */
+            mask = __builtin_ctz(mask);
+            str1 += mask;
+            str2 += mask;
+            n -= mask;
+        }
+
+        if (n == 0) {
+            return 0;
+        }
+
+        c1 = (spr_uint_t) *str1++;
+        c2 = (spr_uint_t) *str2++;
+        n--;
+
+        c1 = (c1 >= 'A' && c1 <= 'Z') ? (c1 | 0x20) : c1;
+        c2 = (c2 >= 'A' && c2 <= 'Z') ? (c2 | 0x20) : c2;
+
+        if (c1 != c2) {
+            return c1 - c2;
+        }
+
+        if (c1 == 0) {
+            return 0;
+        }
+    }
+}
+
+static SPR_TARGET_SSE2 void
+spr_strlower_sse2(char *dst, const char *src, size_t n)
+{
+    __m128i v;
+
+    for ( ; n >= 16; n -= 16, src += 16, dst += 16) {
+        v = _mm_loadu_si128((const __m128i *) src);
+        _mm_storeu_si128((__m128i *) dst, spr_str_flip_case_sse2(v, 'A'));
+    }
+
+    spr_strlower_scalar(dst, src, n);
+}
+
+static SPR_TARGET_SSE2 void
+spr_strupper_sse2(char *dst, const char *src, size_t n)
+{
+    __m128i v;
+
+    for ( ; n >= 16; n -= 16, src += 16, dst += 16) {
+        v = _mm_loadu_si128((const __m128i *) src);
+        _mm_storeu_si128((__m128i *) dst, spr_str_flip_case_sse2(v, 'a'));
+    }
+
+    spr_strupper_scalar(dst, src, n);
+}
+
+#endif
+
+#if (SPR_HAVE_AVX2)
+
+/* Flips bit 0x20 of every byte in [first, first + 25] */
+static SPR_TARGET_AVX2 __m256i
+spr_str_flip_case_avx2(__m256i v, char first)
+{
+    __m256i range;
+
+    range = _mm256_add_epi8(v, _mm256_set1_epi8((char) (0x80 - first)));
+    range = _mm256_cmpgt_epi8(_mm256_set1_epi8((char) (-128 + 26)), range);
+    range = _mm256_and_si256(range, _mm256_set1_epi8(0x20));
+
+    return _mm256_xor_si256(v, range);
+}
+
+static SPR_TARGET_AVX2 SPR_NO_SANITIZE_ADDRESS spr_int_t
+spr_strncasecmp_avx2(const char *str1, const char *str2, size_t n)
+{
+    __m256i v1, v2, z, zero;
+    spr_uint_t c1, c2;
+    unsigned mask;
+
+    zero = _mm256_setzero_si256();
+
+    for ( ;; ) {
+
+        if (n >= 32
+            && !spr_str_page_cross(str1, 32)
+            && !spr_str_page_cross(str2, 32))
+        {
+            v1 = _mm256_loadu_si256((const __m256i *) str1);
+            v2 = _mm256_loadu_si256((const __m256i *) str2);
+
+            z = _mm256_cmpeq_epi8(v1, zero);
+
+            v1 = spr_str_flip_case_avx2(v1, 'A');
+            v2 = spr_str_flip_case_avx2(v2, 'A');
+
+            mask = ~(unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v1, v2));
+            mask |= (unsigned) _mm256_movemask_epi8(z);
+
+            if (mask == 0) {
+                str1 += 32;
+                str2 += 32;
+                n -= 32;
+                continue;
+            }
+
+            /* Let the byte loop decide at the first difference or NUL */
+            mask = __builtin_ctz(mask);
+            str1 += mask;
+            str2 += mask;
+            n -= mask;
+        }
+
+        if (n == 0) {
+            return 0;
+        }
+
+        c1 = (spr_uint_t) *str1++;
+        c2 = (spr_uint_t) *str2++;
+        n--;
+
+        c1 = (c1 >= 'A' && c1 <= 'Z') ? (c1 | 0x20) : c1;
+        c2 = (c2 >= 'A' && c2 <= 'Z') ? (c2 | 0x20) : c2;
+
+        if (c1 != c2) {
+            return c1 - c2;
+        }
+
+        if (c1 == 0) {
+            return 0;
+        }
+    }
+}
+
+static SPR_TARGET_AVX2 void
+spr_strlower_avx2(char *dst, const char *src, size_t n)
+{
+    __m256i v;
+
+    for ( ; n >= 32; n -= 32, src += 32, dst += 32) {
+        v = _mm256_loadu_si256((const __m256i *) src);
+        _mm256_storeu_si256((__m256i *) dst, spr_str_flip_case_avx2(v, 'A'));
+    }
+
+    spr_strlower_scalar(dst, src, n);
+}
+
+static SPR_TARGET_AVX2 void
+spr_strupper_avx2(char *dst, const char *src, size_t n)
+{
+    __m256i v;
+
+    for ( ; n >= 32; n -= 32, src += 32, dst += 32) {
+        v = _mm256_loadu_si256((const __m256i *) src);
+        _mm256_storeu_si256((__m256i *) dst, spr_str_flip_case_avx2(v, 'a'));
+    }
+
+    spr_strupper_scalar(dst, src, n);
+}
+
+#endif
+
+#if (SPR_HAVE_NEON)
+
+/* Flips bit 0x20 of every byte in [first, first + 25] */
+static uint8x16_t
+spr_str_flip_case_neon(uint8x16_t v, char first)
+{
+    uint8x16_t range;
+
+    range = vcltq_u8(vsubq_u8(v, vdupq_n_u8((uint8_t) first)),
+                     vdupq_n_u8(26));
+
+    return veorq_u8(v, vandq_u8(range, vdupq_n_u8(0x20)));
+}
+
+static SPR_NO_SANITIZE_ADDRESS spr_int_t
+spr_strncasecmp_neon(const char *str1, const char *str2, size_t n)
+{
+    uint8x16_t v1, v2;
+    spr_uint_t c1, c2;
+    uint64_t mask;
+    size_t i;
+
+    for ( ;; ) {
+
+        if (n >= 16
+            && !spr_str_page_cross(str1, 16)
+            && !spr_str_page_cross(str2, 16))
+        {
+            v1 = vld1q_u8((const uint8_t *) str1);
+            v2 = vld1q_u8((const uint8_t *) str2);
+
+            mask = spr_str_neon_mask(vorrq_u8(
+                       vmvnq_u8(vceqq_u8(spr_str_flip_case_neon(v1, 'A'),
+                                         spr_str_flip_case_neon(v2, 'A'))),
+                       vceqzq_u8(v1)));
+
+            if (mask == 0) {
+                str1 += 16;
+                str2 += 16;
+                n -= 16;
+                continue;
+            }
+
+            /* Let the byte loop decide at the first difference or NUL */
+            i = __builtin_ctzll(mask) >> 2;
+            str1 += i;
+            str2 += i;
+            n -= i;
+        }
+
+        if (n == 0) {
+            return 0;
+        }
+
+        c1 = (spr_uint_t) *str1++;
+        c2 = (spr_uint_t) *str2++;
+        n--;
+
+        c1 = (c1 >= 'A' && c1 <= 'Z') ? (c1 | 0x20) : c1;
+        c2 = (c2 >= 'A' && c2 <= 'Z') ? (c2 | 0x20) : c2;
+
+        if (c1 != c2) {
+            return c1 - c2;
+        }
+
+        if (c1 == 0) {
+            return 0;
+        }
+    }
+}
+
+static void
+spr_strlower_neon(char *dst, const char *src, size_t n)
+{
+    for ( ; n >= 16; n -= 16, src += 16, dst += 16) {
+        vst1q_u8((uint8_t *) dst,
+            spr_str_flip_case_neon(vld1q_u8((const uint8_t *) src), 'A'));
+    }
+
+    spr_strlower_scalar(dst, src, n);
+}
+
+static void
+spr_strupper_neon(char *dst, const char *src, size_t n)
+{
+    for ( ; n >= 16; n -= 16, src += 16, dst += 16) {
+        vst1q_u8((uint8_t *) dst,
+            spr_str_flip_case_neon(vld1q_u8((const uint8_t *) src), 'a'));
+    }
+
+    spr_strupper_scalar(dst, src, n);
+}
+
+#endif
+
+/*
+ * Converts 8 ASCII digits at once: pairs, then quads, then the final
+ * value, each step a multiply and a shift on the whole word.
+ */
+static bool
+spr_str_parse8(const char *p, uint64_t *value)
+{
+    uint64_t x;
+
+    spr_memcpy(&x, p, sizeof(uint64_t));
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    x = __builtin_bswap64(x);
+#endif
+
+    if ((x & 0xf0f0f0f0f0f0f0f0ULL) != 0x3030303030303030ULL
+        || ((x + 0x0606060606060606ULL) & 0xf0f0f0f0f0f0f0f0ULL)
+           != 0x3030303030303030ULL)
+    {
+        return false;
+    }
+
+    x -= 0x3030303030303030ULL;
+    x = (x * 10) + (x >> 8);
+    x = (((x & 0x000000ff000000ffULL) * (100 + (1000000ULL << 32)))
+         + (((x >> 16) & 0x000000ff000000ffULL) * (1 + (10000ULL << 32))))
+        >> 32;
+
+    *value = (uint32_t) x;
+
+    return true;
+}
+
+static bool
+spr_str_parse16_scalar(const char *p, uint64_t *value)
+{
+    uint64_t high, low;
+
+    if (!spr_str_parse8(p, &high) || !spr_str_parse8(p + 8, &low)) {
+        return false;
+    }
+
+    *value = high * 100000000ULL + low;
+
+    return true;
+}
+
+#if (SPR_HAVE_SSE42)
+
+static SPR_TARGET_SSE42 bool
+spr_str_parse16_sse42(const char *p, uint64_t *value)
+{
+    __m128i v, nine;
+    uint32_t high, low;
+
+    nine = _mm_set1_epi8(9);
+
+    v = _mm_loadu_si128((const __m128i *) p);
+    v = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, nine), nine))
+        != 0xffff)
+    {
+        return false;
+    }
+
+    v = _mm_maddubs_epi16(v, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1,
+                                           10, 1, 10, 1, 10, 1, 10, 1));
+    v = _mm_madd_epi16(v, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+    v = _mm_packus_epi32(v, v);
+    v = _mm_madd_epi16(v, _mm_setr_epi16(10000, 1, 10000, 1,
+                                         10000, 1, 10000, 1));
+
+    high = (uint32_t) _mm_cvtsi128_si32(v);
+    low = (uint32_t) _mm_extract_epi32(v, 1);
+
+    *value = high * 100000000ULL + low;
+
+    return true;
+}
+
+#endif
+
+/*
+ * Two-Way string matching (Crochemore and Perrin): the needle is split at
+ * a critical factorization, the right part is matched left to right and
+ * the left part right to left, which bounds the search to linear time
+ * without any per-needle table.
+ */
+static size_t
+spr_memmem_factorize(const uint8_t *needle, size_t nlen, size_t *period)
+{
+    size_t max_suffix, max_suffix_rev, j, k, p;
+    uint8_t a, b;
+
+    /* Maximal suffix for the forward order, SIZE_MAX stands for -1 */
+    max_suffix = SIZE_MAX;
+    j = 0;
+    k = p = 1;
+
+    while (j + k < nlen) {
+        a = needle[j + k];
+        b = needle[max_suffix + k];
+
+        if (a < b) {
+            j += k;
+            k = 1;
+            p = j - max_suffix;
+
+        } else if (a == b) {
+
+            if (k != p) {
+                k++;
+
+            } else {
+                j += p;
+                k = 1;
+            }
+
+        } else {
+            max_suffix = j++;
+            k = p = 1;
+        }
+    }
+
+    *period = p;
+
+    /* And for the reverse order */
+    max_suffix_rev = SIZE_MAX;
+    j = 0;
+    k = p = 1;
+
+    while (j + k < nlen) {
+        a = needle[j + k];
+        b = needle[max_suffix_rev + k];
+
+        if (b < a) {
+            j += k;
+            k = 1;
+            p = j - max_suffix_rev;
+
+        } else if (a == b) {
+
+            if (k != p) {
+                k++;
+
+            } else {
+                j += p;
+                k = 1;
+            }
+
+        } else {
+            max_suffix_rev = j++;
+            k = p = 1;
+        }
+    }
+
+    if (max_suffix_rev + 1 < max_suffix + 1) {
+        return max_suffix + 1;
+    }
+
+    *period = p;
+
+    return max_suffix_rev + 1;
+}
+
+static const uint8_t *
+spr_memmem_twoway(const uint8_t *haystack, size_t hlen,
+    const uint8_t *needle, size_t nlen)
+{
+    size_t suffix, period, memory, i, j;
+
+    suffix = spr_memmem_factorize(needle, nlen, &period);
+
+    if (spr_memcmp(needle, needle + period, suffix) == 0) {
+
+        /* Periodic needle, remember how much of the period has matched */
+        memory = 0;
+
+        for (j = 0; j <= hlen - nlen; /* void */) {
+            i = (suffix > memory) ? suffix : memory;
+
+            while (i < nlen && needle[i] == haystack[i + j]) {
+                i++;
+            }
+
+            if (i < nlen) {
+                j += i - suffix + 1;
+                memory = 0;
+                continue;
+            }
+
+            i = suffix - 1;
+
+            while (memory < i + 1 && needle[i] == haystack[i + j]) {
+                i--;
+            }
+
+            if (i + 1 < memory + 1) {
+                return haystack + j;
+            }
+
+            j += period;
+            memory = nlen - period;
+        }
+
+        return NULL;
+    }
+
+    period = ((suffix > nlen - suffix) ? suffix : nlen - suffix) + 1;
+
+    for (j = 0; j <= hlen - nlen; /* void */) {
+        i = suffix;
+
+        while (i < nlen && needle[i] == haystack[i + j]) {
+            i++;
+        }
+
+        if (i < nlen) {
+            j += i - suffix + 1;
+            continue;
+        }
+
+        i = suffix - 1;
+
+        while (i != SIZE_MAX && needle[i] == haystack[i + j]) {
+            i--;
+        }
+
+        if (i == SIZE_MAX) {
+            return haystack + j;
+        }
+
+        j += period;
+    }
+
+    return NULL;
+}
+
+static const uint8_t *
+spr_memmem_short_scalar(const uint8_t *haystack, size_t hlen,
+    const uint8_t *needle, size_t nlen)
+{
+    const uint8_t *p, *end;
+
+    /* The vector tails pass what is left, it may be shorter than needle */
+    if (hlen < nlen) {
+        return NULL;
+    }
+
+    end = haystack + (hlen - nlen) + 1;
+
+    for (p = haystack; p < end; p++) {
+        p = spr_memchr(p, needle[0], end - p);
+        if (p == NULL) {
+            return NULL;
+        }
+
+        if (p[nlen - 1] == needle[nlen - 1]
+            && spr_memcmp(p + 1, needle + 1, nlen - 2) == 0)
+        {
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+#if (SPR_HAVE_SSE2)
+
+static SPR_TARGET_SSE2 const uint8_t *
+spr_memmem_short_sse2(const uint8_t *haystack, size_t hlen,
+    const uint8_t *needle, size_t nlen)
+{
+    __m128i first, last, block_first, block_last;
+    unsigned mask, bit;
+    size_t i;
+
+    first = _mm_set1_epi8((char) needle[0]);
+    last = _mm_set1_epi8((char) needle[nlen - 1]);
+
+    for (i = 0; hlen - i >= nlen - 1 + 16; i += 16) {
+        block_first = _mm_loadu_si128((const __m128i *) (haystack + i));
+        block_last = _mm_loadu_si128((const __m128i *)
+                                     (haystack + i + nlen - 1));
+
+        mask = (unsigned) _mm_movemask_epi8(
+                   _mm_and_si128(_mm_cmpeq_epi8(block_first, first),
+                                 _mm_cmpeq_epi8(block_last, last)));
+
+        while (mask) {
+            bit = __builtin_ctz(mask);
+
+            if (spr_memcmp(haystack + i + bit + 1, needle + 1, nlen - 2)
+                == 0)
+            {
+                return haystack + i + bit;
+            }
+
+            mask &= mask - 1;
+        }
+    }
+
+    return spr_memmem_short_scalar(haystack + i, hlen - i, needle, nlen);
+}
+
+#endif
+
+#if (SPR_HAVE_AVX2)
+
+static SPR_TARGET_AVX2 const uint8_t *
+spr_memmem_short_avx2(const uint8_t *haystack, size_t hlen,
+    const uint8_t *needle, size_t nlen)
+{
+    __m256i first, last, block_first, block_last;
+    unsigned mask, bit;
+    size_t i;
+
+    first = _mm256_set1_epi8((char) needle[0]);
+    last = _mm256_set1_epi8((char) needle[nlen - 1]);
+
+    for (i = 0; hlen - i >= nlen - 1 + 32; i += 32) {
+        block_first = _mm256_loadu_si256((const __m256i *) (haystack + i));
+        block_last = _mm256_loadu_si256((const __m256i *)
+                                        (haystack + i + nlen - 1));
+
+        mask = (unsigned) _mm256_movemask_epi8(
+                   _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+                                    _mm256_cmpeq_epi8(block_last, last)));
+
+        while (mask) {
+            bit = __builtin_ctz(mask);
+
+            if (spr_memcmp(haystack + i + bit + 1, needle + 1, nlen - 2)
+                == 0)
+            {
+                return haystack + i + bit;
+            }
+
+            mask &= mask - 1;
+        }
+    }
+
+    return spr_memmem_short_scalar(haystack + i, hlen - i, needle, nlen);
+}
+
+#endif
+
+#if (SPR_HAVE_NEON)
+
+static const uint8_t *
+spr_memmem_short_neon(const uint8_t *haystack, size_t hlen,
+    const uint8_t *needle, size_t nlen)
+{
+    uint8x16_t first, last, block_first, block_last;
+    spr_uint_t bit;
+    uint64_t mask;
+    size_t i;
+
+    first = vdupq_n_u8(needle[0]);
+    last = vdupq_n_u8(needle[nlen - 1]);
+
+    for (i = 0; hlen - i >= nlen - 1 + 16; i += 16) {
+        block_first = vld1q_u8(haystack + i);
+        block_last = vld1q_u8(haystack + i + nlen - 1);
+
+        /* Keep one bit per byte so that clearing it moves to the next */
+        mask = spr_str_neon_mask(vandq_u8(vceqq_u8(block_first, first),
+                                          vceqq_u8(block_last, last)));
+        mask &= 0x8888888888888888ULL;
+
+        while (mask) {
+            bit = __builtin_ctzll(mask) >> 2;
+
+            if (spr_memcmp(haystack + i + bit + 1, needle + 1, nlen - 2)
+                == 0)
+            {
+                return haystack + i + bit;
+            }
+
+            mask &= mask - 1;
+        }
+    }
+
+    return spr_memmem_short_scalar(haystack + i, hlen - i, needle, nlen);
+}
+
+#endif
+
+static void
+spr_string_dispatch(void)
+{
+    spr_strlen_pt strlen_impl;
+    spr_strnlen_pt strnlen_impl;
+    spr_strchr_pt strchr_impl, strrchr_impl;
+    spr_strncasecmp_pt strncasecmp_impl;
+    spr_strcase_pt strlower_impl, strupper_impl;
+    spr_str_parse16_pt parse16;
+    spr_memmem_pt memmem_short;
+
+    strlen_impl = spr_strlen_scalar;
+    strnlen_impl = spr_strnlen_scalar;
+    strchr_impl = spr_strchr_scalar;
+    strrchr_impl = spr_strrchr_scalar;
+    strncasecmp_impl = spr_strncasecmp_scalar;
+    strlower_impl = spr_strlower_scalar;
+    strupper_impl = spr_strupper_scalar;
+    parse16 = spr_str_parse16_scalar;
+    memmem_short = spr_memmem_short_scalar;
+
+#if (SPR_HAVE_SSE2)
+    if (spr_cpu_has_feature(SPR_CPU_FEATURE_SSE2)) {
+        strlen_impl = spr_strlen_sse2;
+        strnlen_impl = spr_strnlen_sse2;
+        strchr_impl = spr_strchr_sse2;
+        strrchr_impl = spr_strrchr_sse2;
+        strncasecmp_impl = spr_strncasecmp_sse2;
+        strlower_impl = spr_strlower_sse2;
+        strupper_impl = spr_strupper_sse2;
+        memmem_short = spr_memmem_short_sse2;
+    }
+#endif
+
+#if (SPR_HAVE_SSE42)
+    if (spr_cpu_has_feature(SPR_CPU_FEATURE_SSE42)) {
+        parse16 = spr_str_parse16_sse42;
+    }
+#endif
+
+#if (SPR_HAVE_AVX2)
+    if (spr_cpu_has_feature(SPR_CPU_FEATURE_AVX2)) {
+        strlen_impl = spr_strlen_avx2;
+        strnlen_impl = spr_strnlen_avx2;
+        strchr_impl = spr_strchr_avx2;
+        strrchr_impl = spr_strrchr_avx2;
+        strncasecmp_impl = spr_strncasecmp_avx2;
+        strlower_impl = spr_strlower_avx2;
+        strupper_impl = spr_strupper_avx2;
+        memmem_short = spr_memmem_short_avx2;
+    }
+#endif
+
+#if (SPR_HAVE_NEON)
+    if (spr_cpu_has_feature(SPR_CPU_FEATURE_NEON)) {
+        strlen_impl = spr_strlen_neon;
+        strnlen_impl = spr_strnlen_neon;
+        strchr_impl = spr_strchr_neon;
+        strrchr_impl = spr_strrchr_neon;
+        strncasecmp_impl = spr_strncasecmp_neon;
+        strlower_impl = spr_strlower_neon;
+        strupper_impl = spr_strupper_neon;
+        memmem_short = spr_memmem_short_neon;
+    }
+#endif
+
+    /* Concurrent first calls may all get here, each stores the same set */
+
+    spr_atomic_store(&spr_memmem_short, memmem_short);
+    spr_atomic_store(&spr_str_parse16, parse16);
+    spr_atomic_store(&spr_strupper_impl, strupper_impl);
+    spr_atomic_store(&spr_strlower_impl, strlower_impl);
+    spr_atomic_store(&spr_strncasecmp_impl, strncasecmp_impl);
+    spr_atomic_store(&spr_strrchr_impl, strrchr_impl);
+    spr_atomic_store(&spr_strchr_impl, strchr_impl);
+    spr_atomic_store(&spr_strnlen_impl, strnlen_impl);
+    spr_atomic_store(&spr_strlen_impl, strlen_impl);
+}
+
+static size_t
+spr_strlen_init(const char *str)
+{
+    spr_string_dispatch();
+    return spr_atomic_load(&spr_strlen_impl)(str);
+}
+
+static size_t
+spr_strnlen_init(const char *str, size_t n)
+{
+    spr_string_dispatch();
+    return spr_atomic_load(&spr_strnlen_impl)(str, n);
+}
+
+static char *
+spr_strchr_init(const char *str, int c)
+{
+    spr_string_dispatch();
+    return spr_atomic_load(&spr_strchr_impl)(str, c);
+}
+
+static char *
+spr_strrchr_init(const char *str, int c)
+{
+    spr_string_dispatch();
+    return spr_atomic_load(&spr_strrchr_impl)(str, c);
+}
+
+static spr_int_t
+spr_strncasecmp_init(const char *str1, const char *str2, size_t n)
+{
+    spr_string_dispatch();
+    return spr_atomic_load(&spr_strncasecmp_impl)(str1, str2, n);
+}
+
+static void
+spr_strlower_init(char *dst, const char *src, size_t n)
+{
+    spr_string_dispatch();
+    spr_atomic_load(&spr_strlower_impl)(dst, src, n);
+}
+
+static void
+spr_strupper_init(char *dst, const char *src, size_t n)
+{
+    spr_string_dispatch();
+    spr_atomic_load(&spr_strupper_impl)(dst, src, n);
+}
+
+static bool
+spr_str_parse16_init(const char *p, uint64_t *value)
+{
+    spr_string_dispatch();
+    return spr_atomic_load(&spr_str_parse16)(p, value);
+}
+
+static const uint8_t *
+spr_memmem_short_init(const uint8_t *haystack, size_t hlen,
+    const uint8_t *needle, size_t nlen)
+{
+    spr_string_dispatch();
+    return spr_atomic_load(&spr_memmem_short)(haystack, hlen, needle, nlen);
+}
+
+/*
+ * Parses plain decimal digits, no sign or spaces, and fails if the value
+ * exceeds max.
+ */
+static spr_err_t
+spr_str_atou(const char *str, size_t n, uint64_t max, uint64_t *value)
+{
+    uint64_t result, chunk, digit;
+
+    if (n == 0) {
+        return SPR_FAILED;
+    }
+
+    /* Leading zeros do not count towards the overflow limit */
+    while (n && *str == '0') {
+        str++;
+        n--;
+    }
+
+    if (n > SPR_STR_U64_SAFE_DIGITS + 1) {
+        return SPR_FAILED;
+    }
+
+    result = 0;
+
+    if (n >= 16) {
+
+        if (!spr_atomic_load(&spr_str_parse16)(str, &result)) {
+            return SPR_FAILED;
+        }
+
+        str += 16;
+        n -= 16;
+    }
+
+    if (n >= 8) {
+
+        if (!spr_str_parse8(str, &chunk)) {
+            return SPR_FAILED;
+        }
+
+        result = chunk;
+        str += 8;
+        n -= 8;
+    }
+
+    for ( ; n; str++, n--) {
+        digit = (uint8_t) (*str - '0');
+
+        if (digit > 9 || result > (max - digit) / 10) {
+            return SPR_FAILED;
+        }
+
+        result = result * 10 + digit;
+    }
+
+    if (result > max) {
+        return SPR_FAILED;
+    }
+
+    *value = result;
+
+    return SPR_OK;
+}
+
+static spr_uint_t
+spr_str_count_digits(uint64_t value)
+{
+    spr_uint_t n;
+
+    for (n = 1; ; n += 4) {
+
+        if (value < 10) {
+            return n;
+        }
+
+        if (value < 100) {
+            return n + 1;
+        }
+
+        if (value < 1000) {
+            return n + 2;
+        }
+
+        if (value < 10000) {
+            return n + 3;
+        }
+
+        value /= 10000;
+    }
+}
 
 spr_int_t
 spr_atoi(const char *str, size_t n)
 {
-    spr_int_t value, temp;
-    spr_int_t cutoff, cutlim;
-    spr_uint_t i;
+    uint64_t value;
+
+    if (spr_str_atou(str, n, SPR_INT_T_MAX, &value) != SPR_OK) {
+        return -1;
+    }
+
+    return (spr_int_t) value;
+}
+
+ssize_t
+spr_atosz(const char *str, size_t n)
+{
+    uint64_t value;
 
-    if (n == 0) {
+    if (spr_str_atou(str, n, SPR_SSIZE_T_MAX, &value) != SPR_OK) {
         return -1;
     }
 
-    cutoff = SPR_INT_T_MAX / 10;
-    cutlim = SPR_INT_T_MAX % 10;
+    return (ssize_t) value;
+}
 
-    value = 0;
+spr_err_t
+spr_atou64(const char *str, size_t n, uint64_t *value)
+{
+    return spr_str_atou(str, n, SPR_UINT64_MAX_VALUE, value);
+}
 
-    for (i = 0; i < n; ++i) {
-        if (str[i] < '0' || str[i] > '9') {
-            return -1;
-        }
+spr_err_t
+spr_atoi64(const char *str, size_t n, int64_t *value)
+{
+    uint64_t result;
+    bool negative;
 
-        temp = str[i] - '0';
+    negative = false;
 
-        if (value >= cutoff && (value > cutoff || temp > cutlim)) {
-            return -1;
-        }
+    if (n && (*str == '-' || *str == '+')) {
+        negative = (*str == '-');
+        str++;
+        n--;
+    }
 
-        value = value * 10 + temp;
+    if (spr_str_atou(str, n, SPR_INT64_MAX_VALUE + negative, &result)
+        != SPR_OK)
+    {
+        return SPR_FAILED;
     }
 
-    return value;
+    *value = negative ? (int64_t) (0 - result) : (int64_t) result;
+
+    return SPR_OK;
 }
 
-ssize_t
-spr_atosz(const char *str, size_t n)
+spr_err_t
+spr_hextou64(const char *str, size_t n, uint64_t *value)
 {
-    ssize_t value, temp;
-    ssize_t cutoff, cutlim;
-    spr_uint_t i;
+    uint64_t result;
+    uint8_t c;
 
     if (n == 0) {
-        return -1;
+        return SPR_FAILED;
     }
 
-    cutoff = SPR_SSIZE_T_MAX / 10;
-    cutlim = SPR_SSIZE_T_MAX % 10;
+    while (n && *str == '0') {
+        str++;
+        n--;
+    }
+
+    if (n > 2 * sizeof(uint64_t)) {
+        return SPR_FAILED;
+    }
 
-    value = 0;
+    for (result = 0; n; str++, n--) {
+        c = (uint8_t) *str;
 
-    for (i = 0; i < n; ++i) {
-        if (str[i] < '0' || str[i] > '9') {
-            return -1;
-        }
+        if (c >= '0' && c <= '9') {
+            c -= '0';
 
-        temp = str[i] - '0';
+        } else {
+            c |= 0x20;
 
-        if (value >= cutoff && (value > cutoff || temp > cutlim)) {
-            return -1;
+            if (c < 'a' || c > 'f') {
+                return SPR_FAILED;
+            }
+
+            c -= 'a' - 10;
         }
 
-        value = value * 10 + temp;
+        result = (result << 4) | c;
     }
 
-    return value;
+    *value = result;
+
+    return SPR_OK;
 }
 
 size_t
-spr_strlen(const char *str)
+spr_u64toa(uint64_t value, char *buf)
 {
     spr_uint_t i;
+    size_t len;
+    char *p;
 
-    for (i = 0; ; ++i) {
+    len = spr_str_count_digits(value);
 
-        if (str[i] == '\0') {
-            return i;
-        }
+    p = buf + len;
+    *p = '\0';
+
+    while (value >= 100) {
+        i = (spr_uint_t) (value % 100) * 2;
+        value /= 100;
+
+        *--p = spr_str_digits2[i + 1];
+        *--p = spr_str_digits2[i];
+    }
+
+    if (value >= 10) {
+        i = (spr_uint_t) value * 2;
+
+        *--p = spr_str_digits2[i + 1];
+        *--p = spr_str_digits2[i];
+
+    } else {
+        *--p = (char) ('0' + value);
     }
+
+    return len;
 }
 
 size_t
-spr_strnlen(const char *str, size_t n)
+spr_i64toa(int64_t value, char *buf)
 {
-    spr_uint_t i;
+    if (value < 0) {
+        *buf = '-';
+        return spr_u64toa(0 - (uint64_t) value, buf + 1) + 1;
+    }
 
-    for (i = 0; i < n; ++i) {
+    return spr_u64toa((uint64_t) value, buf);
+}
 
-        if (str[i] == '\0') {
-            return i;
-        }
-    }
+size_t
+spr_u64tohex(uint64_t value, char *buf)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t len;
+    char *p;
+
+    len = (64 - __builtin_clzll(value | 1) + 3) / 4;
+
+    p = buf + len;
+    *p = '\0';
 
-    return n;
+    do {
+        *--p = hex[value & 0xf];
+        value >>= 4;
+    } while (p != buf);
+
+    return len;
 }
 
-spr_int_t
-spr_strcasecmp(char *str1, char *str2)
+char *
+spr_pu64toa(spr_pool_t *pool, uint64_t value)
 {
-    spr_uint_t c1, c2;
+    char buf[SPR_UINT64_MAX_LEN + 1];
+    size_t len;
 
-    for ( ; ; ) {
-        c1 = (spr_uint_t) *str1++;
-        c2 = (spr_uint_t) *str2++;
+    len = spr_u64toa(value, buf);
 
-        c1 = (c1 >= 'A' && c1 <= 'Z') ? (c1 | 0x20) : c1;
-        c2 = (c2 >= 'A' && c2 <= 'Z') ? (c2 | 0x20) : c2;
+    return spr_pstrndup(pool, buf, len);
+}
 
-        if (c1 == c2) {
+char *
+spr_pi64toa(spr_pool_t *pool, int64_t value)
+{
+    char buf[SPR_INT64_MAX_LEN + 1];
+    size_t len;
 
-            if (c1) {
-                continue;
-            }
+    len = spr_i64toa(value, buf);
 
-            return 0;
-        }
+    return spr_pstrndup(pool, buf, len);
+}
 
-        return c1 - c2;
-    }
+size_t
+spr_strlen(const char *str)
+{
+    return spr_atomic_load(&spr_strlen_impl)(str);
+}
+
+size_t
+spr_strnlen(const char *str, size_t n)
+{
+    return spr_atomic_load(&spr_strnlen_impl)(str, n);
 }
 
 spr_int_t
-spr_strncasecmp(char *str1, char *str2, size_t n)
+spr_strcasecmp(const char *str1, const char *str2)
 {
-    spr_uint_t c1, c2;
+    return spr_atomic_load(&spr_strncasecmp_impl)(str1, str2, (size_t) -1);
+}
 
-    while (n) {
-        c1 = (spr_uint_t) *str1++;
-        c2 = (spr_uint_t) *str2++;
+spr_int_t
+spr_strncasecmp(const char *str1, const char *str2, size_t n)
+{
+    return spr_atomic_load(&spr_strncasecmp_impl)(str1, str2, n);
+}
 
-        c1 = (c1 >= 'A' && c1 <= 'Z') ? (c1 | 0x20) : c1;
-        c2 = (c2 >= 'A' && c2 <= 'Z') ? (c2 | 0x20) : c2;
+void
+spr_strlower(char *str, size_t n)
+{
+    spr_atomic_load(&spr_strlower_impl)(str, str, n);
+}
 
-        if (c1 == c2) {
+void
+spr_strupper(char *str, size_t n)
+{
+    spr_atomic_load(&spr_strupper_impl)(str, str, n);
+}
 
-            if (c1) {
-                n--;
-                continue;
-            }
+uint64_t
+spr_strcasehash(const char *str, size_t n, uint64_t seed)
+{
+    char buf[SPR_STR_CASEHASH_CHUNK];
+    spr_hash_state_t state;
+    size_t size;
 
-            return 0;
-        }
+    if (n <= SPR_STR_CASEHASH_CHUNK) {
+        spr_atomic_load(&spr_strlower_impl)(buf, str, n);
+        return spr_hash64(buf, n, seed);
+    }
 
-        return c1 - c2;
+    spr_hash_init(&state, seed);
+
+    while (n) {
+        size = (n < SPR_STR_CASEHASH_CHUNK) ? n : SPR_STR_CASEHASH_CHUNK;
+
+        spr_atomic_load(&spr_strlower_impl)(buf, str, size);
+        spr_hash_update(&state, buf, size);
+
+        str += size;
+        n -= size;
     }
 
-    return 0;
+    return spr_hash64_final(&state);
 }
 
 char *
 spr_strchr(const char *str, int c)
 {
-    size_t len, i;
+    return spr_atomic_load(&spr_strchr_impl)(str, c);
+}
+
+char *
+spr_strrchr(const char *str, int c)
+{
+    return spr_atomic_load(&spr_strrchr_impl)(str, c);
+}
 
-    len = spr_strlen(str);
+void *
+spr_memmem(const void *haystack, size_t hlen, const void *needle,
+    size_t nlen)
+{
+    const uint8_t *h, *n;
 
-    for (i = 0; i < len; ++i) {
+    h = haystack;
+    n = needle;
 
-        if (str[i] == c) {
-            return (char *) &str[i];
-        }
+    if (nlen == 0) {
+        return (void *) h;
     }
-    return NULL;
+
+    if (nlen > hlen) {
+        return NULL;
+    }
+
+    if (nlen == 1) {
+        return spr_memchr(h, n[0], hlen);
+    }
+
+    if (nlen <= SPR_STR_MEMMEM_SHORT) {
+        return (void *) spr_atomic_load(&spr_memmem_short)(h, hlen, n, nlen);
+    }
+
+    return (void *) spr_memmem_twoway(h, hlen, n, nlen);
 }
 
 char *
-spr_strrchr(const char *str, int c)
+spr_strstr(const char *haystack, const char *needle)
 {
-    size_t len;
-    spr_int_t i;
+    size_t nlen;
 
-    len = spr_strlen(str);
+    nlen = spr_strlen(needle);
 
-    for (i = len; i >= 0; i--) {
+    if (nlen == 0) {
+        return (char *) haystack;
+    }
 
-        if (str[i] == c) {
-            return (char *) &str[i];
-        }
+    if (nlen == 1) {
+        return spr_strchr(haystack, needle[0]);
     }
-    return NULL;
+
+    return spr_memmem(haystack, spr_strlen(haystack), needle, nlen);
 }
 
 char *
@@ -284,3 +2080,244 @@ spr_pstrcat1(spr_pool_t *pool, ...)
 
     return str;
 }
+
+spr_int_t
+spr_str_cmp(const spr_str_t *str1, const spr_str_t *str2)
+{
+    spr_int_t rc;
+    size_t n;
+
+    n = (str1->len < str2->len) ? str1->len : str2->len;
+
+    if (n) {
+        rc = spr_memcmp(str1->data, str2->data, n);
+
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    return (str1->len > str2->len) - (str1->len < str2->len);
+}
+
+/* Case-insensitive memcmp(), NUL is an ordinary byte */
+static spr_int_t
+spr_memcasecmp(const uint8_t *p1, const uint8_t *p2, size_t n)
+{
+    spr_uint_t c1, c2;
+
+    for ( ; n; n--) {
+        c1 = *p1++;
+        c2 = *p2++;
+
+        if (c1 == c2) {
+            continue;
+        }
+
+        c1 = (c1 >= 'A' && c1 <= 'Z') ? (c1 | 0x20) : c1;
+        c2 = (c2 >= 'A' && c2 <= 'Z') ? (c2 | 0x20) : c2;
+
+        if (c1 != c2) {
+            return (spr_int_t) c1 - (spr_int_t) c2;
+        }
+    }
+
+    return 0;
+}
+
+spr_int_t
+spr_str_casecmp(const spr_str_t *str1, const spr_str_t *str2)
+{
+    spr_int_t rc;
+
+    rc = spr_memcasecmp((const uint8_t *) str1->data,
+                        (const uint8_t *) str2->data,
+                        (str1->len < str2->len) ? str1->len : str2->len);
+
+    if (rc != 0) {
+        return rc;
+    }
+
+    return (str1->len > str2->len) - (str1->len < str2->len);
+}
+
+char *
+spr_str_chr(const spr_str_t *str, int c)
+{
+    if (str->len == 0) {
+        return NULL;
+    }
+
+    return spr_memchr(str->data, c, str->len);
+}
+
+char *
+spr_str_find(const spr_str_t *str, const spr_str_t *needle)
+{
+    return spr_memmem(str->data, str->len, needle->data, needle->len);
+}
+
+char *
+spr_str_pdup(spr_pool_t *pool, spr_str_t *dst, const spr_str_t *src)
+{
+    char *mem;
+
+    mem = spr_pstrndup(pool, src->data, src->len);
+    if (!mem) {
+        return NULL;
+    }
+
+    dst->len = src->len;
+    dst->data = mem;
+
+    return mem;
+}
+
+char *
+spr_str_pcat1(spr_pool_t *pool, spr_str_t *dst, ...)
+{
+    va_list args;
+    spr_str_t *argv;
+    char *pos;
+    size_t len;
+
+    len = 0;
+
+    va_start(args, dst);
+
+    while ((argv = va_arg(args, spr_str_t *)) != NULL) {
+        len += argv->len;
+    }
+
+    va_end(args);
+
+    pos = spr_palloc(pool, len + 1);
+    if (!pos) {
+        return NULL;
+    }
+
+    dst->len = len;
+    dst->data = pos;
+
+    va_start(args, dst);
+
+    while ((argv = va_arg(args, spr_str_t *)) != NULL) {
+        spr_memcpy(pos, argv->data, argv->len);
+        pos += argv->len;
+    }
+
+    va_end(args);
+
+    *pos = '\0';
+
+    return dst->data;
+}
+
+spr_err_t
+spr_strbuf_init(spr_strbuf_t *buf, spr_pool_t *pool, size_t size)
+{
+    if (size == 0) {
+        size = SPR_STRBUF_DEFAULT_SIZE;
+    }
+
+    buf->data = spr_palloc(pool, size + 1);
+    if (!buf->data) {
+        return spr_get_errno();
+    }
+
+    buf->len = 0;
+    buf->size = size;
+    buf->pool = pool;
+
+    return SPR_OK;
+}
+
+static spr_err_t
+spr_strbuf_grow(spr_strbuf_t *buf, size_t n)
+{
+    size_t size;
+    char *data;
+
+    if (n > SIZE_MAX - 1 - buf->len) {
+        return SPR_FAILED;
+    }
+
+    size = buf->size;
+
+    do {
+        size = (size <= (SIZE_MAX - 1) / 2) ? size * 2 : SIZE_MAX - 1;
+    } while (size < buf->len + n);
+
+    /*
+     * Grows in place while the buffer is the last pool allocation. If it
+     * has to move, the old block stays in the pool, doubling keeps the
+     * total waste below the final size.
+     */
+    data = spr_prealloc(buf->pool, buf->data, buf->size + 1, size + 1);
+    if (!data) {
+        return spr_get_errno();
+    }
+
+    buf->data = data;
+    buf->size = size;
+
+    return SPR_OK;
+}
+
+char *
+spr_strbuf_reserve(spr_strbuf_t *buf, size_t n)
+{
+    if (buf->size - buf->len < n && spr_strbuf_grow(buf, n) != SPR_OK) {
+        return NULL;
+    }
+
+    return buf->data + buf->len;
+}
+
+spr_err_t
+spr_strbuf_append(spr_strbuf_t *buf, const void *data, size_t n)
+{
+    spr_err_t err;
+
+    if (buf->size - buf->len < n) {
+        err = spr_strbuf_grow(buf, n);
+        if (err != SPR_OK) {
+            return err;
+        }
+    }
+
+    spr_memcpy(buf->data + buf->len, data, n);
+    buf->len += n;
+
+    return SPR_OK;
+}
+
+spr_err_t
+spr_strbuf_append_char(spr_strbuf_t *buf, char c)
+{
+    spr_err_t err;
+
+    if (buf->len == buf->size) {
+        err = spr_strbuf_grow(buf, 1);
+        if (err != SPR_OK) {
+            return err;
+        }
+    }
+
+    buf->data[buf->len++] = c;
+
+    return SPR_OK;
+}
+
+char *
+spr_strbuf_finish(spr_strbuf_t *buf, spr_str_t *str)
+{
+    buf->data[buf->len] = '\0';
+
+    if (str) {
+        str->len = buf->len;
+        str->data = buf->data;
+    }
+
+    return buf->data;
+}
@@ -37,6 +37,16 @@ spr_gettimeofday(struct timeval *tv)
     gettimeofday(tv, NULL);
 }
 
+uint64_t
+spr_monotonic_msec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
 void
 spr_localtime(time_t sec, spr_tm_t *tm)
 {
@@ -63,6 +73,12 @@ spr_gettimeofday(struct timeval *tv)
     tv->tv_usec = (long) ((intervals % 10000000) / 10);
 }
 
+uint64_t
+spr_monotonic_msec(void)
+{
+    return GetTickCount64();
+}
+
 void
 spr_localtime(time_t sec, spr_tm_t *tm)
 {
@@ -0,0 +1,333 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "spr_portable.h"
+#include "spr_timer.h"
+#include "spr_memory.h"
+#include "spr_errno.h"
+
+#define SPR_TIMER_ROOT_MASK          (SPR_TIMER_ROOT_SIZE - 1)
+#define SPR_TIMER_LEVEL_MASK         (SPR_TIMER_LEVEL_SIZE - 1)
+
+/* Farthest expiration time which the wheel can hold */
+#define SPR_TIMER_MAX_RANGE \
+    (((uint64_t) 1 << (SPR_TIMER_ROOT_BITS \
+                       + SPR_TIMER_LEVELS * SPR_TIMER_LEVEL_BITS)) - 1)
+
+#define spr_timer_level_shift(level) \
+    (SPR_TIMER_ROOT_BITS + (level) * SPR_TIMER_LEVEL_BITS)
+#define spr_timer_level_index(time, level) \
+    (((time) >> spr_timer_level_shift(level)) & SPR_TIMER_LEVEL_MASK)
+
+#define spr_timer_list_init(head)    ((head)->next = (head)->prev = (head))
+#define spr_timer_list_empty(head)   ((head)->next == (head))
+
+
+static void
+spr_timer_list_insert(spr_timer_link_t *head, spr_timer_link_t *link)
+{
+    link->prev = head->prev;
+    link->next = head;
+    head->prev->next = link;
+    head->prev = link;
+}
+
+static void
+spr_timer_list_remove(spr_timer_link_t *link)
+{
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->next = NULL;
+    link->prev = NULL;
+}
+
+spr_err_t
+spr_timer_wheel_create1(spr_timer_wheel_t **out_wheel, spr_pool_t *pool,
+    uint64_t now)
+{
+    spr_timer_wheel_t *wheel;
+    spr_uint_t i, j;
+
+    wheel = spr_palloc(pool, sizeof(spr_timer_wheel_t));
+    if (!wheel) {
+        return spr_get_errno();
+    }
+
+    wheel->pool = pool;
+    wheel->time = now;
+    wheel->current = now + 1;
+    wheel->size = 0;
+
+    for (i = 0; i < SPR_TIMER_ROOT_SIZE; ++i) {
+        spr_timer_list_init(&wheel->root[i]);
+    }
+
+    for (i = 0; i < SPR_TIMER_LEVELS; ++i) {
+        for (j = 0; j < SPR_TIMER_LEVEL_SIZE; ++j) {
+            spr_timer_list_init(&wheel->levels[i][j]);
+        }
+    }
+
+    *out_wheel = wheel;
+
+    return SPR_OK;
+}
+
+spr_timer_wheel_t *
+spr_timer_wheel_create(spr_pool_t *pool, uint64_t now)
+{
+    spr_timer_wheel_t *wheel;
+
+    wheel = NULL;
+
+    if (spr_timer_wheel_create1(&wheel, pool, now) != SPR_OK) {
+        return NULL;
+    }
+
+    return wheel;
+}
+
+static void
+spr_timer_wheel_place(spr_timer_wheel_t *wheel, spr_timer_t *timer)
+{
+    spr_timer_link_t *slot;
+    uint64_t expires, idx;
+    spr_uint_t level;
+
+    expires = timer->expires;
+
+    /* Expired timers go to the slot which is processed next */
+    if (expires < wheel->current) {
+        expires = wheel->current;
+    }
+
+    idx = expires - wheel->current;
+
+    if (idx < SPR_TIMER_ROOT_SIZE) {
+        slot = &wheel->root[expires & SPR_TIMER_ROOT_MASK];
+    }
+    else {
+        if (idx > SPR_TIMER_MAX_RANGE) {
+            /* The timer is placed again when its slot is cascaded */
+            idx = SPR_TIMER_MAX_RANGE;
+            expires = wheel->current + idx;
+        }
+
+        for (level = 0; level < SPR_TIMER_LEVELS - 1; ++level) {
+            if (idx < ((uint64_t) 1 << spr_timer_level_shift(level + 1))) {
+                break;
+            }
+        }
+
+        slot = &wheel->levels[level][spr_timer_level_index(expires, level)];
+    }
+
+    spr_timer_list_insert(slot, &timer->link);
+}
+
+/* Moves timers of the slot one level down, returns the slot index */
+static spr_uint_t
+spr_timer_wheel_cascade(spr_timer_wheel_t *wheel, spr_uint_t level)
+{
+    spr_timer_link_t *slot, *link;
+    spr_uint_t index;
+
+    index = spr_timer_level_index(wheel->current, level);
+    slot = &wheel->levels[level][index];
+
+    while (!spr_timer_list_empty(slot)) {
+        link = slot->next;
+        spr_timer_list_remove(link);
+        spr_timer_wheel_place(wheel, (spr_timer_t *) link);
+    }
+
+    return index;
+}
+
+/* Returns the nearest tick which expires or cascades timers */
+static uint64_t
+spr_timer_wheel_next_tick(spr_timer_wheel_t *wheel)
+{
+    uint64_t next, tick, base;
+    spr_uint_t i, level, shift;
+
+    next = SPR_TIMER_INFINITE;
+
+    for (i = 0, tick = wheel->current; i < SPR_TIMER_ROOT_SIZE; ++i, ++tick) {
+        if (!spr_timer_list_empty(&wheel->root[tick & SPR_TIMER_ROOT_MASK])) {
+            next = tick;
+            break;
+        }
+    }
+
+    for (level = 0; level < SPR_TIMER_LEVELS; ++level) {
+        shift = spr_timer_level_shift(level);
+        base = (wheel->current + ((uint64_t) 1 << shift) - 1) >> shift;
+
+        for (i = 0; i < SPR_TIMER_LEVEL_SIZE; ++i) {
+            tick = (base + i) << shift;
+
+            if (tick >= next) {
+                break;
+            }
+
+            if (!spr_timer_list_empty(
+                    &wheel->levels[level][(base + i) & SPR_TIMER_LEVEL_MASK]))
+            {
+                next = tick;
+                break;
+            }
+        }
+    }
+
+    return next;
+}
+
+void
+spr_timer_init(spr_timer_t *timer, spr_timer_handler_pt handler, void *data)
+{
+    timer->link.next = NULL;
+    timer->link.prev = NULL;
+    timer->expires = 0;
+    timer->handler = handler;
+    timer->data = data;
+}
+
+void
+spr_timer_add(spr_timer_wheel_t *wheel, spr_timer_t *timer, uint64_t msec)
+{
+    if (spr_timer_pending(timer)) {
+        spr_timer_list_remove(&timer->link);
+    }
+    else {
+        wheel->size += 1;
+    }
+
+    timer->expires = wheel->time + msec;
+
+    spr_timer_wheel_place(wheel, timer);
+}
+
+void
+spr_timer_cancel(spr_timer_wheel_t *wheel, spr_timer_t *timer)
+{
+    if (!spr_timer_pending(timer)) {
+        return;
+    }
+
+    spr_timer_list_remove(&timer->link);
+    wheel->size -= 1;
+}
+
+size_t
+spr_timer_wheel_advance(spr_timer_wheel_t *wheel, uint64_t now)
+{
+    spr_timer_link_t expired, *slot, *link;
+    spr_timer_t *timer;
+    size_t nexpired, n;
+    spr_uint_t level;
+    uint64_t next;
+
+    spr_timer_list_init(&expired);
+    nexpired = 0;
+
+    /*
+     * Expired timers are collected first, so handlers are free
+     * to add and cancel any timers, including the collected ones
+     */
+    while (wheel->current <= now) {
+
+        if (wheel->size == nexpired) {
+            wheel->current = now + 1;
+            break;
+        }
+
+        if ((wheel->current & SPR_TIMER_ROOT_MASK) == 0) {
+            for (level = 0; level < SPR_TIMER_LEVELS; ++level) {
+                if (spr_timer_wheel_cascade(wheel, level) != 0) {
+                    break;
+                }
+            }
+
+            /* Skips the ticks which have nothing to expire or cascade */
+            next = spr_timer_wheel_next_tick(wheel);
+
+            if (next > wheel->current) {
+                wheel->current = next <= now ? next : now + 1;
+                continue;
+            }
+        }
+
+        slot = &wheel->root[wheel->current & SPR_TIMER_ROOT_MASK];
+
+        while (!spr_timer_list_empty(slot)) {
+            link = slot->next;
+            spr_timer_list_remove(link);
+            spr_timer_list_insert(&expired, link);
+            nexpired++;
+        }
+
+        wheel->current++;
+    }
+
+    if (now > wheel->time) {
+        wheel->time = now;
+    }
+
+    n = 0;
+
+    while (!spr_timer_list_empty(&expired)) {
+        timer = (spr_timer_t *) expired.next;
+
+        spr_timer_list_remove(&timer->link);
+        wheel->size -= 1;
+        n++;
+
+        timer->handler(timer);
+    }
+
+    return n;
+}
+
+/*
+ * Returns the number of milliseconds until the nearest expiration or
+ * until the nearest cascade, whichever is earlier
+ */
+uint64_t
+spr_timer_wheel_next_timeout(spr_timer_wheel_t *wheel)
+{
+    uint64_t next;
+
+    if (wheel->size == 0) {
+        return SPR_TIMER_INFINITE;
+    }
+
+    next = spr_timer_wheel_next_tick(wheel);
+
+    return next > wheel->time ? next - wheel->time : 0;
+}
@@ -0,0 +1,884 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "spr_portable.h"
+#include "spr_utf8.h"
+#include "spr_memory.h"
+#include "spr_atomic.h"
+#include "spr_cpuinfo.h"
+
+#if (SPR_HAVE_SSE2)
+#include <emmintrin.h>
+#endif
+
+#if (SPR_HAVE_SSE42)
+#include <nmmintrin.h>
+#endif
+
+#if (SPR_HAVE_AVX2)
+#include <immintrin.h>
+#endif
+
+#if (SPR_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+/*
+ * Error classes of the lookup-table validator (Keiser and Lemire). Each
+ * pair of adjacent bytes is classified by the high nibble of the first
+ * byte, its low nibble and the high nibble of the second byte, a bit
+ * which survives all three lookups is an error.
+ */
+#define SPR_UTF8_TOO_SHORT           (1 << 0)
+#define SPR_UTF8_TOO_LONG            (1 << 1)
+#define SPR_UTF8_OVERLONG_3          (1 << 2)
+#define SPR_UTF8_TOO_LARGE           (1 << 3)
+#define SPR_UTF8_SURROGATE           (1 << 4)
+#define SPR_UTF8_OVERLONG_2          (1 << 5)
+#define SPR_UTF8_TOO_LARGE_1000      (1 << 6)
+#define SPR_UTF8_OVERLONG_4          (1 << 6)
+#define SPR_UTF8_TWO_CONTS           (1 << 7)
+#define SPR_UTF8_CARRY \
+    (SPR_UTF8_TOO_SHORT | SPR_UTF8_TOO_LONG | SPR_UTF8_TWO_CONTS)
+
+#define SPR_UTF8_ASCII_MASK          0x8080808080808080ULL
+
+typedef bool (*spr_utf8_validate_pt)(const uint8_t *buf, size_t len);
+typedef size_t (*spr_utf8_widen_pt)(const uint8_t *src, size_t n,
+    uint16_t *dst);
+typedef size_t (*spr_utf16_narrow_pt)(const uint16_t *src, size_t n,
+    uint8_t *dst);
+
+static bool spr_utf8_validate_init(const uint8_t *buf, size_t len);
+static size_t spr_utf8_widen_init(const uint8_t *src, size_t n,
+    uint16_t *dst);
+static size_t spr_utf16_narrow_init(const uint16_t *src, size_t n,
+    uint8_t *dst);
+
+static spr_utf8_validate_pt spr_utf8_validate_impl = spr_utf8_validate_init;
+static spr_utf8_widen_pt spr_utf8_widen = spr_utf8_widen_init;
+static spr_utf16_narrow_pt spr_utf16_narrow = spr_utf16_narrow_init;
+
+#if (SPR_HAVE_SSE42 || SPR_HAVE_AVX2 || SPR_HAVE_NEON)
+
+static const uint8_t spr_utf8_byte_1_high[16] = {
+    /* 0_______ ________ */
+    SPR_UTF8_TOO_LONG, SPR_UTF8_TOO_LONG, SPR_UTF8_TOO_LONG,
+    SPR_UTF8_TOO_LONG, SPR_UTF8_TOO_LONG, SPR_UTF8_TOO_LONG,
+    SPR_UTF8_TOO_LONG, SPR_UTF8_TOO_LONG,
+    /* 10______ ________ */
+    SPR_UTF8_TWO_CONTS, SPR_UTF8_TWO_CONTS, SPR_UTF8_TWO_CONTS,
+    SPR_UTF8_TWO_CONTS,
+    /* 1100____ ________ */
+    SPR_UTF8_TOO_SHORT | SPR_UTF8_OVERLONG_2,
+    /* 1101____ ________ */
+    SPR_UTF8_TOO_SHORT,
+    /* 1110____ ________ */
+    SPR_UTF8_TOO_SHORT | SPR_UTF8_OVERLONG_3 | SPR_UTF8_SURROGATE,
+    /* 1111____ ________ */
+    SPR_UTF8_TOO_SHORT | SPR_UTF8_TOO_LARGE | SPR_UTF8_TOO_LARGE_1000
+    | SPR_UTF8_OVERLONG_4
+};
+
+static const uint8_t spr_utf8_byte_1_low[16] = {
+    /* ____0000 ________ */
+    SPR_UTF8_CARRY | SPR_UTF8_OVERLONG_3 | SPR_UTF8_OVERLONG_2
+    | SPR_UTF8_OVERLONG_4,
+    /* ____0001 ________ */
+    SPR_UTF8_CARRY | SPR_UTF8_OVERLONG_2,
+    /* ____001_ ________ */
+    SPR_UTF8_CARRY,
+    SPR_UTF8_CARRY,
+    /* ____0100 ________ */
+    SPR_UTF8_CARRY | SPR_UTF8_TOO_LARGE,
+    /* ____0101 ________ and above */
+    SPR_UTF8_CARRY | SPR_UTF8_TOO_LARGE | SPR_UTF8_TOO_LARGE_1000,
+    SPR_UTF8_CARRY | SPR_UTF8_TOO_LARGE | SPR_UTF8_TOO_LARGE_1000,
+    SPR_UTF8_CARRY | SPR_UTF8_TOO_LARGE | SPR_UTF8_TOO_LARGE_1000,
+    SPR_UTF8_CARRY | SPR_UTF8_TOO_LARGE | SPR_UTF8_TOO_LARGE_1000,
+    SPR_UTF8_CARRY | SPR_UTF8_TOO_LARGE | SPR_UTF8_TOO_LARGE_1000,
+    SPR_UTF8_CARRY | SPR_UTF8_TOO_LARGE | SPR_UTF8_TOO_LARGE_1000,
+    SPR_UTF8_CARRY | SPR_UTF8_TOO_LARGE | SPR_UTF8_TOO_LARGE_1000,
+    SPR_UTF8_CARRY | SPR_UTF8_TOO_LARGE | SPR_UTF8_TOO_LARGE_1000,
+    /* ____1101 ________ */
+    SPR_UTF8_CARRY | SPR_UTF8_TOO_LARGE | SPR_UTF8_TOO_LARGE_1000
+    | SPR_UTF8_SURROGATE,
+    SPR_UTF8_CARRY | SPR_UTF8_TOO_LARGE | SPR_UTF8_TOO_LARGE_1000,
+    SPR_UTF8_CARRY | SPR_UTF8_TOO_LARGE | SPR_UTF8_TOO_LARGE_1000
+};
+
+static const uint8_t spr_utf8_byte_2_high[16] = {
+    /* ________ 0_______ */
+    SPR_UTF8_TOO_SHORT, SPR_UTF8_TOO_SHORT, SPR_UTF8_TOO_SHORT,
+    SPR_UTF8_TOO_SHORT, SPR_UTF8_TOO_SHORT, SPR_UTF8_TOO_SHORT,
+    SPR_UTF8_TOO_SHORT, SPR_UTF8_TOO_SHORT,
+    /* ________ 1000____ */
+    SPR_UTF8_TOO_LONG | SPR_UTF8_OVERLONG_2 | SPR_UTF8_TWO_CONTS
+    | SPR_UTF8_OVERLONG_3 | SPR_UTF8_TOO_LARGE_1000 | SPR_UTF8_OVERLONG_4,
+    /* ________ 1001____ */
+    SPR_UTF8_TOO_LONG | SPR_UTF8_OVERLONG_2 | SPR_UTF8_TWO_CONTS
+    | SPR_UTF8_OVERLONG_3 | SPR_UTF8_TOO_LARGE,
+    /* ________ 101_____ */
+    SPR_UTF8_TOO_LONG | SPR_UTF8_OVERLONG_2 | SPR_UTF8_TWO_CONTS
+    | SPR_UTF8_SURROGATE | SPR_UTF8_TOO_LARGE,
+    SPR_UTF8_TOO_LONG | SPR_UTF8_OVERLONG_2 | SPR_UTF8_TWO_CONTS
+    | SPR_UTF8_SURROGATE | SPR_UTF8_TOO_LARGE,
+    /* ________ 11______ */
+    SPR_UTF8_TOO_SHORT, SPR_UTF8_TOO_SHORT, SPR_UTF8_TOO_SHORT,
+    SPR_UTF8_TOO_SHORT
+};
+
+/*
+ * Bytes which are still waiting for continuation bytes at the end of
+ * a block: a 4-byte lead in the last three positions, a 3-byte lead in
+ * the last two and any lead in the last one.
+ */
+static const uint8_t spr_utf8_max_value[16] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xf0 - 1, 0xe0 - 1, 0xc0 - 1
+};
+
+#endif
+
+
+/*
+ * Decodes one multi-byte sequence, returns its length or 0 if it is
+ * truncated, overlong, a surrogate or beyond U+10FFFF
+ */
+static size_t
+spr_utf8_decode(const uint8_t *p, size_t n, uint32_t *cp)
+{
+    uint32_t c, u;
+
+    c = p[0];
+
+    if (c < 0xc2) {
+        return 0;
+    }
+
+    if (c < 0xe0) {
+
+        if (n < 2 || (p[1] & 0xc0) != 0x80) {
+            return 0;
+        }
+
+        *cp = ((c & 0x1f) << 6) | (p[1] & 0x3f);
+
+        return 2;
+    }
+
+    if (c < 0xf0) {
+
+        if (n < 3 || (p[1] & 0xc0) != 0x80 || (p[2] & 0xc0) != 0x80) {
+            return 0;
+        }
+
+        u = ((c & 0x0f) << 12) | ((p[1] & 0x3f) << 6) | (p[2] & 0x3f);
+
+        if (u < 0x800 || (u >= 0xd800 && u <= 0xdfff)) {
+            return 0;
+        }
+
+        *cp = u;
+
+        return 3;
+    }
+
+    if (c < 0xf5) {
+
+        if (n < 4 || (p[1] & 0xc0) != 0x80 || (p[2] & 0xc0) != 0x80
+            || (p[3] & 0xc0) != 0x80)
+        {
+            return 0;
+        }
+
+        u = ((c & 0x07) << 18) | ((p[1] & 0x3f) << 12)
+            | ((p[2] & 0x3f) << 6) | (p[3] & 0x3f);
+
+        if (u < 0x10000 || u > 0x10ffff) {
+            return 0;
+        }
+
+        *cp = u;
+
+        return 4;
+    }
+
+    return 0;
+}
+
+static bool
+spr_utf8_validate_scalar(const uint8_t *buf, size_t len)
+{
+    uint64_t word;
+    uint32_t cp;
+    size_t i, n;
+
+    i = 0;
+
+    while (i < len) {
+
+        if (len - i >= 8) {
+            spr_memcpy(&word, buf + i, sizeof(uint64_t));
+
+            if ((word & SPR_UTF8_ASCII_MASK) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+
+        if (buf[i] < 0x80) {
+            i++;
+            continue;
+        }
+
+        n = spr_utf8_decode(buf + i, len - i, &cp);
+        if (n == 0) {
+            return false;
+        }
+
+        i += n;
+    }
+
+    return true;
+}
+
+static size_t
+spr_utf8_widen_scalar(const uint8_t *src, size_t n, uint16_t *dst)
+{
+    size_t i;
+
+    for (i = 0; i < n && src[i] < 0x80; i++) {
+        dst[i] = src[i];
+    }
+
+    return i;
+}
+
+static size_t
+spr_utf16_narrow_scalar(const uint16_t *src, size_t n, uint8_t *dst)
+{
+    size_t i;
+
+    for (i = 0; i < n && src[i] < 0x80; i++) {
+        dst[i] = (uint8_t) src[i];
+    }
+
+    return i;
+}
+
+#if (SPR_HAVE_SSE2)
+
+static SPR_TARGET_SSE2 size_t
+spr_utf8_widen_sse2(const uint8_t *src, size_t n, uint16_t *dst)
+{
+    __m128i v, zero;
+    size_t i;
+
+    zero = _mm_setzero_si128();
+
+    for (i = 0; n - i >= 16; i += 16) {
+        v = _mm_loadu_si128((const __m128i *) (src + i));
+
+        if (_mm_movemask_epi8(v) != 0) {
+            break;
+        }
+
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128((__m128i *) (dst + i + 8),
+                         _mm_unpackhi_epi8(v, zero));
+    }
+
+    return i + spr_utf8_widen_scalar(src + i, n - i, dst + i);
+}
+
+static SPR_TARGET_SSE2 size_t
+spr_utf16_narrow_sse2(const uint16_t *src, size_t n, uint8_t *dst)
+{
+    __m128i v, high, zero;
+    size_t i;
+
+    zero = _mm_setzero_si128();
+    high = _mm_set1_epi16((short) 0xff80);
+
+    for (i = 0; n - i >= 8; i += 8) {
+        v = _mm_loadu_si128((const __m128i *) (src + i));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, high), zero))
+            != 0xffff)
+        {
+            break;
+        }
+
+        _mm_storel_epi64((__m128i *) (dst + i), _mm_packus_epi16(v, v));
+    }
+
+    return i + spr_utf16_narrow_scalar(src + i, n - i, dst + i);
+}
+
+#endif
+
+#if (SPR_HAVE_SSE42)
+
+static SPR_TARGET_SSE42 __m128i
+spr_utf8_check_block_sse42(__m128i input, __m128i prev_input)
+{
+    __m128i prev1, prev2, prev3, nibble, special, must23;
+
+    nibble = _mm_set1_epi8(0x0f);
+
+    prev1 = _mm_alignr_epi8(input, prev_input, 15);
+    prev2 = _mm_alignr_epi8(input, prev_input, 14);
+    prev3 = _mm_alignr_epi8(input, prev_input, 13);
+
+    special = _mm_and_si128(
+        _mm_and_si128(
+            _mm_shuffle_epi8(
+                _mm_loadu_si128((const __m128i *) spr_utf8_byte_1_high),
+                _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+            _mm_shuffle_epi8(
+                _mm_loadu_si128((const __m128i *) spr_utf8_byte_1_low),
+                _mm_and_si128(prev1, nibble))),
+        _mm_shuffle_epi8(
+            _mm_loadu_si128((const __m128i *) spr_utf8_byte_2_high),
+            _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+
+    /* Third and fourth bytes of a sequence must be continuation bytes */
+    must23 = _mm_or_si128(
+                 _mm_subs_epu8(prev2, _mm_set1_epi8((char) (0xe0 - 0x80))),
+                 _mm_subs_epu8(prev3, _mm_set1_epi8((char) (0xf0 - 0x80))));
+    must23 = _mm_and_si128(must23, _mm_set1_epi8((char) 0x80));
+
+    return _mm_xor_si128(must23, special);
+}
+
+static SPR_TARGET_SSE42 bool
+spr_utf8_validate_sse42(const uint8_t *buf, size_t len)
+{
+    __m128i input, prev_input, prev_incomplete, error, max_value;
+    uint8_t tail[16];
+    size_t i;
+
+    max_value = _mm_loadu_si128((const __m128i *) spr_utf8_max_value);
+
+    error = _mm_setzero_si128();
+    prev_input = _mm_setzero_si128();
+    prev_incomplete = _mm_setzero_si128();
+
+    for (i = 0; i < len; i += 16) {
+
+        if (len - i >= 16) {
+            input = _mm_loadu_si128((const __m128i *) (buf + i));
+
+        } else {
+            /* Zero padding is ASCII, so a truncated sequence fails */
+            spr_memzero(tail, sizeof(tail));
+            spr_memcpy(tail, buf + i, len - i);
+            input = _mm_loadu_si128((const __m128i *) tail);
+        }
+
+        if (_mm_movemask_epi8(input) == 0) {
+            error = _mm_or_si128(error, prev_incomplete);
+
+        } else {
+            error = _mm_or_si128(error,
+                                 spr_utf8_check_block_sse42(input,
+                                                            prev_input));
+            prev_incomplete = _mm_subs_epu8(input, max_value);
+        }
+
+        prev_input = input;
+    }
+
+    error = _mm_or_si128(error, prev_incomplete);
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128()))
+           == 0xffff;
+}
+
+#endif
+
+#if (SPR_HAVE_AVX2)
+
+static SPR_TARGET_AVX2 __m256i
+spr_utf8_table_avx2(const uint8_t *table)
+{
+    return _mm256_broadcastsi128_si256(
+               _mm_loadu_si128((const __m128i *) table));
+}
+
+static SPR_TARGET_AVX2 __m256i
+spr_utf8_check_block_avx2(__m256i input, __m256i prev_input)
+{
+    __m256i prev, prev1, prev2, prev3, nibble, special, must23;
+
+    nibble = _mm256_set1_epi8(0x0f);
+
+    /* Last lane of the previous block followed by the first lane */
+    prev = _mm256_permute2x128_si256(prev_input, input, 0x21);
+
+    prev1 = _mm256_alignr_epi8(input, prev, 15);
+    prev2 = _mm256_alignr_epi8(input, prev, 14);
+    prev3 = _mm256_alignr_epi8(input, prev, 13);
+
+    special = _mm256_and_si256(
+        _mm256_and_si256(
+            _mm256_shuffle_epi8(
+                spr_utf8_table_avx2(spr_utf8_byte_1_high),
+                _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+            _mm256_shuffle_epi8(
+                spr_utf8_table_avx2(spr_utf8_byte_1_low),
+                _mm256_and_si256(prev1, nibble))),
+        _mm256_shuffle_epi8(
+            spr_utf8_table_avx2(spr_utf8_byte_2_high),
+            _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+
+    must23 = _mm256_or_si256(
+                 _mm256_subs_epu8(prev2,
+                                  _mm256_set1_epi8((char) (0xe0 - 0x80))),
+                 _mm256_subs_epu8(prev3,
+                                  _mm256_set1_epi8((char) (0xf0 - 0x80))));
+    must23 = _mm256_and_si256(must23, _mm256_set1_epi8((char) 0x80));
+
+    return _mm256_xor_si256(must23, special);
+}
+
+static SPR_TARGET_AVX2 bool
+spr_utf8_validate_avx2(const uint8_t *buf, size_t len)
+{
+    __m256i input, prev_input, prev_incomplete, error, max_value;
+    uint8_t tail[32];
+    size_t i;
+
+    /* Only the upper lane may end a block */
+    max_value = _mm256_set_m128i(
+                    _mm_loadu_si128((const __m128i *) spr_utf8_max_value),
+                    _mm_set1_epi8((char) 0xff));
+
+    error = _mm256_setzero_si256();
+    prev_input = _mm256_setzero_si256();
+    prev_incomplete = _mm256_setzero_si256();
+
+    for (i = 0; i < len; i += 32) {
+
+        if (len - i >= 32) {
+            input = _mm256_loadu_si256((const __m256i *) (buf + i));
+
+        } else {
+            spr_memzero(tail, sizeof(tail));
+            spr_memcpy(tail, buf + i, len - i);
+            input = _mm256_loadu_si256((const __m256i *) tail);
+        }
+
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = _mm256_or_si256(error, prev_incomplete);
+
+        } else {
+            error = _mm256_or_si256(error,
+                                    spr_utf8_check_block_avx2(input,
+                                                              prev_input));
+            prev_incomplete = _mm256_subs_epu8(input, max_value);
+        }
+
+        prev_input = input;
+    }
+
+    error = _mm256_or_si256(error, prev_incomplete);
+
+    return _mm256_testz_si256(error, error);
+}
+
+#endif
+
+#if (SPR_HAVE_NEON)
+
+static uint8x16_t
+spr_utf8_check_block_neon(uint8x16_t input, uint8x16_t prev_input)
+{
+    uint8x16_t prev1, prev2, prev3, nibble, special, must23;
+
+    nibble = vdupq_n_u8(0x0f);
+
+    prev1 = vextq_u8(prev_input, input, 15);
+    prev2 = vextq_u8(prev_input, input, 14);
+    prev3 = vextq_u8(prev_input, input, 13);
+
+    special = vandq_u8(
+        vandq_u8(vqtbl1q_u8(vld1q_u8(spr_utf8_byte_1_high),
+                            vshrq_n_u8(prev1, 4)),
+                 vqtbl1q_u8(vld1q_u8(spr_utf8_byte_1_low),
+                            vandq_u8(prev1, nibble))),
+        vqtbl1q_u8(vld1q_u8(spr_utf8_byte_2_high), vshrq_n_u8(input, 4)));
+
+    must23 = vorrq_u8(vqsubq_u8(prev2, vdupq_n_u8(0xe0 - 0x80)),
+                      vqsubq_u8(prev3, vdupq_n_u8(0xf0 - 0x80)));
+    must23 = vandq_u8(must23, vdupq_n_u8(0x80));
+
+    return veorq_u8(must23, special);
+}
+
+static bool
+spr_utf8_validate_neon(const uint8_t *buf, size_t len)
+{
+    uint8x16_t input, prev_input, prev_incomplete, error, max_value;
+    uint8_t tail[16];
+    size_t i;
+
+    max_value = vld1q_u8(spr_utf8_max_value);
+
+    error = vdupq_n_u8(0);
+    prev_input = vdupq_n_u8(0);
+    prev_incomplete = vdupq_n_u8(0);
+
+    for (i = 0; i < len; i += 16) {
+
+        if (len - i >= 16) {
+            input = vld1q_u8(buf + i);
+
+        } else {
+            spr_memzero(tail, sizeof(tail));
+            spr_memcpy(tail, buf + i, len - i);
+            input = vld1q_u8(tail);
+        }
+
+        if (vmaxvq_u8(input) < 0x80) {
+            error = vorrq_u8(error, prev_incomplete);
+
+        } else {
+            error = vorrq_u8(error,
+                             spr_utf8_check_block_neon(input, prev_input));
+            prev_incomplete = vqsubq_u8(input, max_value);
+        }
+
+        prev_input = input;
+    }
+
+    error = vorrq_u8(error, prev_incomplete);
+
+    return vmaxvq_u8(error) == 0;
+}
+
+static size_t
+spr_utf8_widen_neon(const uint8_t *src, size_t n, uint16_t *dst)
+{
+    uint8x16_t v;
+    size_t i;
+
+    for (i = 0; n - i >= 16; i += 16) {
+        v = vld1q_u8(src + i);
+
+        if (vmaxvq_u8(v) >= 0x80) {
+            break;
+        }
+
+        vst1q_u16(dst + i, vmovl_u8(vget_low_u8(v)));
+        vst1q_u16(dst + i + 8, vmovl_high_u8(v));
+    }
+
+    return i + spr_utf8_widen_scalar(src + i, n - i, dst + i);
+}
+
+static size_t
+spr_utf16_narrow_neon(const uint16_t *src, size_t n, uint8_t *dst)
+{
+    uint16x8_t v;
+    size_t i;
+
+    for (i = 0; n - i >= 8; i += 8) {
+        v = vld1q_u16(src + i);
+
+        if (vmaxvq_u16(v) >= 0x80) {
+            break;
+        }
+
+        vst1_u8(dst + i, vmovn_u16(v));
+    }
+
+    return i + spr_utf16_narrow_scalar(src + i, n - i, dst + i);
+}
+
+#endif
+
+static void
+spr_utf8_dispatch(void)
+{
+    spr_utf8_validate_pt validate;
+    spr_utf8_widen_pt widen;
+    spr_utf16_narrow_pt narrow;
+
+    validate = spr_utf8_validate_scalar;
+    widen = spr_utf8_widen_scalar;
+    narrow = spr_utf16_narrow_scalar;
+
+#if (SPR_HAVE_SSE2)
+    if (spr_cpu_has_feature(SPR_CPU_FEATURE_SSE2)) {
+        widen = spr_utf8_widen_sse2;
+        narrow = spr_utf16_narrow_sse2;
+    }
+#endif
+
+#if (SPR_HAVE_SSE42)
+    if (spr_cpu_has_feature(SPR_CPU_FEATURE_SSE42)) {
+        validate = spr_utf8_validate_sse42;
+    }
+#endif
+
+#if (SPR_HAVE_AVX2)
+    if (spr_cpu_has_feature(SPR_CPU_FEATURE_AVX2)) {
+        validate = spr_utf8_validate_avx2;
+    }
+#endif
+
+#if (SPR_HAVE_NEON)
+    if (spr_cpu_has_feature(SPR_CPU_FEATURE_NEON)) {
+        validate = spr_utf8_validate_neon;
+        widen = spr_utf8_widen_neon;
+        narrow = spr_utf16_narrow_neon;
+    }
+#endif
+
+    spr_atomic_store(&spr_utf16_narrow, narrow);
+    spr_atomic_store(&spr_utf8_widen, widen);
+    spr_atomic_store(&spr_utf8_validate_impl, validate);
+}
+
+static bool
+spr_utf8_validate_init(const uint8_t *buf, size_t len)
+{
+    spr_utf8_dispatch();
+    return spr_atomic_load(&spr_utf8_validate_impl)(buf, len);
+}
+
+static size_t
+spr_utf8_widen_init(const uint8_t *src, size_t n, uint16_t *dst)
+{
+    spr_utf8_dispatch();
+    return spr_atomic_load(&spr_utf8_widen)(src, n, dst);
+}
+
+static size_t
+spr_utf16_narrow_init(const uint16_t *src, size_t n, uint8_t *dst)
+{
+    spr_utf8_dispatch();
+    return spr_atomic_load(&spr_utf16_narrow)(src, n, dst);
+}
+
+bool
+spr_utf8_validate(const void *buf, size_t len)
+{
+    return spr_atomic_load(&spr_utf8_validate_impl)(buf, len);
+}
+
+/* Both functions below expect valid input */
+
+size_t
+spr_utf8_utf16_length(const uint8_t *src, size_t len)
+{
+    size_t i, n;
+
+    n = 0;
+
+    for (i = 0; i < len; i++) {
+        n += ((src[i] & 0xc0) != 0x80) + (src[i] >= 0xf0);
+    }
+
+    return n;
+}
+
+size_t
+spr_utf16_utf8_length(const uint16_t *src, size_t len)
+{
+    size_t i, n;
+
+    n = 0;
+
+    for (i = 0; i < len; i++) {
+
+        if (src[i] < 0x80) {
+            n += 1;
+
+        } else if (src[i] < 0x800) {
+            n += 2;
+
+        } else if (src[i] >= 0xd800 && src[i] <= 0xdfff) {
+            /* Four bytes per surrogate pair */
+            n += 2;
+
+        } else {
+            n += 3;
+        }
+    }
+
+    return n;
+}
+
+/*
+ * Transcoders return the number of units written, or -1 if the input is
+ * not valid or does not fit into size units of dst.
+ */
+
+ssize_t
+spr_utf8_to_utf16(const uint8_t *src, size_t len, uint16_t *dst,
+    size_t size)
+{
+    size_t i, o, n;
+    uint32_t cp;
+    spr_utf8_widen_pt widen;
+
+    widen = spr_atomic_load(&spr_utf8_widen);
+
+    i = 0;
+    o = 0;
+
+    while (i < len) {
+
+        if (src[i] < 0x80) {
+
+            if (o == size) {
+                return -1;
+            }
+
+            n = (len - i < size - o) ? len - i : size - o;
+            n = widen(src + i, n, dst + o);
+
+            i += n;
+            o += n;
+
+            continue;
+        }
+
+        n = spr_utf8_decode(src + i, len - i, &cp);
+        if (n == 0) {
+            return -1;
+        }
+
+        i += n;
+
+        if (cp >= 0x10000) {
+
+            if (size - o < 2) {
+                return -1;
+            }
+
+            cp -= 0x10000;
+            dst[o++] = (uint16_t) (0xd800 | (cp >> 10));
+            dst[o++] = (uint16_t) (0xdc00 | (cp & 0x3ff));
+
+            continue;
+        }
+
+        if (o == size) {
+            return -1;
+        }
+
+        dst[o++] = (uint16_t) cp;
+    }
+
+    return (ssize_t) o;
+}
+
+ssize_t
+spr_utf16_to_utf8(const uint16_t *src, size_t len, uint8_t *dst,
+    size_t size)
+{
+    size_t i, o, n;
+    uint32_t cp;
+    spr_utf16_narrow_pt narrow;
+
+    narrow = spr_atomic_load(&spr_utf16_narrow);
+
+    i = 0;
+    o = 0;
+
+    while (i < len) {
+        cp = src[i];
+
+        if (cp < 0x80) {
+
+            if (o == size) {
+                return -1;
+            }
+
+            n = (len - i < size - o) ? len - i : size - o;
+            n = narrow(src + i, n, dst + o);
+
+            i += n;
+            o += n;
+
+            continue;
+        }
+
+        if (cp < 0x800) {
+
+            if (size - o < 2) {
+                return -1;
+            }
+
+            dst[o++] = (uint8_t) (0xc0 | (cp >> 6));
+            dst[o++] = (uint8_t) (0x80 | (cp & 0x3f));
+            i++;
+
+            continue;
+        }
+
+        if (cp >= 0xd800 && cp <= 0xdfff) {
+
+            /* Only a high surrogate followed by a low one is valid */
+            if (cp > 0xdbff || i + 1 == len
+                || src[i + 1] < 0xdc00 || src[i + 1] > 0xdfff)
+            {
+                return -1;
+            }
+
+            if (size - o < 4) {
+                return -1;
+            }
+
+            cp = 0x10000 + ((cp - 0xd800) << 10) + (src[i + 1] - 0xdc00);
+
+            dst[o++] = (uint8_t) (0xf0 | (cp >> 18));
+            dst[o++] = (uint8_t) (0x80 | ((cp >> 12) & 0x3f));
+            dst[o++] = (uint8_t) (0x80 | ((cp >> 6) & 0x3f));
+            dst[o++] = (uint8_t) (0x80 | (cp & 0x3f));
+            i += 2;
+
+            continue;
+        }
+
+        if (size - o < 3) {
+            return -1;
+        }
+
+        dst[o++] = (uint8_t) (0xe0 | (cp >> 12));
+        dst[o++] = (uint8_t) (0x80 | ((cp >> 6) & 0x3f));
+        dst[o++] = (uint8_t) (0x80 | (cp & 0x3f));
+        i++;
+    }
+
+    return (ssize_t) o;
+}
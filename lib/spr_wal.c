@@ -0,0 +1,771 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "spr_portable.h"
+#include "spr_errno.h"
+#include "spr_memory.h"
+#include "spr_pool.h"
+#include "spr_string.h"
+#include "spr_hash.h"
+#include "spr_time.h"
+#include "spr_mutex.h"
+#include "spr_cond.h"
+#include "spr_thread.h"
+#include "spr_filesys.h"
+#include "spr_wal.h"
+
+/* Sixteen hex digits and the suffix */
+#define SPR_WAL_NAME_LEN             20
+#define SPR_WAL_SUFFIX               ".wal"
+
+
+/*
+ * Bytes in [durable, head) occupy the buffer, the flusher owns
+ * [durable, taken) while it writes them. Appenders reserve space at
+ * head and copy their records without the mutex, filled advances over
+ * the records in order as their copies complete and the flusher takes
+ * no more than that. Everything else is guarded by the mutex.
+ */
+struct spr_wal_s {
+    spr_mutex_t mutex;
+    spr_cond_t flush_cond;
+    spr_cond_t done_cond;
+    spr_cond_t fill_cond;
+    uint8_t *buf;
+    size_t size;
+    size_t batch_size;
+    spr_msec_t latency;
+    size_t segment_size;
+    spr_wal_lsn_t head;
+    spr_wal_lsn_t filled;
+    spr_wal_lsn_t taken;
+    spr_wal_lsn_t durable;
+    uint64_t since;
+    uint64_t segno;
+    spr_file_t file;
+    char *dir;
+    char *path;
+    spr_thread_t thread;
+    spr_err_t err;
+    bool urgent;
+    bool stop;
+};
+
+
+static void
+spr_wal_segment_name(spr_wal_t *wal, uint64_t segno)
+{
+    static const char hex[] = "0123456789abcdef";
+    char *p;
+    int i;
+
+    p = wal->path + spr_strlen(wal->dir) + 1;
+
+    for (i = 15; i >= 0; i--) {
+        p[i] = hex[segno & 0xf];
+        segno >>= 4;
+    }
+
+    spr_memcpy(p + 16, SPR_WAL_SUFFIX, sizeof(SPR_WAL_SUFFIX));
+}
+
+/* The segment after the last one found, 0 in an empty directory */
+static spr_err_t
+spr_wal_segment_next(spr_wal_t *wal, uint64_t *segno)
+{
+    const char *name;
+    uint64_t value;
+    spr_dir_t dir;
+    spr_err_t err;
+
+    *segno = 0;
+
+    err = spr_dir_open(&dir, wal->dir);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    while (spr_dir_read(&dir) == SPR_OK) {
+        name = spr_dir_current_name(&dir);
+
+        if (spr_strlen(name) != SPR_WAL_NAME_LEN
+            || spr_strcmp(name + 16, SPR_WAL_SUFFIX) != 0
+            || spr_hextou64(name, 16, &value) != SPR_OK)
+        {
+            continue;
+        }
+
+        if (value >= *segno) {
+            *segno = value + 1;
+        }
+    }
+
+    spr_dir_close(&dir);
+
+    return SPR_OK;
+}
+
+/*
+ * Reserving the blocks up front keeps the data sync from having to
+ * update the file size and allocation on every batch.
+ */
+static spr_err_t
+spr_wal_preallocate(spr_wal_t *wal)
+{
+#if (SPR_HAVE_POSIX_FALLOCATE)
+
+    spr_err_t err;
+
+    err = posix_fallocate(wal->file.fd, 0, (off_t) wal->segment_size);
+
+    /* Not every filesystem reserves blocks, writing still works */
+    if (err == EINVAL || err == EOPNOTSUPP) {
+        return SPR_OK;
+    }
+
+    return err;
+
+#elif (SPR_DARWIN)
+
+    fstore_t store;
+
+    spr_memzero(&store, sizeof(fstore_t));
+
+    store.fst_flags = F_ALLOCATECONTIG|F_ALLOCATEALL;
+    store.fst_posmode = F_PEOFPOSMODE;
+    store.fst_length = (off_t) wal->segment_size;
+
+    if (fcntl(wal->file.fd, F_PREALLOCATE, &store) == -1) {
+        store.fst_flags = F_ALLOCATEALL;
+        if (fcntl(wal->file.fd, F_PREALLOCATE, &store) == -1) {
+            return spr_get_errno();
+        }
+    }
+
+    return SPR_OK;
+
+#elif (SPR_WIN32)
+
+    FILE_ALLOCATION_INFO info;
+
+    info.AllocationSize.QuadPart = (LONGLONG) wal->segment_size;
+
+    if (SetFileInformationByHandle(wal->file.fd, FileAllocationInfo, &info,
+                                   sizeof(FILE_ALLOCATION_INFO)) == 0)
+    {
+        return spr_get_errno();
+    }
+
+    return SPR_OK;
+
+#else
+
+    (void) wal;
+
+    return SPR_OK;
+
+#endif
+}
+
+static spr_err_t
+spr_wal_sync(spr_file_t *file)
+{
+#if (SPR_DARWIN) && defined(F_FULLFSYNC)
+
+    /* fsync() leaves the data in the drive cache */
+    if (fcntl(file->fd, F_FULLFSYNC) == -1 && fsync(file->fd) == -1) {
+        return spr_get_errno();
+    }
+
+#elif (SPR_HAVE_FDATASYNC)
+
+    if (fdatasync(file->fd) == -1) {
+        return spr_get_errno();
+    }
+
+#elif (SPR_POSIX)
+
+    if (fsync(file->fd) == -1) {
+        return spr_get_errno();
+    }
+
+#elif (SPR_WIN32)
+
+    if (FlushFileBuffers(file->fd) == 0) {
+        return spr_get_errno();
+    }
+
+#endif
+
+    return SPR_OK;
+}
+
+/* A new file is only durable once its directory entry is */
+static spr_err_t
+spr_wal_sync_dir(spr_wal_t *wal)
+{
+#if (SPR_POSIX)
+
+    spr_err_t err;
+    int fd;
+
+    fd = open(wal->dir, O_RDONLY);
+    if (fd == -1) {
+        return spr_get_errno();
+    }
+
+    err = SPR_OK;
+
+    if (fsync(fd) == -1) {
+        err = spr_get_errno();
+    }
+
+    close(fd);
+
+    return err;
+
+#else
+
+    (void) wal;
+
+    return SPR_OK;
+
+#endif
+}
+
+/* Syncs and closes the current segment, then opens the given one */
+static spr_err_t
+spr_wal_rotate(spr_wal_t *wal, uint64_t segno)
+{
+    spr_err_t err;
+
+    if (wal->file.fd != SPR_INVALID_FILE) {
+        err = spr_wal_sync(&wal->file);
+        if (err != SPR_OK) {
+            return err;
+        }
+
+        spr_file_close(&wal->file);
+        wal->file.fd = SPR_INVALID_FILE;
+    }
+
+    spr_wal_segment_name(wal, segno);
+
+    err = spr_file_open(&wal->file, wal->path, SPR_FILE_WRONLY,
+                        SPR_FILE_CREATE_OR_OPEN, SPR_FILE_DEFAULT_ACCESS);
+    if (err != SPR_OK) {
+        wal->file.fd = SPR_INVALID_FILE;
+        return err;
+    }
+
+    wal->segno = segno;
+
+    err = spr_wal_preallocate(wal);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    err = spr_wal_sync(&wal->file);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    return spr_wal_sync_dir(wal);
+}
+
+/*
+ * Writes [start, end) of the log, at most two vectors per segment as
+ * the range may wrap around the buffer, and syncs once at the end.
+ */
+static spr_err_t
+spr_wal_write(spr_wal_t *wal, spr_wal_lsn_t start, spr_wal_lsn_t end)
+{
+    spr_iovec_t iov[2];
+    spr_wal_lsn_t last;
+    size_t off, n, iovcnt;
+    uint64_t segno;
+    spr_err_t err;
+
+    while (start < end) {
+        segno = start / wal->segment_size;
+
+        if (segno != wal->segno) {
+            err = spr_wal_rotate(wal, segno);
+            if (err != SPR_OK) {
+                return err;
+            }
+        }
+
+        last = (segno + 1) * wal->segment_size;
+        if (last > end) {
+            last = end;
+        }
+
+        off = (size_t) (start % wal->size);
+        n = (size_t) (last - start);
+
+        iov[0].iov_base = wal->buf + off;
+        iov[0].iov_len = n;
+        iovcnt = 1;
+
+        if (n > wal->size - off) {
+            iov[0].iov_len = wal->size - off;
+            iov[1].iov_base = wal->buf;
+            iov[1].iov_len = n - iov[0].iov_len;
+            iovcnt = 2;
+        }
+
+        if (spr_file_writev(&wal->file, iov, iovcnt,
+                            (spr_off_t) (start % wal->segment_size)) == -1)
+        {
+            return spr_get_errno();
+        }
+
+        start = last;
+    }
+
+    return spr_wal_sync(&wal->file);
+}
+
+static spr_thread_value_t
+spr_wal_flusher(void *arg)
+{
+    spr_wal_lsn_t start, end;
+    spr_wal_t *wal;
+    spr_err_t err;
+    uint64_t now;
+
+    wal = arg;
+
+    spr_mutex_lock(&wal->mutex);
+
+    for ( ;; ) {
+        while (wal->filled == wal->taken && !wal->stop) {
+            spr_cond_wait(&wal->flush_cond, &wal->mutex);
+        }
+
+        /* Stopped with nothing left to write */
+        if (wal->filled == wal->taken) {
+            break;
+        }
+
+        while (!wal->urgent && !wal->stop
+               && wal->filled - wal->taken < wal->batch_size)
+        {
+            now = spr_monotonic_msec();
+            if (now - wal->since >= wal->latency) {
+                break;
+            }
+
+            (void) spr_cond_timedwait(&wal->flush_cond, &wal->mutex,
+                                      wal->since + wal->latency - now);
+        }
+
+        start = wal->taken;
+        end = wal->filled;
+        wal->taken = end;
+
+        /* Records still being copied go out with the next batch */
+        if (end == wal->head) {
+            wal->urgent = false;
+        }
+
+        spr_mutex_unlock(&wal->mutex);
+
+        err = spr_wal_write(wal, start, end);
+
+        spr_mutex_lock(&wal->mutex);
+
+        if (err != SPR_OK) {
+            wal->err = err;
+            spr_cond_broadcast(&wal->done_cond);
+            break;
+        }
+
+        wal->durable = end;
+        spr_cond_broadcast(&wal->done_cond);
+    }
+
+    spr_mutex_unlock(&wal->mutex);
+
+    return 0;
+}
+
+/* Copies into the buffer at the log position, a NULL data writes zeros */
+static void
+spr_wal_copy(spr_wal_t *wal, spr_wal_lsn_t pos, const void *data,
+    size_t size)
+{
+    size_t off, n;
+
+    off = (size_t) (pos % wal->size);
+    n = (size < wal->size - off) ? size : wal->size - off;
+
+    if (data) {
+        spr_memcpy(wal->buf + off, data, n);
+        spr_memcpy(wal->buf, (const uint8_t *) data + n, size - n);
+
+    } else {
+        spr_memzero(wal->buf + off, n);
+        spr_memzero(wal->buf, size - n);
+    }
+}
+
+static void
+spr_wal_cleanup(spr_wal_t *wal)
+{
+    spr_mutex_lock(&wal->mutex);
+    wal->stop = true;
+    spr_cond_signal(&wal->flush_cond);
+    spr_mutex_unlock(&wal->mutex);
+
+    spr_thread_join(&wal->thread);
+    spr_thread_fini(&wal->thread);
+
+    if (wal->file.fd != SPR_INVALID_FILE) {
+        spr_file_close(&wal->file);
+    }
+
+    spr_cond_fini(&wal->fill_cond);
+    spr_cond_fini(&wal->done_cond);
+    spr_cond_fini(&wal->flush_cond);
+    spr_mutex_fini(&wal->mutex);
+}
+
+/*
+ * Sizes of 0 take the defaults, a latency of 0 flushes as soon as the
+ * previous batch is synced. The batch size is capped at half the buffer
+ * so that appenders keep filling one half while the other is written.
+ */
+spr_err_t
+spr_wal_create1(spr_wal_t **out_wal, spr_pool_t *pool, const char *dir,
+    size_t buffer_size, size_t batch_size, spr_msec_t latency,
+    size_t segment_size)
+{
+    spr_wal_t *wal;
+    spr_err_t err;
+    uint64_t segno;
+    size_t len;
+
+    wal = spr_pcalloc(pool, sizeof(spr_wal_t));
+    if (!wal) {
+        return spr_get_errno();
+    }
+
+    wal->size = buffer_size ? buffer_size : SPR_WAL_BUFFER_SIZE;
+    wal->batch_size = batch_size ? batch_size : SPR_WAL_BATCH_SIZE;
+    wal->segment_size = segment_size ? segment_size : SPR_WAL_SEGMENT_SIZE;
+    wal->latency = latency;
+
+    if (wal->batch_size > wal->size / 2) {
+        wal->batch_size = wal->size / 2;
+    }
+
+    if (wal->size < 2 * SPR_WAL_HEADER_SIZE
+        || wal->segment_size < SPR_WAL_HEADER_SIZE)
+    {
+        return SPR_DECLINED;
+    }
+
+    wal->buf = spr_palloc(pool, wal->size);
+    if (!wal->buf) {
+        return spr_get_errno();
+    }
+
+    len = spr_strlen(dir);
+
+    wal->dir = spr_pstrdup(pool, dir);
+    wal->path = spr_palloc(pool, len + 1 + SPR_WAL_NAME_LEN + 1);
+    if (!wal->dir || !wal->path) {
+        return spr_get_errno();
+    }
+
+    spr_memcpy(wal->path, dir, len);
+    wal->path[len] = SPR_PATH_SEPARATOR;
+
+    wal->file.fd = SPR_INVALID_FILE;
+
+    err = spr_wal_segment_next(wal, &segno);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    err = spr_wal_rotate(wal, segno);
+    if (err != SPR_OK) {
+        goto failed;
+    }
+
+    wal->head = segno * wal->segment_size;
+    wal->filled = wal->head;
+    wal->taken = wal->head;
+    wal->durable = wal->head;
+
+    err = spr_mutex_init(&wal->mutex, SPR_MUTEX_DEFAULT|SPR_MUTEX_COND);
+    if (err != SPR_OK) {
+        goto failed;
+    }
+
+    err = spr_cond_init(&wal->flush_cond);
+    if (err != SPR_OK) {
+        goto failed_mutex;
+    }
+
+    err = spr_cond_init(&wal->done_cond);
+    if (err != SPR_OK) {
+        goto failed_flush_cond;
+    }
+
+    err = spr_cond_init(&wal->fill_cond);
+    if (err != SPR_OK) {
+        goto failed_done_cond;
+    }
+
+    err = spr_thread_init(&wal->thread, SPR_THREAD_CREATE_JOINABLE, 0,
+                          SPR_THREAD_PRIORITY_NORMAL, spr_wal_flusher, wal);
+    if (err != SPR_OK) {
+        goto failed_fill_cond;
+    }
+
+    spr_pool_cleanup_add(pool, wal, spr_wal_cleanup);
+
+    *out_wal = wal;
+
+    return SPR_OK;
+
+failed_fill_cond:
+
+    spr_cond_fini(&wal->fill_cond);
+
+failed_done_cond:
+
+    spr_cond_fini(&wal->done_cond);
+
+failed_flush_cond:
+
+    spr_cond_fini(&wal->flush_cond);
+
+failed_mutex:
+
+    spr_mutex_fini(&wal->mutex);
+
+failed:
+
+    if (wal->file.fd != SPR_INVALID_FILE) {
+        spr_file_close(&wal->file);
+    }
+
+    return err;
+}
+
+spr_wal_t *
+spr_wal_create(spr_pool_t *pool, const char *dir, size_t buffer_size,
+    size_t batch_size, spr_msec_t latency, size_t segment_size)
+{
+    spr_wal_t *wal;
+
+    wal = NULL;
+
+    if (spr_wal_create1(&wal, pool, dir, buffer_size, batch_size, latency,
+                        segment_size) != SPR_OK)
+    {
+        return NULL;
+    }
+
+    return wal;
+}
+
+/*
+ * Returns once the record is in the buffer, lsn is set to the position
+ * past it for spr_wal_wait(). Records larger than half the buffer or
+ * than a segment are declined. An appender that finds the buffer full
+ * waits for the flusher, which then starts without waiting for a batch.
+ * The copy runs outside the mutex, only its completion is published in
+ * log order, after the records reserved before it.
+ */
+spr_err_t
+spr_wal_append(spr_wal_t *wal, const void *data, size_t size,
+    spr_wal_lsn_t *lsn)
+{
+    uint8_t header[SPR_WAL_HEADER_SIZE];
+    spr_wal_lsn_t start, end;
+    size_t len, pad, off;
+    uint32_t crc;
+    spr_err_t err;
+    bool wake;
+
+    if (size > wal->size / 2 - SPR_WAL_HEADER_SIZE
+        || size > wal->segment_size - SPR_WAL_HEADER_SIZE)
+    {
+        return SPR_DECLINED;
+    }
+
+    len = SPR_WAL_HEADER_SIZE + size;
+
+    header[0] = (uint8_t) size;
+    header[1] = (uint8_t) (size >> 8);
+    header[2] = (uint8_t) (size >> 16);
+    header[3] = (uint8_t) (size >> 24);
+
+    crc = spr_crc32c(0, header, 4);
+    crc = spr_crc32c(crc, data, size);
+
+    header[4] = (uint8_t) crc;
+    header[5] = (uint8_t) (crc >> 8);
+    header[6] = (uint8_t) (crc >> 16);
+    header[7] = (uint8_t) (crc >> 24);
+
+    spr_mutex_lock(&wal->mutex);
+
+    for ( ;; ) {
+        if (wal->err != SPR_OK || wal->stop) {
+            err = (wal->err != SPR_OK) ? wal->err : SPR_ABORT;
+            spr_mutex_unlock(&wal->mutex);
+            return err;
+        }
+
+        /* A record that does not fit the segment moves to the next one */
+        off = (size_t) (wal->head % wal->segment_size);
+        pad = (off + len > wal->segment_size) ? wal->segment_size - off : 0;
+
+        if (wal->head + pad + len - wal->durable <= wal->size) {
+            break;
+        }
+
+        wal->urgent = true;
+        spr_cond_signal(&wal->flush_cond);
+        spr_cond_wait(&wal->done_cond, &wal->mutex);
+    }
+
+    start = wal->head;
+    end = start + pad + len;
+    wal->head = end;
+
+    spr_mutex_unlock(&wal->mutex);
+
+    spr_wal_copy(wal, start, NULL, pad);
+    spr_wal_copy(wal, start + pad, header, SPR_WAL_HEADER_SIZE);
+    spr_wal_copy(wal, start + pad + SPR_WAL_HEADER_SIZE, data, size);
+
+    spr_mutex_lock(&wal->mutex);
+
+    while (wal->filled != start) {
+        spr_cond_wait(&wal->fill_cond, &wal->mutex);
+    }
+
+    if (wal->filled == wal->taken) {
+        wal->since = spr_monotonic_msec();
+        wake = true;
+
+    } else {
+        wake = (wal->filled - wal->taken < wal->batch_size
+                && end - wal->taken >= wal->batch_size);
+    }
+
+    wal->filled = end;
+
+    if (end != wal->head) {
+        spr_cond_broadcast(&wal->fill_cond);
+    }
+
+    if (wake || wal->urgent) {
+        spr_cond_signal(&wal->flush_cond);
+    }
+
+    spr_mutex_unlock(&wal->mutex);
+
+    if (lsn) {
+        *lsn = end;
+    }
+
+    return SPR_OK;
+}
+
+/* Waits until the log is durable up to lsn */
+spr_err_t
+spr_wal_wait(spr_wal_t *wal, spr_wal_lsn_t lsn)
+{
+    spr_err_t err;
+
+    spr_mutex_lock(&wal->mutex);
+
+    while (wal->durable < lsn && wal->err == SPR_OK) {
+        spr_cond_wait(&wal->done_cond, &wal->mutex);
+    }
+
+    err = (wal->durable >= lsn) ? SPR_OK : wal->err;
+
+    spr_mutex_unlock(&wal->mutex);
+
+    return err;
+}
+
+spr_err_t
+spr_wal_commit(spr_wal_t *wal, const void *data, size_t size)
+{
+    spr_wal_lsn_t lsn;
+    spr_err_t err;
+
+    err = spr_wal_append(wal, data, size, &lsn);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    return spr_wal_wait(wal, lsn);
+}
+
+/* Makes everything appended so far durable without waiting for a batch */
+spr_err_t
+spr_wal_flush(spr_wal_t *wal)
+{
+    spr_wal_lsn_t lsn;
+
+    spr_mutex_lock(&wal->mutex);
+
+    lsn = wal->head;
+
+    if (lsn != wal->taken) {
+        wal->urgent = true;
+        spr_cond_signal(&wal->flush_cond);
+    }
+
+    spr_mutex_unlock(&wal->mutex);
+
+    return spr_wal_wait(wal, lsn);
+}
+
+spr_wal_lsn_t
+spr_wal_durable(spr_wal_t *wal)
+{
+    spr_wal_lsn_t lsn;
+
+    spr_mutex_lock(&wal->mutex);
+    lsn = wal->durable;
+    spr_mutex_unlock(&wal->mutex);
+
+    return lsn;
+}
@@ -0,0 +1,185 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "spr_portable.h"
+#include "spr_cond.h"
+#include "spr_errno.h"
+
+#if (SPR_POSIX)
+
+/*
+ * Timeouts run on the monotonic clock where the condition variable can
+ * be told to use it, so a clock step does not stretch or cut the wait.
+ */
+spr_err_t
+spr_cond_init(spr_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    spr_err_t err;
+
+    err = pthread_condattr_init(&attr);
+    if (err != 0) {
+        return err;
+    }
+
+#if !(SPR_DARWIN)
+    err = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    if (err != 0) {
+        pthread_condattr_destroy(&attr);
+        return err;
+    }
+#endif
+
+    err = pthread_cond_init(&cond->handle, &attr);
+
+    pthread_condattr_destroy(&attr);
+
+    return err;
+}
+
+spr_err_t
+spr_cond_wait(spr_cond_t *cond, spr_mutex_t *mutex)
+{
+    return pthread_cond_wait(&cond->handle, &mutex->handle);
+}
+
+/* Returns SPR_BUSY when the timeout expires */
+spr_err_t
+spr_cond_timedwait(spr_cond_t *cond, spr_mutex_t *mutex, spr_msec_t timeout)
+{
+    struct timespec ts;
+    spr_err_t err;
+
+    ts.tv_sec = (time_t) (timeout / 1000);
+    ts.tv_nsec = (long) (timeout % 1000) * 1000000;
+
+#if (SPR_DARWIN)
+    err = pthread_cond_timedwait_relative_np(&cond->handle, &mutex->handle,
+                                             &ts);
+#else
+    {
+        struct timespec now;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        ts.tv_sec += now.tv_sec;
+        ts.tv_nsec += now.tv_nsec;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+    }
+
+    err = pthread_cond_timedwait(&cond->handle, &mutex->handle, &ts);
+#endif
+
+    if (err == ETIMEDOUT) {
+        return SPR_BUSY;
+    }
+
+    return err;
+}
+
+spr_err_t
+spr_cond_signal(spr_cond_t *cond)
+{
+    return pthread_cond_signal(&cond->handle);
+}
+
+spr_err_t
+spr_cond_broadcast(spr_cond_t *cond)
+{
+    return pthread_cond_broadcast(&cond->handle);
+}
+
+void
+spr_cond_fini(spr_cond_t *cond)
+{
+    pthread_cond_destroy(&cond->handle);
+}
+
+
+#elif (SPR_WIN32)
+
+spr_err_t
+spr_cond_init(spr_cond_t *cond)
+{
+    InitializeConditionVariable(&cond->handle);
+    return SPR_OK;
+}
+
+spr_err_t
+spr_cond_wait(spr_cond_t *cond, spr_mutex_t *mutex)
+{
+    return spr_cond_timedwait(cond, mutex, INFINITE);
+}
+
+spr_err_t
+spr_cond_timedwait(spr_cond_t *cond, spr_mutex_t *mutex, spr_msec_t timeout)
+{
+    if (mutex->type != spr_mutex_critical_section) {
+        return ERROR_NOT_SUPPORTED;
+    }
+
+    if (timeout > INFINITE) {
+        timeout = INFINITE;
+    }
+
+    if (SleepConditionVariableCS(&cond->handle, &mutex->section,
+                                 (DWORD) timeout) == 0)
+    {
+        if (spr_get_errno() == ERROR_TIMEOUT) {
+            return SPR_BUSY;
+        }
+        return spr_get_errno();
+    }
+
+    return SPR_OK;
+}
+
+spr_err_t
+spr_cond_signal(spr_cond_t *cond)
+{
+    WakeConditionVariable(&cond->handle);
+    return SPR_OK;
+}
+
+spr_err_t
+spr_cond_broadcast(spr_cond_t *cond)
+{
+    WakeAllConditionVariable(&cond->handle);
+    return SPR_OK;
+}
+
+void
+spr_cond_fini(spr_cond_t *cond)
+{
+    (void) cond;
+}
+
+#endif
@@ -114,9 +114,10 @@ spr_mutex_init(spr_mutex_t *mutex, spr_bitfield_t params)
 {
     HANDLE handle;
 
-    (void) params;
-
-    if (spr_bit_is_set(params, SPR_MUTEX_RECURSIVE)) {
+    /* spr_cond can only sleep on a critical section */
+    if (spr_bit_is_set(params, SPR_MUTEX_RECURSIVE)
+        || spr_bit_is_set(params, SPR_MUTEX_COND))
+    {
         InitializeCriticalSection(&mutex->section);
         mutex->handle = NULL;
         mutex->type = spr_mutex_critical_section;
@@ -0,0 +1,489 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "spr_portable.h"
+#include "spr_queue.h"
+#include "spr_atomic.h"
+#include "spr_memory.h"
+#include "spr_errno.h"
+
+#define SPR_MPMC_SEMAPHORE_MAX       0x7fffffff
+
+#if (SPR_POSIX)
+#define spr_mpmc_interrupted(err)    ((err) == EINTR)
+#else
+#define spr_mpmc_interrupted(err)    0
+#endif
+
+
+static spr_err_t
+spr_mpmc_queue_init(spr_mpmc_queue_t *queue, spr_pool_t *pool, size_t n)
+{
+    size_t size, i;
+
+    for (size = 2; size < n; size <<= 1) {
+        /* void */
+    }
+
+    queue->cells = spr_pmemalign(pool, size * sizeof(spr_mpmc_cell_t),
+                                 SPR_CACHELINE_SIZE);
+    if (!queue->cells) {
+        return spr_get_errno();
+    }
+
+    for (i = 0; i < size; ++i) {
+        queue->cells[i].seq = i;
+        queue->cells[i].data = NULL;
+    }
+
+    queue->mask = size - 1;
+    queue->head = 0;
+    queue->tail = 0;
+
+    return SPR_OK;
+}
+
+spr_err_t
+spr_mpmc_queue_create1(spr_mpmc_queue_t **out_queue, spr_pool_t *pool,
+    size_t n)
+{
+    spr_mpmc_queue_t *queue;
+    spr_err_t err;
+
+    queue = spr_pmemalign(pool, sizeof(spr_mpmc_queue_t),
+                          SPR_CACHELINE_SIZE);
+    if (!queue) {
+        return spr_get_errno();
+    }
+
+    err = spr_mpmc_queue_init(queue, pool, n);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    *out_queue = queue;
+
+    return SPR_OK;
+}
+
+spr_mpmc_queue_t *
+spr_mpmc_queue_create(spr_pool_t *pool, size_t n)
+{
+    spr_mpmc_queue_t *queue;
+
+    queue = NULL;
+
+    if (spr_mpmc_queue_create1(&queue, pool, n) != SPR_OK) {
+        return NULL;
+    }
+
+    return queue;
+}
+
+spr_err_t
+spr_mpmc_queue_try_push(spr_mpmc_queue_t *queue, void *data)
+{
+    spr_mpmc_cell_t *cell;
+    spr_int_t dif;
+    size_t pos;
+
+    pos = spr_atomic_load_relaxed(&queue->head);
+
+    for ( ; ; ) {
+        cell = &queue->cells[pos & queue->mask];
+        dif = (spr_int_t) spr_atomic_load(&cell->seq) - (spr_int_t) pos;
+
+        if (dif == 0) {
+            if (spr_atomic_cas_weak(&queue->head, &pos, pos + 1)) {
+                break;
+            }
+        }
+        else if (dif < 0) {
+            return SPR_BUSY;
+        }
+        else {
+            pos = spr_atomic_load_relaxed(&queue->head);
+        }
+    }
+
+    cell->data = data;
+    spr_atomic_store(&cell->seq, pos + 1);
+
+    return SPR_OK;
+}
+
+spr_err_t
+spr_mpmc_queue_try_pop(spr_mpmc_queue_t *queue, void **data)
+{
+    spr_mpmc_cell_t *cell;
+    spr_int_t dif;
+    size_t pos;
+
+    pos = spr_atomic_load_relaxed(&queue->tail);
+
+    for ( ; ; ) {
+        cell = &queue->cells[pos & queue->mask];
+        dif = (spr_int_t) spr_atomic_load(&cell->seq) - (spr_int_t) (pos + 1);
+
+        if (dif == 0) {
+            if (spr_atomic_cas_weak(&queue->tail, &pos, pos + 1)) {
+                break;
+            }
+        }
+        else if (dif < 0) {
+            return SPR_BUSY;
+        }
+        else {
+            pos = spr_atomic_load_relaxed(&queue->tail);
+        }
+    }
+
+    *data = cell->data;
+    spr_atomic_store(&cell->seq, pos + queue->mask + 1);
+
+    return SPR_OK;
+}
+
+/*
+ * Bulk operations claim the longest run of ready cells with a single
+ * CAS, returns the number of transferred items
+ */
+size_t
+spr_mpmc_queue_push_bulk(spr_mpmc_queue_t *queue, void *const *data,
+    size_t n)
+{
+    spr_mpmc_cell_t *cell;
+    spr_int_t dif;
+    size_t pos, k, i;
+
+    if (n == 0) {
+        return 0;
+    }
+
+    if (n > queue->mask + 1) {
+        n = queue->mask + 1;
+    }
+
+    pos = spr_atomic_load_relaxed(&queue->head);
+
+    for ( ; ; ) {
+        cell = &queue->cells[pos & queue->mask];
+        dif = (spr_int_t) spr_atomic_load(&cell->seq) - (spr_int_t) pos;
+
+        if (dif < 0) {
+            return 0;
+        }
+
+        if (dif > 0) {
+            pos = spr_atomic_load_relaxed(&queue->head);
+            continue;
+        }
+
+        for (k = 1; k < n; ++k) {
+            cell = &queue->cells[(pos + k) & queue->mask];
+            if (spr_atomic_load(&cell->seq) != pos + k) {
+                break;
+            }
+        }
+
+        if (spr_atomic_cas_weak(&queue->head, &pos, pos + k)) {
+            break;
+        }
+    }
+
+    for (i = 0; i < k; ++i) {
+        cell = &queue->cells[(pos + i) & queue->mask];
+        cell->data = data[i];
+        spr_atomic_store(&cell->seq, pos + i + 1);
+    }
+
+    return k;
+}
+
+size_t
+spr_mpmc_queue_pop_bulk(spr_mpmc_queue_t *queue, void **data, size_t n)
+{
+    spr_mpmc_cell_t *cell;
+    spr_int_t dif;
+    size_t pos, k, i;
+
+    if (n == 0) {
+        return 0;
+    }
+
+    if (n > queue->mask + 1) {
+        n = queue->mask + 1;
+    }
+
+    pos = spr_atomic_load_relaxed(&queue->tail);
+
+    for ( ; ; ) {
+        cell = &queue->cells[pos & queue->mask];
+        dif = (spr_int_t) spr_atomic_load(&cell->seq) - (spr_int_t) (pos + 1);
+
+        if (dif < 0) {
+            return 0;
+        }
+
+        if (dif > 0) {
+            pos = spr_atomic_load_relaxed(&queue->tail);
+            continue;
+        }
+
+        for (k = 1; k < n; ++k) {
+            cell = &queue->cells[(pos + k) & queue->mask];
+            if (spr_atomic_load(&cell->seq) != pos + k + 1) {
+                break;
+            }
+        }
+
+        if (spr_atomic_cas_weak(&queue->tail, &pos, pos + k)) {
+            break;
+        }
+    }
+
+    for (i = 0; i < k; ++i) {
+        cell = &queue->cells[(pos + i) & queue->mask];
+        data[i] = cell->data;
+        spr_atomic_store(&cell->seq, pos + i + queue->mask + 1);
+    }
+
+    return k;
+}
+
+/* The result is approximate while other threads use the queue */
+size_t
+spr_mpmc_queue_size(spr_mpmc_queue_t *queue)
+{
+    size_t head, tail;
+
+    tail = spr_atomic_load(&queue->tail);
+    head = spr_atomic_load(&queue->head);
+
+    return head > tail ? head - tail : 0;
+}
+
+static void
+spr_mpmc_bqueue_cleanup(spr_mpmc_bqueue_t *queue)
+{
+    spr_semaphore_fini(&queue->items_sem);
+    spr_semaphore_fini(&queue->slots_sem);
+}
+
+spr_err_t
+spr_mpmc_bqueue_create1(spr_mpmc_bqueue_t **out_queue, spr_pool_t *pool,
+    size_t n)
+{
+    spr_mpmc_bqueue_t *queue;
+    spr_err_t err;
+
+    queue = spr_pmemalign(pool, sizeof(spr_mpmc_bqueue_t),
+                          SPR_CACHELINE_SIZE);
+    if (!queue) {
+        return spr_get_errno();
+    }
+
+    err = spr_mpmc_queue_init(&queue->queue, pool, n);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    queue->items = 0;
+    queue->slots = (spr_ssize_t) spr_mpmc_queue_capacity(&queue->queue);
+
+    err = spr_semaphore_init(&queue->items_sem, 0, SPR_MPMC_SEMAPHORE_MAX,
+                             SPR_SEMAPHORE_PRIVATE);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    err = spr_semaphore_init(&queue->slots_sem, 0, SPR_MPMC_SEMAPHORE_MAX,
+                             SPR_SEMAPHORE_PRIVATE);
+    if (err != SPR_OK) {
+        spr_semaphore_fini(&queue->items_sem);
+        return err;
+    }
+
+    spr_pool_cleanup_add(pool, queue, spr_mpmc_bqueue_cleanup);
+
+    *out_queue = queue;
+
+    return SPR_OK;
+}
+
+spr_mpmc_bqueue_t *
+spr_mpmc_bqueue_create(spr_pool_t *pool, size_t n)
+{
+    spr_mpmc_bqueue_t *queue;
+
+    queue = NULL;
+
+    if (spr_mpmc_bqueue_create1(&queue, pool, n) != SPR_OK) {
+        return NULL;
+    }
+
+    return queue;
+}
+
+/*
+ * A decremented counter reserves an item or a cell, the matching push
+ * or pop may still be in flight, so the queue operation is retried
+ */
+static void
+spr_mpmc_bqueue_put(spr_mpmc_bqueue_t *queue, void *data)
+{
+    while (spr_mpmc_queue_try_push(&queue->queue, data) != SPR_OK) {
+        spr_cpu_relax();
+    }
+
+    if (spr_atomic_fetch_add(&queue->items, 1) < 0) {
+        spr_semaphore_post(&queue->items_sem);
+    }
+}
+
+static void
+spr_mpmc_bqueue_get(spr_mpmc_bqueue_t *queue, void **data)
+{
+    while (spr_mpmc_queue_try_pop(&queue->queue, data) != SPR_OK) {
+        spr_cpu_relax();
+    }
+
+    if (spr_atomic_fetch_add(&queue->slots, 1) < 0) {
+        spr_semaphore_post(&queue->slots_sem);
+    }
+}
+
+static bool
+spr_mpmc_bqueue_try_reserve(spr_ssize_t *counter)
+{
+    spr_ssize_t value;
+
+    value = spr_atomic_load_relaxed(counter);
+
+    do {
+        if (value <= 0) {
+            return 0;
+        }
+    } while (!spr_atomic_cas_weak(counter, &value, value - 1));
+
+    return 1;
+}
+
+/*
+ * Withdraws a waiter whose wait failed. While the counter is negative
+ * the reservation is simply given back. Otherwise a put has already
+ * counted this waiter and its post is pending or on the way, it is
+ * taken back and passed on the way a put would.
+ */
+static void
+spr_mpmc_bqueue_cancel(spr_ssize_t *counter, spr_semaphore_t *sem)
+{
+    spr_ssize_t value;
+
+    value = spr_atomic_load_relaxed(counter);
+
+    while (value < 0) {
+        if (spr_atomic_cas_weak(counter, &value, value + 1)) {
+            return;
+        }
+    }
+
+    while (spr_semaphore_trywait(sem) != SPR_OK) {
+        spr_cpu_relax();
+    }
+
+    if (spr_atomic_fetch_add(counter, 1) < 0) {
+        spr_semaphore_post(sem);
+    }
+}
+
+spr_err_t
+spr_mpmc_bqueue_push(spr_mpmc_bqueue_t *queue, void *data)
+{
+    spr_err_t err;
+
+    if (spr_atomic_fetch_sub(&queue->slots, 1) <= 0) {
+        do {
+            err = spr_semaphore_wait(&queue->slots_sem);
+        } while (spr_mpmc_interrupted(err));
+
+        if (err != SPR_OK) {
+            spr_mpmc_bqueue_cancel(&queue->slots, &queue->slots_sem);
+            return err;
+        }
+    }
+
+    spr_mpmc_bqueue_put(queue, data);
+
+    return SPR_OK;
+}
+
+spr_err_t
+spr_mpmc_bqueue_pop(spr_mpmc_bqueue_t *queue, void **data)
+{
+    spr_err_t err;
+
+    if (spr_atomic_fetch_sub(&queue->items, 1) <= 0) {
+        do {
+            err = spr_semaphore_wait(&queue->items_sem);
+        } while (spr_mpmc_interrupted(err));
+
+        if (err != SPR_OK) {
+            spr_mpmc_bqueue_cancel(&queue->items, &queue->items_sem);
+            return err;
+        }
+    }
+
+    spr_mpmc_bqueue_get(queue, data);
+
+    return SPR_OK;
+}
+
+spr_err_t
+spr_mpmc_bqueue_try_push(spr_mpmc_bqueue_t *queue, void *data)
+{
+    if (!spr_mpmc_bqueue_try_reserve(&queue->slots)) {
+        return SPR_BUSY;
+    }
+
+    spr_mpmc_bqueue_put(queue, data);
+
+    return SPR_OK;
+}
+
+spr_err_t
+spr_mpmc_bqueue_try_pop(spr_mpmc_bqueue_t *queue, void **data)
+{
+    if (!spr_mpmc_bqueue_try_reserve(&queue->items)) {
+        return SPR_BUSY;
+    }
+
+    spr_mpmc_bqueue_get(queue, data);
+
+    return SPR_OK;
+}
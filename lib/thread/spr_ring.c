@@ -0,0 +1,587 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 movhex <movhex@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "spr_portable.h"
+#include "spr_ring.h"
+#include "spr_atomic.h"
+#include "spr_memory.h"
+#include "spr_errno.h"
+
+#define SPR_RING_NAME_SIZE           64
+#define SPR_RING_NAME_ATTEMPTS       16
+
+
+static size_t
+spr_ring_round_size(size_t size)
+{
+    size_t n;
+
+    for (n = spr_get_page_size(); n < size; n <<= 1) {
+        /* void */
+    }
+
+    return n;
+}
+
+static spr_ring_t *
+spr_ring_alloc(spr_pool_t *pool)
+{
+    spr_ring_t *ring;
+
+    ring = spr_pmemalign(pool, sizeof(spr_ring_t), SPR_CACHELINE_SIZE);
+    if (!ring) {
+        return NULL;
+    }
+
+    spr_memzero(ring, sizeof(spr_ring_t));
+
+    return ring;
+}
+
+static void
+spr_ring_attach(spr_ring_t *ring, uint8_t *base, size_t size, bool init)
+{
+    ring->ctl = (spr_ring_ctl_t *) base;
+    ring->data = base + spr_get_page_size();
+    ring->mask = size - 1;
+
+    if (init) {
+        ring->ctl->head = 0;
+        ring->ctl->tail = 0;
+        ring->ctl->size = size;
+    }
+
+    ring->cached_tail = spr_atomic_load(&ring->ctl->tail);
+    ring->cached_head = spr_atomic_load(&ring->ctl->head);
+}
+
+/* Fallback without a mapping, the ring is private and never mirrored */
+static spr_err_t
+spr_ring_create_local(spr_ring_t **out_ring, spr_pool_t *pool,
+    size_t size)
+{
+    spr_ring_t *ring;
+    uint8_t *base;
+
+    ring = spr_ring_alloc(pool);
+    if (!ring) {
+        return spr_get_errno();
+    }
+
+    base = spr_pmemalign(pool, spr_get_page_size() + size,
+                         spr_get_page_size());
+    if (!base) {
+        return spr_get_errno();
+    }
+
+    spr_ring_attach(ring, base, size, 1);
+
+    *out_ring = ring;
+
+    return SPR_OK;
+}
+
+
+#if (SPR_POSIX && SPR_HAVE_MMAP && SPR_HAVE_SHM_OPEN)
+
+static void
+spr_ring_cleanup(spr_ring_t *ring)
+{
+    munmap(ring->map, ring->map_size);
+}
+
+/*
+ * The file holds the control page followed by the data, the data is
+ * mapped a second time right after the first mapping
+ */
+static spr_err_t
+spr_ring_map(spr_ring_t *ring, int fd, size_t size)
+{
+    uint8_t *addr;
+    size_t hdr, total;
+
+    hdr = spr_get_page_size();
+    total = hdr + 2 * size;
+
+    addr = mmap(NULL, total, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+
+    if (addr != MAP_FAILED) {
+        if (mmap(addr, hdr + size, PROT_READ|PROT_WRITE,
+                 MAP_SHARED|MAP_FIXED, fd, 0) != MAP_FAILED
+            && mmap(addr + hdr + size, size, PROT_READ|PROT_WRITE,
+                    MAP_SHARED|MAP_FIXED, fd, hdr) != MAP_FAILED)
+        {
+            ring->map = addr;
+            ring->map_size = total;
+            ring->mirror = 1;
+            return SPR_OK;
+        }
+
+        munmap(addr, total);
+    }
+
+    addr = mmap(NULL, hdr + size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        return spr_get_errno();
+    }
+
+    ring->map = addr;
+    ring->map_size = hdr + size;
+    ring->mirror = 0;
+
+    return SPR_OK;
+}
+
+static spr_err_t
+spr_ring_open_fd(spr_ring_t **out_ring, spr_pool_t *pool, int fd,
+    size_t size, bool init)
+{
+    spr_ring_t *ring;
+    spr_err_t err;
+
+    ring = spr_ring_alloc(pool);
+    if (!ring) {
+        return spr_get_errno();
+    }
+
+    if (init && ftruncate(fd, spr_get_page_size() + size) != 0) {
+        return spr_get_errno();
+    }
+
+    err = spr_ring_map(ring, fd, size);
+    if (err != SPR_OK) {
+        return err;
+    }
+
+    spr_ring_attach(ring, ring->map, size, init);
+    spr_pool_cleanup_add(pool, ring, spr_ring_cleanup);
+
+    *out_ring = ring;
+
+    return SPR_OK;
+}
+
+spr_err_t
+spr_ring_create1(spr_ring_t **ring, spr_pool_t *pool, size_t size)
+{
+    static size_t counter;
+    char name[SPR_RING_NAME_SIZE];
+    spr_uint_t i;
+    spr_err_t err;
+    int fd;
+
+    size = spr_ring_round_size(size);
+    fd = -1;
+
+    for (i = 0; i < SPR_RING_NAME_ATTEMPTS; ++i) {
+        snprintf(name, sizeof(name), "/spr-ring-%ld-%lu", (long) getpid(),
+                 (unsigned long) spr_atomic_fetch_add(&counter, 1));
+
+        fd = shm_open(name, O_RDWR|O_CREAT|O_EXCL, 0600);
+        if (fd != -1 || errno != EEXIST) {
+            break;
+        }
+    }
+
+    if (fd == -1) {
+        return spr_ring_create_local(ring, pool, size);
+    }
+
+    shm_unlink(name);
+
+    err = spr_ring_open_fd(ring, pool, fd, size, 1);
+    close(fd);
+
+    return err;
+}
+
+spr_err_t
+spr_ring_create_shared(spr_ring_t **ring, spr_pool_t *pool,
+    const char *name, size_t size)
+{
+    spr_err_t err;
+    int fd;
+
+    fd = shm_open(name, O_RDWR|O_CREAT|O_EXCL, 0600);
+    if (fd == -1) {
+        return spr_get_errno();
+    }
+
+    err = spr_ring_open_fd(ring, pool, fd, spr_ring_round_size(size), 1);
+    close(fd);
+
+    if (err != SPR_OK) {
+        shm_unlink(name);
+    }
+
+    return err;
+}
+
+spr_err_t
+spr_ring_open_shared(spr_ring_t **ring, spr_pool_t *pool,
+    const char *name)
+{
+    struct stat st;
+    spr_err_t err;
+    size_t size;
+    int fd;
+
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd == -1) {
+        return spr_get_errno();
+    }
+
+    if (fstat(fd, &st) != 0) {
+        err = spr_get_errno();
+        close(fd);
+        return err;
+    }
+
+    size = (size_t) st.st_size - spr_get_page_size();
+
+    if ((size_t) st.st_size <= spr_get_page_size() || (size & (size - 1))) {
+        close(fd);
+        return SPR_FAILED;
+    }
+
+    err = spr_ring_open_fd(ring, pool, fd, size, 0);
+    close(fd);
+
+    return err;
+}
+
+spr_err_t
+spr_ring_remove_shared(const char *name)
+{
+    if (shm_unlink(name) != 0) {
+        return spr_get_errno();
+    }
+
+    return SPR_OK;
+}
+
+
+#elif (SPR_WIN32)
+
+static void
+spr_ring_cleanup(spr_ring_t *ring)
+{
+    UnmapViewOfFile(ring->map);
+    CloseHandle(ring->mapping);
+}
+
+spr_err_t
+spr_ring_create1(spr_ring_t **ring, spr_pool_t *pool, size_t size)
+{
+    return spr_ring_create_local(ring, pool, spr_ring_round_size(size));
+}
+
+static spr_err_t
+spr_ring_map(spr_ring_t **out_ring, spr_pool_t *pool, HANDLE mapping,
+    size_t size, bool init)
+{
+    MEMORY_BASIC_INFORMATION info;
+    spr_ring_t *ring;
+    uint8_t *base;
+    spr_err_t err;
+
+    ring = spr_ring_alloc(pool);
+    if (!ring) {
+        err = spr_get_errno();
+        CloseHandle(mapping);
+        return err;
+    }
+
+    base = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!base) {
+        err = spr_get_errno();
+        CloseHandle(mapping);
+        return err;
+    }
+
+    if (!init) {
+        size = ((spr_ring_ctl_t *) base)->size;
+
+        /* The header is written by another process, do not trust its size */
+        if (VirtualQuery(base, &info, sizeof(info)) == 0
+            || size == 0 || (size & (size - 1))
+            || size > info.RegionSize - spr_get_page_size())
+        {
+            UnmapViewOfFile(base);
+            CloseHandle(mapping);
+            return SPR_FAILED;
+        }
+    }
+
+    ring->map = base;
+    ring->mapping = mapping;
+
+    spr_ring_attach(ring, base, size, init);
+    spr_pool_cleanup_add(pool, ring, spr_ring_cleanup);
+
+    *out_ring = ring;
+
+    return SPR_OK;
+}
+
+spr_err_t
+spr_ring_create_shared(spr_ring_t **ring, spr_pool_t *pool,
+    const char *name, size_t size)
+{
+    uint64_t total;
+    HANDLE mapping;
+
+    size = spr_ring_round_size(size);
+    total = (uint64_t) spr_get_page_size() + size;
+
+    mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                 (DWORD) (total >> 32), (DWORD) total, name);
+    if (!mapping) {
+        return spr_get_errno();
+    }
+
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(mapping);
+        return ERROR_ALREADY_EXISTS;
+    }
+
+    return spr_ring_map(ring, pool, mapping, size, 1);
+}
+
+spr_err_t
+spr_ring_open_shared(spr_ring_t **ring, spr_pool_t *pool,
+    const char *name)
+{
+    HANDLE mapping;
+
+    mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+    if (!mapping) {
+        return spr_get_errno();
+    }
+
+    return spr_ring_map(ring, pool, mapping, 0, 0);
+}
+
+/* Named mappings go away with the last handle */
+spr_err_t
+spr_ring_remove_shared(const char *name)
+{
+    (void) name;
+    return SPR_OK;
+}
+
+
+#else
+
+spr_err_t
+spr_ring_create1(spr_ring_t **ring, spr_pool_t *pool, size_t size)
+{
+    return spr_ring_create_local(ring, pool, spr_ring_round_size(size));
+}
+
+spr_err_t
+spr_ring_create_shared(spr_ring_t **ring, spr_pool_t *pool,
+    const char *name, size_t size)
+{
+    (void) ring;
+    (void) pool;
+    (void) name;
+    (void) size;
+    return SPR_FAILED;
+}
+
+spr_err_t
+spr_ring_open_shared(spr_ring_t **ring, spr_pool_t *pool,
+    const char *name)
+{
+    (void) ring;
+    (void) pool;
+    (void) name;
+    return SPR_FAILED;
+}
+
+spr_err_t
+spr_ring_remove_shared(const char *name)
+{
+    (void) name;
+    return SPR_FAILED;
+}
+
+#endif
+
+
+spr_ring_t *
+spr_ring_create(spr_pool_t *pool, size_t size)
+{
+    spr_ring_t *ring;
+
+    ring = NULL;
+
+    if (spr_ring_create1(&ring, pool, size) != SPR_OK) {
+        return NULL;
+    }
+
+    return ring;
+}
+
+/*
+ * On input len holds the minimal number of bytes the caller needs,
+ * zero means any. On output it holds the contiguous free space.
+ */
+void *
+spr_ring_reserve(spr_ring_t *ring, size_t *len)
+{
+    size_t head, size, avail, want;
+
+    head = spr_atomic_load_relaxed(&ring->ctl->head);
+    size = ring->mask + 1;
+    want = *len ? *len : 1;
+
+    avail = size - (head - ring->cached_tail);
+
+    if (avail < want) {
+        ring->cached_tail = spr_atomic_load(&ring->ctl->tail);
+        avail = size - (head - ring->cached_tail);
+    }
+
+    if (!ring->mirror && avail > size - (head & ring->mask)) {
+        avail = size - (head & ring->mask);
+    }
+
+    *len = avail;
+
+    if (avail < want) {
+        return NULL;
+    }
+
+    return ring->data + (head & ring->mask);
+}
+
+void
+spr_ring_commit(spr_ring_t *ring, size_t n)
+{
+    size_t head;
+
+    head = spr_atomic_load_relaxed(&ring->ctl->head);
+    spr_atomic_store(&ring->ctl->head, head + n);
+}
+
+/* Same as spr_ring_reserve() for the readable data */
+const void *
+spr_ring_peek(spr_ring_t *ring, size_t *len)
+{
+    size_t tail, size, avail, want;
+
+    tail = spr_atomic_load_relaxed(&ring->ctl->tail);
+    size = ring->mask + 1;
+    want = *len ? *len : 1;
+
+    avail = ring->cached_head - tail;
+
+    if (avail < want) {
+        ring->cached_head = spr_atomic_load(&ring->ctl->head);
+        avail = ring->cached_head - tail;
+    }
+
+    if (!ring->mirror && avail > size - (tail & ring->mask)) {
+        avail = size - (tail & ring->mask);
+    }
+
+    *len = avail;
+
+    if (avail < want) {
+        return NULL;
+    }
+
+    return ring->data + (tail & ring->mask);
+}
+
+void
+spr_ring_release(spr_ring_t *ring, size_t n)
+{
+    size_t tail;
+
+    tail = spr_atomic_load_relaxed(&ring->ctl->tail);
+    spr_atomic_store(&ring->ctl->tail, tail + n);
+}
+
+size_t
+spr_ring_write(spr_ring_t *ring, const void *data, size_t n)
+{
+    size_t total, len;
+    uint8_t *p;
+
+    total = 0;
+
+    while (total < n) {
+        len = 0;
+
+        p = spr_ring_reserve(ring, &len);
+        if (!p) {
+            break;
+        }
+
+        if (len > n - total) {
+            len = n - total;
+        }
+
+        spr_memcpy(p, (const uint8_t *) data + total, len);
+        spr_ring_commit(ring, len);
+        total += len;
+    }
+
+    return total;
+}
+
+size_t
+spr_ring_read(spr_ring_t *ring, void *buf, size_t n)
+{
+    const uint8_t *p;
+    size_t total, len;
+
+    total = 0;
+
+    while (total < n) {
+        len = 0;
+
+        p = spr_ring_peek(ring, &len);
+        if (!p) {
+            break;
+        }
+
+        if (len > n - total) {
+            len = n - total;
+        }
+
+        spr_memcpy((uint8_t *) buf + total, p, len);
+        spr_ring_release(ring, len);
+        total += len;
+    }
+
+    return total;
+}